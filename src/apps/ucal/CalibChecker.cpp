@@ -128,7 +128,8 @@ CalibChecker::_run(Ookala::PluginChain *chain)
     }
 
     // Retrieve the chain dictionary
-    std::vector<Ookala::Plugin *> plugins = mRegistry->queryByName("DictHash");
+    const std::vector<Ookala::Plugin *> &plugins = 
+                                    mRegistry->queryByName("DictHash");
     if (plugins.empty()) {
         if (debug) {
             fprintf(stderr, "No DictHash found for CalibChecker.");
@@ -336,7 +337,8 @@ CalibChecker::checkLuts(Ookala::CalibRecordDictItem *calibItem)
     std::vector<uint32_t> rCurrLut, gCurrLut, bCurrLut;
 
 
-    std::vector<Ookala::Plugin *> plugins = mRegistry->queryByName("WsLut");
+    const std::vector<Ookala::Plugin *> &plugins = 
+                                    mRegistry->queryByName("WsLut");
     if (plugins.empty()) {
         if (debug) {
             fprintf(stderr, "No WsLut found for CalibChecker.\n");
@@ -358,51 +360,29 @@ CalibChecker::checkLuts(Ookala::CalibRecordDictItem *calibItem)
     //      as "red", "green", and "blue".
     bool     lutsOk = true;
     bool     lutsChecked[3];
-    uint32_t idx;
-    std::vector<uint32_t> calibLut;
 
     lutsChecked[0] = lutsChecked[1] = lutsChecked[2] = false;
 
+    // Compare against the record's luts in place, rather than 
+    // copying each one out.
+
     // Check red.
-    calibLut = calibItem->getLut("red");
     lutsChecked[0] = true;
-    if (calibLut.size() != rCurrLut.size()) {
+    if (calibItem->getLut("red") != rCurrLut) {
         lutsOk = false;
     }
-    for (idx=0; idx<calibLut.size(); ++idx) {
-        if (calibLut[idx] != rCurrLut[idx]) {
-            lutsOk = false;
-            break;
-        }
-    }
-
 
     // Check green.
-    calibLut = calibItem->getLut("green");
     lutsChecked[1] = true;
-    if (calibLut.size() != gCurrLut.size()) {
+    if (calibItem->getLut("green") != gCurrLut) {
         lutsOk = false;
     }
-    for (idx=0; idx<calibLut.size(); ++idx) {
-        if (calibLut[idx] != gCurrLut[idx]) {
-            lutsOk = false;
-            break;
-        }
-    }
-
 
     // Check blue.
-    calibLut = calibItem->getLut("blue");
     lutsChecked[2] = true;
-    if (calibLut.size() != bCurrLut.size()) {
+    if (calibItem->getLut("blue") != bCurrLut) {
         lutsOk = false;
     }
-    for (idx=0; idx<calibLut.size(); ++idx) {
-        if (calibLut[idx] != bCurrLut[idx]) {
-            lutsOk = false;
-            break;
-        }
-    }
 
 
     // Make sure that we've hit all the Luts that we're supposed to,
@@ -432,7 +412,7 @@ CalibChecker::checkDisplayState(Ookala::CalibRecordDictItem *calibItem)
 {
     if (!calibItem) return false;
 
-    std::vector<Ookala::Plugin *> plugins = mRegistry->queryByName(
+    const std::vector<Ookala::Plugin *> &plugins = mRegistry->queryByName(
                             calibItem->getCalibrationPluginName());
     if (plugins.empty()) {
         return false;
@@ -447,7 +427,8 @@ CalibChecker::checkDisplayState(Ookala::CalibRecordDictItem *calibItem)
 bool
 CalibChecker::setIcon(Ookala::PluginChain *chain, const std::string &iconName)
 {
-    std::vector<Ookala::Plugin *> plugins = mRegistry->queryByName("WxIconCtrl");
+    const std::vector<Ookala::Plugin *> &plugins = 
+                                    mRegistry->queryByName("WxIconCtrl");
     if (plugins.empty()) {
         return false;
     }
@@ -39,6 +39,10 @@
     #include <wx/cmdline.h>
 #endif
 
+#include "Plugin.h"
+#include "PluginRegistry.h"
+#include "DataSavior.h"
+
 #include "SessionManage.h"
 #include "Events.h"
 
@@ -51,6 +55,7 @@
 SessionManage::SessionManage(wxApp *app)
 {
     mApp                  = app;
+    mRegistry             = NULL;
     mStartedWorkerThread  = false;
     mShutdownWorkerThread = false;
     mThreadMainCancel     = false;
@@ -138,6 +143,14 @@ printf("SessionManage::shutdown()\n");
     mShutdownWorkerThread = true;
 }
 
+// -----------------------------------------
+//
+void
+SessionManage::setRegistry(Ookala::PluginRegistry *reg)
+{
+    mRegistry = reg;
+}
+
 // -----------------------------------------
 //
 // protected
@@ -389,7 +402,7 @@ SessionManage::smcSaveCallback(SmcConn connection,
                                int       interactStyle,
                                Bool      fast)
 {
-    //SessionManage * us = (SessionManage *)clientData;
+    SessionManage * us = (SessionManage *)clientData;
 
     printf("smcSaveCallback()\n");
     printf("\tsaveType:      %d\n", saveType);
@@ -402,6 +415,25 @@ SessionManage::smcSaveCallback(SmcConn connection,
 
     printf("Set properties\n");
 
+    // Anything the chains saved in the background should be
+    // on disk before we tell the session manager we're done.
+    if (us->mRegistry) {
+        std::vector<Ookala::Plugin *> plugins = 
+                                us->mRegistry->queryByName("DataSavior");
+
+        for (std::vector<Ookala::Plugin *>::iterator thePlugin = 
+                                plugins.begin();
+                thePlugin != plugins.end(); ++thePlugin) {
+            Ookala::DataSavior *savior = 
+                            dynamic_cast<Ookala::DataSavior *>(*thePlugin);
+
+            if ((savior) && (!savior->flush())) {
+                fprintf(stderr, "Error flushing saves: %s\n",
+                                    savior->errorString().c_str());
+            }
+        }
+    }
+
     SmcSaveYourselfDone(connection, True);
 
     printf("Save Done\n");
@@ -42,6 +42,10 @@
 // restored when a user logs back in.
 
 class wxApp;
+namespace Ookala {
+    class PluginRegistry;
+};
+
 class SessionManage
 {
     public:
@@ -64,12 +68,20 @@ class SessionManage
         // _only_ call this from the main thread).
         void shutdown();
 
+        // When the session manager asks us to save, we'll first
+        // wait on any DataSavior saves in reg that are still being
+        // written. Set this before mainloop().
+        void setRegistry(Ookala::PluginRegistry *reg);
+
     protected:
         // Hold a pointer back to the app, so we can get things
         // like argv/argc, as well as posting events into the
         // main loop.
         wxApp          *mApp;
 
+        // For finding DataSaviors to flush; may be NULL.
+        Ookala::PluginRegistry *mRegistry;
+
         // Our worker thread, and a flag set by the main thread that
         // we've previously called pthread_create() or shutdown().
         pthread_t       mWorkerThread;
@@ -42,7 +42,8 @@ WxIconCtrl::WxIconCtrl():
     Ookala::Plugin()
 {
     setName("WxIconCtrl");
-    mTaskbarIcon = NULL;
+    mTaskbarIcon  = NULL;
+    mIconsVersion = 0;
 }
 
 // ----------------------------------
@@ -50,8 +51,10 @@ WxIconCtrl::WxIconCtrl():
 WxIconCtrl::WxIconCtrl(const WxIconCtrl &src):
     Ookala::Plugin(src)
 {
-    mTaskbarIcon = src.mTaskbarIcon;
-    mIcons       = src.mIcons;
+    mTaskbarIcon  = src.mTaskbarIcon;
+    mIcons        = src.mIcons;
+    mIconsVersion = src.mIconsVersion;
+    mIconsWatch   = src.mIconsWatch;
 }
 
 // ----------------------------------
@@ -227,6 +230,17 @@ WxIconCtrl::loadIcons(Ookala::Dict *chainDict)
         return true;
     }
 
+    // We're run every period, so don't go back to the disk unless
+    // the list, or one of the entries it names, has changed since
+    // we last loaded.
+    if ((mIconsVersion != 0) && 
+            (!chainDict->changedSince(mIconsVersion, mIconsWatch))) {
+        return true;
+    }
+    mIconsVersion = chainDict->getVersion();
+    mIconsWatch.clear();
+    mIconsWatch.push_back("WxIconCtrl::load");
+
     // Look for the list of keys to icon files, "WxIconCtrl::load"
     item = chainDict->get("WxIconCtrl::load");
     if (!item) {
@@ -243,6 +257,7 @@ WxIconCtrl::loadIcons(Ookala::Dict *chainDict)
         return true;
     }
     keys = stringArrayItem->get();
+    mIconsWatch.insert(mIconsWatch.end(), keys.begin(), keys.end());
 
     // Walk over all the keys, and look for filenames to load
     for (std::vector<std::string>::iterator theKey = keys.begin();
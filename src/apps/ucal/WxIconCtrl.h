@@ -62,6 +62,11 @@ class WxIconCtrl: public Ookala::Plugin
 
         std::map<std::string, wxIcon> mIcons;
 
+        // Chain dict version when we last loaded icons, and the keys
+        // that went into it, so loadIcons() can skip unchanged work.
+        uint64_t                      mIconsVersion;
+        std::vector<std::string>      mIconsWatch;
+
         // This is currently looking for, in the chain dict:
         //
         //    WxIconCtrl::set  -> name of icon to set [STRING]
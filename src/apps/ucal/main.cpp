@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <errno.h>
 
 
 #include <vector>
@@ -53,6 +54,7 @@
 #include "DataSavior.h"
 #include "PluginChain.h"
 #include "PluginRegistry.h"
+#include "Trace.h"
 
 
 #include "wx/taskbar.h"
@@ -65,6 +67,8 @@
 
 #ifdef __linux__
 #include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
 
@@ -167,6 +171,13 @@ class UcalApp: public wxApp
         std::string                 mManualChainName;
         Ookala::PluginChain        *mManualChain;
 
+        // <loadplugin> files seen since the last other node, 
+        // waiting to be loaded together.
+        std::vector<std::string>    mPluginFiles;
+
+        // From --trace: where to write what was recorded, on exit.
+        std::string                 mTraceFile;
+
 #ifdef __linux__
         SignalHandler               mSignalHandler;
 
@@ -181,21 +192,29 @@ class UcalApp: public wxApp
        
         bool     parseArgs();
 
+        // Wait on any DataSavior saves still being written
+        void     flushSaves();
+
         // Locate where our config happens to be hiding, if we can find anything.       
         bool     findConfigFileXdg(std::string &configFile);
         bool     findConfigFile(std::string &configFile);
 
-        void     handleDictNode(xmlDocPtr doc, xmlNodePtr root, 
+        // Where to keep the plugin manifest, so we only have to 
+        // open the plugin DSOs that a run actually uses.
+        bool     findManifestFile(std::string &manifestFile);
+
+        void     handleDictNode(xmlTextReaderPtr reader, 
                         Ookala::DictHash *dhash, std::string &dictName);
 
-        Ookala::Plugin * handlePluginNode(xmlDocPtr doc, xmlNodePtr root, 
+        Ookala::Plugin * handlePluginNode(xmlTextReaderPtr reader,
                         Ookala::PluginRegistry &reg);
 
-        bool     handleLoadPluginNode(xmlDocPtr doc, xmlNodePtr root,
+        bool     handleLoadPluginNode(xmlTextReaderPtr reader,
                         Ookala::PluginRegistry &reg);
 
-        void     handleXmlNode(xmlDocPtr                           doc,    
-                               xmlNodePtr                          root,      
+        bool     loadPluginFiles(Ookala::PluginRegistry &reg);
+
+        void     handleXmlNode(xmlTextReaderPtr                    reader,    
                                Ookala::DictHash                   *dhash,                       
                                Ookala::PluginRegistry             &reg,  
                                std::vector<Ookala::PluginChain *> &chains);
@@ -474,6 +493,7 @@ bool
 UcalApp::OnInit()
 {
     std::string configFile;
+    std::string manifestFile;
 
     mTaskbar        = NULL;
     mListChains     = false;
@@ -490,6 +510,10 @@ UcalApp::OnInit()
 
     mReg.loadPlugin(new CalibChecker(), NULL, NULL);
 
+    if (findManifestFile(manifestFile)) {
+        mReg.setManifestFile(manifestFile);
+    }
+
     if (!findConfigFile(configFile)) {
         fprintf(stderr, "Unable to locate config file ucal.xml\n");
         return false;
@@ -580,6 +604,7 @@ UcalApp::OnInit()
     // to the session manager
     if (!mManualChainRun) {
         if (mSession.hasSms()) {
+            mSession.setRegistry(&mReg);
             mSession.mainloop(mSessionId);
         }
     }
@@ -595,6 +620,8 @@ UcalApp::OnInit()
                 (*theChain)->run();        
                 mManualChain = NULL;
 
+                flushSaves();
+
 #ifdef __linux__
                 mSignalHandler.shutdown();
 #endif
@@ -638,6 +665,17 @@ UcalApp::OnExit()
         mTaskbar = NULL;
     }
 
+    flushSaves();
+
+    if (!mTraceFile.empty()) {
+        std::string error;
+
+        if (!Ookala::Trace::writeChromeTrace(mTraceFile, error)) {
+            fprintf(stderr, "ERROR: %s\n", error.c_str());
+        }
+        printf("%s", Ookala::Trace::summary().c_str());
+    }
+
 #ifdef __linux__
     if (mSession.hasSms()) {
         mSession.shutdown();
@@ -692,6 +730,27 @@ UcalApp::onSessionKilled(wxEvent &event)
 
 }
 
+// --------------------------------------
+//
+// Chains may have left saves with the DataSavior writer thread,
+// so give them a chance to land before we go away.
+//
+// protected
+void
+UcalApp::flushSaves()
+{
+    std::vector<Ookala::Plugin *> plugins = mReg.queryByName("DataSavior");
+
+    for (std::vector<Ookala::Plugin *>::iterator thePlugin = plugins.begin();
+            thePlugin != plugins.end(); ++thePlugin) {
+        Ookala::DataSavior *savior = dynamic_cast<Ookala::DataSavior *>(*thePlugin);
+
+        if ((savior) && (!savior->flush())) {
+            fprintf(stderr, "ERROR: %s\n", savior->errorString().c_str());
+        }
+    }
+}
+
 
 
 
@@ -718,6 +777,12 @@ UcalApp::parseArgs()
     parser.AddOption(wxT("r"), wxT("run"), _("Execute a chain and exit"),
                          wxCMD_LINE_VAL_STRING);
 
+    // -t "file", --trace "file" -> time chain runs, and write a
+    // Chrome trace to file on exit
+    parser.AddOption(wxT("t"), wxT("trace"),
+                     _("Time chain runs, and write a Chrome trace on exit"),
+                         wxCMD_LINE_VAL_STRING);
+
     // Return and display usage if things go wrong.
     if (parser.Parse(true)) {
         return false;
@@ -731,6 +796,11 @@ UcalApp::parseArgs()
 
     mListChains = parser.Found(wxT("l"));
 
+    if (parser.Found(wxT("t"), &stringVal)) {
+        mTraceFile = stringVal.mb_str();
+        Ookala::Trace::setEnabled(true);
+    }
+
     mManualChainRun = parser.Found(wxT("r"), &stringVal);
     if (mManualChainRun) {
         mManualChainName = stringVal.mb_str();
@@ -891,17 +961,58 @@ UcalApp::findConfigFile(std::string &configFile)
 }
 
 
+// --------------------------------------
+//
+// $XDG_CACHE_HOME/ucal/plugins.xml, with $XDG_CACHE_HOME 
+// being $HOME/.cache by default. Elsewhere, we go without
+// and open every plugin DSO at startup.
+//
+// protected
+
+bool
+UcalApp::findManifestFile(std::string &manifestFile)
+{
+#ifdef __linux__
+    std::string cacheDir;
+
+    if (getenv("XDG_CACHE_HOME")) {
+        cacheDir = getenv("XDG_CACHE_HOME");
+    } else if (getenv("HOME")) {
+        cacheDir = std::string(getenv("HOME")) + std::string("/.cache");
+    } else {
+        return false;
+    }
+
+    mkdir(cacheDir.c_str(), 0755);
+
+    cacheDir += "/ucal";
+    if ((mkdir(cacheDir.c_str(), 0755) != 0) && (errno != EEXIST)) {
+        fprintf(stderr, "WARNING: Can't create %s\n", cacheDir.c_str());
+        return false;
+    }
+
+    manifestFile = cacheDir + std::string("/plugins.xml");
+    return true;
+
+#else
+
+    manifestFile = "";
+    return false;
+
+#endif
+}
+
 // --------------------------------------
 //
 // Deal with <dict>...</dict> nodes. 
 // protected
 void
-UcalApp::handleDictNode(xmlDocPtr doc, xmlNodePtr root, 
+UcalApp::handleDictNode(xmlTextReaderPtr reader, 
                 Ookala::DictHash *dhash, std::string &dictName)
 {
-    if (root == NULL) return;
+    if (reader == NULL) return;
 
-    std::string rootName((char *)root->name);
+    std::string rootName((const char *)xmlTextReaderConstName(reader));
     
     // If node is a dict, grab it's name and unserialize it
     if (rootName == "dict") {
@@ -909,7 +1020,8 @@ UcalApp::handleDictNode(xmlDocPtr doc, xmlNodePtr root,
 
         printf("\tLoading Dict...\n");
         
-        xmlChar *attrName = xmlGetProp(root, (const xmlChar *)("name"));
+        xmlChar *attrName = xmlTextReaderGetAttribute(reader, 
+                                                (const xmlChar *)("name"));
         if (attrName != NULL) {
             dictName = (char *)(attrName);
             xmlFree(attrName);
@@ -924,7 +1036,7 @@ UcalApp::handleDictNode(xmlDocPtr doc, xmlNodePtr root,
             return;
         }
 
-        dict->unserialize(doc, root);
+        dict->unserialize(reader);
         return;
     }
 }
@@ -938,18 +1050,18 @@ UcalApp::handleDictNode(xmlDocPtr doc, xmlNodePtr root,
 // protected
 
 Ookala::Plugin *
-UcalApp::handlePluginNode(xmlDocPtr doc, xmlNodePtr root, 
+UcalApp::handlePluginNode(xmlTextReaderPtr reader,
                                     Ookala::PluginRegistry &registry)
 {
-    if (root == NULL) return NULL;
+    if (reader == NULL) return NULL;
 
-    std::string rootName((char *)root->name);
+    std::string rootName((const char *)xmlTextReaderConstName(reader));
     
     if (rootName == "plugin") {
         std::string pluginName;
         std::vector<Ookala::Plugin *>  plugins;
     
-        xmlChar *value = xmlNodeListGetString(doc, root->xmlChildrenNode, 1);
+        xmlChar *value = xmlTextReaderReadString(reader);
         if (value != NULL) {
             pluginName = (char *)value;            
             xmlFree(value);
@@ -974,23 +1086,25 @@ UcalApp::handlePluginNode(xmlDocPtr doc, xmlNodePtr root,
 
 // --------------------------------------
 //
-// Deal with <loadplugin>filename</loadplugin>. Try to
-// load the file and return if we succeeded/failed.
+// Deal with <loadplugin>filename</loadplugin>. The file is
+// loaded along with any others that follow it, once we get to 
+// something that isn't a <loadplugin>, so their plugins can 
+// all be initialized together.
 //
 // protected
 
 bool
-UcalApp::handleLoadPluginNode(xmlDocPtr doc, xmlNodePtr root,
+UcalApp::handleLoadPluginNode(xmlTextReaderPtr reader,
                            Ookala::PluginRegistry &registry)
 {
-    if (root == NULL) return false;
+    if (reader == NULL) return false;
 
-    std::string rootName((char *)root->name);
+    std::string rootName((const char *)xmlTextReaderConstName(reader));
     
     if (rootName == "loadplugin") {
         std::string pluginName;
     
-        xmlChar *value = xmlNodeListGetString(doc, root->xmlChildrenNode, 1);
+        xmlChar *value = xmlTextReaderReadString(reader);
         if (value != NULL) {
             pluginName = (char *)value;            
             xmlFree(value);
@@ -1000,12 +1114,7 @@ UcalApp::handleLoadPluginNode(xmlDocPtr doc, xmlNodePtr root,
 
         printf("Found plugin; %s\n", pluginName.c_str());
 
-
-        if (!registry.loadPlugin(pluginName.c_str())) {
-            fprintf(stderr, "ERROR: Can't load plugin %s\n",
-                                    pluginName.c_str());
-            return false;
-        }
+        mPluginFiles.push_back(pluginName);
 
         return true;
     }
@@ -1013,35 +1122,60 @@ UcalApp::handleLoadPluginNode(xmlDocPtr doc, xmlNodePtr root,
     return false;
 }
 
+// --------------------------------------
+//
+// Load everything that handleLoadPluginNode() has collected.
+// The registry reports any that fail.
+//
+// protected
+
+bool
+UcalApp::loadPluginFiles(Ookala::PluginRegistry &registry)
+{
+    bool retVal = true;
+
+    if (!mPluginFiles.empty()) {
+        retVal = registry.loadPlugins(mPluginFiles);
+        mPluginFiles.clear();
+    }
+
+    return retVal;
+}
+
 // --------------------------------------
 //
 // This is a big switch statement based on the 
-// tag types we care about. 
+// tag types we care about. reader should be sitting
+// on the start element of the node to handle.
 //
 // protected
 void
-UcalApp::handleXmlNode(xmlDocPtr doc,    
-                       xmlNodePtr root, 
+UcalApp::handleXmlNode(xmlTextReaderPtr reader,
                        Ookala::DictHash *dhash, 
                        Ookala::PluginRegistry &registry,
                        std::vector<Ookala::PluginChain *> &chains)
 {
-    if (root == NULL) return;
+    if (reader == NULL) return;
 
-    //xmlNodePtr  child = NULL;
     std::string dictName;
-    std::string rootName((char *)root->name);
+    std::string rootName((const char *)xmlTextReaderConstName(reader));
     
-    printf("got element: [%s]\n", root->name);
+    printf("got element: [%s]\n", rootName.c_str());
+
+    // Anything other than another plugin to load may need the 
+    // plugins we've seen so far.
+    if (rootName != "loadplugin") {
+        loadPluginFiles(registry);
+    }
 
     // If node is a dict, grab it's name and unserialize it
     if (rootName == "dict") {
-        handleDictNode(doc, root, dhash, dictName);
+        handleDictNode(reader, dhash, dictName);
     }
 
     // If we're supposed to load a plugin, do that.
     if (rootName == "loadplugin") {
-        handleLoadPluginNode(doc, root, registry);
+        handleLoadPluginNode(reader, registry);
     }
 
     // If the node is a chain, grab that.
@@ -1049,7 +1183,7 @@ UcalApp::handleXmlNode(xmlDocPtr doc,
         Ookala::PluginChain   *chain;
 
         chain = new Ookala::PluginChain(&registry);
-        if (!chain->unserialize(doc, root)) {
+        if (!chain->unserialize(reader)) {
             delete chain;
             chain = NULL;
         } else {
@@ -1061,17 +1195,17 @@ UcalApp::handleXmlNode(xmlDocPtr doc,
 
 // ---------------------------------
 // 
-// Open up our config file, walk through the
-// tree, and handle the various tag types
-// that we run into.
+// Open up our config file, stream through it,
+// and handle the various tag types that we run 
+// into directly under the root.
 //
 // protected
 bool
 UcalApp::loadConfig(std::string filename, Ookala::PluginRegistry &reg,
                     std::vector<Ookala::PluginChain *> &chains)
 {
-    xmlDocPtr                      doc;
-    xmlNodePtr                     root, child;
+    xmlTextReaderPtr               reader;
+    int                            ret, rootDepth = -1;
     Ookala::DictHash              *hash = NULL;
     std::vector<Ookala::Plugin *>  plugins;
 
@@ -1083,29 +1217,41 @@ UcalApp::loadConfig(std::string filename, Ookala::PluginRegistry &reg,
 
     hash = (Ookala::DictHash *)(plugins[0]);
  
-    doc = xmlParseFile(filename.c_str());
-    if (doc == NULL) {
+    reader = xmlReaderForFile(filename.c_str(), NULL, 0);
+    if (reader == NULL) {
         printf("Can't parse file\n");
         return false;
     }
 
-    root = xmlDocGetRootElement(doc);
-    if (root == NULL) {
-        printf("no root!\n");
-        return false;
+    while ((ret = xmlTextReaderRead(reader)) == 1) {
+        if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+            continue;
+        }
+
+        if (rootDepth < 0) {
+            rootDepth = xmlTextReaderDepth(reader);
+            printf("root element: %s\n", 
+                        (const char *)xmlTextReaderConstName(reader));
+        } else if (xmlTextReaderDepth(reader) != rootDepth+1) {
+            continue;
+        }
+
+        handleXmlNode(reader, hash, reg, chains); 
     }
 
-    printf("root element: %s\n", root->name);
+    xmlFreeTextReader(reader);
 
-    handleXmlNode(doc, root, hash, reg, chains);
-    child = root->xmlChildrenNode;
-    while (child != NULL) {
-        handleXmlNode(doc, child, hash, reg, chains); 
+    loadPluginFiles(reg);
 
-        child = child->next;
+    if (ret != 0) {
+        printf("Can't parse file\n");
+        return false;
     }
 
-    xmlFreeDoc(doc);
+    if (rootDepth < 0) {
+        printf("no root!\n");
+        return false;
+    }
 
     return true;
 }
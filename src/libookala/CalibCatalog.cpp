@@ -0,0 +1,220 @@
+// --------------------------------------------------------------------------
+// $Id: CalibCatalog.cpp 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+#ifdef _WIN32
+#pragma warning(disable: 4786)
+#endif
+
+#include "CalibCatalog.h"
+
+// ===================================
+// 
+// CalibCatalog
+//
+// -----------------------------------
+//
+Ookala::CalibCatalog::CalibCatalog()
+{
+    mCalibCatalogData = new _CalibCatalog;
+}
+
+// -----------------------------------
+//
+Ookala::CalibCatalog::CalibCatalog(const CalibCatalog &src)
+{
+    mCalibCatalogData = new _CalibCatalog;
+
+    if (src.mCalibCatalogData) {
+        *mCalibCatalogData = *(src.mCalibCatalogData);
+    }
+}
+
+// -----------------------------------
+//
+// virtual
+Ookala::CalibCatalog::~CalibCatalog()
+{
+    if (mCalibCatalogData) {
+        delete mCalibCatalogData;
+        mCalibCatalogData = NULL;
+    }
+}
+
+// ----------------------------
+//
+Ookala::CalibCatalog &
+Ookala::CalibCatalog::operator=(const CalibCatalog &src)
+{
+    if (this != &src) {
+        if (mCalibCatalogData) {
+            delete mCalibCatalogData;
+            mCalibCatalogData = NULL;
+        }
+
+        mCalibCatalogData = new _CalibCatalog;
+        if (src.mCalibCatalogData) {
+            *mCalibCatalogData = *(src.mCalibCatalogData);
+        }
+    }
+
+    return *this;
+}
+
+// -----------------------------------
+//
+void
+Ookala::CalibCatalog::clear()
+{
+    mCalibCatalogData->mRecords.clear();
+    mCalibCatalogData->mByTime.clear();
+    mCalibCatalogData->mByDevice.clear();
+    mCalibCatalogData->mByPreset.clear();
+    mCalibCatalogData->mByPlugin.clear();
+    mCalibCatalogData->mLatest.clear();
+}
+
+// -----------------------------------
+//
+void
+Ookala::CalibCatalog::add(const CalibRecordHandle &handle)
+{
+    size_t   idx  = mCalibCatalogData->mRecords.size();
+    uint32_t time = handle.calibrationTime;
+
+    mCalibCatalogData->mRecords.push_back(handle);
+
+    mCalibCatalogData->mByTime.insert(std::make_pair(time, idx));
+    mCalibCatalogData->mByDevice.insert(std::make_pair(
+                    _CalibCatalogNameKey(handle.deviceId, time), idx));
+    mCalibCatalogData->mByPreset.insert(std::make_pair(
+                    _CalibCatalogIntKey(handle.preset, time), idx));
+    mCalibCatalogData->mByPlugin.insert(std::make_pair(
+                    _CalibCatalogNameKey(handle.calibrationPluginName, 
+                                         time), idx));
+
+    _CalibCatalogNameKey latestKey(handle.deviceId, handle.preset);
+
+    std::map<_CalibCatalogNameKey, size_t>::iterator latest =
+                            mCalibCatalogData->mLatest.find(latestKey);
+    if ((latest == mCalibCatalogData->mLatest.end()) ||
+            (mCalibCatalogData->mRecords[latest->second].calibrationTime
+                                                                <= time)) {
+        mCalibCatalogData->mLatest[latestKey] = idx;
+    }
+}
+
+// -----------------------------------
+//
+uint32_t
+Ookala::CalibCatalog::size() const
+{
+    return (uint32_t)mCalibCatalogData->mRecords.size();
+}
+
+// -----------------------------------
+//
+bool
+Ookala::CalibCatalog::getLatest(const std::string &deviceId, 
+                                uint32_t           preset,
+                                CalibRecordHandle &handle) const
+{
+    std::map<_CalibCatalogNameKey, size_t>::const_iterator latest =
+                    mCalibCatalogData->mLatest.find(
+                                _CalibCatalogNameKey(deviceId, preset));
+
+    if (latest == mCalibCatalogData->mLatest.end()) {
+        return false;
+    }
+
+    handle = mCalibCatalogData->mRecords[latest->second];
+
+    return true;
+}
+
+// -----------------------------------
+//
+std::vector<Ookala::CalibRecordHandle> 
+Ookala::CalibCatalog::getByTime(uint32_t begin, uint32_t end) const
+{
+    return getRange(mCalibCatalogData->mByTime, begin, end);
+}
+
+// -----------------------------------
+//
+std::vector<Ookala::CalibRecordHandle> 
+Ookala::CalibCatalog::getByDevice(const std::string &deviceId,
+                                  uint32_t begin, uint32_t end) const
+{
+    return getRange(mCalibCatalogData->mByDevice, 
+                    _CalibCatalogNameKey(deviceId, begin),
+                    _CalibCatalogNameKey(deviceId, end));
+}
+
+// -----------------------------------
+//
+std::vector<Ookala::CalibRecordHandle> 
+Ookala::CalibCatalog::getByPreset(uint32_t preset,
+                                  uint32_t begin, uint32_t end) const
+{
+    return getRange(mCalibCatalogData->mByPreset, 
+                    _CalibCatalogIntKey(preset, begin),
+                    _CalibCatalogIntKey(preset, end));
+}
+
+// -----------------------------------
+//
+std::vector<Ookala::CalibRecordHandle> 
+Ookala::CalibCatalog::getByPlugin(const std::string &pluginName,
+                                  uint32_t begin, uint32_t end) const
+{
+    return getRange(mCalibCatalogData->mByPlugin, 
+                    _CalibCatalogNameKey(pluginName, begin),
+                    _CalibCatalogNameKey(pluginName, end));
+}
+
+// -----------------------------------
+//
+// Everything in index from begin to end, inclusive.
+//
+// private
+template <class Index, class Key>
+std::vector<Ookala::CalibRecordHandle> 
+Ookala::CalibCatalog::getRange(const Index &index, 
+                               const Key &begin, const Key &end) const
+{
+    std::vector<CalibRecordHandle> handles;
+
+    if (end < begin) {
+        return handles;
+    }
+
+    typename Index::const_iterator last = index.upper_bound(end);
+
+    for (typename Index::const_iterator theRecord = index.lower_bound(begin);
+            theRecord != last; ++theRecord) {
+        handles.push_back(mCalibCatalogData->mRecords[theRecord->second]);
+    }
+
+    return handles;
+}
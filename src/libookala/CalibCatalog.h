@@ -0,0 +1,137 @@
+// --------------------------------------------------------------------------
+// $Id: CalibCatalog.h 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+// 
+// Permission is hereby granted, free of charge, to any person obtaining 
+// a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation 
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the 
+// Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included 
+// in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR 
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR 
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+#ifndef CALIBCATALOG_H_HAS_BEEN_INCLUDED
+#define CALIBCATALOG_H_HAS_BEEN_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "Types.h"
+#include "Plugin.h"
+
+namespace Ookala {
+
+//
+// Where to find one calibRecord, along with the fields it can be
+// searched on. These are cheap to copy around; the rest of the 
+// record only gets read by DataSavior::loadCalibRecord().
+//
+struct CalibRecordHandle
+{
+    std::string deviceId;
+    uint32_t    preset;
+    uint32_t    calibrationTime;        // seconds since epoch
+    std::string calibrationPluginName;
+
+    // The file holding the record, after "%s" substitution, and the
+    // dict and key it was saved under.
+    std::string filename;
+    std::string dictName;
+    std::string key;
+
+    // Where the record starts in the load cache, for xml files,
+    // and the hash of the xml the cache was made from.
+    uint64_t    offset;
+    uint32_t    size;
+    uint64_t    sourceHash;
+};
+
+//
+// An index of calibRecords, filled in by DataSavior::buildCalibCatalog()
+// from the load cache or journal of a file, so nothing has to be 
+// loaded into the DictHash to search it. 
+//
+// Every query returns handles ordered by calibration time, oldest
+// first. The time ranges include both ends.
+//
+// A catalog is just a value; it isn't locked, and doesn't notice if
+// the file changes after it's built.
+//
+class EXIMPORT CalibCatalog
+{
+    public:
+        CalibCatalog();
+        CalibCatalog(const CalibCatalog &src);
+        virtual ~CalibCatalog();
+        CalibCatalog & operator=(const CalibCatalog &src);
+
+        void     clear();
+        void     add(const CalibRecordHandle &handle);
+
+        uint32_t size() const;
+
+        // The newest record for deviceId and preset. Returns false
+        // if there isn't one.
+        bool     getLatest(const std::string &deviceId, uint32_t preset,
+                           CalibRecordHandle &handle) const;
+
+        std::vector<CalibRecordHandle> 
+                 getByTime(uint32_t begin, uint32_t end) const;
+
+        std::vector<CalibRecordHandle> 
+                 getByDevice(const std::string &deviceId,
+                             uint32_t begin = 0, 
+                             uint32_t end   = 0xffffffff) const;
+
+        std::vector<CalibRecordHandle> 
+                 getByPreset(uint32_t preset,
+                             uint32_t begin = 0, 
+                             uint32_t end   = 0xffffffff) const;
+
+        std::vector<CalibRecordHandle> 
+                 getByPlugin(const std::string &pluginName,
+                             uint32_t begin = 0, 
+                             uint32_t end   = 0xffffffff) const;
+
+    private:
+        typedef std::pair<std::string, uint32_t>  _CalibCatalogNameKey;
+        typedef std::pair<uint32_t, uint32_t>     _CalibCatalogIntKey;
+
+        struct _CalibCatalog {
+            std::vector<CalibRecordHandle>                   mRecords;
+
+            // Secondary indexes, holding positions in mRecords. Each
+            // is keyed on the field and then the calibration time.
+            std::multimap<uint32_t, size_t>                  mByTime;
+            std::multimap<_CalibCatalogNameKey, size_t>      mByDevice;
+            std::multimap<_CalibCatalogIntKey, size_t>       mByPreset;
+            std::multimap<_CalibCatalogNameKey, size_t>      mByPlugin;
+
+            // Newest record for each (device, preset)
+            std::map<_CalibCatalogNameKey, size_t>           mLatest;
+        };
+
+        _CalibCatalog *mCalibCatalogData;
+
+        template <class Index, class Key>
+        std::vector<CalibRecordHandle> 
+                 getRange(const Index &index, 
+                          const Key &begin, const Key &end) const;
+};
+
+}; // namespace Ookala
+
+#endif
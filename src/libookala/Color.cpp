@@ -38,6 +38,7 @@ Ookala::Color::Color():
     Plugin()
 {
     setName("Color");
+    declareNoDependencies();
 }
 
 // ----------------------------
@@ -28,6 +28,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -36,8 +39,24 @@
 #include <unistd.h>
 #endif
 
+#ifdef WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <pwd.h>
+#endif
+
+#include <time.h>
+
+#include <thread>
+#include <algorithm>
+
 #include <libxml/xmlmemory.h>
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 
 
 
@@ -47,6 +66,10 @@
 #include "PluginChain.h"
 #include "PluginRegistry.h"
 #include "DataSavior.h"
+#include "Journal.h"
+#include "CalibCatalog.h"
+#include "LutStore.h"
+#include "Pack.h"
 
 // ===================================
 // 
@@ -162,6 +185,15 @@ Ookala::CalibRecordDictItem::operator=(const CalibRecordDictItem &src)
     return *this;
 }
 
+// ----------------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::CalibRecordDictItem::clone() const
+{
+    return new CalibRecordDictItem(*this);
+}
+
 
 
 // -----------------------------------
@@ -375,8 +407,8 @@ Ookala::CalibRecordDictItem::setMeasuredBlue(const Yxy &value)
 
 // -----------------------------------
 //
-std::vector<Ookala::Rgb>      
-Ookala::CalibRecordDictItem::getMeasuredRgb()
+const std::vector<Ookala::Rgb> &
+Ookala::CalibRecordDictItem::getMeasuredRgb() const
 {
     return mCalibRecordDictItemData->measuredRgb;
 }
@@ -389,10 +421,19 @@ Ookala::CalibRecordDictItem::setMeasuredRgb(const std::vector<Rgb> &values)
     mCalibRecordDictItemData->measuredRgb = values;
 }
 
+// -----------------------------------
+//
+void                  
+Ookala::CalibRecordDictItem::setMeasuredRgb(std::vector<Rgb> &&values)
+{  
+    mCalibRecordDictItemData->measuredRgb.swap(values);
+    values.clear();
+}
+
 // -----------------------------------
 //       
-std::vector<Ookala::Yxy>      
-Ookala::CalibRecordDictItem::getMeasuredYxy()
+const std::vector<Ookala::Yxy> &
+Ookala::CalibRecordDictItem::getMeasuredYxy() const
 {
     return mCalibRecordDictItemData->measuredYxy;
 }
@@ -405,6 +446,15 @@ Ookala::CalibRecordDictItem::setMeasuredYxy(const std::vector<Yxy> &values)
     mCalibRecordDictItemData->measuredYxy = values;
 }
 
+// -----------------------------------
+//
+void                  
+Ookala::CalibRecordDictItem::setMeasuredYxy(std::vector<Yxy> &&values)
+{
+    mCalibRecordDictItemData->measuredYxy.swap(values);
+    values.clear();
+}
+
 // -----------------------------------
 //
 std::vector<std::string> 
@@ -423,16 +473,15 @@ Ookala::CalibRecordDictItem::getLutNames()
 
 // -----------------------------------
 //
-std::vector<uint32_t>    
-Ookala::CalibRecordDictItem::getLut(const std::string &key)
+const std::vector<uint32_t> &
+Ookala::CalibRecordDictItem::getLut(const std::string &key) const
 {
-    std::map<std::string, std::vector<uint32_t> >::iterator theIter;
+    static const std::vector<uint32_t>                  nothing;
+    std::map<std::string, std::vector<uint32_t> >::const_iterator theIter;
 
     theIter = mCalibRecordDictItemData->luts.find(key);
 
     if (theIter == mCalibRecordDictItemData->luts.end()) {
-        std::vector<uint32_t> nothing;
-
         return nothing;
     }
 
@@ -449,6 +498,19 @@ Ookala::CalibRecordDictItem::setLut(
     mCalibRecordDictItemData->luts[key] = values;
 }
 
+// -----------------------------------
+//
+void                     
+Ookala::CalibRecordDictItem::setLut(
+                            const std::string      &key, 
+                            std::vector<uint32_t> &&values)
+{
+    std::vector<uint32_t> &lut = mCalibRecordDictItemData->luts[key];
+
+    lut.swap(values);
+    values.clear();
+}
+
 
 
 // -----------------------------------
@@ -460,7 +522,6 @@ Ookala::CalibRecordDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
     StringDictItem      stringItem;
     IntDictItem         intItem;
     DoubleArrayDictItem doubleArrayItem;
-    IntArrayDictItem    intArrayItem;
 
     std::vector<double> doubleVals;
 
@@ -569,8 +630,7 @@ Ookala::CalibRecordDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
         doubleVals.push_back((*theRgbVal).b);
     }
     if (!doubleVals.empty()) {
-        doubleArrayItem.set(doubleVals);
-        serializeSubItem(doc, root, "measuredRgb", &doubleArrayItem);
+        serializeSeries(root, "measuredRgb", doubleVals);
     }
 
     // measuredYxy
@@ -584,24 +644,22 @@ Ookala::CalibRecordDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
         doubleVals.push_back((*theYxyVal).y);
     }
     if (!doubleVals.empty()) {
-        doubleArrayItem.set(doubleVals);
-        serializeSubItem(doc, root, "measuredYxy", &doubleArrayItem);
+        serializeSeries(root, "measuredYxy", doubleVals);
     }
 
-    // luts
+    // luts - written in the same form as an intArray, but straight
+    // from the stored values so we don't build a temporary copy 
+    // of every lut. They're smooth, so each entry is written as
+    // the step from the one before. If we're saving through a
+    // LutStore, just refer to the lut by its hash instead.
+    LutStore *lutStore = LutStore::getCurrent();
+
     for (std::map<std::string, std::vector<uint32_t> >::iterator theLut = 
                           mCalibRecordDictItemData->luts.begin();
                 theLut != mCalibRecordDictItemData->luts.end(); ++theLut) {
         if (! (*theLut).second.empty()) {
-            xmlNodePtr           itemNode;
-            std::vector<int32_t> intVals;
-
-            for (std::vector<uint32_t>::iterator theVal = (*theLut).second.begin();
-                    theVal != (*theLut).second.end(); ++theVal) {
-                intVals.push_back(*theVal);
-            }
-
-            intArrayItem.set(intVals);
+            xmlNodePtr  itemNode;
+            std::string hash;
 
             itemNode = xmlNewTextChild(root, NULL, (const xmlChar *)"dictitem", NULL);
             xmlSetProp(itemNode, (const xmlChar *)"name", (const xmlChar *)"luts");
@@ -609,8 +667,20 @@ Ookala::CalibRecordDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
                                             (const xmlChar *)(*theLut).first.c_str());
 
             xmlSetProp(itemNode, (const xmlChar *)"type", 
-                                 (const xmlChar *)intArrayItem.itemType().c_str());
-            intArrayItem.serialize(doc, itemNode);
+                       (const xmlChar *)IntArrayDictItem::typeKey().str().c_str());
+
+            if (lutStore) {
+                hash = lutStore->add((*theLut).second);
+            }
+            if (!hash.empty()) {
+                xmlSetProp(itemNode, (const xmlChar *)"lut", 
+                                     (const xmlChar *)hash.c_str());
+                continue;
+            }
+
+            serializeDeltaArray(itemNode, 
+                           reinterpret_cast<const int32_t *>(&(*theLut).second[0]),
+                           (*theLut).second.size());
         }
     }
 
@@ -632,10 +702,6 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
     DoubleArrayDictItem  doubleArrayItem;
     IntArrayDictItem     intArrayItem;
 
-    std::vector<double>  doubleVals;
-    std::vector<int32_t> intVals;
-
-
     // Don't check type here, so we can re-use this for derived classes.
 
     printf("Loading calibRecord...\n");
@@ -644,6 +710,7 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
     while (node != NULL) {
         std::string nodeName;
         std::string nodeKey;
+        std::string lutHash;
 
 
         if (node->name != NULL) {
@@ -720,7 +787,7 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
                 fprintf(stderr, 
                     "Error parsing CalibRecordDictItem::targetWhite\n");
             } else {
-                doubleVals = doubleArrayItem.get();
+                const std::vector<double> &doubleVals = doubleArrayItem.get();
 
                 if (doubleVals.size() != 3) {
                     fprintf(stderr, 
@@ -741,7 +808,7 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
                 fprintf(stderr, 
                     "Error parsing CalibRecordDictItem::targetRed\n");
             } else {
-                doubleVals = doubleArrayItem.get();
+                const std::vector<double> &doubleVals = doubleArrayItem.get();
 
                 if (doubleVals.size() != 3) {
                     fprintf(stderr, 
@@ -761,7 +828,7 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
                     "Error parsing CalibRecordDictItem::targetGreen\n");
             } else {
 
-                doubleVals = doubleArrayItem.get();
+                const std::vector<double> &doubleVals = doubleArrayItem.get();
 
                 if (doubleVals.size() != 3) {
                     fprintf(stderr, 
@@ -782,7 +849,7 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
                     "Error parsing CalibRecordDictItem::targetBlue\n");
             } else {
 
-                doubleVals = doubleArrayItem.get();
+                const std::vector<double> &doubleVals = doubleArrayItem.get();
 
                 if (doubleVals.size() != 3) {
                     fprintf(stderr, 
@@ -802,7 +869,7 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
                     "Error parsing CalibRecordDictItem::measuredWhite\n");
             } else {
 
-                doubleVals = doubleArrayItem.get();
+                const std::vector<double> &doubleVals = doubleArrayItem.get();
 
                 if (doubleVals.size() != 3) {
                     fprintf(stderr, 
@@ -821,7 +888,7 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
                 fprintf(stderr, 
                     "Error parsing CalibRecordDictItem::measuredRed\n");
             } else {
-                doubleVals = doubleArrayItem.get();
+                const std::vector<double> &doubleVals = doubleArrayItem.get();
 
                 if (doubleVals.size() != 3) {
                     fprintf(stderr, 
@@ -840,7 +907,7 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
                 fprintf(stderr, 
                     "Error parsing CalibRecordDictItem::measuredGreen\n");
             } else {
-                doubleVals = doubleArrayItem.get();
+                const std::vector<double> &doubleVals = doubleArrayItem.get();
 
                 if (doubleVals.size() != 3) {
                     fprintf(stderr, 
@@ -860,7 +927,7 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
                 fprintf(stderr, 
                     "Error parsing CalibRecordDictItem::measuredBlue\n");
             } else {
-                doubleVals = doubleArrayItem.get();
+                const std::vector<double> &doubleVals = doubleArrayItem.get();
 
                 if (doubleVals.size() != 3) {
                     fprintf(stderr, 
@@ -879,10 +946,10 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
                 fprintf(stderr, 
                     "Error parsing CalibRecordDictItem::measuredBlue\n");
             } else {
-                doubleVals = doubleArrayItem.get();
+                const std::vector<double> &doubleVals = doubleArrayItem.get();
 
                 mCalibRecordDictItemData->measuredRgb.clear();
-                for (uint32_t idx=0; idx<doubleVals.size(); idx+=3) {
+                for (uint32_t idx=0; 3*idx<doubleVals.size(); ++idx) {
                     Rgb rgb;
 
                     if (3*idx   < doubleVals.size())  rgb.r = doubleVals[3*idx];
@@ -901,10 +968,10 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
                     "Error parsing CalibRecordDictItem::measuredBlue\n");
             } else {
 
-                doubleVals = doubleArrayItem.get();
+                const std::vector<double> &doubleVals = doubleArrayItem.get();
 
                 mCalibRecordDictItemData->measuredYxy.clear();
-                for (uint32_t idx=0; idx<doubleVals.size(); idx+=3) {
+                for (uint32_t idx=0; 3*idx<doubleVals.size(); ++idx) {
                     Yxy val;
 
                     if (3*idx   < doubleVals.size())  val.Y = doubleVals[3*idx];
@@ -919,24 +986,35 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
         // luts
         if (nodeName == "luts") {
 
+            attrName = xmlGetProp(node, (const xmlChar *)("lut"));
+            if (attrName != NULL) {
+                lutHash = (char *)(attrName);
+                xmlFree(attrName);
+            }
+
             if (nodeKey.empty()) {
                 fprintf(stderr, "Error parsing CalibRecordDictItem::luts; No key\n");
+            } else if (!lutHash.empty()) {
+                LutStore *lutStore = LutStore::getCurrent();
+
+                if ((!lutStore) || 
+                        (!lutStore->get(lutHash, 
+                                    mCalibRecordDictItemData->luts[nodeKey]))) {
+                    fprintf(stderr, 
+                        "Error parsing CalibRecordDictItem::luts; "
+                        "Missing lut %s\n", lutHash.c_str());
+                    mCalibRecordDictItemData->luts.erase(nodeKey);
+                }
             } else {
                 if (!intArrayItem.unserialize(doc, node)) {
                     fprintf(stderr, 
                         "Error parsing CalibRecordDictItem::luts\n");
                 } else {
 
-                    intVals = intArrayItem.get();
-
-                    std::vector<uint32_t> newVals;
+                    const std::vector<int32_t> &intVals = intArrayItem.get();
 
-                    for (std::vector<int32_t>::iterator theVal = intVals.begin();
-                            theVal != intVals.end(); ++theVal) {
-                        newVals.push_back(*theVal);
-                    }
-
-                    mCalibRecordDictItemData->luts[nodeKey] = newVals;
+                    mCalibRecordDictItemData->luts[nodeKey].assign(
+                                            intVals.begin(), intVals.end());
                 }
             }
         }
@@ -949,6 +1027,131 @@ Ookala::CalibRecordDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
     return true;
 }
 
+// -----------------------------------
+//
+// virtual
+bool
+Ookala::CalibRecordDictItem::serializeBinary(std::string &buf)
+{
+    _CalibRecordDictItem *data = mCalibRecordDictItemData;
+    const Yxy             yxy[8] = {
+                            data->targetWhite,   data->targetRed,
+                            data->targetGreen,   data->targetBlue,
+                            data->measuredWhite, data->measuredRed,
+                            data->measuredGreen, data->measuredBlue };
+
+    packString(buf, data->deviceId);
+    packU32(buf,    data->calibrationTime);
+    packString(buf, data->calibrationPluginName);
+    packU32(buf,    data->preset);
+    packString(buf, data->presetName);
+
+    for (int idx=0; idx<8; ++idx) {
+        packDouble(buf, yxy[idx].Y);
+        packDouble(buf, yxy[idx].x);
+        packDouble(buf, yxy[idx].y);
+    }
+
+    packU32(buf, (uint32_t)data->measuredRgb.size());
+    for (std::vector<Rgb>::const_iterator i = data->measuredRgb.begin();
+            i != data->measuredRgb.end(); ++i) {
+        packDouble(buf, (*i).r);
+        packDouble(buf, (*i).g);
+        packDouble(buf, (*i).b);
+    }
+
+    packU32(buf, (uint32_t)data->measuredYxy.size());
+    for (std::vector<Yxy>::const_iterator i = data->measuredYxy.begin();
+            i != data->measuredYxy.end(); ++i) {
+        packDouble(buf, (*i).Y);
+        packDouble(buf, (*i).x);
+        packDouble(buf, (*i).y);
+    }
+
+    packU32(buf, (uint32_t)data->luts.size());
+    for (std::map<std::string, std::vector<uint32_t> >::const_iterator 
+            lut = data->luts.begin(); lut != data->luts.end(); ++lut) {
+        packString(buf, lut->first);
+        packU32(buf, (uint32_t)lut->second.size());
+        for (std::vector<uint32_t>::const_iterator i = lut->second.begin();
+                i != lut->second.end(); ++i) {
+            packU32(buf, *i);
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+// virtual
+bool
+Ookala::CalibRecordDictItem::unserializeBinary(PackReader &reader)
+{
+    _CalibRecordDictItem *data = mCalibRecordDictItemData;
+    Yxy                  *yxy[8] = {
+                            &data->targetWhite,   &data->targetRed,
+                            &data->targetGreen,   &data->targetBlue,
+                            &data->measuredWhite, &data->measuredRed,
+                            &data->measuredGreen, &data->measuredBlue };
+    uint32_t              count;
+
+    data->deviceId              = reader.str();
+    data->calibrationTime       = reader.u32();
+    data->calibrationPluginName = reader.str();
+    data->preset                = reader.u32();
+    data->presetName            = reader.str();
+
+    for (int idx=0; idx<8; ++idx) {
+        yxy[idx]->Y = reader.f64();
+        yxy[idx]->x = reader.f64();
+        yxy[idx]->y = reader.f64();
+    }
+
+    // Check counts against what's left before sizing anything
+    // from them.
+    count = reader.u32();
+    if ((!reader.ok()) || (reader.left() / 24 < count)) {
+        return false;
+    }
+    data->measuredRgb.resize(count);
+    for (uint32_t idx=0; idx<count; ++idx) {
+        data->measuredRgb[idx].r = reader.f64();
+        data->measuredRgb[idx].g = reader.f64();
+        data->measuredRgb[idx].b = reader.f64();
+    }
+
+    count = reader.u32();
+    if ((!reader.ok()) || (reader.left() / 24 < count)) {
+        return false;
+    }
+    data->measuredYxy.resize(count);
+    for (uint32_t idx=0; idx<count; ++idx) {
+        data->measuredYxy[idx].Y = reader.f64();
+        data->measuredYxy[idx].x = reader.f64();
+        data->measuredYxy[idx].y = reader.f64();
+    }
+
+    data->luts.clear();
+    count = reader.u32();
+    for (uint32_t idx=0; (idx<count) && (reader.ok()); ++idx) {
+        std::string name = reader.str();
+        uint32_t    size = reader.u32();
+
+        if ((!reader.ok()) || (reader.left() / 4 < size)) {
+            return false;
+        }
+
+        std::vector<uint32_t> &lut = data->luts[name];
+        lut.resize(size);
+        for (uint32_t i=0; i<size; ++i) {
+            lut[i] = reader.u32();
+        }
+    }
+
+    return reader.ok();
+}
+
 // -----------------------------------
 //
 // virtual
@@ -1035,236 +1238,2114 @@ Ookala::CalibRecordDictItem::serializeSubItem(
 }
 
 
-
-// ===================================
-// 
-// DataSavior
-//
 // -----------------------------------
 //
-Ookala::DataSavior::DataSavior():
-    Plugin()
-{
-    setName("DataSavior");
-}
-
-// -----------------------------------
+// Write a series of 3 component measurements as a doubleArray,
+// with each component stored relative to the same component of
+// the previous measurement.
 //
-Ookala::DataSavior::DataSavior(const DataSavior &src):
-    Plugin(src)
+// protected
+void
+Ookala::CalibRecordDictItem::serializeSeries(xmlNodePtr root,
+                    const char *name, const std::vector<double> &values)
 {
+    xmlNodePtr          itemNode;
 
-}
+    itemNode = xmlNewTextChild(root, NULL, (const xmlChar *)"dictitem", NULL);
+    xmlSetProp(itemNode, (const xmlChar *)"name", (const xmlChar *)name);
+    xmlSetProp(itemNode, (const xmlChar *)"type", 
+               (const xmlChar *)DoubleArrayDictItem::typeKey().str().c_str());
 
-// -----------------------------------
-//
-// virtual
-Ookala::DataSavior::~DataSavior()
-{
+    serializeDeltaArray(itemNode, &values[0], values.size(), 3);
 }
 
-// ----------------------------
+// ===================================
+// 
+// Load caches
 //
-Ookala::DataSavior &
-Ookala::DataSavior::operator=(const DataSavior &src)
-{
-    if (this != &src) {
-        Plugin::operator=(src);
-    }
+// -----------------------------------
 
-    return *this;
-}
+#define _DATASAVIOR_CACHE_MAGIC    "OMCFCACH"
+#define _DATASAVIOR_CACHE_VERSION  2
+#define _DATASAVIOR_CACHE_SUFFIX   ".cache"
 
+#define _DATASAVIOR_CACHE_BINARY   0
+#define _DATASAVIOR_CACHE_XML      1
 
-// -----------------------------------
-//
-// virtual
-bool
-Ookala::DataSavior::save(std::vector<Dict *>      dicts,
-                         std::vector<std::string> filenames)
-{
-printf("DataSavior::save() - %d elements\n", (int)dicts.size());
+// How many different saves saveAsync() will hold before it
+// waits on the writer.
+#define _DATASAVIOR_MAX_QUEUED_WRITES  4
 
-    xmlDocPtr doc = xmlNewDoc((const xmlChar *)("1.0"));
-    if (doc == NULL) {
-        setErrorString("Error creating XML document.");
-        return false;
-    }
+namespace {
 
-    xmlNodePtr cur = xmlNewNode(NULL,(const xmlChar *)("DataSavior"));
+// A read-only view of a whole file; mapped where we can, read
+// in where we can't.
+class _DataSaviorMappedFile
+{
+    public:
+        _DataSaviorMappedFile(): mData(NULL), mSize(0) {}
 
-    xmlDocSetRootElement(doc, cur);
+        ~_DataSaviorMappedFile() {
+#ifndef WIN32
+            if ((mData) && (mBuffer.empty())) {
+                munmap((void *)mData, mSize);
+            }
+#endif
+        }
 
-    for (std::vector<Dict *>::iterator theDict = dicts.begin();
-            theDict != dicts.end(); ++theDict) {
-        (*theDict)->serialize(doc, cur);
-    }
-    
-    // We want to save the same data to multiple places. For example,
-    // we might want to save a local copy and copy on a network
-    // mount. The net-mount would be useful for book-keeping by
-    // admins, while the local version would be useful if we 
-    // get disconnected from the net-mount.
+        bool open(const std::string &filename) {
+#ifndef WIN32
+            struct stat statbuf;
+            int         fd = ::open(filename.c_str(), O_RDONLY);
 
-    for (std::vector<std::string>::iterator theName = filenames.begin();
-            theName != filenames.end(); ++theName) {
-        std::string finalName = getFilename(*theName);
+            if (fd < 0) {
+                return false;
+            }
 
-        xmlSaveFormatFile(finalName.c_str(), doc, 1);
-    }
+            if ((fstat(fd, &statbuf) != 0) || (statbuf.st_size == 0)) {
+                close(fd);
+                return false;
+            }
 
+            void *data = mmap(NULL, (size_t)statbuf.st_size, PROT_READ,
+                              MAP_PRIVATE, fd, 0);
+            close(fd);
 
-    xmlFreeDoc(doc);
+            if (data == MAP_FAILED) {
+                return false;
+            }
 
+            mData = (const uint8_t *)data;
+            mSize = (size_t)statbuf.st_size;
+#else
+            FILE *fid = fopen(filename.c_str(), "rb");
+            if (!fid) {
+                return false;
+            }
 
-    return true;
-}
+            fseek(fid, 0, SEEK_END);
+            long size = ftell(fid);
+            fseek(fid, 0, SEEK_SET);
 
-// -----------------------------------
-//
-// virtual
-bool
-Ookala::DataSavior::load(std::vector<std::string> filenames)
-{
-    xmlDocPtr              doc;
-    xmlNodePtr             root, child;
-    DictHash              *hash = NULL;
-    std::vector<Plugin *>  plugins;
+            if (size <= 0) {
+                fclose(fid);
+                return false;
+            }
 
-    if (filenames.empty()) {
-        setErrorString("No file names to load.");
-        return false;
-    }
+            mBuffer.resize(size);
+            if (fread(&mBuffer[0], 1, size, fid) != (size_t)size) {
+                fclose(fid);
+                return false;
+            }
+            fclose(fid);
 
-    if (mRegistry == NULL) {
-        setErrorString("No PluginRegistry in DataSavior.");
-        return false;
-    }
+            mData = &mBuffer[0];
+            mSize = mBuffer.size();
+#endif
+            return true;
+        }
 
+        const uint8_t *data() const { return mData; }
+        size_t         size() const { return mSize; }
 
-    // Choose the newest file to deal with
+    private:
+        const uint8_t        *mData;
+        size_t                mSize;
+        std::vector<uint8_t>  mBuffer;
 
-    std::string newestFilename = "";
-    time_t      newestMTime    = 0;
-    for (std::vector<std::string>::iterator theName = filenames.begin();
-            theName != filenames.end(); ++theName) {
-        std::string realFilename = getFilename(*theName);
+        _DataSaviorMappedFile(const _DataSaviorMappedFile &src);
+        _DataSaviorMappedFile & operator=(const _DataSaviorMappedFile &src);
+};
+
+// -----------------------------------
 
+bool
+_dataSaviorStat(const std::string &filename, uint64_t &mtime, uint64_t &size)
+{
 #ifdef WIN32
-        struct _stat statbuf;
-        if (_stat(realFilename.c_str(), &statbuf) != 0) {
+    struct _stat statbuf;
+    if (_stat(filename.c_str(), &statbuf) != 0) {
 #else
-        struct stat statbuf;
-        if (stat(realFilename.c_str(), &statbuf) != 0) {
+    struct stat statbuf;
+    if (stat(filename.c_str(), &statbuf) != 0) {
 #endif
-            continue;
-        }
-
-        if (statbuf.st_mtime > newestMTime) {
-            newestMTime    = statbuf.st_mtime;
-            newestFilename = realFilename;
-        }
+        return false;
     }
 
-    if ((newestFilename == "")        || 
-         (newestFilename.size() == 0) ||
-         (newestMTime == 0)) {
+    mtime = (uint64_t)statbuf.st_mtime;
+    size  = (uint64_t)statbuf.st_size;
 
-        setErrorString("No files found.");
+    return true;
+}
+
+// -----------------------------------
+//
+// Check that cache was made from filename as it is now, and leave
+// reader just past the header. Hashing the file is the slow part,
+// and can be skipped if the mtime and size are enough. hash gets
+// the one recorded in the cache.
+
+bool
+_dataSaviorCheckCache(const _DataSaviorMappedFile &cache, 
+                      const std::string &filename, bool checkHash,
+                      Ookala::PackReader &reader, uint64_t &hash)
+{
+    uint64_t mtime, size;
+
+    if (!_dataSaviorStat(filename, mtime, size)) {
         return false;
     }
 
-    printf("Loading %s...\n", newestFilename.c_str());
+    reader = Ookala::PackReader(cache.data(), cache.size());
 
-    plugins = mRegistry->queryByName("DictHash");
-    if (plugins.empty()) {
-        fprintf(stderr, "No DictHash found\n");
+    if ((!reader.skip(strlen(_DATASAVIOR_CACHE_MAGIC))) ||
+            (memcmp(cache.data(), _DATASAVIOR_CACHE_MAGIC, 
+                    strlen(_DATASAVIOR_CACHE_MAGIC))) ||
+            (reader.u32() != _DATASAVIOR_CACHE_VERSION)) {
         return false;
     }
+    reader.u32();
 
-    hash = dynamic_cast<DictHash *>(plugins[0]);
-    if (!hash) {
-        fprintf(stderr, "No DictHash found\n");
+    if ((reader.u64() != mtime) || (reader.u64() != size)) {
         return false;
     }
- 
-    doc = xmlParseFile(newestFilename.c_str());
-    if (doc == NULL) {
-        setErrorString(std::string("Can't open ") + newestFilename);
-        return false;
+
+    hash = reader.u64();
+    if (checkHash) {
+        _DataSaviorMappedFile source;
+
+        if ((!source.open(filename)) ||
+                (hash != Ookala::packHash(source.data(), source.size()))) {
+            return false;
+        }
     }
 
-    root = xmlDocGetRootElement(doc);
-    if (root == NULL) {
-        setErrorString(std::string("No root element in ") + newestFilename);
+    return reader.ok();
+}
+
+// -----------------------------------
+//
+// Make a handle for each calibRecord in the cache for filename. 
+// Only the fields at the front of each record are read.
+
+bool
+_dataSaviorCacheRecords(const std::string &filename,
+                        std::vector<Ookala::CalibRecordHandle> &handles)
+{
+    _DataSaviorMappedFile cache;
+    Ookala::PackReader    reader(NULL, 0);
+    uint64_t              sourceHash;
+
+    if ((!cache.open(filename + _DATASAVIOR_CACHE_SUFFIX)) ||
+            (!_dataSaviorCheckCache(cache, filename, true, reader, 
+                                    sourceHash))) {
         return false;
     }
 
-    child = root->xmlChildrenNode;
-    while (child != NULL) {
+    uint32_t numDicts = reader.u32();
+    for (uint32_t dictIdx=0; (dictIdx<numDicts) && (reader.ok()); 
+                                                        ++dictIdx) {
+        std::string dictName = reader.str();
+        uint64_t    offset   = reader.u64();
+        uint64_t    length   = reader.u64();
 
-        std::string nodeName((char *)child->name);
-        if (nodeName == "dict") {
-            
-            std::string dictName;
+        if ((!reader.ok()) || (offset > cache.size()) || 
+                (length > cache.size() - offset)) {
+            return false;
+        }
 
-            xmlChar *attrName = xmlGetProp(child, (const xmlChar *)("name"));
-            if (attrName != NULL) {
-                dictName = (char *)(attrName);
-                xmlFree(attrName);
-            }
+        Ookala::PackReader dictReader(cache.data() + offset, 
+                                      (size_t)length);
+        uint32_t           numItems = dictReader.u32();
 
-            Dict *dict = hash->newDict(dictName.c_str());
-            if (!dict) {
-                setErrorString(std::string("Unable to create dict in ")
-                                                         + newestFilename);
+        for (uint32_t itemIdx=0; (itemIdx<numItems) && (dictReader.ok());
+                                                            ++itemIdx) {
+            std::string    key  = dictReader.str();
+            std::string    type = dictReader.str();
+            uint8_t        form = dictReader.u8();
+            uint32_t       len  = dictReader.u32();
+            const uint8_t *data = dictReader.ptr();
+
+            if (!dictReader.skip(len)) {
                 return false;
             }
 
-            if (!dict->unserialize(doc, child)) {
-                setErrorString(std::string("Error unserializing dict in ")
-                                                         + newestFilename);
-                return false;
+            if ((form != _DATASAVIOR_CACHE_BINARY) || 
+                    (type != "calibRecord")) {
+                continue;
             }
 
-            dict->debug();
+            Ookala::CalibRecordHandle handle;
+            Ookala::PackReader        itemReader(data, len);
+
+            handle.deviceId              = itemReader.str();
+            handle.calibrationTime       = itemReader.u32();
+            handle.calibrationPluginName = itemReader.str();
+            handle.preset                = itemReader.u32();
+            handle.filename              = filename;
+            handle.dictName              = dictName;
+            handle.key                   = key;
+            handle.offset                = (uint64_t)(data - cache.data());
+            handle.size                  = len;
+            handle.sourceHash            = sourceHash;
+
+            if (itemReader.ok()) {
+                handles.push_back(handle);
+            }
         }
 
-        child = child->next;
+        if (!dictReader.ok()) {
+            return false;
+        }
     }
 
-    xmlFreeDoc(doc);
-
-    return true;
+    return reader.ok();
 }
 
 // -----------------------------------
 //
-// Perform any string substitution on file names that we
-// get as input to form proper file names
-//
-// protected
-std::string
-Ookala::DataSavior::getFilename(std::string filePattern)
-{
-    std::string replaceSrc("%s");
-    std::string replaceDst;
-    std::string replaced, orig;
-    char        buf[1024];
+// Write size bytes to filename by way of a temporary file that's
+// synced and renamed into place, so anyone reading filename sees 
+// either all of the old contents or all of the new. On failure,
+// error says what went wrong.
 
-    gethostname(buf, 1023);
-    replaceDst = buf;
+bool
+_dataSaviorWriteFile(const std::string &filename, const char *data,
+                     size_t size, std::string &error)
+{
+    std::string tmpName = filename + ".tmp";
+    FILE       *fid;
+    bool        ok;
+
+    fid = fopen(tmpName.c_str(), "wb");
+    if (!fid) {
+        error = std::string("Can't open ") + tmpName + ": " + 
+                                                strerror(errno);
+        return false;
+    }
+
+    ok = (fwrite(data, 1, size, fid) == size);
+    ok = (fflush(fid) == 0) && ok;
+#ifdef WIN32
+    ok = (_commit(_fileno(fid)) == 0) && ok;
+#else
+    ok = (fsync(fileno(fid)) == 0) && ok;
+#endif
+    int err = errno;
+    ok = (fclose(fid) == 0) && ok;
+
+    if (!ok) {
+        error = std::string("Error writing ") + tmpName + ": " + 
+                                                strerror(err);
+        remove(tmpName.c_str());
+        return false;
+    }
+
+#ifdef WIN32
+    if (!MoveFileExA(tmpName.c_str(), filename.c_str(),
+                     MOVEFILE_REPLACE_EXISTING)) {
+#else
+    if (rename(tmpName.c_str(), filename.c_str()) != 0) {
+#endif
+        error = std::string("Can't rename ") + tmpName + " to " + 
+                                                filename;
+        remove(tmpName.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+// Thread body for each file that save() writes.
+
+void
+_dataSaviorWriteTarget(const std::string *filename, const xmlChar *text,
+                       int size, char *written, std::string *error)
+{
+    *written = _dataSaviorWriteFile(*filename, (const char *)text, 
+                                    (size_t)size, *error);
+}
+
+
+// -----------------------------------
+//
+// The host and user that file name patterns expand to. Neither 
+// changes while we're running, so they're only looked up once.
+
+void
+_dataSaviorHostUser(std::string &host, std::string &user)
+{
+    static Ookala::Mutex mutex;
+    static bool          resolved = false;
+    static std::string   cachedHost;
+    static std::string   cachedUser;
+
+    mutex.lock();
+
+    if (!resolved) {
+        char        buf[1024];
+        const char *name;
+
+        memset(buf, 0, sizeof(buf));
+        if (gethostname(buf, sizeof(buf) - 1) == 0) {
+            cachedHost = buf;
+        }
+
+        name = getenv("USER");
+        if ((!name) || (!name[0])) {
+            name = getenv("LOGNAME");
+        }
+#ifdef WIN32
+        if ((!name) || (!name[0])) {
+            name = getenv("USERNAME");
+        }
+#else
+        if ((!name) || (!name[0])) {
+            struct passwd *pw = getpwuid(geteuid());
+            if (pw) {
+                name = pw->pw_name;
+            }
+        }
+#endif
+        if (name) {
+            cachedUser = name;
+        }
+
+        resolved = true;
+    }
+
+    host = cachedHost;
+    user = cachedUser;
+
+    mutex.unlock();
+}
+
+// -----------------------------------
+//
+// Today's local date as YYYYMMDD
+
+int
+_dataSaviorToday()
+{
+    time_t    now = time(NULL);
+    struct tm local;
+
+#ifdef WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+
+    return (local.tm_year + 1900) * 10000 + (local.tm_mon + 1) * 100 +
+            local.tm_mday;
+}
+
+// -----------------------------------
+//
+// Does a (expanded) file name have wildcards in it?
+
+bool
+_dataSaviorIsGlob(const std::string &filename)
+{
+    return filename.find_first_of("*?[") != std::string::npos;
+}
+
+// -----------------------------------
+//
+// Substitute the tokens in a file name pattern:
+//
+//    %s, %h   host name
+//    %u       user name
+//    %d       device id, with any '/' turned into '_'
+//    %D       date, as YYYYMMDD
+//    %%       a single '%'
+//
+// Anything else after a '%' is left alone.
+
+std::string
+_dataSaviorExpand(const std::string &pattern, const std::string &host,
+                  const std::string &user, const std::string &deviceId,
+                  int today)
+{
+    std::string expanded;
+    char        date[16];
+
+    expanded.reserve(pattern.size() + host.size());
+
+    for (size_t idx = 0; idx < pattern.size(); ++idx) {
+        if ((pattern[idx] != '%') || (idx + 1 == pattern.size())) {
+            expanded.push_back(pattern[idx]);
+            continue;
+        }
+
+        switch (pattern[idx + 1]) {
+            case 's':
+            case 'h':
+                expanded += host;
+                break;
+
+            case 'u':
+                expanded += user;
+                break;
+
+            case 'd':
+                for (size_t chr = 0; chr < deviceId.size(); ++chr) {
+                    expanded.push_back(deviceId[chr] == '/'? 
+                                                    '_': deviceId[chr]);
+                }
+                break;
+
+            case 'D':
+                snprintf(date, sizeof(date), "%08d", today);
+                expanded += date;
+                break;
+
+            case '%':
+                expanded.push_back('%');
+                break;
+
+            default:
+                expanded.push_back('%');
+                expanded.push_back(pattern[idx + 1]);
+                break;
+        }
+        ++idx;
+    }
+
+    return expanded;
+}
+
+// -----------------------------------
+//
+// Files we keep beside the real ones, which a wildcard 
+// shouldn't pick up.
+
+bool
+_dataSaviorIsSidecar(const char *name)
+{
+    static const char *suffixes[] = { 
+        _DATASAVIOR_CACHE_SUFFIX, ".tmp", ".compact", ".lock", NULL };
+
+    size_t len = strlen(name);
+
+    for (int idx = 0; suffixes[idx]; ++idx) {
+        size_t suffixLen = strlen(suffixes[idx]);
+
+        if ((len > suffixLen) && 
+                (!strcmp(name + len - suffixLen, suffixes[idx]))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// -----------------------------------
+//
+// One of the expanded file names that getNewestFilename() is
+// choosing between, split into its directory and the last
+// part of the name. order is its place in the list, which 
+// breaks ties in mtime.
+
+struct _DataSaviorCandidate
+{
+    std::string leaf;
+    size_t      order;
+    bool        glob;
+};
+
+// -----------------------------------
+//
+// The newest file so far. Ties go to whichever came first in 
+// the list of names, and then to the name that sorts last, so 
+// that dated names favor the latest.
+
+struct _DataSaviorNewest
+{
+    _DataSaviorNewest(): found(false), mtime(0), order(0) {}
+
+    void consider(const std::string &filename, uint64_t fileMTime,
+                  size_t fileOrder) {
+        if ((found) &&
+                ((fileMTime < mtime) ||
+                 ((fileMTime == mtime) && (fileOrder > order)) ||
+                 ((fileMTime == mtime) && (fileOrder == order) &&
+                        (filename <= name)))) {
+            return;
+        }
+
+        found = true;
+        mtime = fileMTime;
+        order = fileOrder;
+        name  = filename;
+    }
+
+    bool        found;
+    uint64_t    mtime;
+    size_t      order;
+    std::string name;
+};
+
+// -----------------------------------
+//
+// Check everything in dir against candidates with a single pass
+// over the directory, rather than a stat for each name we 
+// might be looking for.
+
+void
+_dataSaviorScanDir(const std::string                        &dir,
+                   const std::vector<_DataSaviorCandidate>  &candidates,
+                   _DataSaviorNewest                        &newest)
+{
+#ifndef WIN32
+    DIR           *dirp;
+    struct dirent *entry;
+    struct stat    statbuf;
+
+    dirp = opendir(dir.empty()? ".": dir.c_str());
+    if (!dirp) {
+        return;
+    }
+
+    while ((entry = readdir(dirp)) != NULL) {
+        if ((!strcmp(entry->d_name, ".")) || 
+                (!strcmp(entry->d_name, "..")) ||
+                (_dataSaviorIsSidecar(entry->d_name))) {
+            continue;
+        }
+
+        for (std::vector<_DataSaviorCandidate>::const_iterator 
+                    theCandidate = candidates.begin();
+                theCandidate != candidates.end(); ++theCandidate) {
+
+            if (theCandidate->glob) {
+                if (fnmatch(theCandidate->leaf.c_str(), entry->d_name,
+                            FNM_PERIOD) != 0) {
+                    continue;
+                }
+            } else if (theCandidate->leaf != entry->d_name) {
+                continue;
+            }
+
+            if ((fstatat(dirfd(dirp), entry->d_name, &statbuf, 0) != 0) ||
+                    (!S_ISREG(statbuf.st_mode))) {
+                break;
+            }
+
+            std::string filename(entry->d_name);
+            if (dir == "/") {
+                filename = dir + filename;
+            } else if (!dir.empty()) {
+                filename = dir + "/" + filename;
+            }
+
+            newest.consider(filename, (uint64_t)statbuf.st_mtime,
+                            theCandidate->order);
+            break;
+        }
+    }
+
+    closedir(dirp);
+#endif
+}
+
+
+// -----------------------------------
+//
+// Look at the tag starting with the '<' at data[start]. Returns
+// the offset just past its '>', or 0 if there isn't a whole tag 
+// there; <?...?>, <!...> and anything mangled all count as 
+// not being a tag.
+
+size_t
+_dataSaviorTag(const char *data, size_t size, size_t start,
+               std::string &name, bool &closing, bool &empty)
+{
+    size_t pos = start + 1;
+
+    closing = ((pos < size) && (data[pos] == '/'));
+    if (closing) {
+        ++pos;
+    }
+
+    name.clear();
+    while ((pos < size) && 
+            ((isalnum((unsigned char)data[pos])) || (data[pos] == '_') ||
+             (data[pos] == ':') || (data[pos] == '.') || 
+             (data[pos] == '-'))) {
+        name.push_back(data[pos++]);
+    }
+    if (name.empty()) {
+        return 0;
+    }
+
+    // We write '<' and '>' in attributes as entities, so the first 
+    // of them has to be the end of this tag.
+    while ((pos < size) && (data[pos] != '>')) {
+        if (data[pos] == '<') {
+            return 0;
+        }
+        ++pos;
+    }
+    if (pos == size) {
+        return 0;
+    }
+
+    empty = (data[pos - 1] == '/');
+
+    return pos + 1;
+}
+
+// -----------------------------------
+//
+// Offset just past the close of a name element whose start tag 
+// ends at pos, or 0 if it doesn't get closed before something 
+// that can't be inside it.
+
+size_t
+_dataSaviorElementEnd(const char *data, size_t size, size_t pos,
+                      const std::string &name)
+{
+    std::string tagName;
+    bool        closing, empty;
+    int         depth = 1;
+
+    while (pos < size) {
+        const char *next = (const char *)memchr(data + pos, '<', 
+                                                size - pos);
+        if (!next) {
+            break;
+        }
+
+        size_t start  = (size_t)(next - data);
+        size_t tagEnd = _dataSaviorTag(data, size, start, 
+                                       tagName, closing, empty);
+        if (!tagEnd) {
+            pos = start + 1;
+            continue;
+        }
+
+        if ((tagName == "dict") || (tagName == "luts") || 
+                (tagName == "DataSavior") || 
+                ((tagName == "lut") && (name != "lut"))) {
+            return 0;
+        }
+
+        if (tagName == name) {
+            if (closing) {
+                if (--depth == 0) {
+                    return tagEnd;
+                }
+            } else if (!empty) {
+                ++depth;
+            }
+        }
+
+        pos = tagEnd;
+    }
+
+    return 0;
+}
+
+// -----------------------------------
+//
+// Parse a piece of a damaged file, quietly.
+
+xmlDocPtr
+_dataSaviorParseFragment(const std::string &xml)
+{
+    return xmlReadMemory(xml.data(), (int)xml.size(), NULL, NULL,
+                         XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+}
+
+}; // namespace
+
+
+
+// ===================================
+// 
+// DataSavior
+//
+// -----------------------------------
+//
+Ookala::DataSavior::DataSavior():
+    Plugin()
+{
+    setName("DataSavior");
+    declareNoDependencies();
+
+    mDataSaviorData = new _DataSavior;
+    mDataSaviorData->mWriting     = false;
+    mDataSaviorData->mWriterQuit  = false;
+    mDataSaviorData->mPatternsDay = 0;
+}
+
+// -----------------------------------
+//
+// Journals hold open state about their files, so copies start
+// without any and make their own as needed. The same goes for
+// the writer thread and its queue.
+Ookala::DataSavior::DataSavior(const DataSavior &src):
+    Plugin(src)
+{
+    mDataSaviorData = new _DataSavior;
+    mDataSaviorData->mWriting     = false;
+    mDataSaviorData->mWriterQuit  = false;
+    mDataSaviorData->mPatternsDay = 0;
+
+    setDeviceId(src.getDeviceId());
+}
+
+// -----------------------------------
+//
+// virtual
+Ookala::DataSavior::~DataSavior()
+{
+    if (mDataSaviorData) {
+
+        // Let the writer drain its queue before it goes away, 
+        // so nothing that was saved gets dropped.
+        if (mDataSaviorData->mWriter.joinable()) {
+            mDataSaviorData->mWriteMutex.lock();
+            mDataSaviorData->mWriterQuit = true;
+            mDataSaviorData->mWriteCond.broadcast();
+            mDataSaviorData->mWriteMutex.unlock();
+
+            mDataSaviorData->mWriter.join();
+        }
+
+        for (std::map<std::string, Journal *>::iterator theJournal =
+                        mDataSaviorData->mJournals.begin();
+                theJournal != mDataSaviorData->mJournals.end(); 
+                ++theJournal) {
+            delete theJournal->second;
+        }
+
+        delete mDataSaviorData;
+        mDataSaviorData = NULL;
+    }
+}
+
+// ----------------------------
+//
+Ookala::DataSavior &
+Ookala::DataSavior::operator=(const DataSavior &src)
+{
+    if (this != &src) {
+        Plugin::operator=(src);
+
+        setDeviceId(src.getDeviceId());
+    }
+
+    return *this;
+}
+
+
+// -----------------------------------
+//
+// virtual
+bool
+Ookala::DataSavior::save(std::vector<Dict *>      dicts,
+                         std::vector<std::string> filenames)
+{
+printf("DataSavior::save() - %d elements\n", (int)dicts.size());
+
+    std::string error;
+
+    // Anything still queued is older than this, so it has to 
+    // land first.
+    waitForWriter();
+
+    if (!writeDicts(dicts, filenames, error)) {
+        setErrorString(error);
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::DataSavior::saveAsync(const std::vector<Dict *>      &dicts,
+                              const std::vector<std::string> &filenames)
+{
+    std::string       errors;
+    _DataSaviorWrite *write = new _DataSaviorWrite;
+
+    write->mFilenames = filenames;
+    write->mDicts.reserve(dicts.size());
+    for (std::vector<Dict *>::const_iterator theDict = dicts.begin();
+            theDict != dicts.end(); ++theDict) {
+        write->mDicts.push_back(**theDict);
+    }
+
+    mDataSaviorData->mWriteMutex.lock();
+
+    // A newer save of the same files makes a queued one pointless.
+    bool replaced = false;
+    for (std::deque<_DataSaviorWrite *>::iterator theWrite = 
+                        mDataSaviorData->mWrites.begin();
+            theWrite != mDataSaviorData->mWrites.end(); ++theWrite) {
+        if ((*theWrite)->mFilenames == filenames) {
+            delete *theWrite;
+            *theWrite = write;
+            replaced  = true;
+            break;
+        }
+    }
+
+    if (!replaced) {
+        while (mDataSaviorData->mWrites.size() >= 
+                                    _DATASAVIOR_MAX_QUEUED_WRITES) {
+            mDataSaviorData->mWriteDoneCond.wait(
+                                    mDataSaviorData->mWriteMutex);
+        }
+        mDataSaviorData->mWrites.push_back(write);
+    }
+
+    if (!mDataSaviorData->mWriter.joinable()) {
+        mDataSaviorData->mWriter = std::thread(writerMain, this);
+    }
+
+    errors.swap(mDataSaviorData->mWriteErrors);
+
+    mDataSaviorData->mWriteCond.signal();
+    mDataSaviorData->mWriteMutex.unlock();
+
+    if (!errors.empty()) {
+        setErrorString(errors);
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::DataSavior::flush()
+{
+    std::string errors;
+
+    waitForWriter();
+
+    mDataSaviorData->mWriteMutex.lock();
+    errors.swap(mDataSaviorData->mWriteErrors);
+    mDataSaviorData->mWriteMutex.unlock();
+
+    if (!errors.empty()) {
+        setErrorString(errors);
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+// private
+bool
+Ookala::DataSavior::writeDicts(const std::vector<Dict *>      &dicts,
+                               const std::vector<std::string> &filenames,
+                               std::string                    &error)
+{
+    std::vector<std::string> xmlFilenames;
+    bool                     ret = true;
+
+    // Journals only need whatever changed since they last saw
+    // these dicts.
+    for (std::vector<std::string>::const_iterator theName = 
+                        filenames.begin();
+            theName != filenames.end(); ++theName) {
+        std::string realFilename = getFilename(*theName);
+
+        // Wildcards are only for finding files to load; there's 
+        // no telling which file a save should go to.
+        if (_dataSaviorIsGlob(realFilename)) {
+            if (!error.empty()) {
+                error += "\n";
+            }
+            error += std::string("Can't save to ") + *theName + 
+                     ", it has wildcards in it.";
+            ret = false;
+            continue;
+        }
+
+        Journal *journal = getJournal(*theName);
+
+        if (!journal) {
+            xmlFilenames.push_back(realFilename);
+            continue;
+        }
+
+        if (!journal->append(dicts)) {
+            if (!error.empty()) {
+                error += "\n";
+            }
+            error += journal->getErrorString();
+            ret = false;
+        }
+    }
+
+    if (xmlFilenames.empty()) {
+        return ret;
+    }
+
+    xmlDocPtr doc = xmlNewDoc((const xmlChar *)("1.0"));
+    if (doc == NULL) {
+        error = "Error creating XML document.";
+        return false;
+    }
+
+    xmlNodePtr cur = xmlNewNode(NULL,(const xmlChar *)("DataSavior"));
+
+    xmlDocSetRootElement(doc, cur);
+
+    // calibRecords only refer to their luts; each distinct lut is
+    // written once, ahead of the dicts, so it's in hand by the
+    // time a load gets to the records.
+    LutStore  luts;
+    LutStore *prevLuts = LutStore::setCurrent(&luts);
+
+    for (std::vector<Dict *>::const_iterator theDict = dicts.begin();
+            theDict != dicts.end(); ++theDict) {
+        (*theDict)->serialize(doc, cur);
+    }
+
+    LutStore::setCurrent(prevLuts);
+
+    if (luts.size()) {
+        xmlNodePtr               lutsNode = xmlNewNode(NULL, 
+                                                (const xmlChar *)("luts"));
+        std::vector<std::string> hashes   = luts.getHashes();
+
+        if (cur->children) {
+            xmlAddPrevSibling(cur->children, lutsNode);
+        } else {
+            xmlAddChild(cur, lutsNode);
+        }
+
+        for (std::vector<std::string>::iterator theHash = hashes.begin();
+                theHash != hashes.end(); ++theHash) {
+            luts.serialize(lutsNode, *theHash);
+        }
+    }
+
+    // Format the document once, and write the same bytes everywhere.
+    xmlChar *text     = NULL;
+    int      textSize = 0;
+
+    xmlDocDumpFormatMemory(doc, &text, &textSize, 1);
+    xmlFreeDoc(doc);
+
+    if (text == NULL) {
+        error = "Error formatting XML document.";
+        return false;
+    }
+    
+    // We want to save the same data to multiple places. For example,
+    // we might want to save a local copy and copy on a network
+    // mount. The net-mount would be useful for book-keeping by
+    // admins, while the local version would be useful if we 
+    // get disconnected from the net-mount.
+    //
+    // The writes go in parallel, so a slow mount only holds us up 
+    // for as long as it takes itself.
+
+    std::vector<std::string> errors(xmlFilenames.size());
+    std::vector<char>        written(xmlFilenames.size(), 0);
+    std::vector<std::thread> writers;
+
+    for (size_t idx=0; idx<xmlFilenames.size(); ++idx) {
+        writers.push_back(std::thread(_dataSaviorWriteTarget,
+                                      &xmlFilenames[idx], text, textSize,
+                                      &written[idx], &errors[idx]));
+    }
+
+    for (size_t idx=0; idx<writers.size(); ++idx) {
+        writers[idx].join();
+    }
+
+    // If someone has been loading one of these files, bring its 
+    // cache up to date now, while we still have the dicts in hand,
+    // rather than leaving the next load to parse the xml.
+    std::vector<std::vector<DictKey> > keys;
+
+    for (size_t idx=0; idx<xmlFilenames.size(); ++idx) {
+        uint64_t cacheTime, cacheSize;
+
+        if ((!written[idx]) || 
+                (!_dataSaviorStat(xmlFilenames[idx] + 
+                                  _DATASAVIOR_CACHE_SUFFIX,
+                                  cacheTime, cacheSize))) {
+            continue;
+        }
+
+        if (keys.empty()) {
+            for (std::vector<Dict *>::const_iterator theDict = 
+                                                        dicts.begin();
+                    theDict != dicts.end(); ++theDict) {
+                bool removed;
+
+                keys.push_back((*theDict)->getChangedKeys(0, removed));
+            }
+        }
+
+        saveCache(xmlFilenames[idx], (const uint8_t *)text, 
+                  (size_t)textSize, dicts, keys);
+    }
+
+    xmlFree(text);
+
+    for (size_t idx=0; idx<xmlFilenames.size(); ++idx) {
+        if (written[idx]) {
+            continue;
+        }
+
+        fprintf(stderr, "DataSavior: %s\n", errors[idx].c_str());
+
+        if (!error.empty()) {
+            error += "\n";
+        }
+        error += errors[idx];
+        ret = false;
+    }
+
+    return ret;
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::DataSavior::waitForWriter()
+{
+    mDataSaviorData->mWriteMutex.lock();
+
+    while (!mDataSaviorData->mWrites.empty() || 
+                    mDataSaviorData->mWriting) {
+        mDataSaviorData->mWriteDoneCond.wait(mDataSaviorData->mWriteMutex);
+    }
+
+    mDataSaviorData->mWriteMutex.unlock();
+}
+
+// -----------------------------------
+//
+// Take saves off the queue one at a time until we're told to 
+// quit and there's nothing left.
+//
+// static private
+void
+Ookala::DataSavior::writerMain(DataSavior *savior)
+{
+    _DataSavior *data = savior->mDataSaviorData;
+
+    data->mWriteMutex.lock();
+
+    while (true) {
+        while (data->mWrites.empty() && !data->mWriterQuit) {
+            data->mWriteCond.wait(data->mWriteMutex);
+        }
+        if (data->mWrites.empty()) {
+            break;
+        }
+
+        _DataSaviorWrite *write = data->mWrites.front();
+        data->mWrites.pop_front();
+        data->mWriting = true;
+
+        // There's room in the queue again
+        data->mWriteDoneCond.broadcast();
+
+        data->mWriteMutex.unlock();
+
+        std::vector<Dict *> dicts;
+        std::string         error;
+
+        for (size_t idx=0; idx<write->mDicts.size(); ++idx) {
+            dicts.push_back(&write->mDicts[idx]);
+        }
+
+        bool ret = savior->writeDicts(dicts, write->mFilenames, error);
+        delete write;
+
+        data->mWriteMutex.lock();
+
+        if (!ret) {
+            if (!data->mWriteErrors.empty()) {
+                data->mWriteErrors += "\n";
+            }
+            data->mWriteErrors += error;
+        }
+
+        data->mWriting = false;
+        data->mWriteDoneCond.broadcast();
+    }
+
+    data->mWriteMutex.unlock();
+}
+
+
+// -----------------------------------
+//
+// virtual
+bool
+Ookala::DataSavior::load(std::vector<std::string> filenames)
+{
+    return load(filenames, std::vector<std::string>());
+}
+
+// -----------------------------------
+//
+bool
+Ookala::DataSavior::load(const std::vector<std::string> &filenames,
+                         const std::vector<std::string> &dictNames)
+{
+    DictHash              *hash = NULL;
+    std::vector<Plugin *>  plugins;
+
+    if (filenames.empty()) {
+        setErrorString("No file names to load.");
+        return false;
+    }
+
+    // Make sure we read back anything still being written.
+    waitForWriter();
+
+    if (mRegistry == NULL) {
+        setErrorString("No PluginRegistry in DataSavior.");
+        return false;
+    }
+
+
+    // Choose the newest file to deal with
+    std::string newestFilename = getNewestFilename(filenames);
+
+    if (newestFilename.empty()) {
+        setErrorString("No files found.");
+        return false;
+    }
+
+    printf("Loading %s...\n", newestFilename.c_str());
+
+    plugins = mRegistry->queryByName("DictHash");
+    if (plugins.empty()) {
+        fprintf(stderr, "No DictHash found\n");
+        return false;
+    }
+
+    hash = dynamic_cast<DictHash *>(plugins[0]);
+    if (!hash) {
+        fprintf(stderr, "No DictHash found\n");
+        return false;
+    }
+ 
+    bool ret;
+    if (Journal::isJournal(newestFilename)) {
+        Journal *journal = findJournal(newestFilename);
+
+        ret = journal->load(hash, dictNames);
+        if (!ret) {
+            setErrorString(journal->getErrorString());
+        }
+    } else if (loadCache(newestFilename, hash, dictNames)) {
+        ret = true;
+    } else {
+        std::map<std::string, std::vector<DictKey> > loaded;
+
+        ret = loadFile(newestFilename, hash, loaded, dictNames);
+
+        // The cache has to cover the whole file, so only a full
+        // load can write it.
+        if ((ret) && (dictNames.empty())) {
+            saveCache(newestFilename, hash, loaded);
+        }
+    }
+
+    return ret;
+}
+
+// -----------------------------------
+//
+Ookala::Journal *
+Ookala::DataSavior::getJournal(const std::string &filename)
+{
+    std::string suffix(".journal");
+
+    if ((filename.size() < suffix.size()) ||
+            (filename.compare(filename.size() - suffix.size(), 
+                              suffix.size(), suffix))) {
+        return NULL;
+    }
+
+    std::string realFilename = getFilename(filename);
+
+    if (_dataSaviorIsGlob(realFilename)) {
+        std::vector<std::string> patterns;
+
+        patterns.push_back(filename);
+        realFilename = getNewestFilename(patterns);
+        if (realFilename.empty()) {
+            return NULL;
+        }
+    }
+
+    return findJournal(realFilename);
+}
+
+// -----------------------------------
+//
+void
+Ookala::DataSavior::setDeviceId(const std::string &deviceId)
+{
+    mDataSaviorData->mPatternsMutex.lock();
+
+    if (deviceId != mDataSaviorData->mDeviceId) {
+        mDataSaviorData->mDeviceId = deviceId;
+        mDataSaviorData->mPatterns.clear();
+    }
+
+    mDataSaviorData->mPatternsMutex.unlock();
+}
+
+// -----------------------------------
+//
+std::string
+Ookala::DataSavior::getDeviceId() const
+{
+    std::string deviceId;
+
+    mDataSaviorData->mPatternsMutex.lock();
+    deviceId = mDataSaviorData->mDeviceId;
+    mDataSaviorData->mPatternsMutex.unlock();
+
+    return deviceId;
+}
+
+// -----------------------------------
+//
+// private
+Ookala::Journal *
+Ookala::DataSavior::findJournal(const std::string &realFilename)
+{
+    Journal *journal;
+
+    mDataSaviorData->mJournalsMutex.lock();
+
+    std::map<std::string, Journal *>::iterator theJournal =
+                        mDataSaviorData->mJournals.find(realFilename);
+    if (theJournal != mDataSaviorData->mJournals.end()) {
+        journal = theJournal->second;
+    } else {
+        journal = new Journal(realFilename);
+        mDataSaviorData->mJournals[realFilename] = journal;
+    }
+
+    mDataSaviorData->mJournalsMutex.unlock();
+
+    return journal;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::DataSavior::buildCalibCatalog(
+                        const std::vector<std::string> &filenames,
+                        CalibCatalog                   &catalog)
+{
+    std::vector<CalibRecordHandle> handles;
+
+    catalog.clear();
+
+    // Make sure we see anything still being written.
+    waitForWriter();
+
+    std::string newestFilename = getNewestFilename(filenames);
+    if (newestFilename.empty()) {
+        setErrorString("No files found.");
+        return false;
+    }
+
+    if (Journal::isJournal(newestFilename)) {
+        Journal *journal = findJournal(newestFilename);
+
+        if (!journal->getCalibRecords(handles)) {
+            setErrorString(journal->getErrorString());
+            return false;
+        }
+    } else if (!_dataSaviorCacheRecords(newestFilename, handles)) {
+
+        // No cache to go by, so read the xml once, off to the side,
+        // and write one.
+        DictHash                                     scratch;
+        std::map<std::string, std::vector<DictKey> > loaded;
+
+        scratch.setPluginRegistry(mRegistry);
+
+        if (!loadFile(newestFilename, &scratch, loaded, 
+                      std::vector<std::string>())) {
+            return false;
+        }
+
+        handles.clear();
+        if ((!saveCache(newestFilename, &scratch, loaded)) ||
+                (!_dataSaviorCacheRecords(newestFilename, handles))) {
+            setErrorString(std::string("Can't write a load cache for ") +
+                                                        newestFilename);
+            return false;
+        }
+    }
+
+    for (std::vector<CalibRecordHandle>::iterator theHandle = 
+                                                    handles.begin();
+            theHandle != handles.end(); ++theHandle) {
+        catalog.add(*theHandle);
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::DataSavior::loadCalibRecord(const CalibRecordHandle &handle,
+                                    CalibRecordDictItem     &record)
+{
+    waitForWriter();
+
+    if (Journal::isJournal(handle.filename)) {
+        Journal *journal = findJournal(handle.filename);
+
+        if (!journal->getCalibRecord(handle.dictName, handle.key, record)) {
+            setErrorString(journal->getErrorString());
+            return false;
+        }
+
+        return true;
+    }
+
+    // The offset is only good for the cache the catalog was built
+    // from. save() rewrites caches, so go by the hash it was made
+    // from, not just the file's mtime and size.
+    _DataSaviorMappedFile cache;
+    PackReader            reader(NULL, 0);
+    uint64_t              sourceHash;
+
+    if ((!cache.open(handle.filename + _DATASAVIOR_CACHE_SUFFIX)) ||
+            (!_dataSaviorCheckCache(cache, handle.filename, false, reader,
+                                    sourceHash)) ||
+            (sourceHash != handle.sourceHash) ||
+            (handle.offset > cache.size()) ||
+            (handle.size > cache.size() - handle.offset)) {
+        setErrorString(handle.filename + 
+                       " has changed since the catalog was built.");
+        return false;
+    }
+
+    PackReader itemReader(cache.data() + handle.offset, handle.size);
+    if (!record.unserializeBinary(itemReader)) {
+        setErrorString(std::string("Bad calibRecord in ") + 
+                        handle.filename + _DATASAVIOR_CACHE_SUFFIX);
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+// The real name of the newest of filenames, or "" if none of 
+// them exist.
+//
+// private
+std::string
+Ookala::DataSavior::getNewestFilename(
+                        const std::vector<std::string> &filenames)
+{
+    std::map<std::string, std::vector<_DataSaviorCandidate> > dirs;
+    _DataSaviorNewest                                         newest;
+
+    // Sort the names out by directory, so that wildcards only 
+    // cost one pass over each directory they're in.
+    for (size_t idx = 0; idx < filenames.size(); ++idx) {
+        std::string          realFilename = getFilename(filenames[idx]);
+        _DataSaviorCandidate candidate;
+        std::string          dir;
+        size_t               slash = realFilename.rfind('/');
+
+        if (slash == std::string::npos) {
+            candidate.leaf = realFilename;
+        } else {
+            dir            = realFilename.substr(0, slash? slash: 1);
+            candidate.leaf = realFilename.substr(slash + 1);
+        }
+        candidate.order = idx;
+        candidate.glob  = _dataSaviorIsGlob(candidate.leaf);
+
+        dirs[dir].push_back(candidate);
+    }
+
+    for (std::map<std::string, 
+                  std::vector<_DataSaviorCandidate> >::const_iterator
+                theDir = dirs.begin(); theDir != dirs.end(); ++theDir) {
+        bool anyGlob = false;
+
+        for (std::vector<_DataSaviorCandidate>::const_iterator
+                    theCandidate = theDir->second.begin();
+                theCandidate != theDir->second.end(); ++theCandidate) {
+            anyGlob |= theCandidate->glob;
+        }
+
+        if (anyGlob) {
+            _dataSaviorScanDir(theDir->first, theDir->second, newest);
+            continue;
+        }
+
+        // Without wildcards, a stat per name is cheaper than 
+        // reading a directory that may hold a lot of others.
+        for (std::vector<_DataSaviorCandidate>::const_iterator
+                    theCandidate = theDir->second.begin();
+                theCandidate != theDir->second.end(); ++theCandidate) {
+            std::string realFilename = theCandidate->leaf;
+            uint64_t    mtime, size;
+
+            if (theDir->first == "/") {
+                realFilename = theDir->first + realFilename;
+            } else if (!theDir->first.empty()) {
+                realFilename = theDir->first + "/" + realFilename;
+            }
+
+            if (!_dataSaviorStat(realFilename, mtime, size)) {
+                continue;
+            }
+
+            newest.consider(realFilename, mtime, theCandidate->order);
+        }
+    }
+
+    return newest.name;
+}
+
+// -----------------------------------
+//
+// protected
+bool
+Ookala::DataSavior::loadFile(const std::string &filename, DictHash *hash,
+                     std::map<std::string, std::vector<DictKey> > &loaded,
+                     const std::vector<std::string> &dictNames)
+{
+    xmlTextReaderPtr reader;
+    int              ret, rootDepth = -1;
+    bool             skip = false;
+    LutStore         luts;
+    LutStore        *prevLuts;
+
+    // Stream through the file rather than building the whole tree;
+    // each <dict> pulls in its own items as they go by.
+    reader = xmlReaderForFile(filename.c_str(), NULL, 0);
+    if (reader == NULL) {
+        setErrorString(std::string("Can't open ") + filename);
+        return false;
+    }
+
+    // Shared luts come first in the file; calibRecords further
+    // on find them through here.
+    prevLuts = LutStore::setCurrent(&luts);
+
+    // Dicts we don't want are stepped over with xmlTextReaderNext(),
+    // which doesn't hand us their insides.
+    for (ret = xmlTextReaderRead(reader); ret == 1; 
+            ret = skip? xmlTextReaderNext(reader): 
+                        xmlTextReaderRead(reader)) {
+        skip = false;
+
+        if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+            continue;
+        }
+
+        // The first element is the root; we want its <dict> children.
+        if (rootDepth < 0) {
+            rootDepth = xmlTextReaderDepth(reader);
+            continue;
+        }
+
+        if (xmlTextReaderDepth(reader) != rootDepth+1) {
+            continue;
+        }
+
+        if (!strcmp((const char *)xmlTextReaderConstName(reader), "luts")) {
+            xmlNodePtr lutsNode = xmlTextReaderExpand(reader);
+
+            for (xmlNodePtr node = lutsNode? lutsNode->children: NULL;
+                    node != NULL; node = node->next) {
+                if ((node->type == XML_ELEMENT_NODE) &&
+                        (!strcmp((const char *)node->name, "lut"))) {
+                    luts.unserialize(node->doc, node);
+                }
+            }
+
+            skip = true;
+            continue;
+        }
+
+        if (strcmp((const char *)xmlTextReaderConstName(reader), "dict")) {
+            continue;
+        }
+
+        std::string dictName;
+
+        xmlChar *attrName = xmlTextReaderGetAttribute(reader, 
+                                                (const xmlChar *)("name"));
+        if (attrName != NULL) {
+            dictName = (char *)(attrName);
+            xmlFree(attrName);
+        }
+
+        if ((!dictNames.empty()) &&
+                (std::find(dictNames.begin(), dictNames.end(), 
+                           dictName) == dictNames.end())) {
+            skip = true;
+            continue;
+        }
+
+        Dict *dict = hash->newDict(dictName.c_str());
+        if (!dict) {
+            setErrorString(std::string("Unable to create dict in ")
+                                                     + filename);
+            xmlFreeTextReader(reader);
+            LutStore::setCurrent(prevLuts);
+            return false;
+        }
+
+        uint64_t version = dict->getVersion();
+        bool     removed;
+
+        if (!dict->unserialize(reader)) {
+            xmlFreeTextReader(reader);
+            LutStore::setCurrent(prevLuts);
+            return salvageFile(filename, hash, loaded, dictNames);
+        }
+
+        // Whatever changed just now came from the file.
+        std::vector<DictKey>  keys = dict->getChangedKeys(version, removed);
+        std::vector<DictKey> &dictKeys = loaded[dictName];
+
+        dictKeys.insert(dictKeys.end(), keys.begin(), keys.end());
+
+        dict->debug();
+    }
+
+    xmlFreeTextReader(reader);
+    LutStore::setCurrent(prevLuts);
+
+    if (ret != 0) {
+        return salvageFile(filename, hash, loaded, dictNames);
+    }
+
+    if (rootDepth < 0) {
+        setErrorString(std::string("No root element in ") + filename);
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+// Rather than parsing the file as a whole, walk the raw bytes for
+// <lut>s and the <dictitem>s directly in each <dict>, and read 
+// each one that's whole on its own. Items check their own crc as
+// they're read, so anything damaged is left out, and damage in 
+// one place doesn't cost us anything past it. 
+//
+// Items are only taken while we're between a <dict> and its 
+// </dict>, so losing a <dict> tag can't send them to the wrong one.
+//
+// protected
+bool
+Ookala::DataSavior::salvageFile(const std::string &filename, 
+                     DictHash *hash,
+                     std::map<std::string, std::vector<DictKey> > &loaded,
+                     const std::vector<std::string> &dictNames)
+{
+    _DataSaviorMappedFile file;
+    LutStore              luts;
+    LutStore             *prevLuts;
+    Dict                 *dict        = NULL;
+    uint64_t              dictVersion = 0;
+    int                   found       = 0;
+    int                   salvaged    = 0;
+    bool                  dictBroken  = false;
+    bool                  sawCrc      = false;
+    std::string           name;
+    bool                  closing, empty;
+
+    if (!file.open(filename)) {
+        setErrorString(std::string("Can't open ") + filename);
+        return false;
+    }
+
+    const char *data = (const char *)file.data();
+    size_t      size = file.size();
+    size_t      pos  = 0;
+
+    loaded.clear();
+    prevLuts = LutStore::setCurrent(&luts);
+
+    while (pos <= size) {
+        const char *next = (pos < size)? 
+                    (const char *)memchr(data + pos, '<', size - pos): NULL;
+        size_t      start  = next? (size_t)(next - data): size;
+        size_t      tagEnd = next? _dataSaviorTag(data, size, start, 
+                                                  name, closing, empty): 0;
+
+        if ((next) && (!tagEnd)) {
+            pos = start + 1;
+            continue;
+        }
+
+        // The end of a dict, one way or another; note what we 
+        // got from it.
+        if ((!next) || (name == "dict") || (dictBroken)) {
+            if (dict) {
+                bool                  removed;
+                std::vector<DictKey>  keys = dict->getChangedKeys(
+                                                    dictVersion, removed);
+                std::vector<DictKey> &dictKeys = loaded[dict->getName()];
+
+                dictKeys.insert(dictKeys.end(), keys.begin(), keys.end());
+                salvaged += (int)keys.size();
+                dict      = NULL;
+            }
+            dictBroken = false;
+
+            if (!next) {
+                break;
+            }
+        }
+
+        if ((name == "dict") && (!closing)) {
+            std::string tag(data + start, tagEnd - start);
+            std::string dictName;
+
+            if (!empty) {
+                tag.insert(tag.size() - 1, "/");
+            }
+
+            xmlDocPtr doc = _dataSaviorParseFragment(tag);
+            if (doc) {
+                xmlChar *attrName = xmlGetProp(xmlDocGetRootElement(doc),
+                                               (const xmlChar *)"name");
+                if (attrName) {
+                    dictName = (const char *)attrName;
+                    xmlFree(attrName);
+                }
+                xmlFreeDoc(doc);
+            }
+
+            if ((doc) && (!empty) &&
+                    ((dictNames.empty()) ||
+                     (std::find(dictNames.begin(), dictNames.end(),
+                                dictName) != dictNames.end()))) {
+                dict = hash->newDict(dictName.c_str());
+                if (dict) {
+                    dictVersion = dict->getVersion();
+                }
+            }
+
+            pos = tagEnd;
+            continue;
+        }
+
+        if ((closing) || ((name != "lut") && (name != "dictitem")) ||
+                ((name == "dictitem") && (!dict))) {
+            pos = tagEnd;
+            continue;
+        }
+
+        // Only the items directly in a <dict> get a crc, so once we
+        // know the file has them, anything without one is from 
+        // inside an item we couldn't read.
+        bool hasCrc = (name == "dictitem") &&
+                        (std::string(data + start, tagEnd - start).find(
+                                            " crc=\"") != std::string::npos);
+        if ((name == "dictitem") && (sawCrc) && (!hasCrc)) {
+            pos = tagEnd;
+            continue;
+        }
+        sawCrc |= hasCrc;
+
+        size_t end = empty? tagEnd: 
+                        _dataSaviorElementEnd(data, size, tagEnd, name);
+        if (!end) {
+            // Without crcs, there's no telling this item's insides
+            // from the items after it, so give up on the rest of 
+            // this dict.
+            if (name == "dictitem") {
+                ++found;
+                if (!hasCrc) {
+                    dictBroken = true;
+                }
+            }
+            pos = tagEnd;
+            continue;
+        }
+
+        if (name == "lut") {
+            xmlDocPtr doc = _dataSaviorParseFragment(
+                                std::string(data + start, end - start));
+            if (doc) {
+                luts.unserialize(doc, xmlDocGetRootElement(doc));
+                xmlFreeDoc(doc);
+            }
+        } else {
+            xmlDocPtr doc = _dataSaviorParseFragment(
+                                std::string("<dict>") + 
+                                std::string(data + start, end - start) +
+                                "</dict>");
+            ++found;
+            if (doc) {
+                dict->unserialize(doc, xmlDocGetRootElement(doc));
+                xmlFreeDoc(doc);
+            }
+        }
+
+        pos = end;
+    }
+
+    LutStore::setCurrent(prevLuts);
+
+    fprintf(stderr, "Recovered %d of %d items from damaged %s\n",
+                                    salvaged, found, filename.c_str());
+
+    if (salvaged == 0) {
+        setErrorString(std::string("Nothing could be recovered from ") +
+                                                            filename);
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+// The cache is laid out like:
+//
+//    "OMCFCACH" <u32 version> <u32 reserved>
+//    <u64 mtime> <u64 size> <u64 hash>         of the xml file
+//    <u32 dict count>
+//       <str name> <u64 offset> <u64 length>   where the dict starts
+//    for each dict:
+//       <u32 item count>
+//          <str key> <str type> <u8 form> <str data>
+//
+// using the encodings in Pack.h. Offsets are from the start of
+// the cache. form says if data came from DictItem::serializeBinary(),
+// or is a <dictitem> for types that don't have a binary form.
+//
+// protected
+bool
+Ookala::DataSavior::loadCache(const std::string &filename, DictHash *hash,
+                              const std::vector<std::string> &dictNames)
+{
+    _DataSaviorMappedFile cache;
+    PackReader            reader(NULL, 0);
+    uint64_t              sourceHash;
+
+    if ((!mRegistry) ||
+            (!cache.open(filename + _DATASAVIOR_CACHE_SUFFIX)) ||
+            (!_dataSaviorCheckCache(cache, filename, true, reader,
+                                    sourceHash))) {
+        return false;
+    }
+
+    printf("Using %s%s\n", filename.c_str(), _DATASAVIOR_CACHE_SUFFIX);
+
+    bool     damaged  = false;
+    uint32_t numDicts = reader.u32();
+
+    for (uint32_t dictIdx=0; (dictIdx<numDicts) && (reader.ok()); 
+                                                        ++dictIdx) {
+        std::string dictName = reader.str();
+        uint64_t    offset   = reader.u64();
+        uint64_t    length   = reader.u64();
+        std::string xml;
+
+        if (!reader.ok()) {
+            break;
+        }
+
+        if ((!dictNames.empty()) &&
+                (std::find(dictNames.begin(), dictNames.end(), 
+                           dictName) == dictNames.end())) {
+            continue;
+        }
 
-    orig = filePattern;
+        if ((offset > cache.size()) || (length > cache.size() - offset)) {
+            damaged = true;
+            break;
+        }
+
+        PackReader dictReader(cache.data() + offset, (size_t)length);
+        uint32_t   numItems = dictReader.u32();
+
+        Dict *dict = hash->newDict(dictName.c_str());
+        if (!dict) {
+            return false;
+        }
+
+        for (uint32_t itemIdx=0; itemIdx<numItems; ++itemIdx) {
+            std::string    key  = dictReader.str();
+            std::string    type = dictReader.str();
+            uint8_t        form = dictReader.u8();
+            uint32_t       len  = dictReader.u32();
+            const uint8_t *data = dictReader.ptr();
+
+            if (!dictReader.skip(len)) {
+                break;
+            }
+
+            if (form == _DATASAVIOR_CACHE_XML) {
+                xml.append((const char *)data, len);
+                continue;
+            }
+
+            DictItem *item = mRegistry->createDictItem(type);
+            if (!item) {
+                fprintf(stderr, "WARNING: No DictItem found for type %s\n",
+                                                        type.c_str());
+                continue;
+            }
+
+            PackReader itemReader(data, len);
+            if (!item->unserializeBinary(itemReader)) {
+                mRegistry->deleteDictItem(item);
+                return false;
+            }
+
+            dict->adopt(DictKey(key), item);
+        }
+
+        if (!dictReader.ok()) {
+            damaged = true;
+            break;
+        }
+
+        // Anything without a binary form goes through xml, as usual.
+        if (!xml.empty()) {
+            xml = "<dict>" + xml + "</dict>";
+
+            xmlDocPtr doc = xmlReadMemory(xml.data(), (int)xml.size(),
+                                          NULL, NULL, 0);
+            if (doc == NULL) {
+                return false;
+            }
+
+            dict->unserialize(doc, xmlDocGetRootElement(doc));
+            xmlFreeDoc(doc);
+        }
+    }
+
+    if ((damaged) || (!reader.ok())) {
+        fprintf(stderr, "%s%s is damaged\n", filename.c_str(), 
+                                        _DATASAVIOR_CACHE_SUFFIX);
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+// protected
+bool
+Ookala::DataSavior::saveCache(const std::string &filename, DictHash *hash,
+                  const std::map<std::string, std::vector<DictKey> > &loaded)
+{
+    _DataSaviorMappedFile              source;
+    std::vector<Dict>                  snapshots(loaded.size());
+    std::vector<Dict *>                dicts;
+    std::vector<std::vector<DictKey> > keys;
+
+    size_t idx = 0;
+    for (std::map<std::string, std::vector<DictKey> >::const_iterator
+            theDict = loaded.begin(); theDict != loaded.end(); 
+            ++theDict, ++idx) {
+        hash->getDictSnapshot(theDict->first, snapshots[idx]);
+        dicts.push_back(&snapshots[idx]);
+        keys.push_back(theDict->second);
+    }
+
+    if (!source.open(filename)) {
+        return false;
+    }
+
+    return saveCache(filename, source.data(), source.size(), dicts, keys);
+}
+
+// -----------------------------------
+//
+// Failing to write the cache isn't a problem for the load or
+// save that got us here; it's just slower next time.
+//
+// protected
+bool
+Ookala::DataSavior::saveCache(const std::string &filename, 
+                              const uint8_t *source, size_t sourceSize,
+                              const std::vector<Dict *>                &dicts,
+                              const std::vector<std::vector<DictKey> > &keys)
+{
+    uint64_t                 mtime, size;
+    std::string              buf;
+    std::vector<std::string> names, bodies;
+    xmlDocPtr                doc;
+    xmlNodePtr               scratch;
+
+    std::string cacheName = filename + _DATASAVIOR_CACHE_SUFFIX;
+
+    if ((dicts.size() != keys.size()) || 
+            (!_dataSaviorStat(filename, mtime, size)) ||
+            (size != sourceSize)) {
+        return false;
+    }
+
+    doc = xmlNewDoc((const xmlChar *)("1.0"));
+    if (doc == NULL) {
+        return false;
+    }
+    scratch = xmlNewNode(NULL, (const xmlChar *)("dict"));
+    xmlDocSetRootElement(doc, scratch);
+
+    for (size_t dictIdx=0; dictIdx<dicts.size(); ++dictIdx) {
+        const Dict  &dict     = *dicts[dictIdx];
+        std::string  items;
+        uint32_t     numItems = 0;
+
+        for (std::vector<DictKey>::const_iterator theKey = 
+                    keys[dictIdx].begin();
+                theKey != keys[dictIdx].end(); ++theKey) {
+            DictItem   *item = const_cast<DictItem *>(dict.get(*theKey));
+            std::string data;
+            uint8_t     form = _DATASAVIOR_CACHE_BINARY;
+
+            if ((!item) || (!item->serializable())) {
+                continue;
+            }
+
+            if (!item->serializeBinary(data)) {
+                xmlNodePtr   itemNode;
+                xmlBufferPtr buffer = xmlBufferCreate();
+
+                if (!buffer) {
+                    continue;
+                }
+
+                itemNode = Dict::serializeItem(doc, scratch, 
+                                               (*theKey).str(), item);
+                xmlNodeDump(buffer, doc, itemNode, 0, 0);
 
-    size_t start = filePattern.find(replaceSrc);
-    if (start == std::string::npos) {
+                data.assign((const char *)xmlBufferContent(buffer),
+                            (size_t)xmlBufferLength(buffer));
+                form = _DATASAVIOR_CACHE_XML;
+
+                xmlBufferFree(buffer);
+                xmlUnlinkNode(itemNode);
+                xmlFreeNode(itemNode);
+            }
+
+            packString(items, (*theKey).str());
+            packString(items, item->itemType());
+            packU8(items, form);
+            packString(items, data);
+            numItems++;
+        }
+
+        bodies.push_back(std::string());
+        packU32(bodies.back(), numItems);
+        bodies.back().append(items);
+
+        names.push_back(dicts[dictIdx]->getName());
+    }
+
+    xmlFreeDoc(doc);
+
+    buf.append(_DATASAVIOR_CACHE_MAGIC);
+    packU32(buf, _DATASAVIOR_CACHE_VERSION);
+    packU32(buf, 0);
+    packU64(buf, mtime);
+    packU64(buf, size);
+    packU64(buf, packHash(source, sourceSize));
+    packU32(buf, (uint32_t)names.size());
+
+    // The bodies start right after the index.
+    uint64_t offset = buf.size();
+    for (size_t idx=0; idx<names.size(); ++idx) {
+        offset += 4 + names[idx].size() + 8 + 8;
+    }
+
+    for (size_t idx=0; idx<names.size(); ++idx) {
+        packString(buf, names[idx]);
+        packU64(buf, offset);
+        packU64(buf, bodies[idx].size());
+        offset += bodies[idx].size();
+    }
+
+    for (size_t idx=0; idx<bodies.size(); ++idx) {
+        buf.append(bodies[idx]);
+    }
+
+    std::string error;
+
+    if (!_dataSaviorWriteFile(cacheName, buf.data(), buf.size(), error)) {
+        printf("%s\n", error.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+// Perform any string substitution on file names that we
+// get as input to form proper file names. Expansions are 
+// kept until the device id or the date changes.
+//
+// protected
+std::string
+Ookala::DataSavior::getFilename(std::string filePattern)
+{
+    std::string host, user, replaced;
+
+    if (filePattern.find('%') == std::string::npos) {
         return filePattern;
     }
 
-    replaced = orig.replace(start, replaceSrc.size(), replaceDst);
+    int today = _dataSaviorToday();
 
-    printf("%s -> %s\n", filePattern.c_str(), replaced.c_str());
+    mDataSaviorData->mPatternsMutex.lock();
+
+    if (today != mDataSaviorData->mPatternsDay) {
+        mDataSaviorData->mPatterns.clear();
+        mDataSaviorData->mPatternsDay = today;
+    }
+
+    std::map<std::string, std::string>::const_iterator thePattern =
+                        mDataSaviorData->mPatterns.find(filePattern);
+    if (thePattern != mDataSaviorData->mPatterns.end()) {
+        replaced = thePattern->second;
+    } else {
+        _dataSaviorHostUser(host, user);
+
+        replaced = _dataSaviorExpand(filePattern, host, user, 
+                                     mDataSaviorData->mDeviceId, today);
+        mDataSaviorData->mPatterns[filePattern] = replaced;
+    }
+
+    mDataSaviorData->mPatternsMutex.unlock();
 
     return replaced;
 }
@@ -1280,6 +3361,14 @@ Ookala::DataSavior::getFilename(std::string filePattern)
 //    DataSavior::fileNames [stringArray]
 //    DataSavior::dictNames [stringArray]
 //      + When saving, save out these dicts.
+//    DataSavior::async     [bool]
+//      + Queue the save for the writer thread instead
+//        of waiting on it.
+//    DataSavior::loadDictNames [stringArray]
+//      + When loading, only load these dicts. Without 
+//        it, everything in the file is loaded.
+//    DataSavior::deviceId  [string]
+//      + What %d in fileNames expands to.
 //
 // Order of operations is:
 //    1) load
@@ -1294,16 +3383,25 @@ Ookala::DataSavior::_run(PluginChain *chain)
 {
     DictHash            *hash            = NULL;
     Dict                *chainDict       = NULL;
-    Dict                *dict            = NULL;
-    DictItem            *item            = NULL;
     BoolDictItem        *boolItem        = NULL;
+    StringDictItem      *stringItem      = NULL;
     StringArrayDictItem *stringArrayItem = NULL;
 
+    static const DictKey fileNamesKey("DataSavior::fileNames");
+    static const DictKey dictNamesKey("DataSavior::dictNames");
+    static const DictKey saveKey("DataSavior::save");
+    static const DictKey loadKey("DataSavior::load");
+    static const DictKey asyncKey("DataSavior::async");
+    static const DictKey loadDictNamesKey("DataSavior::loadDictNames");
+    static const DictKey deviceIdKey("DataSavior::deviceId");
+
     bool                     doSave      = false;
     bool                     doLoad      = false;
+    bool                     doAsync     = false;
 
     std::vector<std::string> fileNames;
     std::vector<std::string> dictNames;
+    std::vector<std::string> loadDictNames;
     std::vector<Dict *>      saveDicts;
 
 
@@ -1317,7 +3415,7 @@ Ookala::DataSavior::_run(PluginChain *chain)
         return true;
     }
 
-    std::vector<Plugin *> plugins = mRegistry->queryByName("DictHash");
+    const std::vector<Plugin *> &plugins = mRegistry->queryByName("DictHash");
     if (plugins.empty()) {
         setErrorString("No DictHash plugin found.");
         return false;
@@ -1335,76 +3433,82 @@ Ookala::DataSavior::_run(PluginChain *chain)
     }
 
     // If we're going to do anything, we need filenames.
-    item = chainDict->get("DataSavior::fileNames");
-    if (!item) {
-        setErrorString("DataSavior::fileNames [stringArray] not found.");
-        return false;
-    }
-    stringArrayItem = dynamic_cast<StringArrayDictItem *>(item);
+    stringArrayItem = chainDict->get<StringArrayDictItem>(fileNamesKey);
     if (!stringArrayItem) {
         setErrorString("DataSavior::fileNames [stringArray] not found.");
         return false;
     }
     fileNames = stringArrayItem->get();
 
+    // Any %d in them is for this device
+    stringItem = chainDict->get<StringDictItem>(deviceIdKey);
+    if (stringItem) {
+        setDeviceId(stringItem->get());
+    }
+
 
     // Check if we're supposed to save
     doSave = false;
-    item = chainDict->get("DataSavior::save");
-    if (item) {
-        boolItem = dynamic_cast<BoolDictItem *>(item);
-        if (boolItem) {
-            doSave = boolItem->get();
-        }
+    boolItem = chainDict->get<BoolDictItem>(saveKey);
+    if (boolItem) {
+        doSave = boolItem->get();
     }
 
     // And check if we're supposed to load
     doLoad = false;
-    item = chainDict->get("DataSavior::load");
-    if (item) {
-        boolItem = dynamic_cast<BoolDictItem *>(item);
-        if (boolItem) {
-            doLoad = boolItem->get();
-        }
+    boolItem = chainDict->get<BoolDictItem>(loadKey);
+    if (boolItem) {
+        doLoad = boolItem->get();
     }
 
     // If we're supposed to save, we'll need to have a list
     // of dictNames to save.
     if (doSave) {
-        item = chainDict->get("DataSavior::dictNames");
-        if (!item) {
-            setErrorString("DataSavior::dictNames [stringArray] not found.");
-            return false;
-        }
-        stringArrayItem = dynamic_cast<StringArrayDictItem *>(item);
+        stringArrayItem = chainDict->get<StringArrayDictItem>(dictNamesKey);
         if (!stringArrayItem) {
             setErrorString("DataSavior::dictNames [stringArray] not found.");
             return false;
         }
         dictNames = stringArrayItem->get();        
 
-        for (std::vector<std::string>::iterator theName = dictNames.begin();
-                theName != dictNames.end(); ++theName) {
-            dict = hash->getDict((*theName).c_str());
-        
-            if (dict) {
-                saveDicts.push_back(dict);
-            }
+        boolItem = chainDict->get<BoolDictItem>(asyncKey);
+        if (boolItem) {
+            doAsync = boolItem->get();
         }
-        
     }
     
     // Load should happen before save, as then we can re-sync data files
     // by issuing both a load and a save
     if (doLoad) {
+        stringArrayItem = chainDict->get<StringArrayDictItem>(
+                                                    loadDictNamesKey);
+        if (stringArrayItem) {
+            loadDictNames = stringArrayItem->get();
+        }
 
-        if (!load(fileNames)) {
+        if (!load(fileNames, loadDictNames)) {
             return false;
         }
     }
 
     if (doSave) {
-        if (!save(saveDicts, fileNames)) {
+
+        // Write out snapshots rather than the live dicts, so what
+        // lands on disk is consistent even if someone changes the
+        // dicts while we're busy serializing.
+        std::vector<Dict> snapshots(dictNames.size());
+        
+        for (uint32_t idx=0; idx<dictNames.size(); ++idx) {
+            if (hash->getDictSnapshot(dictNames[idx], snapshots[idx])) {
+                saveDicts.push_back(&snapshots[idx]);
+            }
+        }
+
+        if (doAsync) {
+            if (!saveAsync(saveDicts, fileNames)) {
+                return false;
+            }
+        } else if (!save(saveDicts, fileNames)) {
             return false;
         }
     }
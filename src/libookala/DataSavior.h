@@ -28,12 +28,20 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
+#include <thread>
 
 #include "Plugin.h"
 #include "Dict.h"
+#include "Mutex.h"
 
 namespace Ookala {
 
+class DictHash;
+class Journal;
+class CalibCatalog;
+struct CalibRecordHandle;
+
 //
 // A generic record for saving calibration data of interest.
 //
@@ -46,6 +54,8 @@ class EXIMPORT CalibRecordDictItem: public DictItem
         virtual ~CalibRecordDictItem();
         CalibRecordDictItem & operator=(const CalibRecordDictItem &src);
 
+        virtual DictItem *clone() const;
+
 
         std::string           getDeviceId();
         void                  setDeviceId(const std::string &);
@@ -86,21 +96,32 @@ class EXIMPORT CalibRecordDictItem: public DictItem
         Yxy                   getMeasuredBlue();
         void                  setMeasuredBlue(const Yxy &);
 
-        std::vector<Rgb>      getMeasuredRgb();
-        void                  setMeasuredRgb(const std::vector<Rgb> &);
+        // The vector getters return references into the record; they
+        // stay valid until the matching set is called. The rvalue
+        // setters take over the caller's storage instead of copying.
+        const std::vector<Rgb> &getMeasuredRgb() const;
+        void                    setMeasuredRgb(const std::vector<Rgb> &);
+        void                    setMeasuredRgb(std::vector<Rgb> &&);
        
-        std::vector<Yxy>      getMeasuredYxy();
-        void                  setMeasuredYxy(const std::vector<Yxy> &);
-
-        std::vector<std::string> getLutNames();
-        std::vector<uint32_t>    getLut(const std::string &);
-        void                     setLut(const std::string &, 
-                                        const std::vector<uint32_t> &);
+        const std::vector<Yxy> &getMeasuredYxy() const;
+        void                    setMeasuredYxy(const std::vector<Yxy> &);
+        void                    setMeasuredYxy(std::vector<Yxy> &&);
+
+        std::vector<std::string>     getLutNames();
+
+        // Returns an empty vector if there's no lut named key.
+        const std::vector<uint32_t> &getLut(const std::string &key) const;
+        void                         setLut(const std::string &, 
+                                            const std::vector<uint32_t> &);
+        void                         setLut(const std::string &, 
+                                            std::vector<uint32_t> &&);
         
         // Need to fill these in for classes derived from DictItem
         // so saving and loading can behave properly.
         virtual bool serialize(xmlDocPtr doc, xmlNodePtr root);
         virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
+        virtual bool serializeBinary(std::string &buf);
+        virtual bool unserializeBinary(PackReader &reader);
 
         virtual void debug();
 
@@ -108,6 +129,9 @@ class EXIMPORT CalibRecordDictItem: public DictItem
         bool serializeSubItem(xmlDocPtr   doc,  xmlNodePtr root,
                               std::string name, DictItem *item);
 
+        void serializeSeries(xmlNodePtr root, const char *name,
+                             const std::vector<double> &values);
+
     private:
         struct _CalibRecordDictItem {
             std::string           deviceId;
@@ -145,8 +169,15 @@ class EXIMPORT CalibRecordDictItem: public DictItem
 // A simple plugin for dealing with persistant data 
 // saving and loading.
 //
-// Filenames are treated to a substitution with of
-// "%s" with the current host name.
+// Filenames are treated to a substitution of "%s" or "%h" 
+// with the current host name, "%u" with the user, "%d" with
+// the device id and "%D" with the date (YYYYMMDD). The last 
+// part of a name can also hold shell wildcards, which pick out
+// the newest matching file when loading.
+//
+// File names ending in ".journal" are kept as an append-only
+// Journal rather than an xml document, so saving only writes
+// what has changed. load() tells the two apart by their contents.
 // 
 
 class EXIMPORT DataSavior: public Plugin
@@ -171,17 +202,103 @@ class EXIMPORT DataSavior: public Plugin
         virtual bool save(std::vector<Dict *>      dicts, 
                           std::vector<std::string> filenames);
 
+        // Like save(), but hand the writing off to a background 
+        // thread and return right away. The dicts are copied, so
+        // they can change once we return. A queued save that hasn't
+        // started yet is replaced by a newer one for the same files,
+        // and at most a few different saves are held at once; past
+        // that, we wait for the writer to catch up.
+        //
+        // Errors from earlier background saves are reported by the
+        // next saveAsync() or flush().
+        bool saveAsync(const std::vector<Dict *>      &dicts, 
+                       const std::vector<std::string> &filenames);
+
+        // Wait until every queued save has been written. Returns
+        // false if any of them failed since the last flush().
+        bool flush();
+
         // Load the contents of the dictionary from disk. This 
         // will blow away anything currently stored, so be careful!
         // This probably isn't something you want to do frequently.
         //
         // load() will read in the newest file in filenames
+        //
+        // Items read in belong to the dicts they're stored in, and
+        // are freed once they've been replaced or removed.
         virtual bool load(std::vector<std::string> filenames);
+
+        // Like load(), but only read the dicts named in dictNames;
+        // the rest are left on disk and alone in the DictHash. An 
+        // empty dictNames loads everything. The load cache and 
+        // journals know where each dict is kept, so this only 
+        // costs as much as the dicts asked for.
+        bool         load(const std::vector<std::string> &filenames,
+                          const std::vector<std::string> &dictNames);
+
+        // The Journal behind filename, after substitution. If it 
+        // has wildcards, that's the newest journal they match.
+        // Returns NULL unless filename ends in ".journal". The 
+        // Journal belongs to us, so don't delete it.
+        Journal *    getJournal(const std::string &filename);
+
+        // Fill catalog with the calibRecords in the newest of 
+        // filenames, without loading anything into the DictHash. 
+        // Journals already know where their records are. For xml
+        // files this reads the load cache, making one first if 
+        // need be.
+        bool         buildCalibCatalog(
+                            const std::vector<std::string> &filenames,
+                            CalibCatalog                   &catalog);
+
+        // Read the record behind a handle from buildCalibCatalog().
+        // Fails if an xml file has been saved over since then.
+        bool         loadCalibRecord(const CalibRecordHandle &handle,
+                                     CalibRecordDictItem     &record);
+
+        // What "%d" in file names expands to, so each device can
+        // keep its own files.
+        void         setDeviceId(const std::string &deviceId);
+        std::string  getDeviceId() const;
                           
 
 
     protected:
 
+        // Stream the <dict>s in filename into hash. loaded gets the
+        // keys read into each dict. If dictNames isn't empty, other
+        // dicts are skipped over without being read.
+        bool loadFile(const std::string &filename, DictHash *hash,
+                      std::map<std::string, std::vector<DictKey> > &loaded,
+                      const std::vector<std::string> &dictNames);
+
+        // What loadFile() falls back on when filename won't parse:
+        // read every <lut> and <dictitem> in it that's still whole
+        // and matches its checksum, and skip the rest. Fails only 
+        // if nothing could be recovered.
+        bool salvageFile(const std::string &filename, DictHash *hash,
+                      std::map<std::string, std::vector<DictKey> > &loaded,
+                      const std::vector<std::string> &dictNames);
+
+        // Binary copy of the dicts in filename, kept beside it as
+        // filename + ".cache" so the next load can skip parsing the 
+        // xml. The cache notes the mtime, size and a hash of the 
+        // file; loadCache() fails if any of them don't match. It 
+        // also holds an index of where each dict starts, so 
+        // loadCache() only has to look at those in dictNames.
+        //
+        // saveCache() writes either the keys in loaded from the
+        // dicts in hash, or keys[i] from dicts[i]; source is the 
+        // contents of filename.
+        bool loadCache(const std::string &filename, DictHash *hash,
+                       const std::vector<std::string> &dictNames);
+        bool saveCache(const std::string &filename, DictHash *hash,
+                 const std::map<std::string, std::vector<DictKey> > &loaded);
+        bool saveCache(const std::string &filename, 
+                       const uint8_t *source, size_t sourceSize,
+                       const std::vector<Dict *>                &dicts,
+                       const std::vector<std::vector<DictKey> > &keys);
+
         // Perform any string substitution on file names that we
         // get as input to form proper file names
         std::string getFilename(std::string filePattern);
@@ -195,8 +312,68 @@ class EXIMPORT DataSavior: public Plugin
         //    DataSavior::fileNames [stringArray]
         //    DataSavior::dictNames [stringArray]
         //      + When saving, save out these dicts.
+        //    DataSavior::async     [bool]
+        //      + Save with saveAsync() instead of save().
+        //    DataSavior::loadDictNames [stringArray]
+        //      + When loading, only load these dicts.
+        //    DataSavior::deviceId  [string]
+        //      + What %d in fileNames expands to.
         //
         virtual bool _run(PluginChain *chain);
+
+    private:
+        // Find or make the Journal for a real file name
+        Journal *    findJournal(const std::string &realFilename);
+
+        // The real name of the newest of filenames, or "" if none
+        // of them exist.
+        std::string  getNewestFilename(
+                            const std::vector<std::string> &filenames);
+
+        // The body of save(), shared with the writer thread. Rather
+        // than setting our error string, problems go in error.
+        bool         writeDicts(const std::vector<Dict *>      &dicts,
+                                const std::vector<std::string> &filenames,
+                                std::string                    &error);
+
+        // Block until the writer thread has nothing queued or 
+        // in progress.
+        void         waitForWriter();
+
+        // The writer thread
+        static void  writerMain(DataSavior *savior);
+
+        struct _DataSaviorWrite {
+            std::vector<Dict>        mDicts;     // snapshots
+            std::vector<std::string> mFilenames;
+        };
+
+        struct _DataSavior {
+            // Keyed on the real file name
+            std::map<std::string, Journal *> mJournals;
+            Mutex                            mJournalsMutex;
+
+            // Background writes. mWriteMutex covers everything 
+            // below; mWriteCond wakes the writer and mWriteDoneCond
+            // wakes anyone waiting for it to finish something.
+            Mutex                            mWriteMutex;
+            Condition                        mWriteCond;
+            Condition                        mWriteDoneCond;
+            std::deque<_DataSaviorWrite *>   mWrites;
+            bool                             mWriting;
+            bool                             mWriterQuit;
+            std::thread                      mWriter;
+            std::string                      mWriteErrors;
+
+            // Expanded file names, keyed on the pattern. Cleared 
+            // when the device id or the day changes.
+            Mutex                              mPatternsMutex;
+            std::string                        mDeviceId;
+            std::map<std::string, std::string> mPatterns;
+            int                                mPatternsDay;
+        };
+
+        _DataSavior *mDataSaviorData;
 };
 
 }; // namespace Ookala
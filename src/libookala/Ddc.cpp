@@ -30,6 +30,7 @@
 
 #include "Types.h"
 #include "Ddc.h"
+#include "Trace.h"
 
 
 // ------------------------------------
@@ -162,6 +163,8 @@ Ookala::Ddc::setVcpFeature(uint8_t opcode, uint16_t value, uint32_t devId /* = 0
     uint8_t msg[4];
     uint32_t realId;
 
+    TraceSpan span("ddc", "setVcpFeature");
+
     if (!validDevId(devId, realId)) {
         setErrorString("Invalid device ID.");
         return false;
@@ -205,6 +208,8 @@ Ookala::Ddc::getVcpFeature(uint8_t  opcode,    uint16_t &currValue,
     uint8_t  msg[8];
     uint32_t realId;
 
+    TraceSpan span("ddc", "getVcpFeature");
+
     if (!validDevId(devId, realId)) {
         setErrorString("Invalid device ID.");
         return false;
@@ -284,6 +289,8 @@ Ookala::Ddc::resetVcpFeature(uint8_t   opcode,   uint16_t &currValue,
     uint8_t  msg[8];
     uint32_t realId;
 
+    TraceSpan span("ddc", "resetVcpFeature");
+
     if (!validDevId(devId, realId)) {
         setErrorString("Invalid device ID.");
         return false;
@@ -346,6 +353,8 @@ Ookala::Ddc::saveSettings(uint32_t devId /* = 0 */)
     uint8_t msg[2];
     uint32_t realId;
 
+    TraceSpan span("ddc", "saveSettings");
+
     if (!validDevId(devId, realId)) {
         setErrorString("Invalid device ID.");
         return false;
@@ -28,16 +28,266 @@
 
 #include <string>
 #include <map>
+#include <set>
 #include <iostream>
 #include <sstream>
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <algorithm>
 
 #include "Dict.h"
+#include "Mutex.h"
+#include "Pack.h"
 #include "PluginRegistry.h"
 
+// Markers for unused and removed slots in the Dict item table.
+// DictKey id 0 is never handed out to a real key.
+#define _DICT_SLOT_EMPTY     0
+#define _DICT_SLOT_TOMBSTONE 0xffffffffu
+
+// _DictSlot::mFlags
+#define _DICT_SLOT_ESCAPED   0x1
+
+// Numeric arrays with at least this many elements are serialized
+// in packed form; see DictItem::serializeArray().
+#define _DICT_PACK_MIN_COUNT 16
+
+
+// =======================================
+//
+// DictKey
+//
+// ----------------------------------------
+
+namespace {
+
+// Process-wide table of interned key strings. Id 0 is reserved
+// for the invalid key. Strings are never released, so references
+// handed out by DictKey::str() stay valid for the life of the process.
+//
+// Nearly every lookup finds a string that's already here, so lookups
+// don't lock at all. Names are found through an open-addressed index
+// of entries, and by id through an array of them. Both are only ever
+// added to, under mLock, and when one fills up it's replaced by a
+// bigger copy. The old one is kept in mRetired rather than freed, 
+// as a reader may still be in it; together they never add up to 
+// more than the one in use.
+struct _DictKeyEntry {
+    std::string                 mName;
+    size_t                      mHash;
+    uint32_t                    mId;
+};
+
+struct _DictKeyIndex {
+    uint32_t                             mSize;
+    std::atomic<const _DictKeyEntry *>  *mEntry;
+};
+
+struct _DictKeyTable {
+    Ookala::Mutex                        mLock;
+    std::atomic<_DictKeyIndex *>         mIndex;
+    std::atomic<_DictKeyIndex *>         mIds;
+    uint32_t                             mCount;
+
+    std::vector<_DictKeyIndex *>         mRetired;
+};
+
+_DictKeyIndex *
+newDictKeyIndex(uint32_t size)
+{
+    _DictKeyIndex *index = new _DictKeyIndex;
+
+    index->mSize  = size;
+    index->mEntry = new std::atomic<const _DictKeyEntry *>[size];
+    for (uint32_t idx=0; idx<size; ++idx) {
+        index->mEntry[idx].store(NULL, std::memory_order_relaxed);
+    }
+
+    return index;
+}
+
+// Put entry in the first free slot for its hash. The caller makes 
+// sure there's room.
+void
+addDictKeyIndex(_DictKeyIndex *index, const _DictKeyEntry *entry)
+{
+    uint32_t mask = index->mSize - 1;
+    uint32_t pos  = (uint32_t)entry->mHash & mask;
+
+    while (index->mEntry[pos].load(std::memory_order_relaxed)) {
+        pos = (pos + 1) & mask;
+    }
+    index->mEntry[pos].store(entry, std::memory_order_release);
+}
+
+_DictKeyTable *
+newDictKeyTable()
+{
+    _DictKeyTable *table = new _DictKeyTable;
+    _DictKeyEntry *entry = new _DictKeyEntry;
+
+    entry->mName = "";
+    entry->mHash = 0;
+    entry->mId   = 0;
+
+    table->mIndex.store(newDictKeyIndex(64));
+    table->mIds.store(newDictKeyIndex(64));
+    table->mIds.load()->mEntry[0].store(entry);
+    table->mCount = 1;
+
+    return table;
+}
+
+_DictKeyTable &
+dictKeyTable()
+{
+    // Deliberately never freed - static DictKeys in plugins may 
+    // outlive us at exit.
+    static _DictKeyTable *table = newDictKeyTable();
+
+    return *table;
+}
+
+// Lock-free search of index for name. Returns 0 if it isn't there.
+uint32_t
+findDictKey(const _DictKeyIndex *index, const std::string &name, 
+            size_t hash)
+{
+    const _DictKeyEntry *entry;
+    uint32_t             mask = index->mSize - 1;
+    uint32_t             pos  = (uint32_t)hash & mask;
+
+    // The index is never more than half full, so this will terminate.
+    while ((entry = index->mEntry[pos].load(std::memory_order_acquire))) {
+        if ((entry->mHash == hash) && (entry->mName == name)) {
+            return entry->mId;
+        }
+        pos = (pos + 1) & mask;
+    }
+
+    return 0;
+}
+
+uint32_t
+internDictKey(const std::string &name)
+{
+    _DictKeyTable &table = dictKeyTable();
+    _DictKeyIndex *index, *ids, *bigger;
+    _DictKeyEntry *entry;
+    size_t         hash  = std::hash<std::string>()(name);
+    uint32_t       id;
+
+    id = findDictKey(table.mIndex.load(std::memory_order_acquire), 
+                     name, hash);
+    if (id) return id;
+
+    // Someone may have added it since we looked, or be replacing 
+    // the index we looked in, so look again with the lock held.
+    table.mLock.lock();
+
+    index = table.mIndex.load(std::memory_order_relaxed);
+    ids   = table.mIds.load(std::memory_order_relaxed);
+
+    id = findDictKey(index, name, hash);
+    if (id) {
+        table.mLock.unlock();
+        return id;
+    }
+
+    id           = table.mCount++;
+    entry        = new _DictKeyEntry;
+    entry->mName = name;
+    entry->mHash = hash;
+    entry->mId   = id;
+
+    // Make room by id first, so anyone who finds the new key in 
+    // the index can also find its name.
+    if (id >= ids->mSize) {
+        bigger = newDictKeyIndex(2 * ids->mSize);
+        for (uint32_t idx=0; idx<ids->mSize; ++idx) {
+            bigger->mEntry[idx].store(
+                    ids->mEntry[idx].load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+        }
+        table.mIds.store(bigger, std::memory_order_release);
+        table.mRetired.push_back(ids);
+        ids = bigger;
+    }
+    ids->mEntry[id].store(entry, std::memory_order_release);
+
+    // Keep the index no more than half full.
+    if (2 * (id + 1) > index->mSize) {
+        bigger = newDictKeyIndex(2 * index->mSize);
+        for (uint32_t idx=0; idx<index->mSize; ++idx) {
+            if (index->mEntry[idx].load(std::memory_order_relaxed)) {
+                addDictKeyIndex(bigger, 
+                    index->mEntry[idx].load(std::memory_order_relaxed));
+            }
+        }
+        addDictKeyIndex(bigger, entry);
+        table.mIndex.store(bigger, std::memory_order_release);
+        table.mRetired.push_back(index);
+    } else {
+        addDictKeyIndex(index, entry);
+    }
+
+    table.mLock.unlock();
+
+    return id;
+}
+
+}; // namespace
+
+// ----------------------------------------
+//
+Ookala::DictKey::DictKey():
+    mId(0)
+{
+}
+
+// ----------------------------------------
+//
+Ookala::DictKey::DictKey(const std::string &name)
+{
+    mId = internDictKey(name);
+}
+
+// ----------------------------------------
+//
+Ookala::DictKey::DictKey(const char *name)
+{
+    mId = internDictKey(std::string(name ? name : ""));
+}
+
+// ----------------------------------------
+//
+// static
+Ookala::DictKey
+Ookala::DictKey::find(const std::string &name)
+{
+    DictKey key;
+
+    key.mId = findDictKey(
+                dictKeyTable().mIndex.load(std::memory_order_acquire), 
+                name, std::hash<std::string>()(name));
+
+    return key;
+}
+
+// ----------------------------------------
+//
+const std::string &
+Ookala::DictKey::str() const
+{
+    const _DictKeyIndex *ids = 
+                dictKeyTable().mIds.load(std::memory_order_acquire);
+
+    return ids->mEntry[mId].load(std::memory_order_acquire)->mName;
+}
+
 
 // =======================================
 //
@@ -50,8 +300,14 @@ Ookala::DictItem::DictItem()
 {
     mIsSerializable          = true;
 
+    static const DictKey noneKey("none");
+
     mDictItemData            = new _DictItem;        
     mDictItemData->mItemType = "none";
+    mDictItemData->mItemTypeKey = noneKey;
+    mDictItemData->mTableRefs   = 0;
+    mDictItemData->mDictOwned   = false;
+    mDictItemData->mEscaped     = false;
 
 }
 
@@ -61,8 +317,12 @@ Ookala::DictItem::DictItem(const DictItem &src)
 {
     mDictItemData = new _DictItem;
 
-    mDictItemData->mItemType = src.mDictItemData->mItemType;
-    mIsSerializable          = src.mIsSerializable;
+    mDictItemData->mItemType    = src.mDictItemData->mItemType;
+    mDictItemData->mItemTypeKey = src.mDictItemData->mItemTypeKey;
+    mDictItemData->mTableRefs   = 0;
+    mDictItemData->mDictOwned   = false;
+    mDictItemData->mEscaped     = false;
+    mIsSerializable             = src.mIsSerializable;
 }
 
 // ----------------------------------------
@@ -84,14 +344,18 @@ Ookala::DictItem::operator=(const DictItem &src)
     if (this != &src) {
         //DictItem::operator=(src);
 
-        if (mDictItemData) {
-            delete mDictItemData;
-            mDictItemData = NULL;
+        // Which Dicts hold us doesn't change by assigning a value,
+        // so leave mTableRefs and mDictOwned alone.
+        if (!mDictItemData) {
+            mDictItemData = new _DictItem;
+            mDictItemData->mTableRefs = 0;
+            mDictItemData->mDictOwned = false;
+            mDictItemData->mEscaped   = false;
         }
 
         if (src.mDictItemData) {
-            mDictItemData  = new _DictItem();
-            *mDictItemData = *(src.mDictItemData);
+            mDictItemData->mItemType    = src.mDictItemData->mItemType;
+            mDictItemData->mItemTypeKey = src.mDictItemData->mItemTypeKey;
         }
 
         mIsSerializable = src.mIsSerializable;
@@ -113,6 +377,28 @@ Ookala::DictItem::itemType() const
     return std::string("");    
 }
 
+// ----------------------------------------
+//
+const Ookala::DictKey &
+Ookala::DictItem::itemTypeKey() const
+{
+    static const DictKey invalidKey;
+
+    if (mDictItemData) {
+        return mDictItemData->mItemTypeKey;
+    }
+    return invalidKey;
+}
+
+// ----------------------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::DictItem::clone() const
+{
+    return NULL;
+}
+
 // ----------------------------------------
 //
 // virtual
@@ -134,6 +420,24 @@ Ookala::DictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
     return false;
 }
 
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::DictItem::serializeBinary(std::string &buf)
+{
+    return false;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::DictItem::unserializeBinary(PackReader &reader)
+{
+    return false;
+}
+
 // ----------------------------------------
 //
 // virtual
@@ -149,7 +453,20 @@ void
 Ookala::DictItem::setItemType(const std::string &type)
 {
     if (mDictItemData) {
-        mDictItemData->mItemType = type;
+        mDictItemData->mItemType    = type;
+        mDictItemData->mItemTypeKey = DictKey(type);
+    }
+}
+
+// ----------------------------------------
+//
+// protected
+void        
+Ookala::DictItem::setItemType(const DictKey &type)
+{
+    if (mDictItemData) {
+        mDictItemData->mItemType    = type.str();
+        mDictItemData->mItemTypeKey = type;
     }
 }
 
@@ -208,418 +525,592 @@ Ookala::DictItem::getXmlDirectChildren(
     return true;
 }
 
+namespace {
 
-// ========================================
-//
-// BoolDictItem
-//
-// ----------------------------------------
+const char _base64Chars[] = 
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-Ookala::BoolDictItem::BoolDictItem() :  
-    DictItem()
+void
+_base64Encode(const std::vector<uint8_t> &bytes, std::string &out)
 {
-    setItemType("bool");
-    mValue    = false;
-}
+    size_t idx;
 
-// ----------------------------------------
-//
-Ookala::BoolDictItem::BoolDictItem(const BoolDictItem &src):
-    DictItem(src)
-{
-    mValue = src.mValue;
-}
+    out.clear();
+    out.reserve(4 * ((bytes.size() + 2) / 3));
 
-// ----------------------------
-//
-Ookala::BoolDictItem &
-Ookala::BoolDictItem::operator=(const BoolDictItem &src)
-{
-    if (this != &src) {
-        DictItem::operator=(src);
+    for (idx=0; idx+2 < bytes.size(); idx += 3) {
+        uint32_t bits = (bytes[idx] << 16) | (bytes[idx+1] << 8) | bytes[idx+2];
 
-        mValue = src.mValue;
+        out.push_back(_base64Chars[(bits >> 18) & 0x3f]);
+        out.push_back(_base64Chars[(bits >> 12) & 0x3f]);
+        out.push_back(_base64Chars[(bits >>  6) & 0x3f]);
+        out.push_back(_base64Chars[ bits        & 0x3f]);
     }
 
-    return *this;
-}
+    if (idx < bytes.size()) {
+        uint32_t bits = bytes[idx] << 16;
 
+        if (idx+1 < bytes.size()) {
+            bits |= bytes[idx+1] << 8;
+        }
 
-// ----------------------------------------
-//
-// root points to the place whose child should be a 
-// <dictitem></dictitem> tag.
-//
-// virtual
-bool 
-Ookala::BoolDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
-{
-
-    if (mValue) {
-        xmlNodeAddContent(root, (const xmlChar *)"true");
-    } else {
-        xmlNodeAddContent(root, (const xmlChar *)"false");
+        out.push_back(_base64Chars[(bits >> 18) & 0x3f]);
+        out.push_back(_base64Chars[(bits >> 12) & 0x3f]);
+        out.push_back((idx+1 < bytes.size())? _base64Chars[(bits >> 6) & 0x3f]: '=');
+        out.push_back('=');
     }
-
-    return true;
 }
 
-// ----------------------------------------
-//
-// root should point to a <dictitem></dictitem> element.
-//
-// Example:
-//      <dictitem type="bool" name="show parameter gui">false</dictitem>
-//
-// virtual
-bool 
-Ookala::BoolDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+// Whitespace is skipped, so hand-wrapped data still decodes.
+bool
+_base64Decode(const char *in, std::vector<uint8_t> &bytes)
 {
+    uint32_t bits  = 0;
+    int      nBits = 0;
+    bool     done  = false;
 
-    mValue = false;
-
-    std::string contentStr;
-
-    // So, if we have <dictitem type=bool>true</dictitem>, we would
-    // want to do:
-    //
-    //      xmlNodeListGetString(doc, root->xmlChildrenNode, 1);
-    //
-    // to retrieve the text.
-    
-    xmlChar *value = xmlNodeListGetString(doc, root->xmlChildrenNode, 1);
-    if (value != NULL) {
-        contentStr = (char *)value;
-        xmlFree(value);
-    } 
+    bytes.clear();
 
-    // Trim any leading + trailing space, and take 
-    // to lower case.
-    size_t start = contentStr.find_first_not_of(" \t\n");
-    size_t end   = contentStr.find_last_not_of(" \t\n");
+    for (; *in; ++in) {
+        int val;
+        char c = *in;
 
-    if (start == std::string::npos) {
-        contentStr = "";
-    } else {
-        contentStr = contentStr.substr(start, end-start+1);
-    }
-    std::transform(contentStr.begin(), 
-                   contentStr.end(), 
-                   contentStr.begin(), 
-#ifdef _WIN32
-                   tolower);
-#else
-                   (int(*)(int))std::tolower);                  
-#endif
+        if ((c == ' ') || (c == '\t') || (c == '\n') || (c == '\r')) {
+            continue;
+        }
+        if (c == '=') {
+            done = true;
+            continue;
+        }
+        if (done) {
+            return false;
+        }
 
-    if (contentStr == "true") {
-        mValue = true;
-    } else {
-        mValue = false;
+        if      ((c >= 'A') && (c <= 'Z')) val = c - 'A';
+        else if ((c >= 'a') && (c <= 'z')) val = c - 'a' + 26;
+        else if ((c >= '0') && (c <= '9')) val = c - '0' + 52;
+        else if (c == '+')                 val = 62;
+        else if (c == '/')                 val = 63;
+        else return false;
+
+        bits   = (bits << 6) | val;
+        nBits += 6;
+        if (nBits >= 8) {
+            nBits -= 8;
+            bytes.push_back((bits >> nBits) & 0xff);
+        }
     }
 
     return true;
 }
 
-// ----------------------------------------
-
 void
-Ookala::BoolDictItem::set(const bool value)
+_newPackedChild(xmlNodePtr root, const std::vector<uint8_t> &bytes, size_t count,
+                const char *encoding = "base64", size_t stride = 1)
 {
-    mValue = value;
-}
+    std::string encoded;
+    char        countStr[32];
+    xmlNodePtr  node;
 
-// ----------------------------------------
+    _base64Encode(bytes, encoded);
 
-bool
-Ookala::BoolDictItem::get()
-{
-    return mValue;
+    node = xmlNewTextChild(root, NULL, (const xmlChar *)"packed", 
+                                       (const xmlChar *)encoded.c_str());
+    snprintf(countStr, sizeof(countStr), "%lu", (unsigned long)count);
+    xmlSetProp(node, (const xmlChar *)"encoding", (const xmlChar *)encoding);
+    xmlSetProp(node, (const xmlChar *)"count",    (const xmlChar *)countStr);
+
+    if (stride > 1) {
+        snprintf(countStr, sizeof(countStr), "%lu", (unsigned long)stride);
+        xmlSetProp(node, (const xmlChar *)"stride", (const xmlChar *)countStr);
+    }
 }
 
-// ----------------------------------------
-//
-// virtual
+// Base-128 varints, low 7 bits first, high bit set on all but 
+// the last byte.
 void
-Ookala::BoolDictItem::debug()
+_varintAppend(std::vector<uint8_t> &bytes, uint64_t value)
 {
-    if (mValue) {
-        fprintf(stderr, "true\n");
-    } else {
-        fprintf(stderr, "false\n");
+    while (value >= 0x80) {
+        bytes.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
     }
+    bytes.push_back((uint8_t)value);
 }
 
+bool
+_varintRead(const std::vector<uint8_t> &bytes, size_t &pos, uint64_t &value)
+{
+    value = 0;
+    for (int shift=0; (shift < 64) && (pos < bytes.size()); shift += 7) {
+        uint8_t b = bytes[pos++];
 
+        value |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
 
-// ========================================
-//
-// IntDictItem
+// Undo a "delta-varint" packed node, leaving the same little-endian
+// bytes that a "base64" node of count values would have held.
 //
-// ----------------------------------------
+// Each value is stored relative to the one stride places before it
+// (or 0 for the first stride values). For 4 byte ints that's the
+// zigzagged difference, so small steps either way take one byte. 
+// For 8 byte doubles it's the xor of the bit patterns, which leaves
+// only the low mantissa bits when neighbors are close.
+bool
+_deltaVarintDecode(const std::vector<uint8_t> &packed, size_t width,
+                   size_t count, size_t stride, std::vector<uint8_t> &bytes)
+{
+    std::vector<uint64_t> bits(count);
+    size_t                pos = 0;
 
+    for (size_t idx=0; idx<count; ++idx) {
+        uint64_t value;
+        uint64_t base = (idx >= stride)? bits[idx-stride]: 0;
 
-Ookala::IntDictItem::IntDictItem() :  
-    DictItem()
-{
-    setItemType("int");
-    mValue    = 0;
-}
+        if (!_varintRead(packed, pos, value)) {
+            return false;
+        }
 
+        if (width == 4) {
+            uint32_t delta = (uint32_t)(value >> 1) ^ (0u - (uint32_t)(value & 1));
 
-// ----------------------------------------
-//
-Ookala::IntDictItem::IntDictItem(const IntDictItem &src):
-    DictItem(src)
-{
-    mValue = src.mValue;
-}
+            bits[idx] = (uint32_t)((uint32_t)base + delta);
+        } else {
+            bits[idx] = base ^ value;
+        }
+    }
+    if (pos != packed.size()) {
+        return false;
+    }
 
-// ----------------------------------------
-//
-// root points to the place whose child should be a 
-// <dictitem></dictitem> tag.
+    bytes.resize(count * width);
+    for (size_t idx=0; idx<count; ++idx) {
+        for (size_t b=0; b<width; ++b) {
+            bytes[width*idx+b] = (bits[idx] >> (8*b)) & 0xff;
+        }
+    }
 
-// virtual
-bool 
-Ookala::IntDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+    return true;
+}
+
+// Decode a <packed> node into bytes, checking that it holds
+// exactly count values of width bytes.
+bool
+_readPackedChild(xmlDocPtr doc, xmlNodePtr node, size_t width,
+                 std::vector<uint8_t> &bytes, size_t &count)
 {
-    std::ostringstream value;
+    xmlChar *attr;
+    bool     ok    = true;
+    bool     delta = false;
+    size_t   stride = 1;
+
+    attr = xmlGetProp(node, (const xmlChar *)"encoding");
+    if ((attr != NULL) && !strcmp((const char *)attr, "delta-varint")) {
+        delta = true;
+    } else if ((attr == NULL) || strcmp((const char *)attr, "base64")) {
+        ok = false;
+    }
+    if (attr) {
+        xmlFree(attr);
+    }
+    if (!ok) {
+        fprintf(stderr, "Unknown encoding for packed array\n");
+        return false;
+    }
 
-    value << mValue;
+    count = 0;
+    attr  = xmlGetProp(node, (const xmlChar *)"count");
+    if (attr) {
+        count = strtoul((const char *)attr, NULL, 10);
+        xmlFree(attr);
+    }
 
-    xmlNodeAddContent(root, (const xmlChar *)(value.str().c_str()));
+    attr  = xmlGetProp(node, (const xmlChar *)"stride");
+    if (attr) {
+        stride = strtoul((const char *)attr, NULL, 10);
+        xmlFree(attr);
+    }
+
+    attr = xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
+    ok   = _base64Decode(attr? (const char *)attr: "", bytes);
+    if (attr) {
+        xmlFree(attr);
+    }
+
+    if (ok && delta) {
+        std::vector<uint8_t> packed;
+
+        packed.swap(bytes);
+        ok = (stride > 0) && (count <= packed.size()) &&
+                    _deltaVarintDecode(packed, width, count, stride, bytes);
+    }
+
+    if ((!ok) || (bytes.size() != count * width)) {
+        fprintf(stderr, "Malformed packed array (expected %lu values)\n",
+                                                    (unsigned long)count);
+        return false;
+    }
 
     return true;
 }
 
-// ----------------------------
-//
-Ookala::IntDictItem &
-Ookala::IntDictItem::operator=(const IntDictItem &src)
+// Use the short form if it reads back the same, so things like 
+// 0.3333 don't turn into 0.33329999999999999.
+void
+_formatDouble(double value, char *str, size_t size)
 {
-    if (this != &src) {
-        DictItem::operator=(src);
-
-        mValue = src.mValue;
+    snprintf(str, size, "%.15g", value);
+    if (strtod(str, NULL) != value) {
+        snprintf(str, size, "%.17g", value);
     }
-
-    return *this;
 }
 
+}; // namespace
+
 // ----------------------------------------
 //
-// root should point to a <dictitem></dictitem> element.
-//
-// Example:
-//      <dictitem type="int" name="Meaning of life"> 42 </dictitem>
-//
-// virtual
-bool 
-Ookala::IntDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+// protected static
+void
+Ookala::DictItem::serializeArray(xmlNodePtr root, 
+                                 const int32_t *values, size_t count)
 {
-    mValue   = 0;
+    if (count < _DICT_PACK_MIN_COUNT) {
+        char valueStr[16];
 
-    xmlChar *value = xmlNodeListGetString(doc, root->xmlChildrenNode, 1);
-    if (value != NULL) {
-        mValue = atoi((char *)value);
-        xmlFree(value);
-    } 
+        for (size_t idx=0; idx<count; ++idx) {
+            snprintf(valueStr, sizeof(valueStr), "%d", values[idx]);
+            xmlNewTextChild(root, NULL, (const xmlChar *)"value", 
+                                        (const xmlChar *)valueStr);
+        }
+        return;
+    }
 
-    return true;
+    std::vector<uint8_t> bytes(4*count);
+
+    for (size_t idx=0; idx<count; ++idx) {
+        uint32_t bits = (uint32_t)values[idx];
+
+        bytes[4*idx]   =  bits        & 0xff;
+        bytes[4*idx+1] = (bits >>  8) & 0xff;
+        bytes[4*idx+2] = (bits >> 16) & 0xff;
+        bytes[4*idx+3] = (bits >> 24) & 0xff;
+    }
+
+    _newPackedChild(root, bytes, count);
 }
 
 // ----------------------------------------
-
+//
+// protected static
 void
-Ookala::IntDictItem::set(const int32_t value)
+Ookala::DictItem::serializeArray(xmlNodePtr root, 
+                                 const double *values, size_t count)
 {
-    mValue = value;
-}
+    if (count < _DICT_PACK_MIN_COUNT) {
+        char valueStr[32];
 
-// ----------------------------------------
+        for (size_t idx=0; idx<count; ++idx) {
+            _formatDouble(values[idx], valueStr, sizeof(valueStr));
+            xmlNewTextChild(root, NULL, (const xmlChar *)"value", 
+                                        (const xmlChar *)valueStr);
+        }
+        return;
+    }
 
-int32_t
-Ookala::IntDictItem::get()
-{
-    return mValue;
+    std::vector<uint8_t> bytes(8*count);
+
+    for (size_t idx=0; idx<count; ++idx) {
+        uint64_t bits;
+
+        memcpy(&bits, &values[idx], sizeof(bits));
+        for (int b=0; b<8; ++b) {
+            bytes[8*idx+b] = (bits >> (8*b)) & 0xff;
+        }
+    }
+
+    _newPackedChild(root, bytes, count);
 }
 
 // ----------------------------------------
 //
-// virtual
+// protected static
 void
-Ookala::IntDictItem::debug()
+Ookala::DictItem::serializeDeltaArray(xmlNodePtr root, 
+                                      const int32_t *values, size_t count,
+                                      size_t stride)
 {
-    printf("%d\n", mValue);
-}
+    if (count < _DICT_PACK_MIN_COUNT) {
+        serializeArray(root, values, count);
+        return;
+    }
 
+    std::vector<uint8_t> bytes;
 
-// ========================================
-//
-// DoubleDictItem
-//
-// ----------------------------------------
+    bytes.reserve(count + count/4);
+    for (size_t idx=0; idx<count; ++idx) {
+        uint32_t base  = (idx >= stride)? (uint32_t)values[idx-stride]: 0;
+        int32_t  delta = (int32_t)((uint32_t)values[idx] - base);
 
-Ookala::DoubleDictItem::DoubleDictItem() :  
-    DictItem()
-{
-    setItemType("double");
-    mValue    = 0.0;
+        _varintAppend(bytes, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+    }
+
+    _newPackedChild(root, bytes, count, "delta-varint", stride);
 }
 
 // ----------------------------------------
 //
-
-Ookala::DoubleDictItem::DoubleDictItem(const DoubleDictItem &src) :  
-    DictItem(src)
+// protected static
+void
+Ookala::DictItem::serializeDeltaArray(xmlNodePtr root, 
+                                      const double *values, size_t count,
+                                      size_t stride)
 {
-    mValue = src.mValue;
-}
+    if (count < _DICT_PACK_MIN_COUNT) {
+        serializeArray(root, values, count);
+        return;
+    }
 
-// ----------------------------
-//
-Ookala::DoubleDictItem &
-Ookala::DoubleDictItem::operator=(const DoubleDictItem &src)
-{
-    if (this != &src) {
-        DictItem::operator=(src);
+    std::vector<uint8_t> bytes;
 
-        mValue = src.mValue;
+    bytes.reserve(8*count);
+    for (size_t idx=0; idx<count; ++idx) {
+        uint64_t bits, base = 0;
+
+        memcpy(&bits, &values[idx], sizeof(bits));
+        if (idx >= stride) {
+            memcpy(&base, &values[idx-stride], sizeof(base));
+        }
+
+        _varintAppend(bytes, bits ^ base);
     }
 
-    return *this;
+    _newPackedChild(root, bytes, count, "delta-varint", stride);
 }
 
-
 // ----------------------------------------
 //
-// root points to the place whose child should be a 
-// <dictitem></dictitem> tag.
-//
-// virtual
-bool 
-Ookala::DoubleDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+// protected static
+bool
+Ookala::DictItem::unserializeArray(xmlDocPtr doc, xmlNodePtr root,
+                                   std::vector<int32_t> &values)
 {
-    std::ostringstream value;
+    values.clear();
 
-    value << mValue;
+    for (xmlNodePtr node = root->xmlChildrenNode; node != NULL; node = node->next) {
+        if (node->name == NULL) {
+            continue;
+        }
+
+        if (!strcmp((const char *)node->name, "packed")) {
+            std::vector<uint8_t> bytes;
+            size_t               count;
+
+            if (!_readPackedChild(doc, node, 4, bytes, count)) {
+                return false;
+            }
+
+            values.reserve(values.size() + count);
+            for (size_t idx=0; idx<count; ++idx) {
+                values.push_back((int32_t)( (uint32_t)bytes[4*idx]               |
+                                           ((uint32_t)bytes[4*idx+1] <<  8)  |
+                                           ((uint32_t)bytes[4*idx+2] << 16)  |
+                                           ((uint32_t)bytes[4*idx+3] << 24)));
+            }
+        } else if (!strcmp((const char *)node->name, "value")) {
+            xmlChar *value = xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
+
+            values.push_back(value? atoi((const char *)value): 0);
+            if (value) {
+                xmlFree(value);
+            }
+        }
+    }
 
-    xmlNodeAddContent(root, (const xmlChar *)(value.str().c_str()));
     return true;
 }
 
-
 // ----------------------------------------
 //
-// root should point to a <dictitem></dictitem> element.
-// If we don't find a name, return false;
-//
-// Example:
-//      <dictitem type="double" name="Meaning of life">42.0001</dictitem>
-//
-// virtual
+// protected static
 bool
-Ookala::DoubleDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+Ookala::DictItem::unserializeArray(xmlDocPtr doc, xmlNodePtr root,
+                                   std::vector<double> &values)
 {
-    mValue   = 0;
+    values.clear();
 
-    xmlChar *value = xmlNodeListGetString(doc, root->xmlChildrenNode, 1);
-    if (value != NULL) {
-        mValue = atof((char *)value);
-        xmlFree(value);
-    } 
+    for (xmlNodePtr node = root->xmlChildrenNode; node != NULL; node = node->next) {
+        if (node->name == NULL) {
+            continue;
+        }
+
+        if (!strcmp((const char *)node->name, "packed")) {
+            std::vector<uint8_t> bytes;
+            size_t               count;
+
+            if (!_readPackedChild(doc, node, 8, bytes, count)) {
+                return false;
+            }
+
+            values.reserve(values.size() + count);
+            for (size_t idx=0; idx<count; ++idx) {
+                uint64_t bits = 0;
+                double   val;
+
+                for (int b=7; b>=0; --b) {
+                    bits = (bits << 8) | bytes[8*idx+b];
+                }
+                memcpy(&val, &bits, sizeof(val));
+                values.push_back(val);
+            }
+        } else if (!strcmp((const char *)node->name, "value")) {
+            xmlChar *value = xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
+
+            values.push_back(value? atof((const char *)value): 0);
+            if (value) {
+                xmlFree(value);
+            }
+        }
+    }
 
     return true;
 }
 
 // ----------------------------------------
-
+//
+// protected static
 void
-Ookala::DoubleDictItem::set(const double value)
+Ookala::DictItem::serializeValues(xmlNodePtr root, 
+                                  const double *values, size_t count)
 {
-    mValue = value;
-}
+    std::string text;
+    char        valueStr[32];
 
-// ----------------------------------------
+    for (size_t idx=0; idx<count; ++idx) {
+        _formatDouble(values[idx], valueStr, sizeof(valueStr));
+        if (idx) {
+            text.push_back(' ');
+        }
+        text.append(valueStr);
+    }
 
-double
-Ookala::DoubleDictItem::get()
-{
-    return mValue;
+    xmlNodeAddContent(root, (const xmlChar *)(text.c_str()));
 }
 
 // ----------------------------------------
 //
-// virtual
-void
-Ookala::DoubleDictItem::debug()
+// protected static
+bool
+Ookala::DictItem::unserializeValues(xmlDocPtr doc, xmlNodePtr root,
+                                    double *values, size_t count)
 {
-    printf("%f\n", mValue);
+    size_t   found = 0;
+    xmlChar *text  = xmlNodeListGetString(doc, root->xmlChildrenNode, 1);
+
+    if (text != NULL) {
+        const char *pos = (const char *)text;
+        char       *end;
+
+        while (true) {
+            double val = strtod(pos, &end);
+            if (end == pos) {
+                break;
+            }
+            if (found < count) {
+                values[found] = val;
+            }
+            found++;
+            pos = end;
+        }
+
+        // Anything left over that isn't whitespace means junk.
+        while ((*pos == ' ') || (*pos == '\t') || 
+                    (*pos == '\n') || (*pos == '\r')) {
+            pos++;
+        }
+        if (*pos) {
+            found = 0;
+        }
+
+        xmlFree(text);
+    }
+
+    // Fall back on <value> children, as written for a doubleArray.
+    if (found == 0) {
+        std::vector<double> array;
+
+        if (!unserializeArray(doc, root, array)) {
+            return false;
+        }
+        for (size_t idx=0; (idx<array.size()) && (idx<count); ++idx) {
+            values[idx] = array[idx];
+        }
+        found = array.size();
+    }
+
+    return found == count;
 }
 
 
 // ========================================
 //
-// StringDictItem
+// BoolDictItem
 //
 // ----------------------------------------
 
-
-Ookala::StringDictItem::StringDictItem() :  
+Ookala::BoolDictItem::BoolDictItem() :  
     DictItem()
 {
-    setItemType("string");
-
-    mStringDictItemData = new _StringDictItem;    
+    setItemType(typeKey());
+    mValue    = false;
 }
 
 // ----------------------------------------
 //
-Ookala::StringDictItem::StringDictItem(const StringDictItem &src):
+Ookala::BoolDictItem::BoolDictItem(const BoolDictItem &src):
     DictItem(src)
 {
-    mStringDictItemData = new _StringDictItem;
-
-    mStringDictItemData->mValue = src.mStringDictItemData->mValue;
+    mValue = src.mValue;
 }
 
 // ----------------------------------------
 //
-// virtual
-Ookala::StringDictItem::~StringDictItem()
+// static
+const Ookala::DictKey &
+Ookala::BoolDictItem::typeKey()
 {
-    if (mStringDictItemData) {
-        delete mStringDictItemData;
-        mStringDictItemData = NULL;
-    }
-}      
+    static const DictKey key("bool");
+    return key;
+}
 
+// ----------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::BoolDictItem::clone() const
+{
+    return new BoolDictItem(*this);
+}
 
 // ----------------------------
 //
-Ookala::StringDictItem &
-Ookala::StringDictItem::operator=(const StringDictItem &src)
+Ookala::BoolDictItem &
+Ookala::BoolDictItem::operator=(const BoolDictItem &src)
 {
     if (this != &src) {
         DictItem::operator=(src);
 
-        if (mStringDictItemData) {
-            delete mStringDictItemData;
-            mStringDictItemData = NULL;
-        }
-
-        if (src.mStringDictItemData) {
-            mStringDictItemData  = new _StringDictItem();
-            *mStringDictItemData = *(src.mStringDictItemData);
-        }
+        mValue = src.mValue;
     }
 
     return *this;
 }
 
 
-
 // ----------------------------------------
 //
 // root points to the place whose child should be a 
@@ -627,163 +1118,255 @@ Ookala::StringDictItem::operator=(const StringDictItem &src)
 //
 // virtual
 bool 
-Ookala::StringDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+Ookala::BoolDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
 {
 
-    xmlNodeAddContent(root, (const xmlChar *)(get().c_str()));
-
+    if (mValue) {
+        xmlNodeAddContent(root, (const xmlChar *)"true");
+    } else {
+        xmlNodeAddContent(root, (const xmlChar *)"false");
+    }
+
     return true;
 }
 
-
 // ----------------------------------------
 //
 // root should point to a <dictitem></dictitem> element.
-// If we don't find a name, return false;
 //
 // Example:
-//     <dictitem type="string" name="meaning of life">42.0001</dictitem>
+//      <dictitem type="bool" name="show parameter gui">false</dictitem>
 //
 // virtual
-bool
-Ookala::StringDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+bool 
+Ookala::BoolDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
 {
-    std::string str;
 
-    set("");
+    mValue = false;
+
+    std::string contentStr;
 
+    // So, if we have <dictitem type=bool>true</dictitem>, we would
+    // want to do:
+    //
+    //      xmlNodeListGetString(doc, root->xmlChildrenNode, 1);
+    //
+    // to retrieve the text.
+    
     xmlChar *value = xmlNodeListGetString(doc, root->xmlChildrenNode, 1);
     if (value != NULL) {
-        str = ((char *)value);
+        contentStr = (char *)value;
         xmlFree(value);
     } 
 
-    // Trim any leading + trailing space
-    size_t start = str.find_first_not_of(" \t\n");
-    size_t end   = str.find_last_not_of(" \t\n");
+    // Trim any leading + trailing space, and take 
+    // to lower case.
+    size_t start = contentStr.find_first_not_of(" \t\n");
+    size_t end   = contentStr.find_last_not_of(" \t\n");
 
     if (start == std::string::npos) {
-        str = "";
+        contentStr = "";
     } else {
-        str = str.substr(start, end-start+1);
+        contentStr = contentStr.substr(start, end-start+1);
     }
+    std::transform(contentStr.begin(), 
+                   contentStr.end(), 
+                   contentStr.begin(), 
+#ifdef _WIN32
+                   tolower);
+#else
+                   (int(*)(int))std::tolower);                  
+#endif
 
-    set(str);
+    if (contentStr == "true") {
+        mValue = true;
+    } else {
+        mValue = false;
+    }
+
+    return true;
+}
 
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::BoolDictItem::serializeBinary(std::string &buf)
+{
+    packU8(buf, mValue? 1: 0);
     return true;
 }
 
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::BoolDictItem::unserializeBinary(PackReader &reader)
+{
+    mValue = (reader.u8() != 0);
+    return reader.ok();
+}
+
 // ----------------------------------------
 
 void
-Ookala::StringDictItem::set(const std::string value)
+Ookala::BoolDictItem::set(const bool value)
 {
-    if (mStringDictItemData) {
-        mStringDictItemData->mValue = value;
-    }
+    mValue = value;
 }
 
 // ----------------------------------------
 
-std::string
-Ookala::StringDictItem::get()
+bool
+Ookala::BoolDictItem::get() const
 {
-    if (mStringDictItemData) {
-        return mStringDictItemData->mValue;
-    }
-    return std::string("");;
+    return mValue;
 }
 
 // ----------------------------------------
 //
 // virtual
 void
-Ookala::StringDictItem::debug()
+Ookala::BoolDictItem::debug()
 {
-    printf("%s\n", get().c_str());
+    if (mValue) {
+        fprintf(stderr, "true\n");
+    } else {
+        fprintf(stderr, "false\n");
+    }
 }
 
 
+
 // ========================================
 //
-// BlobDictItem
+// IntDictItem
 //
 // ----------------------------------------
 
 
-Ookala::BlobDictItem::BlobDictItem() :  
+Ookala::IntDictItem::IntDictItem() :  
     DictItem()
 {
-    setItemType("blob");
-    mValue          = NULL;
-    mSize           = 0;
-    mIsSerializable = false;
-
+    setItemType(typeKey());
+    mValue    = 0;
 }
 
+
 // ----------------------------------------
 //
-Ookala::BlobDictItem::BlobDictItem(const BlobDictItem &src):
+Ookala::IntDictItem::IntDictItem(const IntDictItem &src):
     DictItem(src)
 {
     mValue = src.mValue;
-    mSize  = src.mSize;
 }
 
 // ----------------------------------------
 //
-// Blob's aren't serializable right now.
-//
+// root points to the place whose child should be a 
+// <dictitem></dictitem> tag.
+
 // virtual
 bool 
-Ookala::BlobDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+Ookala::IntDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
 {
+    std::ostringstream value;
+
+    value << mValue;
+
+    xmlNodeAddContent(root, (const xmlChar *)(value.str().c_str()));
+
     return true;
 }
 
+// ----------------------------------------
+//
+// static
+const Ookala::DictKey &
+Ookala::IntDictItem::typeKey()
+{
+    static const DictKey key("int");
+    return key;
+}
+
 // ----------------------------
 //
-Ookala::BlobDictItem &
-Ookala::BlobDictItem::operator=(const BlobDictItem &src)
+// virtual
+Ookala::DictItem *
+Ookala::IntDictItem::clone() const
+{
+    return new IntDictItem(*this);
+}
+
+// ----------------------------
+//
+Ookala::IntDictItem &
+Ookala::IntDictItem::operator=(const IntDictItem &src)
 {
     if (this != &src) {
         DictItem::operator=(src);
 
         mValue = src.mValue;
-        mSize  = src.mSize;
     }
 
     return *this;
 }
 
+// ----------------------------------------
+//
+// root should point to a <dictitem></dictitem> element.
+//
+// Example:
+//      <dictitem type="int" name="Meaning of life"> 42 </dictitem>
+//
+// virtual
+bool 
+Ookala::IntDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    mValue   = 0;
+
+    xmlChar *value = xmlNodeListGetString(doc, root->xmlChildrenNode, 1);
+    if (value != NULL) {
+        mValue = atoi((char *)value);
+        xmlFree(value);
+    } 
 
+    return true;
+}
 
 // ----------------------------------------
 //
-// Blob's aren't deserializable right now.
-//
 // virtual
 bool
-Ookala::BlobDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+Ookala::IntDictItem::serializeBinary(std::string &buf)
 {
+    packU32(buf, (uint32_t)mValue);
     return true;
 }
 
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::IntDictItem::unserializeBinary(PackReader &reader)
+{
+    mValue = (int32_t)reader.u32();
+    return reader.ok();
+}
+
 // ----------------------------------------
 
 void
-Ookala::BlobDictItem::set(uint8_t *value, uint32_t size)
+Ookala::IntDictItem::set(const int32_t value)
 {
     mValue = value;
-    mSize  = size;
 }
 
 // ----------------------------------------
 
-uint8_t *
-Ookala::BlobDictItem::get(uint32_t &size)
+int32_t
+Ookala::IntDictItem::get() const
 {
-    size = mSize;
     return mValue;
 }
 
@@ -791,66 +1374,62 @@ Ookala::BlobDictItem::get(uint32_t &size)
 //
 // virtual
 void
-Ookala::BlobDictItem::debug()
+Ookala::IntDictItem::debug()
 {
-    printf("%d bytes\n",  mSize);
+    printf("%d\n", mValue);
 }
 
 
 // ========================================
 //
-// IntArrayDictItem
+// DoubleDictItem
 //
 // ----------------------------------------
 
-Ookala::IntArrayDictItem::IntArrayDictItem() :  
+Ookala::DoubleDictItem::DoubleDictItem() :  
     DictItem()
 {
-    setItemType("intArray");
-
-    mIntArrayDictItemData = new _IntArrayDictItem;
+    setItemType(typeKey());
+    mValue    = 0.0;
 }
 
 // ----------------------------------------
 //
-Ookala::IntArrayDictItem::IntArrayDictItem(const IntArrayDictItem &src):
+
+Ookala::DoubleDictItem::DoubleDictItem(const DoubleDictItem &src) :  
     DictItem(src)
 {
-    mIntArrayDictItemData = new _IntArrayDictItem;
-
-    if (src.mIntArrayDictItemData) {
-        mIntArrayDictItemData->mValue = src.mIntArrayDictItemData->mValue;
-    }
+    mValue = src.mValue;
 }
-      
+
 // ----------------------------------------
 //
+// static
+const Ookala::DictKey &
+Ookala::DoubleDictItem::typeKey()
+{
+    static const DictKey key("double");
+    return key;
+}
+
+// ----------------------------
+//
 // virtual
-Ookala::IntArrayDictItem::~IntArrayDictItem()
+Ookala::DictItem *
+Ookala::DoubleDictItem::clone() const
 {
-    if (mIntArrayDictItemData) {
-        delete mIntArrayDictItemData;
-        mIntArrayDictItemData = NULL;
-    }
+    return new DoubleDictItem(*this);
 }
 
 // ----------------------------
 //
-Ookala::IntArrayDictItem &
-Ookala::IntArrayDictItem::operator=(const IntArrayDictItem &src)
+Ookala::DoubleDictItem &
+Ookala::DoubleDictItem::operator=(const DoubleDictItem &src)
 {
     if (this != &src) {
         DictItem::operator=(src);
 
-        if (mIntArrayDictItemData) {
-            delete mIntArrayDictItemData;
-            mIntArrayDictItemData = NULL;
-        }
-
-        if (src.mIntArrayDictItemData) {
-            mIntArrayDictItemData  = new _IntArrayDictItem();
-            *mIntArrayDictItemData = *(src.mIntArrayDictItemData);
-        }
+        mValue = src.mValue;
     }
 
     return *this;
@@ -864,629 +1443,2846 @@ Ookala::IntArrayDictItem::operator=(const IntArrayDictItem &src)
 //
 // virtual
 bool 
-Ookala::IntArrayDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+Ookala::DoubleDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
 {
-    for (std::vector<int32_t>::iterator i=mIntArrayDictItemData->mValue.begin();
-                           i != mIntArrayDictItemData->mValue.end(); ++i) {
-
-        std::ostringstream value;
-        value << (*i);
+    std::ostringstream value;
 
-        xmlNewTextChild(root, NULL, (const xmlChar *)"value", 
-                                    (const xmlChar *)value.str().c_str());
-    }
+    value << mValue;
 
+    xmlNodeAddContent(root, (const xmlChar *)(value.str().c_str()));
     return true;
 }
 
+
 // ----------------------------------------
 //
 // root should point to a <dictitem></dictitem> element.
 // If we don't find a name, return false;
 //
 // Example:
-//            <dictitem type="intArray" name="Countdown">
-//                <value>4</value>
-//                <value>3</value>
-//                <value>2</value>
-//                <value>1</value>
-//            </dictitem>
-
+//      <dictitem type="double" name="Meaning of life">42.0001</dictitem>
+//
 // virtual
 bool
-Ookala::IntArrayDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+Ookala::DoubleDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
 {
-    std::vector<std::string> names, values;
-
-    mIntArrayDictItemData->mValue.clear();
+    mValue   = 0;
 
-    getXmlDirectChildren(doc, root, names, values);
+    xmlChar *value = xmlNodeListGetString(doc, root->xmlChildrenNode, 1);
+    if (value != NULL) {
+        mValue = atof((char *)value);
+        xmlFree(value);
+    } 
 
-    std::vector<std::string>::iterator theName  = names.begin();
-    std::vector<std::string>::iterator theValue = values.begin();
+    return true;
+}
 
-    while ((theName != names.end()) && (theValue != values.end()))  {
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::DoubleDictItem::serializeBinary(std::string &buf)
+{
+    packDouble(buf, mValue);
+    return true;
+}
 
-        if ((*theName) == "value") {
-            mIntArrayDictItemData->mValue.push_back(atoi((*theValue).c_str()));
-        }
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::DoubleDictItem::unserializeBinary(PackReader &reader)
+{
+    mValue = reader.f64();
+    return reader.ok();
+}
+
+// ----------------------------------------
+
+void
+Ookala::DoubleDictItem::set(const double value)
+{
+    mValue = value;
+}
+
+// ----------------------------------------
+
+double
+Ookala::DoubleDictItem::get() const
+{
+    return mValue;
+}
+
+// ----------------------------------------
+//
+// virtual
+void
+Ookala::DoubleDictItem::debug()
+{
+    printf("%f\n", mValue);
+}
+
+
+// ========================================
+//
+// StringDictItem
+//
+// ----------------------------------------
+
+
+Ookala::StringDictItem::StringDictItem() :  
+    DictItem()
+{
+    setItemType(typeKey());
+
+    mStringDictItemData = new _StringDictItem;    
+}
+
+// ----------------------------------------
+//
+Ookala::StringDictItem::StringDictItem(const StringDictItem &src):
+    DictItem(src)
+{
+    mStringDictItemData = new _StringDictItem;
+
+    mStringDictItemData->mValue = src.mStringDictItemData->mValue;
+}
+
+// ----------------------------------------
+//
+// virtual
+Ookala::StringDictItem::~StringDictItem()
+{
+    if (mStringDictItemData) {
+        delete mStringDictItemData;
+        mStringDictItemData = NULL;
+    }
+}      
+
+
+// ----------------------------------------
+//
+// static
+const Ookala::DictKey &
+Ookala::StringDictItem::typeKey()
+{
+    static const DictKey key("string");
+    return key;
+}
+
+// ----------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::StringDictItem::clone() const
+{
+    return new StringDictItem(*this);
+}
+
+// ----------------------------
+//
+Ookala::StringDictItem &
+Ookala::StringDictItem::operator=(const StringDictItem &src)
+{
+    if (this != &src) {
+        DictItem::operator=(src);
+
+        if (mStringDictItemData) {
+            delete mStringDictItemData;
+            mStringDictItemData = NULL;
+        }
+
+        if (src.mStringDictItemData) {
+            mStringDictItemData  = new _StringDictItem();
+            *mStringDictItemData = *(src.mStringDictItemData);
+        }
+    }
+
+    return *this;
+}
+
+
+
+// ----------------------------------------
+//
+// root points to the place whose child should be a 
+// <dictitem></dictitem> tag.
+//
+// virtual
+bool 
+Ookala::StringDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+{
+
+    xmlNodeAddContent(root, (const xmlChar *)(get().c_str()));
+
+    return true;
+}
+
+
+// ----------------------------------------
+//
+// root should point to a <dictitem></dictitem> element.
+// If we don't find a name, return false;
+//
+// Example:
+//     <dictitem type="string" name="meaning of life">42.0001</dictitem>
+//
+// virtual
+bool
+Ookala::StringDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    std::string str;
+
+    set("");
+
+    xmlChar *value = xmlNodeListGetString(doc, root->xmlChildrenNode, 1);
+    if (value != NULL) {
+        str = ((char *)value);
+        xmlFree(value);
+    } 
+
+    // Trim any leading + trailing space
+    size_t start = str.find_first_not_of(" \t\n");
+    size_t end   = str.find_last_not_of(" \t\n");
+
+    if (start == std::string::npos) {
+        str = "";
+    } else {
+        str = str.substr(start, end-start+1);
+    }
+
+    set(str);
+
+    return true;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::StringDictItem::serializeBinary(std::string &buf)
+{
+    packString(buf, mStringDictItemData->mValue);
+    return true;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::StringDictItem::unserializeBinary(PackReader &reader)
+{
+    std::string value = reader.str();
+
+    if (!reader.ok()) {
+        return false;
+    }
+
+    mStringDictItemData->mValue = value;
+    return true;
+}
+
+// ----------------------------------------
+
+void
+Ookala::StringDictItem::set(const std::string value)
+{
+    if (mStringDictItemData) {
+        mStringDictItemData->mValue = value;
+    }
+}
+
+// ----------------------------------------
+
+std::string
+Ookala::StringDictItem::get() const
+{
+    if (mStringDictItemData) {
+        return mStringDictItemData->mValue;
+    }
+    return std::string("");;
+}
+
+// ----------------------------------------
+//
+// virtual
+void
+Ookala::StringDictItem::debug()
+{
+    printf("%s\n", get().c_str());
+}
+
+
+// ========================================
+//
+// BlobDictItem
+//
+// ----------------------------------------
+
+
+Ookala::BlobDictItem::BlobDictItem() :  
+    DictItem()
+{
+    setItemType(typeKey());
+    mValue          = NULL;
+    mSize           = 0;
+    mIsSerializable = false;
+
+}
+
+// ----------------------------------------
+//
+Ookala::BlobDictItem::BlobDictItem(const BlobDictItem &src):
+    DictItem(src)
+{
+    mValue = src.mValue;
+    mSize  = src.mSize;
+}
+
+// ----------------------------------------
+//
+// Blob's aren't serializable right now.
+//
+// virtual
+bool 
+Ookala::BlobDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    return true;
+}
+
+// ----------------------------------------
+//
+// static
+const Ookala::DictKey &
+Ookala::BlobDictItem::typeKey()
+{
+    static const DictKey key("blob");
+    return key;
+}
+
+// ----------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::BlobDictItem::clone() const
+{
+    return new BlobDictItem(*this);
+}
+
+// ----------------------------
+//
+Ookala::BlobDictItem &
+Ookala::BlobDictItem::operator=(const BlobDictItem &src)
+{
+    if (this != &src) {
+        DictItem::operator=(src);
+
+        mValue = src.mValue;
+        mSize  = src.mSize;
+    }
+
+    return *this;
+}
+
+
+
+// ----------------------------------------
+//
+// Blob's aren't deserializable right now.
+//
+// virtual
+bool
+Ookala::BlobDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    return true;
+}
+
+// ----------------------------------------
+
+void
+Ookala::BlobDictItem::set(uint8_t *value, uint32_t size)
+{
+    mValue = value;
+    mSize  = size;
+}
+
+// ----------------------------------------
+
+uint8_t *
+Ookala::BlobDictItem::get(uint32_t &size)
+{
+    size = mSize;
+    return mValue;
+}
+
+// ----------------------------------------
+//
+// virtual
+void
+Ookala::BlobDictItem::debug()
+{
+    printf("%d bytes\n",  mSize);
+}
+
+
+// ========================================
+//
+// IntArrayDictItem
+//
+// ----------------------------------------
+
+Ookala::IntArrayDictItem::IntArrayDictItem() :  
+    DictItem()
+{
+    setItemType(typeKey());
+
+    mIntArrayDictItemData = new _IntArrayDictItem;
+}
+
+// ----------------------------------------
+//
+Ookala::IntArrayDictItem::IntArrayDictItem(const IntArrayDictItem &src):
+    DictItem(src)
+{
+    mIntArrayDictItemData = new _IntArrayDictItem;
+
+    if (src.mIntArrayDictItemData) {
+        mIntArrayDictItemData->mValue = src.mIntArrayDictItemData->mValue;
+    }
+}
+      
+// ----------------------------------------
+//
+// virtual
+Ookala::IntArrayDictItem::~IntArrayDictItem()
+{
+    if (mIntArrayDictItemData) {
+        delete mIntArrayDictItemData;
+        mIntArrayDictItemData = NULL;
+    }
+}
+
+// ----------------------------------------
+//
+// static
+const Ookala::DictKey &
+Ookala::IntArrayDictItem::typeKey()
+{
+    static const DictKey key("intArray");
+    return key;
+}
+
+// ----------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::IntArrayDictItem::clone() const
+{
+    return new IntArrayDictItem(*this);
+}
+
+// ----------------------------
+//
+Ookala::IntArrayDictItem &
+Ookala::IntArrayDictItem::operator=(const IntArrayDictItem &src)
+{
+    if (this != &src) {
+        DictItem::operator=(src);
+
+        if (mIntArrayDictItemData) {
+            delete mIntArrayDictItemData;
+            mIntArrayDictItemData = NULL;
+        }
+
+        if (src.mIntArrayDictItemData) {
+            mIntArrayDictItemData  = new _IntArrayDictItem();
+            *mIntArrayDictItemData = *(src.mIntArrayDictItemData);
+        }
+    }
+
+    return *this;
+}
+
+
+// ----------------------------------------
+//
+// root points to the place whose child should be a 
+// <dictitem></dictitem> tag.
+//
+// virtual
+bool 
+Ookala::IntArrayDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    const std::vector<int32_t> &vals = mIntArrayDictItemData->mValue;
+
+    serializeArray(root, vals.empty()? NULL: &vals[0], vals.size());
+
+    return true;
+}
+
+// ----------------------------------------
+//
+// root should point to a <dictitem></dictitem> element.
+// If we don't find a name, return false;
+//
+// Example:
+//            <dictitem type="intArray" name="Countdown">
+//                <value>4</value>
+//                <value>3</value>
+//                <value>2</value>
+//                <value>1</value>
+//            </dictitem>
+//
+// or, for longer arrays:
+//
+//            <dictitem type="intArray" name="Ramp">
+//                <packed encoding="base64" count="1024">AAAAAEAAAAC...</packed>
+//            </dictitem>
+
+// virtual
+bool
+Ookala::IntArrayDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    return unserializeArray(doc, root, mIntArrayDictItemData->mValue);
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::IntArrayDictItem::serializeBinary(std::string &buf)
+{
+    const std::vector<int32_t> &value = mIntArrayDictItemData->mValue;
+
+    packU32(buf, (uint32_t)value.size());
+    for (std::vector<int32_t>::const_iterator i = value.begin();
+            i != value.end(); ++i) {
+        packU32(buf, (uint32_t)(*i));
+    }
+    return true;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::IntArrayDictItem::unserializeBinary(PackReader &reader)
+{
+    uint32_t count = reader.u32();
+
+    // Don't let a bad count allocate the world
+    if ((!reader.ok()) || (reader.left() / 4 < count)) {
+        return false;
+    }
+
+    std::vector<int32_t> value(count);
+    for (uint32_t idx=0; idx<count; ++idx) {
+        value[idx] = (int32_t)reader.u32();
+    }
+
+    mIntArrayDictItemData->mValue = std::move(value);
+    return true;
+}
+
+// ----------------------------------------
+
+void
+Ookala::IntArrayDictItem::set(const std::vector<int32_t> &value)
+{
+    mIntArrayDictItemData->mValue = value;
+}
+
+// ----------------------------------------
+
+void
+Ookala::IntArrayDictItem::set(std::vector<int32_t> &&value)
+{
+    mIntArrayDictItemData->mValue.swap(value);
+    value.clear();
+}
+
+// ----------------------------------------
+
+
+const std::vector<int32_t> &
+Ookala::IntArrayDictItem::get() const
+{
+    return mIntArrayDictItemData->mValue;
+}
+
+// ----------------------------------------
+//
+// virtual
+void
+Ookala::IntArrayDictItem::debug()
+{
+    int idx = 0;
+
+    for (std::vector<int32_t>::iterator i = mIntArrayDictItemData->mValue.begin();
+                i != mIntArrayDictItemData->mValue.end(); ++i) {
+        printf("%d: %d\n", idx, (*i));
+        idx++;
+    }
+}
+
+
+
+
+
+// ========================================
+//
+// DoubleArrayDictItem
+//
+// ----------------------------------------
+
+Ookala::DoubleArrayDictItem::DoubleArrayDictItem():  
+    DictItem()
+{
+    setItemType(typeKey());
+
+    mDoubleArrayDictItemData = new _DoubleArrayDictItem;
+}
+
+// ----------------------------------------
+//
+Ookala::DoubleArrayDictItem::DoubleArrayDictItem(const DoubleArrayDictItem &src):  
+    DictItem(src)
+{
+    mDoubleArrayDictItemData = new _DoubleArrayDictItem;    
+
+    if (src.mDoubleArrayDictItemData) {
+        mDoubleArrayDictItemData->mValue = src.mDoubleArrayDictItemData->mValue;
+    }
+}
+
+// ----------------------------------------
+//
+// virtual
+Ookala::DoubleArrayDictItem::~DoubleArrayDictItem()
+{
+    if (mDoubleArrayDictItemData) {
+        delete mDoubleArrayDictItemData;
+        mDoubleArrayDictItemData = NULL;
+    }
+}
+
+// ----------------------------------------
+//
+// static
+const Ookala::DictKey &
+Ookala::DoubleArrayDictItem::typeKey()
+{
+    static const DictKey key("doubleArray");
+    return key;
+}
+
+// ----------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::DoubleArrayDictItem::clone() const
+{
+    return new DoubleArrayDictItem(*this);
+}
+
+// ----------------------------
+//
+Ookala::DoubleArrayDictItem &
+Ookala::DoubleArrayDictItem::operator=(const DoubleArrayDictItem &src)
+{
+    if (this != &src) {
+        DictItem::operator=(src);
+
+        if (mDoubleArrayDictItemData) {
+            delete mDoubleArrayDictItemData;
+            mDoubleArrayDictItemData = NULL;
+        }
+
+        if (src.mDoubleArrayDictItemData) {
+            mDoubleArrayDictItemData  = new _DoubleArrayDictItem();
+            *mDoubleArrayDictItemData = *(src.mDoubleArrayDictItemData);
+        }
+    }
+
+    return *this;
+}
+
+
+
+// ----------------------------------------
+//
+// root points to the place whose child should be a 
+// <dictitem></dictitem> tag.
+//
+// virtual
+bool 
+Ookala::DoubleArrayDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    const std::vector<double> &vals = mDoubleArrayDictItemData->mValue;
+
+    serializeArray(root, vals.empty()? NULL: &vals[0], vals.size());
+
+    return true;
+}
+
+// ----------------------------------------
+//
+// root should point to a <dictitem></dictitem> element.
+// If we don't find a name, return false;
+//
+// Example:
+//            <dictitem type="doubleArray" name="Countdown">
+//                <name>Countdown</name>
+//                <value>4</value>
+//                <value>3</value>
+//                <value>2</value>
+//                <value>1</value>
+//            </dictitem>
+//
+// or, for longer arrays:
+//
+//            <dictitem type="doubleArray" name="Ramp">
+//                <packed encoding="base64" count="256">AAAAAAAAAAA...</packed>
+//            </dictitem>
+//
+// virtual
+bool
+Ookala::DoubleArrayDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    return unserializeArray(doc, root, mDoubleArrayDictItemData->mValue);
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::DoubleArrayDictItem::serializeBinary(std::string &buf)
+{
+    const std::vector<double> &value = mDoubleArrayDictItemData->mValue;
+
+    packU32(buf, (uint32_t)value.size());
+    for (std::vector<double>::const_iterator i = value.begin();
+            i != value.end(); ++i) {
+        packDouble(buf, *i);
+    }
+    return true;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::DoubleArrayDictItem::unserializeBinary(PackReader &reader)
+{
+    uint32_t count = reader.u32();
+
+    if ((!reader.ok()) || (reader.left() / 8 < count)) {
+        return false;
+    }
+
+    std::vector<double> value(count);
+    for (uint32_t idx=0; idx<count; ++idx) {
+        value[idx] = reader.f64();
+    }
+
+    mDoubleArrayDictItemData->mValue = std::move(value);
+    return true;
+}
+
+// ----------------------------------------
+
+void
+Ookala::DoubleArrayDictItem::set(const std::vector<double> &value)
+{
+    mDoubleArrayDictItemData->mValue = value;
+}
+
+// ----------------------------------------
+
+void
+Ookala::DoubleArrayDictItem::set(std::vector<double> &&value)
+{
+    mDoubleArrayDictItemData->mValue.swap(value);
+    value.clear();
+}
+
+// ----------------------------------------
+
+const std::vector<double> &
+Ookala::DoubleArrayDictItem::get() const
+{
+    return mDoubleArrayDictItemData->mValue;
+}
+
+// ----------------------------------------
+//
+// virtual
+void
+Ookala::DoubleArrayDictItem::debug()
+{
+    int idx = 0;
+
+    for (std::vector<double>::iterator i = 
+              mDoubleArrayDictItemData->mValue.begin();
+                i != mDoubleArrayDictItemData->mValue.end(); ++i) {
+        printf("%d: %f\n", idx, (*i));
+        idx++;
+    }   
+}
+
+
+
+// ========================================
+//
+// StringArrayDictItem
+//
+// ----------------------------------------
+
+
+Ookala::StringArrayDictItem::StringArrayDictItem() :  
+    DictItem()
+{
+    setItemType(typeKey());
+
+    mStringArrayDictItemData = new _StringArrayDictItem;
+}
+
+// ----------------------------------------
+//
+Ookala::StringArrayDictItem::StringArrayDictItem(
+                        const StringArrayDictItem &src):
+    DictItem(src)
+{
+    mStringArrayDictItemData = new _StringArrayDictItem;
+
+    if (src.mStringArrayDictItemData) {
+        mStringArrayDictItemData->mValue = src.mStringArrayDictItemData->mValue;
+    }
+}
+
+// ----------------------------------------
+//
+// virtual
+Ookala::StringArrayDictItem::~StringArrayDictItem()
+{
+    if (mStringArrayDictItemData) {    
+        delete mStringArrayDictItemData;
+        mStringArrayDictItemData = NULL;
+    }
+}
+
+// ----------------------------------------
+//
+// static
+const Ookala::DictKey &
+Ookala::StringArrayDictItem::typeKey()
+{
+    static const DictKey key("stringArray");
+    return key;
+}
+
+// ----------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::StringArrayDictItem::clone() const
+{
+    return new StringArrayDictItem(*this);
+}
+
+// ----------------------------
+//
+Ookala::StringArrayDictItem &
+Ookala::StringArrayDictItem::operator=(
+                            const StringArrayDictItem &src)
+{
+    if (this != &src) {
+        DictItem::operator=(src);
+
+        if (mStringArrayDictItemData) {
+            delete mStringArrayDictItemData;
+            mStringArrayDictItemData = NULL;
+        }
+
+        if (src.mStringArrayDictItemData) {
+            mStringArrayDictItemData  = new _StringArrayDictItem();
+            *mStringArrayDictItemData = *(src.mStringArrayDictItemData);
+        }
+    }
+
+    return *this;
+}
+
+
+// ----------------------------------------
+//
+// root points to the place whose child should be a 
+// <dictitem></dictitem> tag.
+//
+// virtual
+bool 
+Ookala::StringArrayDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    for (std::vector<std::string>::iterator i =
+                      mStringArrayDictItemData->mValue.begin();
+                 i != mStringArrayDictItemData->mValue.end(); ++i) {
+
+        xmlNewTextChild(root, NULL, (const xmlChar *)"value", 
+                                    (const xmlChar *)(*i).c_str());
+    }
+
+    return true;
+}
+
+// ----------------------------------------
+//
+// root should point to a <dictitem></dictitem> element.
+// If we don't find a name, return false;
+//
+//    Example:
+//        <dictitem type="stringArray" name="DataSavior Files">
+//            <value>/usr/home/ookala/loadme.xml</value>
+//            <value>~/loadme2.xml</value>
+//            <value>~/loadme.%s.xml</value>
+//            <value>/asdfa/vafas/foo.xml</value>
+//        </dictitem>
+//
+// virtual
+bool
+Ookala::StringArrayDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root) 
+{
+    mStringArrayDictItemData->mValue.clear();
+
+    for (xmlNodePtr node = root->xmlChildrenNode; node != NULL; node = node->next) {
+        if ((node->name == NULL) || strcmp((const char *)node->name, "value")) {
+            continue;
+        }
+
+        std::string theValue;
+        xmlChar    *value = xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
+        if (value != NULL) {
+            theValue = (char *)value;
+            xmlFree(value);
+        }
+
+        // Trim any leading + trailing space
+        size_t start = theValue.find_first_not_of(" \t\n");
+        size_t end   = theValue.find_last_not_of(" \t\n");
+
+        if (start == std::string::npos) {
+            mStringArrayDictItemData->mValue.push_back("");
+        } else {
+            mStringArrayDictItemData->mValue.push_back(
+                                theValue.substr(start, end-start+1));
+        }
+    }
+
+    return true;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::StringArrayDictItem::serializeBinary(std::string &buf)
+{
+    const std::vector<std::string> &value = 
+                                mStringArrayDictItemData->mValue;
+
+    packU32(buf, (uint32_t)value.size());
+    for (std::vector<std::string>::const_iterator i = value.begin();
+            i != value.end(); ++i) {
+        packString(buf, *i);
+    }
+    return true;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::StringArrayDictItem::unserializeBinary(PackReader &reader)
+{
+    uint32_t count = reader.u32();
+
+    if ((!reader.ok()) || (reader.left() / 4 < count)) {
+        return false;
+    }
+
+    std::vector<std::string> value(count);
+    for (uint32_t idx=0; idx<count; ++idx) {
+        value[idx] = reader.str();
+    }
+    if (!reader.ok()) {
+        return false;
+    }
+
+    mStringArrayDictItemData->mValue = std::move(value);
+    return true;
+}
+
+// ----------------------------------------
+
+void
+Ookala::StringArrayDictItem::set(const std::vector<std::string> &value)
+{
+    mStringArrayDictItemData->mValue = value;
+}
+
+// ----------------------------------------
+
+void
+Ookala::StringArrayDictItem::set(std::vector<std::string> &&value)
+{
+    mStringArrayDictItemData->mValue.swap(value);
+    value.clear();
+}
+
+// ----------------------------------------
+
+const std::vector<std::string> &
+Ookala::StringArrayDictItem::get() const
+{
+    return mStringArrayDictItemData->mValue;
+}
+
+// ----------------------------------------
+
+// virtual
+void
+Ookala::StringArrayDictItem::debug()
+{
+    int idx = 0;
+
+    for (std::vector<std::string>::iterator i = 
+                     mStringArrayDictItemData->mValue.begin();
+                i != mStringArrayDictItemData->mValue.end(); ++i) {
+        printf("%d: %s\n", idx, (*i).c_str());
+        idx++;
+    }   
+}
+
+
+
+// ========================================
+//
+// YxyDictItem
+//
+// ----------------------------------------
+
+Ookala::YxyDictItem::YxyDictItem() :  
+    DictItem()
+{
+    setItemType(typeKey());
+
+    mValue.Y = mValue.x = mValue.y = 0.0;
+}
+
+// ----------------------------------------
+//
+Ookala::YxyDictItem::YxyDictItem(const YxyDictItem &src) :  
+    DictItem(src)
+{
+    mValue = src.mValue;
+}
+
+// ----------------------------------------
+//
+// static
+const Ookala::DictKey &
+Ookala::YxyDictItem::typeKey()
+{
+    static const DictKey key("Yxy");
+    return key;
+}
+
+// ----------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::YxyDictItem::clone() const
+{
+    return new YxyDictItem(*this);
+}
+
+// ----------------------------
+//
+Ookala::YxyDictItem &
+Ookala::YxyDictItem::operator=(const YxyDictItem &src)
+{
+    if (this != &src) {
+        DictItem::operator=(src);
+
+        mValue = src.mValue;
+    }
+
+    return *this;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool 
+Ookala::YxyDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    double values[3] = { mValue.Y, mValue.x, mValue.y };
+
+    serializeValues(root, values, 3);
+    return true;
+}
+
+// ----------------------------------------
+//
+// Example:
+//      <dictitem type="Yxy" name="target white">80 0.3127 0.329</dictitem>
+//
+// virtual
+bool
+Ookala::YxyDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    double values[3] = { 0.0, 0.0, 0.0 };
+
+    if (!unserializeValues(doc, root, values, 3)) {
+        fprintf(stderr, "Expected 3 values for Yxy\n");
+        return false;
+    }
+
+    mValue.Y = values[0];
+    mValue.x = values[1];
+    mValue.y = values[2];
+
+    return true;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::YxyDictItem::serializeBinary(std::string &buf)
+{
+    packDouble(buf, mValue.Y);
+    packDouble(buf, mValue.x);
+    packDouble(buf, mValue.y);
+    return true;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::YxyDictItem::unserializeBinary(PackReader &reader)
+{
+    mValue.Y = reader.f64();
+    mValue.x = reader.f64();
+    mValue.y = reader.f64();
+    return reader.ok();
+}
+
+// ----------------------------------------
+
+void
+Ookala::YxyDictItem::set(const Yxy &value)
+{
+    mValue = value;
+}
+
+// ----------------------------------------
+
+Ookala::Yxy
+Ookala::YxyDictItem::get() const
+{
+    return mValue;
+}
+
+// ----------------------------------------
+//
+// virtual
+void
+Ookala::YxyDictItem::debug()
+{
+    printf("Yxy: %f %f %f\n", mValue.Y, mValue.x, mValue.y);
+}
+
+
+// ========================================
+//
+// RgbDictItem
+//
+// ----------------------------------------
+
+Ookala::RgbDictItem::RgbDictItem() :  
+    DictItem()
+{
+    setItemType(typeKey());
+
+    mValue.r = mValue.g = mValue.b = 0.0;
+}
+
+// ----------------------------------------
+//
+Ookala::RgbDictItem::RgbDictItem(const RgbDictItem &src) :  
+    DictItem(src)
+{
+    mValue = src.mValue;
+}
+
+// ----------------------------------------
+//
+// static
+const Ookala::DictKey &
+Ookala::RgbDictItem::typeKey()
+{
+    static const DictKey key("Rgb");
+    return key;
+}
+
+// ----------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::RgbDictItem::clone() const
+{
+    return new RgbDictItem(*this);
+}
+
+// ----------------------------
+//
+Ookala::RgbDictItem &
+Ookala::RgbDictItem::operator=(const RgbDictItem &src)
+{
+    if (this != &src) {
+        DictItem::operator=(src);
+
+        mValue = src.mValue;
+    }
+
+    return *this;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool 
+Ookala::RgbDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    double values[3] = { mValue.r, mValue.g, mValue.b };
+
+    serializeValues(root, values, 3);
+    return true;
+}
+
+// ----------------------------------------
+//
+// Example:
+//      <dictitem type="Rgb" name="backlight">0.5 0.48 0.52</dictitem>
+//
+// virtual
+bool
+Ookala::RgbDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    double values[3] = { 0.0, 0.0, 0.0 };
+
+    if (!unserializeValues(doc, root, values, 3)) {
+        fprintf(stderr, "Expected 3 values for Rgb\n");
+        return false;
+    }
+
+    mValue.r = values[0];
+    mValue.g = values[1];
+    mValue.b = values[2];
+
+    return true;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::RgbDictItem::serializeBinary(std::string &buf)
+{
+    packDouble(buf, mValue.r);
+    packDouble(buf, mValue.g);
+    packDouble(buf, mValue.b);
+    return true;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::RgbDictItem::unserializeBinary(PackReader &reader)
+{
+    mValue.r = reader.f64();
+    mValue.g = reader.f64();
+    mValue.b = reader.f64();
+    return reader.ok();
+}
+
+// ----------------------------------------
+
+void
+Ookala::RgbDictItem::set(const Rgb &value)
+{
+    mValue = value;
+}
+
+// ----------------------------------------
+
+Ookala::Rgb
+Ookala::RgbDictItem::get() const
+{
+    return mValue;
+}
+
+// ----------------------------------------
+//
+// virtual
+void
+Ookala::RgbDictItem::debug()
+{
+    printf("Rgb: %f %f %f\n", mValue.r, mValue.g, mValue.b);
+}
+
+
+// ========================================
+//
+// Mat33DictItem
+//
+// ----------------------------------------
+
+Ookala::Mat33DictItem::Mat33DictItem() :  
+    DictItem()
+{
+    setItemType(typeKey());
+
+    mValue.m00 = mValue.m01 = mValue.m02 = 0.0;
+    mValue.m10 = mValue.m11 = mValue.m12 = 0.0;
+    mValue.m20 = mValue.m21 = mValue.m22 = 0.0;
+}
+
+// ----------------------------------------
+//
+Ookala::Mat33DictItem::Mat33DictItem(const Mat33DictItem &src) :  
+    DictItem(src)
+{
+    mValue = src.mValue;
+}
+
+// ----------------------------------------
+//
+// static
+const Ookala::DictKey &
+Ookala::Mat33DictItem::typeKey()
+{
+    static const DictKey key("Mat33");
+    return key;
+}
+
+// ----------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::Mat33DictItem::clone() const
+{
+    return new Mat33DictItem(*this);
+}
+
+// ----------------------------
+//
+Ookala::Mat33DictItem &
+Ookala::Mat33DictItem::operator=(const Mat33DictItem &src)
+{
+    if (this != &src) {
+        DictItem::operator=(src);
+
+        mValue = src.mValue;
+    }
+
+    return *this;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool 
+Ookala::Mat33DictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    double values[9] = { mValue.m00, mValue.m01, mValue.m02,
+                         mValue.m10, mValue.m11, mValue.m12,
+                         mValue.m20, mValue.m21, mValue.m22 };
+
+    serializeValues(root, values, 9);
+    return true;
+}
+
+// ----------------------------------------
+//
+// Example:
+//      <dictitem type="Mat33" name="rgbToXYZ">1 0 0 0 1 0 0 0 1</dictitem>
+//
+// virtual
+bool
+Ookala::Mat33DictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+{
+    double values[9] = { 0.0 };
+
+    if (!unserializeValues(doc, root, values, 9)) {
+        fprintf(stderr, "Expected 9 values for Mat33\n");
+        return false;
+    }
+
+    mValue.m00 = values[0];  mValue.m01 = values[1];  mValue.m02 = values[2];
+    mValue.m10 = values[3];  mValue.m11 = values[4];  mValue.m12 = values[5];
+    mValue.m20 = values[6];  mValue.m21 = values[7];  mValue.m22 = values[8];
+
+    return true;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::Mat33DictItem::serializeBinary(std::string &buf)
+{
+    double values[9] = { mValue.m00, mValue.m01, mValue.m02,
+                         mValue.m10, mValue.m11, mValue.m12,
+                         mValue.m20, mValue.m21, mValue.m22 };
+
+    for (int idx=0; idx<9; ++idx) {
+        packDouble(buf, values[idx]);
+    }
+    return true;
+}
+
+// ----------------------------------------
+//
+// virtual
+bool
+Ookala::Mat33DictItem::unserializeBinary(PackReader &reader)
+{
+    double values[9];
+
+    for (int idx=0; idx<9; ++idx) {
+        values[idx] = reader.f64();
+    }
+    if (!reader.ok()) {
+        return false;
+    }
+
+    mValue.m00 = values[0];  mValue.m01 = values[1];  mValue.m02 = values[2];
+    mValue.m10 = values[3];  mValue.m11 = values[4];  mValue.m12 = values[5];
+    mValue.m20 = values[6];  mValue.m21 = values[7];  mValue.m22 = values[8];
+    return true;
+}
+
+// ----------------------------------------
+
+void
+Ookala::Mat33DictItem::set(const Mat33 &value)
+{
+    mValue = value;
+}
+
+// ----------------------------------------
+
+Ookala::Mat33
+Ookala::Mat33DictItem::get() const
+{
+    return mValue;
+}
+
+// ----------------------------------------
+//
+// virtual
+void
+Ookala::Mat33DictItem::debug()
+{
+    printf("Mat33: %f %f %f\n", mValue.m00, mValue.m01, mValue.m02);
+    printf("       %f %f %f\n", mValue.m10, mValue.m11, mValue.m12);
+    printf("       %f %f %f\n", mValue.m20, mValue.m21, mValue.m22);
+}
+
+
+// ========================================
+//
+// _Dict
+//
+// ----------------------------------------
+
+namespace {
+
+// Source of Dict versions. Sharing one counter keeps versions from
+// different Dicts from colliding, so a Dict that replaces another 
+// one of the same name doesn't look unchanged to a poller.
+std::atomic<uint64_t> gDictVersion(0);
+
+// ----------------------------------------
+//
+// Say, once per type, that an item which had to be kept apart from
+// other copies of its Dict couldn't be, because it has no clone().
+
+void
+_warnUncloneable(const Ookala::DictItem *item)
+{
+    static Ookala::Mutex      warnedMutex;
+    static std::set<uint32_t> warned;
+    bool                      first;
+
+    warnedMutex.lock();
+    first = warned.insert(item->itemTypeKey().id()).second;
+    warnedMutex.unlock();
+
+    if (first) {
+        fprintf(stderr, "WARNING: %s items have no clone(), so copies of "
+                        "a Dict share them, and see changes made through "
+                        "get(). Give the type a clone().\n",
+                        item->itemType().c_str());
+    }
+}
+
+// ----------------------------------------
+//
+// Add the non-whitespace parts of text to crc. Whitespace is left
+// out because formatting adds it between elements, and the parser
+// folds it inside attributes.
+
+uint32_t
+_dictCrcText(uint32_t crc, const xmlChar *text)
+{
+    const xmlChar *run;
+
+    if (!text) {
+        return crc;
+    }
+
+    while (*text) {
+        while ((*text == ' ') || (*text == '\t') || 
+                (*text == '\n') || (*text == '\r')) {
+            ++text;
+        }
+
+        run = text;
+        while ((*text) && (*text != ' ') && (*text != '\t') &&
+                (*text != '\n') && (*text != '\r')) {
+            ++text;
+        }
+
+        crc = Ookala::packCrc(crc, run, (size_t)(text - run));
+    }
+
+    return crc;
+}
+
+// ----------------------------------------
+//
+// Checksum of an element and everything in it: names, attributes
+// and text. The crc attribute of the <dictitem> itself is skipped,
+// as that's where the result goes.
+
+uint32_t
+_dictCrcNode(uint32_t crc, xmlNodePtr node, bool top)
+{
+    for (xmlAttrPtr attr = node->properties; attr; attr = attr->next) {
+        if ((top) && (!strcmp((const char *)attr->name, "crc"))) {
+            continue;
+        }
+
+        crc = Ookala::packCrc(crc, "@", 1);
+        crc = _dictCrcText(crc, attr->name);
+        crc = Ookala::packCrc(crc, "=", 1);
+        for (xmlNodePtr value = attr->children; value; value = value->next) {
+            crc = _dictCrcText(crc, value->content);
+        }
+    }
+
+    for (xmlNodePtr child = node->children; child; child = child->next) {
+        if (child->type == XML_ELEMENT_NODE) {
+            crc = Ookala::packCrc(crc, "<", 1);
+            crc = _dictCrcText(crc, child->name);
+            crc = _dictCrcNode(crc, child, false);
+            crc = Ookala::packCrc(crc, ">", 1);
+        } else if ((child->type == XML_TEXT_NODE) ||
+                   (child->type == XML_CDATA_SECTION_NODE)) {
+            crc = _dictCrcText(crc, child->content);
+        }
+    }
+
+    return crc;
+}
+
+}; // namespace
+
+// ----------------------------------------
+//
+// Tables and slot arrays are never handed back to the heap, as a
+// lock-free reader may still be looking at one after it's been let
+// go. Instead they go back on these lists, slot arrays by size, for
+// newData() and newSlots() to reuse. So we never hold more than we
+// needed at the busiest point.
+//
+struct Ookala::Dict::_DictPool {
+    Mutex                       mLock;
+    std::vector<_Dict *>        mData;
+    std::vector<_DictSlots *>   mSlots[32];
+};
+
+// ----------------------------------------
+
+Ookala::Dict::Dict()
+{
+    mRegistry = NULL;    
+
+    mSeq      = 0;
+    setData(newData());
+    mLock     = new RwLock;
+}
+
+// ----------------------------------------
+//
+
+Ookala::Dict::Dict(PluginRegistry *registry)
+{
+    mRegistry = registry;   
+
+    mSeq      = 0;
+    setData(newData());
+    mLock     = new RwLock;
+}
+
+// ----------------------------------------
+//
+Ookala::Dict::Dict(const Dict &src)
+{
+    _Dict *data;
+
+    mLock = new RwLock;
+    mSeq  = 0;
+
+    // Just share src's table; we'll take our own in detach()
+    // if either side changes.
+    src.readLock();
+
+    mRegistry = src.mRegistry;
+    data      = src.shareData();
+    if (!data) {
+        data = newData();
+    }
+    setData(data);
+
+    src.readUnlock();
+}
+
+// ----------------------------------------
+//
+//virtual 
+Ookala::Dict::~Dict()
+{
+    releaseData(mDictData);
+    setData(NULL);
+
+    delete mLock;
+    mLock = NULL;
+}
+
+// ----------------------------
+//
+Ookala::Dict &
+Ookala::Dict::operator=(const Dict &src)
+{
+    _Dict          *data, *oldData;
+    PluginRegistry *registry;
+
+    if (this == &src) return *this;
+
+    // Only hold one lock at a time, so two threads assigning 
+    // a = b and b = a can't deadlock.
+    src.readLock();
+
+    data     = src.shareData();
+    registry = src.mRegistry;
+
+    src.readUnlock();
+
+    writeLock();
+
+    oldData   = mDictData;
+    setData(data);
+    mRegistry = registry;
+
+    writeUnlock();
+
+    releaseData(oldData);
+
+    return *this;
+}
+
+
+// ----------------------------------------
+
+void
+Ookala::Dict::setName(const std::string &name)
+{
+    // DictHash re-sets the name on every lookup, so don't 
+    // unshare (or block readers) for that.
+    readLock();
+    bool same = (!mDictData) || (mDictData->mName == name);
+    readUnlock();
+
+    if (same) return;
+
+    writeLock();
+
+    if (mDictData) {
+        detach();
+        mDictData->mName = name;
+        bumpVersion();
+    }
+
+    writeUnlock();
+}
+
+// ----------------------------------------
+
+std::string
+Ookala::Dict::getName()
+{   
+    std::string name;
+
+    readLock();
+    if (mDictData) {
+        name = mDictData->mName;
+    }
+    readUnlock();
+
+    return name;
+}
+
+// ----------------------------------------
+
+void 
+Ookala::Dict::setRegistry(PluginRegistry *registry)
+{
+    writeLock();
+    mRegistry = registry;
+    writeUnlock();
+}
+
+// ----------------------------------------
+
+uint64_t
+Ookala::Dict::getVersion() const
+{
+    uint64_t version = 0;
+
+    readLock();
+    if (mDictData) {
+        version = mDictData->mVersion;
+    }
+    readUnlock();
+
+    return version;
+}
+
+// ----------------------------------------
+
+uint64_t
+Ookala::Dict::getVersion(const DictKey &key) const
+{
+    uint64_t version = 0;
+    int32_t  idx;
+
+    readLock();
+    if (mDictData) {
+        idx = findSlot(key.id());
+        if (idx >= 0) {
+            version = slotAt(idx).mVersion;
+        }
+    }
+    readUnlock();
+
+    return version;
+}
+
+// ----------------------------------------
+
+bool
+Ookala::Dict::changedSince(uint64_t version, 
+                           const std::string &pattern) const
+{
+    bool changed = false;
+
+    readLock();
+    if ((mDictData) && (mDictData->mVersion != version)) {
+        changed = changedLocked(version, pattern);
+    }
+    readUnlock();
+
+    return changed;
+}
+
+// ----------------------------------------
+
+bool
+Ookala::Dict::changedSince(uint64_t version, 
+                           const std::vector<std::string> &patterns) const
+{
+    bool changed = false;
+
+    readLock();
+    if ((mDictData) && (mDictData->mVersion != version)) {
+        for (std::vector<std::string>::const_iterator i = patterns.begin();
+                i != patterns.end(); ++i) {
+            if (changedLocked(version, *i)) {
+                changed = true;
+                break;
+            }
+        }
+    }
+    readUnlock();
+
+    return changed;
+}
+
+// ----------------------------------------
+
+std::vector<Ookala::DictKey>
+Ookala::Dict::getChangedKeys(uint64_t version, bool &removed) const
+{
+    return getChangedKeys(version, removed, false);
+}
+
+// ----------------------------------------
+
+std::vector<Ookala::DictKey>
+Ookala::Dict::getChangedKeys(uint64_t version, bool &removed, 
+                             bool escaped) const
+{
+    std::vector<DictKey> keys;
+
+    removed = false;
+
+    readLock();
+
+    // An item edited in place doesn't bump our version, so look
+    // even if nothing's been set.
+    if ((mDictData) && ((mDictData->mVersion != version) || (escaped))) {
+        const _DictSlots *slots = mDictData->mSlots;
+
+        removed = (mDictData->mRemoveVersion > version);
+
+        for (uint32_t idx=0; (slots) && (idx<slots->mSize); ++idx) {
+            const _DictSlot &slot = slots->mSlot[idx];
+
+            if ((slot.mKey == _DICT_SLOT_EMPTY) ||
+                    (slot.mKey == _DICT_SLOT_TOMBSTONE)) {
+                continue;
+            }
+
+            if ((slot.mVersion <= version) &&
+                    ((!escaped) || 
+                     (!(slot.mFlags.load(std::memory_order_acquire) &
+                                            _DICT_SLOT_ESCAPED)))) {
+                continue;
+            }
+
+            DictKey key;
+            key.mId = slot.mKey;
+            keys.push_back(key);
+        }
+    }
+
+    readUnlock();
+
+    return keys;
+}
+
+// ----------------------------------------
+
+bool
+Ookala::Dict::set(const std::string &key, DictItem *value)
+{
+    return set(DictKey(key), value);
+}
+
+// ----------------------------------------
+
+bool
+Ookala::Dict::set(const DictKey &key, DictItem *value)
+{
+    bool ret;
+
+    writeLock();
+
+    ret = setLocked(key, value);
+    if (ret) {
+        bumpVersion(key);
+    }
+
+    writeUnlock();
+
+    return ret;
+}
+
+// ----------------------------------------
+//
+bool
+Ookala::Dict::adopt(const DictKey &key, DictItem *value)
+{
+    if ((!value) || (!value->mDictItemData)) return false;
+
+    value->mDictItemData->mDictOwned = true;
+
+    if (set(key, value)) {
+        return true;
+    }
+
+    if ((mRegistry == NULL) || (!mRegistry->deleteDictItem(value))) {
+        delete value;
+    }
+
+    return false;
+}
+
+// ----------------------------------------
+
+bool
+Ookala::Dict::get(const std::string &key, DictItem **value)
+{
+    DictItem *item = get(DictKey::find(key));
+
+    if (item == NULL) return false;
+
+    *value = item;
+    return true;
+}
+
+// ----------------------------------------
+
+Ookala::DictItem *
+Ookala::Dict::get(const std::string &key)
+{
+    return get(DictKey::find(key));
+}
+
+// ----------------------------------------
+
+Ookala::DictItem *
+Ookala::Dict::get(const DictKey &key)
+{
+    DictItem *item;
+    bool      mine;
+
+    // Once an item has been handed out, and as long as nobody else
+    // shares our table, we can hand it back again without locking.
+    if ((peekItem(key.id(), &item, &mine)) && ((!item) || (mine))) {
+        return item;
+    }
+
+    writeLock();
+    item = getLocked(key, true);
+    writeUnlock();
+
+    return item;
+}
+
+// ----------------------------------------
+
+const Ookala::DictItem *
+Ookala::Dict::get(const std::string &key) const
+{
+    return get(DictKey::find(key));
+}
+
+// ----------------------------------------
+
+const Ookala::DictItem *
+Ookala::Dict::get(const DictKey &key) const
+{
+    DictItem *item;
+    bool      mine;
+
+    if (peekItem(key.id(), &item, &mine)) {
+        return item;
+    }
+
+    readLock();
+    item = const_cast<DictItem *>(findItem(key));
+    readUnlock();
+
+    return item;
+}
+
+// ----------------------------------------
+
+bool
+Ookala::Dict::remove(const std::string &key)
+{
+    return remove(DictKey::find(key));
+}
+
+// ----------------------------------------
+
+bool
+Ookala::Dict::remove(const DictKey &key)
+{
+    int32_t idx;
+
+    writeLock();
+
+    if (!mDictData) {
+        writeUnlock();
+        return false;
+    }
+
+    idx = findSlot(key.id());
+    if (idx < 0) {
+        writeUnlock();
+        return false;
+    }
+
+    detach();
+
+    _DictSlot &slot = slotAt(idx);
+
+    releaseItem(slot.mItem);
+
+    slot.mKey.store(_DICT_SLOT_TOMBSTONE, std::memory_order_release);
+    slot.mFlags.store(0, std::memory_order_release);
+    slot.mItem.store(NULL, std::memory_order_release);
+    mDictData->mCount--;
+    mDictData->mTombstones++;
+
+    bumpVersion();
+    mDictData->mRemoveVersion = mDictData->mVersion;
+
+    writeUnlock();
+
+    return true;
+}
+
+// ----------------------------------------
+
+bool
+Ookala::Dict::clear()
+{
+    _Dict *oldData;
+
+    writeLock();
+
+    if (!mDictData) {
+        writeUnlock();
+        return false;
+    }
+
+    // No point copying a table just to empty it.
+    oldData   = mDictData;
+    setData(newData());
+
+    mDictData->mName          = oldData->mName;
+    mDictData->mVersion       = ++gDictVersion;
+    mDictData->mRemoveVersion = mDictData->mVersion;
+
+    releaseData(oldData);
+
+    writeUnlock();
+
+    return true;
+}
+
+// ----------------------------------------
+//
+// Returns all the keys that we're currently holding
+std::vector<std::string>
+Ookala::Dict::getKeys()
+{
+    std::vector<std::string> keys;
+    std::vector<DictKey>     sorted;
+
+    readLock();
+    sorted = sortedKeys();
+    readUnlock();
+
+    for (std::vector<DictKey>::iterator i = sorted.begin(); 
+            i != sorted.end(); ++i) {
+        keys.push_back((*i).str());
+    }
+
+    return keys;
+}
+
+// ----------------------------------------
+
+void
+Ookala::Dict::debug()
+{
+    readLock();
 
-        ++theName;
-        ++theValue;
+    if (!mDictData) {
+        readUnlock();
+        return;
     }
 
-    return true;
-}
+    std::vector<DictKey> keys = sortedKeys();
 
-// ----------------------------------------
+    printf("%s: %d items\n", mDictData->mName.c_str(),  
+                        (int)mDictData->mCount);
+    for (std::vector<DictKey>::iterator i = keys.begin(); 
+            i != keys.end(); ++i) {
+        printf("---------------------------\n%s:\n", (*i).str().c_str());
+        const_cast<DictItem *>(findItem(*i))->debug();
+    }
 
-void
-Ookala::IntArrayDictItem::set(const std::vector<int32_t> value)
-{
-    mIntArrayDictItemData->mValue = value;
+    readUnlock();
 }
 
 // ----------------------------------------
-
-
-std::vector<int32_t>
-Ookala::IntArrayDictItem::get()
+//
+// private
+void
+Ookala::Dict::readLock() const
 {
-    return mIntArrayDictItemData->mValue;
+    mLock->readLock();
 }
 
 // ----------------------------------------
 //
-// virtual
+// private
 void
-Ookala::IntArrayDictItem::debug()
+Ookala::Dict::readUnlock() const
 {
-    int idx = 0;
-
-    for (std::vector<int32_t>::iterator i = mIntArrayDictItemData->mValue.begin();
-                i != mIntArrayDictItemData->mValue.end(); ++i) {
-        printf("%d: %d\n", idx, (*i));
-        idx++;
-    }
+    mLock->readUnlock();
 }
 
-
-
-
-
-// ========================================
+// ----------------------------------------
 //
-// DoubleArrayDictItem
+// Lock-free readers check mSeq before and after they look, so 
+// make it odd for as long as we might be changing things. Every
+// store to something they read is a release, so a reader that sees
+// any of our changes also sees mSeq go odd.
 //
-// ----------------------------------------
-
-Ookala::DoubleArrayDictItem::DoubleArrayDictItem():  
-    DictItem()
+// private
+void
+Ookala::Dict::writeLock()
 {
-    setItemType("doubleArray");
+    mLock->writeLock();
 
-    mDoubleArrayDictItemData = new _DoubleArrayDictItem;
+    mSeq.store(mSeq.load(std::memory_order_relaxed) + 1, 
+               std::memory_order_relaxed);
 }
 
 // ----------------------------------------
 //
-Ookala::DoubleArrayDictItem::DoubleArrayDictItem(const DoubleArrayDictItem &src):  
-    DictItem(src)
+// private
+void
+Ookala::Dict::writeUnlock()
 {
-    mDoubleArrayDictItemData = new _DoubleArrayDictItem;    
+    mSeq.store(mSeq.load(std::memory_order_relaxed) + 1, 
+               std::memory_order_release);
 
-    if (src.mDoubleArrayDictItemData) {
-        mDoubleArrayDictItemData->mValue = src.mDoubleArrayDictItemData->mValue;
-    }
+    mLock->writeUnlock();
 }
 
 // ----------------------------------------
 //
-// virtual
-Ookala::DoubleArrayDictItem::~DoubleArrayDictItem()
-{
-    if (mDoubleArrayDictItemData) {
-        delete mDoubleArrayDictItemData;
-        mDoubleArrayDictItemData = NULL;
-    }
-}
-
-// ----------------------------
+// Look for keyId without taking the lock. Nothing we read here can
+// have been freed, as tables and slot arrays are recycled rather 
+// than freed, and every field we look at is atomic. But it can be 
+// stale or half changed, so the answer only counts if mSeq says no
+// writer was around while we looked. Our loads are acquires, so the
+// last look at mSeq can't happen before them. The item itself is 
+// never touched.
 //
-Ookala::DoubleArrayDictItem &
-Ookala::DoubleArrayDictItem::operator=(const DoubleArrayDictItem &src)
+// private
+bool
+Ookala::Dict::peekItem(uint32_t keyId, DictItem **item, bool *mine) const
 {
-    if (this != &src) {
-        DictItem::operator=(src);
+    const _Dict       *data;
+    const _DictSlots  *slots;
+    uint32_t           seq, mask, pos, key;
 
-        if (mDoubleArrayDictItemData) {
-            delete mDoubleArrayDictItemData;
-            mDoubleArrayDictItemData = NULL;
-        }
+    *item = NULL;
+    *mine = false;
 
-        if (src.mDoubleArrayDictItemData) {
-            mDoubleArrayDictItemData  = new _DoubleArrayDictItem();
-            *mDoubleArrayDictItemData = *(src.mDoubleArrayDictItemData);
+    seq = mSeq.load(std::memory_order_acquire);
+    if (seq & 1) return false;
+
+    data = mReadData.load(std::memory_order_acquire);
+    if ((data) && (keyId != _DICT_SLOT_EMPTY) && 
+                                (keyId != _DICT_SLOT_TOMBSTONE)) {
+        slots = data->mSlots.load(std::memory_order_acquire);
+    } else {
+        slots = NULL;
+    }
+
+    if (slots) {
+        mask = slots->mSize - 1;
+        pos  = (keyId * 2654435761u) & mask;
+
+        // A table we read halfway through a change might not have
+        // any empty slots, so don't go round more than once.
+        for (uint32_t n=0; n<slots->mSize; ++n) {
+            const _DictSlot &slot = slots->mSlot[pos];
+
+            key = slot.mKey.load(std::memory_order_acquire);
+            if (key == _DICT_SLOT_EMPTY) break;
+
+            if (key == keyId) {
+                *item = slot.mItem.load(std::memory_order_acquire);
+                *mine = (slot.mFlags.load(std::memory_order_acquire) & 
+                                            _DICT_SLOT_ESCAPED) &&
+                        (data->mRefCount.load(
+                                    std::memory_order_acquire) == 1);
+                break;
+            }
+            pos = (pos + 1) & mask;
         }
     }
 
-    return *this;
+    return mSeq.load(std::memory_order_relaxed) == seq;
 }
 
-
-
 // ----------------------------------------
 //
-// root points to the place whose child should be a 
-// <dictitem></dictitem> tag.
+// Plain lookup, with no unsharing. 
 //
-// virtual
-bool 
-Ookala::DoubleArrayDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
+// private
+const Ookala::DictItem *
+Ookala::Dict::findItem(const DictKey &key) const
 {
-    for (std::vector<double>::iterator i=mDoubleArrayDictItemData->mValue.begin();
-                           i != mDoubleArrayDictItemData->mValue.end(); ++i) {
+    int32_t idx;
 
-        std::ostringstream value;
-        value << (*i);
+    if (!mDictData) return NULL;
 
-        xmlNewTextChild(root, NULL, (const xmlChar *)"value", 
-                                    (const xmlChar *)value.str().c_str());
+    idx = findSlot(key.id());
+    if (idx < 0) {
+        return NULL;
     }
 
-    return true;
+    return slotAt(idx).mItem;
 }
 
 // ----------------------------------------
 //
-// root should point to a <dictitem></dictitem> element.
-// If we don't find a name, return false;
-//
-// Example:
-//            <dictitem type="doubleArray" name="Countdown">
-//                <name>Countdown</name>
-//                <value>4</value>
-//                <value>3</value>
-//                <value>2</value>
-//                <value>1</value>
-//            </dictitem>
+// Lookup for an item that the caller may change. If the item is
+// visible from another copy of this Dict, swap in our own clone 
+// of it first. If it's being handed out, mark it so later copies 
+// of us know to clone it.
 //
-// virtual
-bool
-Ookala::DoubleArrayDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root)
+// private
+Ookala::DictItem *
+Ookala::Dict::getLocked(const DictKey &key, bool escape)
 {
-    std::vector<std::string> names, values;
-
-    mDoubleArrayDictItemData->mValue.clear();
+    int32_t   idx;
+    DictItem *item, *copy;
 
-    getXmlDirectChildren(doc, root, names, values);
+    if (!mDictData) return NULL;
 
-    std::vector<std::string>::iterator theName  = names.begin();
-    std::vector<std::string>::iterator theValue = values.begin();
+    idx = findSlot(key.id());
+    if (idx < 0) {
+        return NULL;
+    }
 
-    while ((theName != names.end()) && (theValue != values.end()))  {
+    if (mDictData->mRefCount > 1) {
+        detach();
+    }
 
-        if ((*theName) == "value") {
-            mDoubleArrayDictItemData->mValue.push_back(atof((*theValue).c_str()));
-        }
+    _DictSlot &slot = slotAt(idx);
 
-        ++theName;
-        ++theValue;
+    item = slot.mItem;
+    if (item == NULL) {
+        return NULL;
     }
 
-    return true;
-}
+    if (item->mDictItemData->mTableRefs > 1) {
+        copy = item->clone();
+        if (copy) {
+            copy->mDictItemData->mDictOwned = true;
 
-// ----------------------------------------
+            retainItem(copy);
+            slot.mItem.store(copy, std::memory_order_release);
+            releaseItem(item);
 
-void
-Ookala::DoubleArrayDictItem::set(const std::vector<double> value)
-{
-    mDoubleArrayDictItemData->mValue = value;
-}
+            item = copy;
+        } else {
+            _warnUncloneable(item);
+        }
+    }
 
-// ----------------------------------------
+    if (escape) {
+        item->mDictItemData->mEscaped = true;
+        slot.mFlags.store(slot.mFlags.load(std::memory_order_relaxed) | 
+                                _DICT_SLOT_ESCAPED,
+                          std::memory_order_release);
+    }
 
-std::vector<double>
-Ookala::DoubleArrayDictItem::get()
-{
-    return mDoubleArrayDictItemData->mValue;
+    return item;
 }
 
 // ----------------------------------------
 //
-// virtual
-void
-Ookala::DoubleArrayDictItem::debug()
+// private
+bool
+Ookala::Dict::setLocked(const DictKey &key, DictItem *value)
 {
-    int idx = 0;
+    _DictSlots *slots;
+    int32_t     idx;
 
-    for (std::vector<double>::iterator i = 
-              mDoubleArrayDictItemData->mValue.begin();
-                i != mDoubleArrayDictItemData->mValue.end(); ++i) {
-        printf("%d: %f\n", idx, (*i));
-        idx++;
-    }   
-}
+    if (!mDictData)    return false;
+    if (!key.valid())  return false;
 
+    detach();
 
+    idx = findSlot(key.id());
+    if (idx >= 0) {
+        _DictSlot &slot    = slotAt(idx);
+        DictItem  *oldItem = slot.mItem;
 
-// ========================================
-//
-// StringArrayDictItem
-//
-// ----------------------------------------
+        if (oldItem != value) {
+            retainItem(value);
+            slot.mItem.store(value, std::memory_order_release);
+            slot.mFlags.store(0, std::memory_order_release);
+            releaseItem(oldItem);
+        }
+        return true;
+    }
 
+    // Keep the load factor, counting tombstones, under 3/4
+    slots = mDictData->mSlots;
+    if ((!slots) || (4 * (mDictData->mCount + mDictData->mTombstones + 1) >
+                                                    3 * slots->mSize)) {
+        growSlots();
+        slots = mDictData->mSlots;
+    }
 
-Ookala::StringArrayDictItem::StringArrayDictItem() :  
-    DictItem()
-{
-    setItemType("stringArray");
+    uint32_t mask = slots->mSize - 1;
+    uint32_t pos  = (key.id() * 2654435761u) & mask;
 
-    mStringArrayDictItemData = new _StringArrayDictItem;
+    while ((slots->mSlot[pos].mKey != _DICT_SLOT_EMPTY) &&
+           (slots->mSlot[pos].mKey != _DICT_SLOT_TOMBSTONE)) {
+        pos = (pos + 1) & mask;
+    }
+
+    if (slots->mSlot[pos].mKey == _DICT_SLOT_TOMBSTONE) {
+        mDictData->mTombstones--;
+    }
+
+    retainItem(value);
+
+    slots->mSlot[pos].mFlags.store(0, std::memory_order_release);
+    slots->mSlot[pos].mItem.store(value, std::memory_order_release);
+    slots->mSlot[pos].mKey.store(key.id(), std::memory_order_release);
+    mDictData->mCount++;
+
+    return true;
 }
 
 // ----------------------------------------
 //
-Ookala::StringArrayDictItem::StringArrayDictItem(
-                        const StringArrayDictItem &src):
-    DictItem(src)
+// private
+void
+Ookala::Dict::bumpVersion()
 {
-    mStringArrayDictItemData = new _StringArrayDictItem;
-
-    if (src.mStringArrayDictItemData) {
-        mStringArrayDictItemData->mValue = src.mStringArrayDictItemData->mValue;
+    if (mDictData) {
+        mDictData->mVersion = ++gDictVersion;
     }
 }
 
 // ----------------------------------------
 //
-// virtual
-Ookala::StringArrayDictItem::~StringArrayDictItem()
+// Bump our version, and mark key as changed as of it.
+//
+// private
+void
+Ookala::Dict::bumpVersion(const DictKey &key)
 {
-    if (mStringArrayDictItemData) {    
-        delete mStringArrayDictItemData;
-        mStringArrayDictItemData = NULL;
+    int32_t idx;
+
+    if (!mDictData) return;
+
+    bumpVersion();
+
+    idx = findSlot(key.id());
+    if (idx >= 0) {
+        slotAt(idx).mVersion = mDictData->mVersion;
     }
 }
 
-// ----------------------------
+// ----------------------------------------
 //
-Ookala::StringArrayDictItem &
-Ookala::StringArrayDictItem::operator=(
-                            const StringArrayDictItem &src)
+// private
+bool
+Ookala::Dict::changedLocked(uint64_t version, 
+                            const std::string &pattern) const
 {
-    if (this != &src) {
-        DictItem::operator=(src);
+    if (pattern.empty() || (pattern[pattern.size()-1] != '*')) {
+        int32_t idx = findSlot(DictKey::find(pattern).id());
 
-        if (mStringArrayDictItemData) {
-            delete mStringArrayDictItemData;
-            mStringArrayDictItemData = NULL;
+        if (idx < 0) {
+            return mDictData->mRemoveVersion > version;
         }
+        return slotAt(idx).mVersion > version;
+    }
 
-        if (src.mStringArrayDictItemData) {
-            mStringArrayDictItemData  = new _StringArrayDictItem();
-            *mStringArrayDictItemData = *(src.mStringArrayDictItemData);
-        }
+    if (mDictData->mRemoveVersion > version) {
+        return true;
     }
 
-    return *this;
-}
+    // Only bother with the names of keys that have changed.
+    std::string       prefix = pattern.substr(0, pattern.size()-1);
+    const _DictSlots *slots  = mDictData->mSlots;
 
+    for (uint32_t idx=0; (slots) && (idx<slots->mSize); ++idx) {
+        const _DictSlot &slot = slots->mSlot[idx];
 
-// ----------------------------------------
-//
-// root points to the place whose child should be a 
-// <dictitem></dictitem> tag.
-//
-// virtual
-bool 
-Ookala::StringArrayDictItem::serialize(xmlDocPtr doc, xmlNodePtr root)
-{
-    for (std::vector<std::string>::iterator i =
-                      mStringArrayDictItemData->mValue.begin();
-                 i != mStringArrayDictItemData->mValue.end(); ++i) {
+        if ((slot.mKey == _DICT_SLOT_EMPTY) ||
+                (slot.mKey == _DICT_SLOT_TOMBSTONE) ||
+                (slot.mVersion <= version)) {
+            continue;
+        }
 
-        xmlNewTextChild(root, NULL, (const xmlChar *)"value", 
-                                    (const xmlChar *)(*i).c_str());
+        DictKey key;
+        key.mId = slot.mKey;
+
+        if (!key.str().compare(0, prefix.size(), prefix)) {
+            return true;
+        }
     }
 
-    return true;
+    return false;
 }
 
 // ----------------------------------------
 //
-// root should point to a <dictitem></dictitem> element.
-// If we don't find a name, return false;
-//
-//    Example:
-//        <dictitem type="stringArray" name="DataSavior Files">
-//            <value>/usr/home/ookala/loadme.xml</value>
-//            <value>~/loadme2.xml</value>
-//            <value>~/loadme.%s.xml</value>
-//            <value>/asdfa/vafas/foo.xml</value>
-//        </dictitem>
+// Returns the index of the slot holding keyId, or -1 if 
+// we don't have it.
 //
-// virtual
-bool
-Ookala::StringArrayDictItem::unserialize(xmlDocPtr doc, xmlNodePtr root) 
+// private
+int32_t
+Ookala::Dict::findSlot(uint32_t keyId) const
 {
-    std::vector<std::string> names, values;
-
-    mStringArrayDictItemData->mValue.clear();
+    const _DictSlots *slots = mDictData->mSlots;
 
-    getXmlDirectChildren(doc, root, names, values);
-
-    std::vector<std::string>::iterator theName  = names.begin();
-    std::vector<std::string>::iterator theValue = values.begin();
-
-    while ((theName != names.end()) && (theValue != values.end()))  {
-
-        if ((*theName) == "value") {
+    if (!slots) return -1;
+    if ((keyId == _DICT_SLOT_EMPTY) || (keyId == _DICT_SLOT_TOMBSTONE)) {
+        return -1;
+    }
 
-            // Trim any leading + trailing space
-            size_t start = (*theValue).find_first_not_of(" \t\n");
-            size_t end   = (*theValue).find_last_not_of(" \t\n");
+    uint32_t mask = slots->mSize - 1;
+    uint32_t pos  = (keyId * 2654435761u) & mask;
 
-            if (start == std::string::npos) {
-                mStringArrayDictItemData->mValue.push_back("");
-            } else {
-                mStringArrayDictItemData->mValue.push_back(
-                                (*theValue).substr(start, end-start+1));
-            }
+    // The load factor guarantees at least one empty slot, so 
+    // this will terminate.
+    while (slots->mSlot[pos].mKey != _DICT_SLOT_EMPTY) {
+        if (slots->mSlot[pos].mKey == keyId) {
+            return (int32_t)pos;
         }
-
-        ++theName;
-        ++theValue;
+        pos = (pos + 1) & mask;
     }
 
-    return true;
+    return -1;
 }
 
 // ----------------------------------------
-
+//
+// Double the table (or just sweep out tombstones if that 
+// frees up enough space) and re-insert everything.
+//
+// private
 void
-Ookala::StringArrayDictItem::set(const std::vector<std::string> value)
-{
-    mStringArrayDictItemData->mValue = value;
-}
-
-// ----------------------------------------
-
-std::vector<std::string>
-Ookala::StringArrayDictItem::get()
+Ookala::Dict::growSlots()
 {
-    return mStringArrayDictItemData->mValue;
-}
+    _DictSlots *old, *slots;
+    uint32_t    size;
 
-// ----------------------------------------
+    old = mDictData->mSlots;
 
-// virtual
-void
-Ookala::StringArrayDictItem::debug()
-{
-    int idx = 0;
+    size = 8;
+    while (4 * (mDictData->mCount + 1) > 3 * (size / 2)) {
+        size *= 2;
+    }
 
-    for (std::vector<std::string>::iterator i = 
-                     mStringArrayDictItemData->mValue.begin();
-                i != mStringArrayDictItemData->mValue.end(); ++i) {
-        printf("%d: %s\n", idx, (*i).c_str());
-        idx++;
-    }   
-}
+    slots = newSlots(size);
 
+    uint32_t mask = size - 1;
+    for (uint32_t idx=0; (old) && (idx<old->mSize); ++idx) {
+        const _DictSlot &slot = old->mSlot[idx];
 
+        if ((slot.mKey == _DICT_SLOT_EMPTY) || 
+                (slot.mKey == _DICT_SLOT_TOMBSTONE)) {
+            continue;
+        }
 
-// ========================================
-//
-// _Dict
-//
-// ----------------------------------------
+        uint32_t pos = (slot.mKey * 2654435761u) & mask;
+        while (slots->mSlot[pos].mKey != _DICT_SLOT_EMPTY) {
+            pos = (pos + 1) & mask;
+        }
+        slots->mSlot[pos].mKey.store(slot.mKey, std::memory_order_release);
+        slots->mSlot[pos].mFlags.store(slot.mFlags, 
+                                       std::memory_order_release);
+        slots->mSlot[pos].mItem.store(slot.mItem, std::memory_order_release);
+        slots->mSlot[pos].mVersion = slot.mVersion;
+    }
 
-Ookala::Dict::Dict()
-{
-    mRegistry = NULL;    
+    mDictData->mSlots.store(slots, std::memory_order_release);
+    mDictData->mTombstones = 0;
 
-    mDictData = new _Dict;
+    freeSlots(old);
 }
 
 // ----------------------------------------
 //
-
-Ookala::Dict::Dict(PluginRegistry *registry)
+// private
+std::vector<Ookala::DictKey>
+Ookala::Dict::sortedKeys() const
 {
-    mRegistry = registry;   
+    std::map<std::string, DictKey> byName;
+    std::vector<DictKey>           keys;
+
+    if (!mDictData) return keys;
+
+    const _DictSlots *slots = mDictData->mSlots;
 
-    mDictData = new _Dict;
+    for (uint32_t idx=0; (slots) && (idx<slots->mSize); ++idx) {
+        const _DictSlot &slot = slots->mSlot[idx];
+
+        if ((slot.mKey == _DICT_SLOT_EMPTY) || 
+                (slot.mKey == _DICT_SLOT_TOMBSTONE)) {
+            continue;
+        }
+
+        DictKey key;
+        key.mId = slot.mKey;
+        byName[key.str()] = key;
+    }
+
+    for (std::map<std::string, DictKey>::iterator i = byName.begin();
+            i != byName.end(); ++i) {
+        keys.push_back((*i).second);
+    }
+
+    return keys;
 }
 
 // ----------------------------------------
 //
-Ookala::Dict::Dict(const Dict &src)
+// If other copies of this Dict are sharing our table, make a 
+// private copy of it. The items themselves stay shared, so each 
+// one now has another table referencing it.
+//
+// private
+void
+Ookala::Dict::detach()
 {
-    mRegistry = src.mRegistry;
+    if ((!mDictData) || (mDictData->mRefCount < 2)) return;
+
+    _Dict      *data = newData();
+    _DictSlots *slots;
+
+    data->mCount      = mDictData->mCount;
+    data->mTombstones = mDictData->mTombstones;
+    data->mName          = mDictData->mName;
+    data->mVersion       = mDictData->mVersion;
+    data->mRemoveVersion = mDictData->mRemoveVersion;
+
+    slots = mDictData->mSlots;
+    if (slots) {
+        slots = newSlots(slots->mSize);
+        copySlots(slots, mDictData->mSlots);
+        data->mSlots.store(slots, std::memory_order_release);
+    }
 
-    mDictData = new _Dict;
-    if (src.mDictData) {
-        mDictData->mItems = src.mDictData->mItems;
-        mDictData->mName  = src.mDictData->mName;
+    // Items are shared between the two tables now, so get() has
+    // to look at them again before handing them out.
+    for (uint32_t idx=0; (slots) && (idx<slots->mSize); ++idx) {
+        _DictSlot &slot = slots->mSlot[idx];
+
+        slot.mFlags.store(0, std::memory_order_release);
+        if ((slot.mKey != _DICT_SLOT_EMPTY) && 
+                (slot.mKey != _DICT_SLOT_TOMBSTONE)) {
+            retainItem(slot.mItem);
+        }
     }
+
+    // Someone else may have let go since we checked, in which case
+    // we're the ones tidying up the old table.
+    releaseData(mDictData);
+    setData(data);
 }
 
 // ----------------------------------------
 //
-//virtual 
-Ookala::Dict::~Dict()
+// Called with our lock held, for a copy being made of us. Items
+// handed out by the non-const get() may still be changed by 
+// whoever has them, so rather than share those, the copy gets 
+// its own table with clones of them.
+//
+// private
+Ookala::Dict::_Dict *
+Ookala::Dict::shareData() const
 {
-    if (mDictData) {
-        delete mDictData;
-        mDictData = NULL;
+    _Dict      *data;
+    _DictSlots *slots;
+    DictItem   *item, *copy;
+    bool        escaped = false;
+
+    if (!mDictData) return NULL;
+
+    slots = mDictData->mSlots;
+    for (uint32_t idx=0; (slots) && (idx<slots->mSize); ++idx) {
+        const _DictSlot &slot = slots->mSlot[idx];
+
+        if ((slot.mKey != _DICT_SLOT_EMPTY) && 
+                (slot.mKey != _DICT_SLOT_TOMBSTONE) &&
+                (slot.mItem) && (slot.mItem.load()->mDictItemData->mEscaped)) {
+            escaped = true;
+            break;
+        }
     }
-}
 
-// ----------------------------
-//
-Ookala::Dict &
-Ookala::Dict::operator=(const Dict &src)
-{
-    if (this != &src) {
+    if (!escaped) {
+        mDictData->mRefCount++;
+        return mDictData;
+    }
+
+    data = newData();
+
+    data->mCount         = mDictData->mCount;
+    data->mTombstones    = mDictData->mTombstones;
+    data->mName          = mDictData->mName;
+    data->mVersion       = mDictData->mVersion;
+    data->mRemoveVersion = mDictData->mRemoveVersion;
 
-        if (mDictData) {
-            delete mDictData;
-            mDictData = NULL;
+    slots = newSlots(slots->mSize);
+    copySlots(slots, mDictData->mSlots);
+    data->mSlots.store(slots, std::memory_order_release);
+
+    for (uint32_t idx=0; idx<slots->mSize; ++idx) {
+        _DictSlot &slot = slots->mSlot[idx];
+
+        slot.mFlags.store(0, std::memory_order_release);
+
+        item = slot.mItem;
+        if ((slot.mKey == _DICT_SLOT_EMPTY) || 
+                (slot.mKey == _DICT_SLOT_TOMBSTONE) || 
+                (item == NULL)) {
+            continue;
         }
 
-        if (src.mDictData) {
-            mDictData  = new _Dict();
-            *mDictData = *(src.mDictData);
+        if (item->mDictItemData->mEscaped) {
+            copy = item->clone();
+            if (copy) {
+                copy->mDictItemData->mDictOwned = true;
+                slot.mItem.store(copy, std::memory_order_release);
+                item = copy;
+            } else {
+                _warnUncloneable(item);
+            }
         }
 
-        mRegistry = src.mRegistry;
+        retainItem(item);
     }
 
-    return *this;
+    return data;
 }
 
-
 // ----------------------------------------
-
+//
+// Drop a reference to a table, and if it was the last one, 
+// to the items in it too.
+//
+// private
 void
-Ookala::Dict::setName(const std::string &name)
+Ookala::Dict::releaseData(_Dict *data)
 {
-    if (mDictData) {
-        mDictData->mName = name;
+    if (!data) return;
+
+    if (--data->mRefCount == 0) {
+        _DictSlots *slots = data->mSlots;
+        _DictPool  &dictPool = pool();
+
+        for (uint32_t idx=0; (slots) && (idx<slots->mSize); ++idx) {
+            const _DictSlot &slot = slots->mSlot[idx];
+
+            if ((slot.mKey != _DICT_SLOT_EMPTY) && 
+                    (slot.mKey != _DICT_SLOT_TOMBSTONE)) {
+                releaseItem(slot.mItem);
+            }
+        }
+
+        freeSlots(slots);
+        data->mSlots.store(NULL, std::memory_order_release);
+        data->mName.clear();
+
+        dictPool.mLock.lock();
+        dictPool.mData.push_back(data);
+        dictPool.mLock.unlock();
     }
 }
 
 // ----------------------------------------
+//
+// private static
+Ookala::Dict::_Dict *
+Ookala::Dict::newData()
+{
+    _DictPool &dictPool = pool();
+    _Dict     *data     = NULL;
 
-std::string
-Ookala::Dict::getName()
-{   
-    if (mDictData) {
-        return mDictData->mName;
+    dictPool.mLock.lock();
+    if (!dictPool.mData.empty()) {
+        data = dictPool.mData.back();
+        dictPool.mData.pop_back();
     }
+    dictPool.mLock.unlock();
 
-    return std::string("");
-}
+    if (!data) {
+        data = new _Dict;
+    }
 
-// ----------------------------------------
+    data->mSlots.store(NULL, std::memory_order_release);
+    data->mCount         = 0;
+    data->mTombstones    = 0;
+    data->mRefCount      = 1;
+    data->mVersion       = ++gDictVersion;
+    data->mRemoveVersion = data->mVersion;
 
-void 
-Ookala::Dict::setRegistry(PluginRegistry *registry)
-{
-    mRegistry = registry;
+    return data;
 }
 
 // ----------------------------------------
-
-bool
-Ookala::Dict::set(const std::string &key, DictItem *value)
+//
+// private static
+Ookala::Dict::_DictPool &
+Ookala::Dict::pool()
 {
-    if (mDictData) {
-        mDictData->mItems[key] = value;
-        return true;
-    }
+    // Deliberately never freed, like the DictKey table - static
+    // Dicts may be torn down after us at exit.
+    static _DictPool *dictPool = new _DictPool;
 
-    return false;
+    return *dictPool;
 }
 
 // ----------------------------------------
-
-bool
-Ookala::Dict::get(const std::string &key, DictItem **value)
+//
+// An empty slot array of size entries, which must be a power of two.
+//
+// private static
+Ookala::Dict::_DictSlots *
+Ookala::Dict::newSlots(uint32_t size)
 {
-    
-    if (!mDictData) return false;
+    _DictPool  &dictPool = pool();
+    _DictSlots *slots    = NULL;
+    uint32_t    sizeLog  = 0;
 
-    std::map<std::string, DictItem *>::iterator i = mDictData->mItems.find(key);
-    
-    if (i != mDictData->mItems.end()) {
-        *value = (*i).second;
-        return true;    
+    while ((1u << sizeLog) < size) {
+        ++sizeLog;
     }
 
-    return false;
-}
-
-// ----------------------------------------
+    dictPool.mLock.lock();
+    if (!dictPool.mSlots[sizeLog].empty()) {
+        slots = dictPool.mSlots[sizeLog].back();
+        dictPool.mSlots[sizeLog].pop_back();
+    }
+    dictPool.mLock.unlock();
 
-Ookala::DictItem *
-Ookala::Dict::get(const std::string &key)
-{
-    if (!mDictData) return NULL;
+    if (!slots) {
+        slots        = new _DictSlots;
+        slots->mSize = size;
+        slots->mSlot = new _DictSlot[size];
+    }
 
-    std::map<std::string, DictItem *>::iterator i = mDictData->mItems.find(key);
-    
-    if (i != mDictData->mItems.end()) {
-        return (*i).second;    
+    for (uint32_t idx=0; idx<size; ++idx) {
+        slots->mSlot[idx].mKey.store(_DICT_SLOT_EMPTY, 
+                                     std::memory_order_release);
+        slots->mSlot[idx].mFlags.store(0, std::memory_order_release);
+        slots->mSlot[idx].mItem.store(NULL, std::memory_order_release);
+        slots->mSlot[idx].mVersion = 0;
     }
 
-    return NULL;
+    return slots;
 }
 
 // ----------------------------------------
-
-bool
-Ookala::Dict::remove(const std::string &key)
+//
+// private static
+void
+Ookala::Dict::freeSlots(_DictSlots *slots)
 {
-    if (!mDictData) return false;
+    _DictPool &dictPool = pool();
+    uint32_t   sizeLog  = 0;
 
-    std::map<std::string, DictItem *>::iterator i = mDictData->mItems.find(key);
-   
-    if (i != mDictData->mItems.end()) {
-        mDictData->mItems.erase(i);
-        return true;    
+    if (!slots) return;
+
+    while ((1u << sizeLog) < slots->mSize) {
+        ++sizeLog;
     }
 
-    return false;
+    dictPool.mLock.lock();
+    dictPool.mSlots[sizeLog].push_back(slots);
+    dictPool.mLock.unlock();
 }
 
 // ----------------------------------------
-
-bool
-Ookala::Dict::clear()
+//
+// Copy src's slots into dst, which is the same size.
+//
+// private static
+void
+Ookala::Dict::copySlots(_DictSlots *dst, const _DictSlots *src)
 {
-    if (!mDictData) return false;
-
-    mDictData->mItems.clear();
-
-    return true;
+    for (uint32_t idx=0; idx<src->mSize; ++idx) {
+        const _DictSlot &from = src->mSlot[idx];
+        _DictSlot       &to   = dst->mSlot[idx];
+
+        to.mKey.store(from.mKey, std::memory_order_release);
+        to.mFlags.store(from.mFlags, std::memory_order_release);
+        to.mItem.store(from.mItem, std::memory_order_release);
+        to.mVersion = from.mVersion;
+    }
 }
 
 // ----------------------------------------
 //
-// Returns all the keys that we're currently holding
-std::vector<std::string>
-Ookala::Dict::getKeys()
+// Called with the write lock held, or before anyone else can see us.
+//
+// private
+void
+Ookala::Dict::setData(_Dict *data)
 {
-    std::vector<std::string> keys;
-
-    if (!mDictData) return keys;
+    mDictData = data;
+    mReadData.store(data, std::memory_order_release);
+}
 
-    for (std::map<std::string, DictItem *>::iterator i = 
-                 mDictData->mItems.begin();
-            i != mDictData->mItems.end(); ++i) {
-        keys.push_back((*i).first);
+// ----------------------------------------
+//
+// private static
+void
+Ookala::Dict::retainItem(DictItem *item)
+{
+    if ((item) && (item->mDictItemData)) {
+        item->mDictItemData->mTableRefs++;
     }
-
-    return keys;
 }
 
 // ----------------------------------------
-
+//
+// Items that we made with clone() are ours to free once no
+// table holds them. Anything else still belongs to whoever 
+// set() it.
+//
+// private
 void
-Ookala::Dict::debug()
+Ookala::Dict::releaseItem(DictItem *item)
 {
-    if (!mDictData) return;
+    if ((!item) || (!item->mDictItemData)) return;
 
-    printf("%s: %d items\n", mDictData->mName.c_str(),  
-                        (int)mDictData->mItems.size());
-    for (std::map<std::string, DictItem *>::iterator i = 
-                 mDictData->mItems.begin();
-            i != mDictData->mItems.end(); ++i) {
-        printf("---------------------------\n%s:\n", (*i).first.c_str());
-        (*i).second->debug();
+    // Only the release that takes the count to zero may free it.
+    if (--item->mDictItemData->mTableRefs != 0) return;
+
+    if (item->mDictItemData->mDictOwned) {
+        if ((mRegistry == NULL) || (!mRegistry->deleteDictItem(item))) {
+            delete item;
+        }
     }
 }
 
@@ -1497,9 +4293,14 @@ Ookala::Dict::debug()
 bool 
 Ookala::Dict::serialize(xmlDocPtr doc, xmlNodePtr parent)
 {
-    xmlNodePtr dictNode, itemNode;
+    xmlNodePtr dictNode;
 
-    if (!mDictData) return false;
+    readLock();
+
+    if (!mDictData) {
+        readUnlock();
+        return false;
+    }
 
     dictNode = xmlNewTextChild(parent, NULL, 
                     (const xmlChar *)"dict", NULL);
@@ -1508,27 +4309,56 @@ Ookala::Dict::serialize(xmlDocPtr doc, xmlNodePtr parent)
                     (const xmlChar *)mDictData->mName.c_str());
     }
 
-    for (std::map<std::string, DictItem *>::iterator i = 
-                 mDictData->mItems.begin();
-            i != mDictData->mItems.end(); ++i) {
+    std::vector<DictKey> keys = sortedKeys();
 
-        if ( (*i).second->serializable()) {
-            itemNode = xmlNewTextChild(dictNode, NULL, 
-                                (const xmlChar *)"dictitem", NULL);
+    // Serializing doesn't change anything, so look items up without
+    // unsharing them. That way a snapshot can be saved while the
+    // Dict it came from keeps changing.
+    for (std::vector<DictKey>::iterator i = keys.begin(); 
+            i != keys.end(); ++i) {
+        DictItem *item = const_cast<DictItem *>(findItem(*i));
 
-            xmlSetProp(itemNode, (const xmlChar *)"name",
-                        (const xmlChar *)(*i).first.c_str());
-
-            xmlSetProp(itemNode, (const xmlChar *)"type",
-                        (const xmlChar *)(*i).second->itemType().c_str());
-
-            (*i).second->serialize(doc, itemNode);
+        if (item->serializable()) {
+            serializeItem(doc, dictNode, (*i).str(), item);
         } 
     }
 
+    readUnlock();
+
     return true;
 }
 
+// ----------------------------------------
+//
+// static
+xmlNodePtr
+Ookala::Dict::serializeItem(xmlDocPtr doc, xmlNodePtr parent,
+                            const std::string &key, DictItem *item)
+{
+    xmlNodePtr itemNode;
+
+    itemNode = xmlNewTextChild(parent, NULL, 
+                        (const xmlChar *)"dictitem", NULL);
+
+    xmlSetProp(itemNode, (const xmlChar *)"name",
+                (const xmlChar *)key.c_str());
+
+    xmlSetProp(itemNode, (const xmlChar *)"type",
+                (const xmlChar *)item->itemType().c_str());
+
+    item->serialize(doc, itemNode);
+
+    // So a load can tell an item that made it to disk whole from 
+    // one that didn't.
+    char crc[16];
+
+    snprintf(crc, sizeof(crc), "%08x", 
+                    (unsigned int)_dictCrcNode(0, itemNode, true));
+    xmlSetProp(itemNode, (const xmlChar *)"crc", (const xmlChar *)crc);
+
+    return itemNode;
+}
+
 // ----------------------------------------
 //
 // Assume that root is pointing to a <dict> node.
@@ -1538,8 +4368,6 @@ Ookala::Dict::unserialize(xmlDocPtr doc, xmlNodePtr root)
 {
     xmlNodePtr  dictNode;
     xmlNodePtr  itemNode;
-    DictItem   *itemPtr;
-    std::string itemName, dataType;
     xmlChar    *attrName;
 
     if (!mDictData) return false;
@@ -1558,7 +4386,7 @@ Ookala::Dict::unserialize(xmlDocPtr doc, xmlNodePtr root)
 
     attrName = xmlGetProp(dictNode, (const xmlChar *)("name"));
     if (attrName != NULL) {
-        mDictData->mName = (char *)(attrName);
+        setName((char *)(attrName));
         xmlFree(attrName);
     }
 
@@ -1568,53 +4396,160 @@ Ookala::Dict::unserialize(xmlDocPtr doc, xmlNodePtr root)
     itemNode = dictNode->xmlChildrenNode;
     while (itemNode) {
 
-        if (strcmp((char *)itemNode->name, "dictitem")) {
-            itemNode = itemNode->next;
-            continue;
+        if (!strcmp((char *)itemNode->name, "dictitem")) {
+            unserializeItem(doc, itemNode);
         }
 
-        // <dictitem> must contain a type property that specifies
-        // what sort of data it contains. For example,
-        //   <dictitem name="foo" type="int"> ...
-        attrName = xmlGetProp(itemNode, (const xmlChar *)("type"));
-        if (attrName == NULL) {
-            itemNode = itemNode->next;
-            continue;
-        }
+        itemNode = itemNode->next;
+    }
+
+    return true;
+}
 
-        dataType.assign((char *)attrName);
+// ----------------------------------------
+//
+// Assume that reader is sitting on a <dict> start element.
 
-        // <dictitem> also must have a name property, otherwise,
-        // we'll skip it.
-        attrName = xmlGetProp(itemNode, (const xmlChar *)("name"));
-        if (attrName == NULL) {
-            itemNode = itemNode->next;
-            continue;
+bool
+Ookala::Dict::unserialize(xmlTextReaderPtr reader)
+{
+    xmlChar *attrName;
+    int      dictDepth, ret;
+
+    if (!mDictData) return false;
+
+    if (reader == NULL) {
+        return false;
+    }
+
+    if ((xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) ||
+            strcmp((const char *)xmlTextReaderConstName(reader), "dict")) {
+        return false;
+    }
+
+    printf("Found <dict> in stream\n");
+
+    attrName = xmlTextReaderGetAttribute(reader, (const xmlChar *)("name"));
+    if (attrName != NULL) {
+        setName((char *)(attrName));
+        xmlFree(attrName);
+    }
+
+    if (xmlTextReaderIsEmptyElement(reader)) {
+        return true;
+    }
+
+    // Walk forward until our </dict>. Only <dictitem>s that are
+    // direct children matter; anything deeper is either inside a 
+    // <dictitem> that we've already expanded, or something we 
+    // don't know about.
+    dictDepth = xmlTextReaderDepth(reader);
+    ret       = xmlTextReaderRead(reader);
+    while (ret == 1) {
+        int type  = xmlTextReaderNodeType(reader);
+        int depth = xmlTextReaderDepth(reader);
+
+        if ((type == XML_READER_TYPE_END_ELEMENT) && (depth == dictDepth)) {
+            break;
         }
-        
-        itemName.assign((char *)attrName);
-        printf("Found <dictitem> \"%s\" of type %s\n",
-                    itemName.c_str(), dataType.c_str());
-
-        // Now we have a <dictitem></dictitem> tag. Decode it and
-        // store the resulting values.
-        if (mRegistry == NULL) {
-            itemNode = itemNode->next;
+
+        if ((type != XML_READER_TYPE_ELEMENT) || (depth != dictDepth+1) ||
+                strcmp((const char *)xmlTextReaderConstName(reader), "dictitem")) {
+            ret = xmlTextReaderRead(reader);
             continue;
         }
 
-        itemPtr = mRegistry->createDictItem(dataType);
-        if (itemPtr == NULL) {
-            fprintf(stderr, "WARNING: No DictItem found for type %s\n",
-                                                    dataType.c_str());
-            itemNode = itemNode->next;
-            continue;
+        xmlNodePtr itemNode = xmlTextReaderExpand(reader);
+        if (itemNode == NULL) {
+            ret = -1;
+            break;
         }
-        if (itemPtr->unserialize(doc, itemNode)) {
-            set(itemName, itemPtr);
-        } 
-        itemNode = itemNode->next;
+
+        unserializeItem(itemNode->doc, itemNode);
+
+        // Hop over the item's children; we've already used them.
+        ret = xmlTextReaderNext(reader);
+    }
+
+    if (ret != 1) {
+        fprintf(stderr, "Error reading <dict> \"%s\"\n", 
+                                    getName().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// ----------------------------------------
+//
+// protected
+bool
+Ookala::Dict::unserializeItem(xmlDocPtr doc, xmlNodePtr itemNode)
+{
+    DictItem   *itemPtr;
+    std::string itemName, dataType;
+    xmlChar    *attrName;
+
+    // <dictitem> must contain a type property that specifies
+    // what sort of data it contains. For example,
+    //   <dictitem name="foo" type="int"> ...
+    attrName = xmlGetProp(itemNode, (const xmlChar *)("type"));
+    if (attrName == NULL) {
+        return false;
+    }
+
+    dataType.assign((char *)attrName);
+    xmlFree(attrName);
+
+    // <dictitem> also must have a name property, otherwise,
+    // we'll skip it.
+    attrName = xmlGetProp(itemNode, (const xmlChar *)("name"));
+    if (attrName == NULL) {
+        return false;
+    }
+    
+    itemName.assign((char *)attrName);
+    xmlFree(attrName);
+
+    printf("Found <dictitem> \"%s\" of type %s\n",
+                itemName.c_str(), dataType.c_str());
+
+    // Items written before checksums were added don't have one, 
+    // and are taken as they are.
+    attrName = xmlGetProp(itemNode, (const xmlChar *)("crc"));
+    if (attrName != NULL) {
+        uint32_t crc = (uint32_t)strtoul((const char *)attrName, NULL, 16);
+
+        xmlFree(attrName);
+
+        if (crc != _dictCrcNode(0, itemNode, true)) {
+            fprintf(stderr, "WARNING: <dictitem> \"%s\" is damaged, "
+                            "skipping it\n", itemName.c_str());
+            return false;
+        }
+    }
+
+    // Now we have a <dictitem></dictitem> tag. Decode it and
+    // store the resulting values.
+    if (mRegistry == NULL) {
+        return false;
+    }
+
+    itemPtr = mRegistry->createDictItem(dataType);
+    if (itemPtr == NULL) {
+        fprintf(stderr, "WARNING: No DictItem found for type %s\n",
+                                                dataType.c_str());
+        return false;
     }
+    if (!itemPtr->unserialize(doc, itemNode)) {
+        if (!mRegistry->deleteDictItem(itemPtr)) {
+            delete itemPtr;
+        }
+        return false;
+    } 
+
+    // We made it, so it's ours to free once no table holds it.
+    adopt(DictKey(itemName), itemPtr);
 
     return true;
 }
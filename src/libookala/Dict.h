@@ -28,15 +28,69 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <atomic>
 
 #include <libxml/xmlmemory.h>
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 
 #include "Types.h"
 #include "Plugin.h"
 
 namespace Ookala {
 
+class RwLock;
+class DictItem;
+class PackReader;
+
+//
+// Interned dictionary key. Building a DictKey from a string looks
+// the string up in a process-wide table once; after that, comparing
+// and hashing keys is a single integer operation. The string form
+// can always be recovered with str().
+//
+// Code that looks up the same keys over and over (periodic chains,
+// for example) should build its keys once and hang onto them:
+//
+//     static const DictKey fileNamesKey("DataSavior::fileNames");
+//
+//     StringArrayDictItem *files = 
+//                  dict->get<StringArrayDictItem>(fileNamesKey);
+//
+// The default constructed key is invalid, and never matches anything.
+//
+// Looking up a name that's already in the table doesn't take any
+// locks. Names are never removed, so code that only looks things up
+// by string should use find(), which doesn't add them.
+//
+class EXIMPORT DictKey
+{
+    public:
+        DictKey();
+        explicit DictKey(const std::string &name);
+        explicit DictKey(const char *name);
+
+        // The key for name, if a DictKey has been built from it 
+        // before, or the invalid key if not. Nothing can have been
+        // stored under a name that was never made into a key, so an
+        // invalid key here just means the lookup will come up empty.
+        static DictKey find(const std::string &name);
+
+        uint32_t           id()    const { return mId; }
+        bool               valid() const { return mId != 0; }
+
+        const std::string &str()   const;
+
+        bool operator==(const DictKey &rhs) const { return mId == rhs.mId; }
+        bool operator!=(const DictKey &rhs) const { return mId != rhs.mId; }
+
+    private:
+        friend class Dict;
+
+        uint32_t mId;
+};
+
+
 class EXIMPORT DictItem
 {
     public:
@@ -50,9 +104,20 @@ class EXIMPORT DictItem
         DictItem & operator=(const DictItem &src);
         
         virtual const std::string itemType() const;
+
+        // The interned form of itemType(). This is what Dict::get<T>()
+        // compares against T::typeKey() instead of doing a 
+        // dynamic_cast<>.
+        const DictKey &itemTypeKey() const;
         
         virtual bool serializable() { return mIsSerializable; }
 
+        // Return a new copy of this item, or NULL if the type can't
+        // be copied. Dict uses this to give each copy of itself its 
+        // own version of an item once one side modifies it. Derived 
+        // classes normally just return new Foo(*this).
+        virtual DictItem *clone() const;
+
         // root points to the place whose child should be a 
         // <dictitem></dictitem> tag.
         virtual bool serialize(xmlDocPtr doc, xmlNodePtr root);
@@ -61,6 +126,13 @@ class EXIMPORT DictItem
         // This may return false if we don't find a name.
         virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
 
+        // Binary forms of serialize() and unserialize(), for caches
+        // that nobody needs to read. Append the value to buf, or 
+        // read it back from reader. The defaults return false, in
+        // which case the item is cached as xml instead.
+        virtual bool serializeBinary(std::string &buf);
+        virtual bool unserializeBinary(PackReader &reader);
+
         // NOTE: Derived classes should implement get and set methods, 
         //        to access their particulars. Unfortunaly, we can't 
         //        force them to do so with pure-virtuals, because we
@@ -72,6 +144,7 @@ class EXIMPORT DictItem
         bool        mIsSerializable;
 
         void        setItemType(const std::string &type);        
+        void        setItemType(const DictKey &type);
 
         // root should be pointing to a <dictitem></dictitem> element.
         // (but this isn't enforced)
@@ -88,9 +161,68 @@ class EXIMPORT DictItem
                                    std::vector<std::string> &tags,
                                    std::vector<std::string> &contents);
 
+        // Write numeric arrays under root. Short arrays get one 
+        // <value></value> per element, so they stay easy to read and
+        // edit. Longer ones are written as a single
+        //
+        //    <packed encoding="base64" count="N">...</packed>
+        //
+        // holding the little-endian bytes of each value, which
+        // round-trips exactly and is much quicker to parse.
+        static void serializeArray(xmlNodePtr root, 
+                                   const int32_t *values, size_t count);
+        static void serializeArray(xmlNodePtr root, 
+                                   const double *values, size_t count);
+
+        // Like serializeArray(), but long arrays are written as
+        //
+        //    <packed encoding="delta-varint" count="N" stride="S">
+        //
+        // where each value is stored as a varint relative to the one
+        // stride places before it. Smooth data like luts, or a series
+        // of measurements interleaved S components at a time, packs
+        // much smaller this way.
+        static void serializeDeltaArray(xmlNodePtr root, 
+                                        const int32_t *values, size_t count,
+                                        size_t stride = 1);
+        static void serializeDeltaArray(xmlNodePtr root, 
+                                        const double *values, size_t count,
+                                        size_t stride = 1);
+
+        // Read back any form written by serializeArray() or
+        // serializeDeltaArray(). Returns false if a packed node 
+        // is malformed.
+        static bool unserializeArray(xmlDocPtr doc, xmlNodePtr root,
+                                     std::vector<int32_t> &values);
+        static bool unserializeArray(xmlDocPtr doc, xmlNodePtr root,
+                                     std::vector<double> &values);
+
+        // Write a fixed number of doubles as the text of root,
+        // separated by spaces, e.g. "80 0.3127 0.329".
+        static void serializeValues(xmlNodePtr root, 
+                                    const double *values, size_t count);
+
+        // Read back exactly count values written by serializeValues(),
+        // or by serializeArray(). Returns false if there are more or 
+        // fewer than that.
+        static bool unserializeValues(xmlDocPtr doc, xmlNodePtr root,
+                                      double *values, size_t count);
+
     private:
+        friend class Dict;
+
         struct _DictItem {
-            std::string mItemType;
+            std::string           mItemType;
+            DictKey               mItemTypeKey;
+
+            // Number of Dict tables holding this item, and whether
+            // one of them made it with clone() and so should free it.
+            std::atomic<uint32_t> mTableRefs;
+            bool                  mDictOwned;
+
+            // Set once the non-const Dict::get() has handed us out,
+            // so someone may still change us through that pointer.
+            std::atomic<bool>     mEscaped;
         };
 
         _DictItem *mDictItemData;
@@ -107,11 +239,16 @@ class EXIMPORT BoolDictItem: public DictItem
         BoolDictItem(const BoolDictItem &src);
         BoolDictItem & operator=(const BoolDictItem &src);
 
+        static const DictKey &typeKey();
+        virtual DictItem *clone() const;
+
         virtual bool serialize(xmlDocPtr doc, xmlNodePtr root);
         virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
+        virtual bool serializeBinary(std::string &buf);
+        virtual bool unserializeBinary(PackReader &reader);
 
         void set(const bool value);
-        bool get();
+        bool get() const;
 
         virtual void debug();
 
@@ -129,11 +266,16 @@ class EXIMPORT IntDictItem: public DictItem
         IntDictItem(const IntDictItem &src);
         IntDictItem & operator=(const IntDictItem &src);
 
+        static const DictKey &typeKey();
+        virtual DictItem *clone() const;
+
         virtual bool serialize(xmlDocPtr doc, xmlNodePtr root);
         virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
+        virtual bool serializeBinary(std::string &buf);
+        virtual bool unserializeBinary(PackReader &reader);
 
         void set(const int32_t value);
-        int32_t get();
+        int32_t get() const;
 
         virtual void debug();
 
@@ -151,11 +293,16 @@ class EXIMPORT DoubleDictItem: public DictItem
         DoubleDictItem(const DoubleDictItem &src);
         DoubleDictItem & operator=(const DoubleDictItem &src);
 
+        static const DictKey &typeKey();
+        virtual DictItem *clone() const;
+
         virtual bool serialize(xmlDocPtr doc, xmlNodePtr root);
         virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
+        virtual bool serializeBinary(std::string &buf);
+        virtual bool unserializeBinary(PackReader &reader);
 
         void set(const double value);
-        double get();
+        double get() const;
 
         virtual void debug();
 
@@ -174,11 +321,16 @@ class EXIMPORT StringDictItem: public DictItem
         virtual ~StringDictItem();
         StringDictItem & operator=(const StringDictItem &src);
 
+        static const DictKey &typeKey();
+        virtual DictItem *clone() const;
+
         virtual bool serialize(xmlDocPtr doc, xmlNodePtr root);
         virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
+        virtual bool serializeBinary(std::string &buf);
+        virtual bool unserializeBinary(PackReader &reader);
 
         void set(const std::string value);
-        std::string get();
+        std::string get() const;
 
         virtual void debug();
 
@@ -200,6 +352,9 @@ class EXIMPORT BlobDictItem: public DictItem
         BlobDictItem(const BlobDictItem &src);
         BlobDictItem & operator=(const BlobDictItem &src);
 
+        static const DictKey &typeKey();
+        virtual DictItem *clone() const;
+
         virtual bool serialize(xmlDocPtr doc, xmlNodePtr root);
         virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
 
@@ -224,13 +379,23 @@ class EXIMPORT IntArrayDictItem: public DictItem
         IntArrayDictItem(const IntArrayDictItem &src);
         virtual ~IntArrayDictItem(); 
         IntArrayDictItem & operator=(const IntArrayDictItem &src);
+
+        static const DictKey &typeKey();
+        virtual DictItem *clone() const;
         
         virtual bool serialize(xmlDocPtr doc, xmlNodePtr root); 
         virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);       
+        virtual bool serializeBinary(std::string &buf);
+        virtual bool unserializeBinary(PackReader &reader);
 
-        void set(const std::vector<int32_t> value);
+        // Copy the value in, or with an rvalue, take ownership
+        // of its storage without copying.
+        void set(const std::vector<int32_t> &value);
+        void set(std::vector<int32_t> &&value);
         
-        std::vector<int32_t> get();
+        // Read-only view of the stored values. The reference is
+        // good until the item is set() again or destroyed.
+        const std::vector<int32_t> &get() const;
 
         virtual void debug();       
 
@@ -252,14 +417,20 @@ class EXIMPORT DoubleArrayDictItem: public DictItem
         DoubleArrayDictItem(const DoubleArrayDictItem &src);
         virtual ~DoubleArrayDictItem();
         DoubleArrayDictItem & operator=(const DoubleArrayDictItem &src);
+
+        static const DictKey &typeKey();
+        virtual DictItem *clone() const;
     
         virtual bool serialize(xmlDocPtr doc, xmlNodePtr root);
         
         virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
+        virtual bool serializeBinary(std::string &buf);
+        virtual bool unserializeBinary(PackReader &reader);
         
-        void set(const std::vector<double> value);
+        void set(const std::vector<double> &value);
+        void set(std::vector<double> &&value);
         
-        std::vector<double> get();
+        const std::vector<double> &get() const;
         
         virtual void debug();
 
@@ -282,13 +453,19 @@ class EXIMPORT StringArrayDictItem: public DictItem
         StringArrayDictItem(const StringArrayDictItem &src);    
         virtual ~StringArrayDictItem();
         StringArrayDictItem & operator=(const StringArrayDictItem &src);
+
+        static const DictKey &typeKey();
+        virtual DictItem *clone() const;
         
         virtual bool serialize(xmlDocPtr doc, xmlNodePtr root); 
         virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
+        virtual bool serializeBinary(std::string &buf);
+        virtual bool unserializeBinary(PackReader &reader);
         
-        void set(const std::vector<std::string> value);
+        void set(const std::vector<std::string> &value);
+        void set(std::vector<std::string> &&value);
         
-        std::vector<std::string> get();
+        const std::vector<std::string> &get() const;
         
         virtual void debug();
         
@@ -301,6 +478,88 @@ class EXIMPORT StringArrayDictItem: public DictItem
 };
 
 
+//
+// Fixed size color values. Unlike a DoubleArrayDictItem, these 
+// hold their values inline, and they're written out on one line:
+//
+//     <dictitem type="Yxy" name="target white">80 0.3127 0.329</dictitem>
+//
+class EXIMPORT YxyDictItem: public DictItem
+{
+    public:
+        YxyDictItem();
+        YxyDictItem(const YxyDictItem &src);
+        YxyDictItem & operator=(const YxyDictItem &src);
+
+        static const DictKey &typeKey();
+        virtual DictItem *clone() const;
+
+        virtual bool serialize(xmlDocPtr doc, xmlNodePtr root);
+        virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
+        virtual bool serializeBinary(std::string &buf);
+        virtual bool unserializeBinary(PackReader &reader);
+
+        void set(const Yxy &value);
+        Yxy  get() const;
+
+        virtual void debug();
+
+    protected:
+        Yxy mValue;
+};
+
+class EXIMPORT RgbDictItem: public DictItem
+{
+    public:
+        RgbDictItem();
+        RgbDictItem(const RgbDictItem &src);
+        RgbDictItem & operator=(const RgbDictItem &src);
+
+        static const DictKey &typeKey();
+        virtual DictItem *clone() const;
+
+        virtual bool serialize(xmlDocPtr doc, xmlNodePtr root);
+        virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
+        virtual bool serializeBinary(std::string &buf);
+        virtual bool unserializeBinary(PackReader &reader);
+
+        void set(const Rgb &value);
+        Rgb  get() const;
+
+        virtual void debug();
+
+    protected:
+        Rgb mValue;
+};
+
+//
+// 3x3 matrix, written in row order.
+//
+class EXIMPORT Mat33DictItem: public DictItem
+{
+    public:
+        Mat33DictItem();
+        Mat33DictItem(const Mat33DictItem &src);
+        Mat33DictItem & operator=(const Mat33DictItem &src);
+
+        static const DictKey &typeKey();
+        virtual DictItem *clone() const;
+
+        virtual bool serialize(xmlDocPtr doc, xmlNodePtr root);
+        virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
+        virtual bool serializeBinary(std::string &buf);
+        virtual bool unserializeBinary(PackReader &reader);
+
+        void  set(const Mat33 &value);
+        Mat33 get() const;
+
+        virtual void debug();
+
+    protected:
+        Mat33 mValue;
+};
+
+
 //
 // Given a type, figure out what sort of dictionary item to alloc
 //
@@ -323,11 +582,92 @@ class EXIMPORT Dict
         std::string getName();
         
         void        setRegistry(PluginRegistry *registry);
+
+        // Dicts are safe to use from several threads at once. Each
+        // one has a reader/writer lock, so lookups don't block each 
+        // other; only changes to the table do. get() doesn't even 
+        // take the lock unless it has to, or a change is under way;
+        // see mSeq below. Note that the lock
+        // covers the table, not the items in it. Changing an item 
+        // through a pointer from get() while another thread reads it
+        // is still a race - use the typed set() and getValue() for 
+        // values that are shared between threads.
+        //
+        // Every change made through the Dict bumps its version, so
+        // pollers can cheaply tell if anything happened since they
+        // last looked. Copies start out with the version of their 
+        // source. Versions are drawn from one process-wide counter,
+        // so a Dict created after a version was handed out starts 
+        // out newer than it.
+        uint64_t    getVersion() const;
+
+        // The version at which key was last set, or 0 if we don't
+        // have it.
+        uint64_t    getVersion(const DictKey &key) const;
+
+        // Has anything matching pattern been set or removed since
+        // version? pattern is either a key, or a prefix ending in '*'
+        // such as "CalibChecker::*". A periodic consumer hangs onto 
+        // getVersion() from when it last did its work, and skips the
+        // work if nothing it reads has changed since:
+        //
+        //     if (!dict->changedSince(mVersion, "CalibChecker::*")) {
+        //         return true;
+        //     }
+        //     mVersion = dict->getVersion();
+        //     ...
+        //
+        // Only changes made through the Dict are noticed. If you edit
+        // an item in place through get(), set() it again to flag it.
+        // Removed keys aren't remembered one by one, so after any 
+        // remove() or clear(), every prefix and every missing key 
+        // reports a change once.
+        bool        changedSince(uint64_t version, 
+                                 const std::string &pattern) const;
+
+        // True if any of the patterns have changed.
+        bool        changedSince(uint64_t version,
+                                 const std::vector<std::string> &patterns) const;
+
+        // The keys set since version, in no particular order. removed
+        // is set if anything has been removed since then too.
+        std::vector<DictKey> getChangedKeys(uint64_t version, 
+                                            bool    &removed) const;
+
+        // If escaped is set, also list every key whose item has gone
+        // out through the non-const get() since it was set, since it
+        // may have been changed in place. Savers that only write what
+        // changed use this, so they see the same edits a full save
+        // would.
+        std::vector<DictKey> getChangedKeys(uint64_t version, 
+                                            bool    &removed,
+                                            bool     escaped) const;
         
         // Store a value with a key. The data stored should be
         // allocated dynamically, so it can stay around. Note, 
         // you'll have to free it yourself, sorry.
+        //
+        // Copying a Dict is cheap: the copies share their items until
+        // one of them changes. set(), remove(), and the non-const 
+        // get() give the Dict its own table first, and get() also
+        // clone()s an item that another copy still holds. So a copy
+        // taken as a snapshot keeps its values while the original
+        // carries on being modified. Items created by clone() belong
+        // to the Dict and are freed with it.
+        //
+        // Whoever got an item from the non-const get() may go on 
+        // changing it, so copies made after that get their own clone
+        // of it rather than sharing it. Items whose type has no
+        // clone() can't be kept apart like this; they're shared, 
+        // with a warning on stderr.
         bool        set(const std::string &key, DictItem *value);
+        bool        set(const DictKey     &key, DictItem *value);
+
+        // Like set(), but value is handed over to the Dict and freed
+        // once no table holds it, like a clone. value should come 
+        // from new or PluginRegistry::createDictItem(). If it can't
+        // be stored, it's freed straight away.
+        bool        adopt(const DictKey &key, DictItem *value);
         
 
         // Return the value stored with the given key. Returns
@@ -335,11 +675,109 @@ class EXIMPORT Dict
         bool        get(const std::string &key, DictItem **value);
         
         // Similar, but returns NULL if we don't find anything.
+        // The item may be changed through the pointer; see above
+        // for what that costs later copies.
         DictItem *  get(const std::string &key);
+        DictItem *  get(const DictKey     &key);
+
+        // Read-only lookup; never unshares or clones anything, so
+        // prefer this when you're just looking.
+        const DictItem *get(const std::string &key) const;
+        const DictItem *get(const DictKey     &key) const;
+
+        // Typed lookup. Returns NULL if the key isn't found, or if
+        // the item stored there isn't a T. The type is checked by 
+        // comparing the item's interned type against T::typeKey(), 
+        // so the common case doesn't pay for a dynamic_cast<>. We
+        // only fall back to dynamic_cast<> for items derived from T.
+        template <class T>
+        T *         get(const DictKey &key) {
+            return castItem<T>(get(key));
+        }
+
+        template <class T>
+        T *         get(const std::string &key) {
+            return castItem<T>(get(key));
+        }
+
+        template <class T>
+        const T *   get(const DictKey &key) const {
+            return castItem<T>(const_cast<DictItem *>(get(key)));
+        }
+
+        template <class T>
+        const T *   get(const std::string &key) const {
+            return castItem<T>(const_cast<DictItem *>(get(key)));
+        }
+
+        // Typed store. If a T is already stored under key, update it
+        // in place with T::set(value). Otherwise, allocate a new T,
+        // set() it, and store it under key. Returns the item that
+        // holds the value, or NULL if it couldn't be stored.
+        //
+        // An item allocated here belongs to the dict, and is freed 
+        // once no table holds it, like those made by clone(). The 
+        // returned pointer is borrowed and read-only: don't delete 
+        // it, don't hang on to it past the next set() or remove() 
+        // of key, and call set() again to change the value.
+        template <class T, class V>
+        const T *   set(const DictKey &key, const V &value) {
+            T *item;
+
+            writeLock();
+
+            item = castItem<T>(getLocked(key, false));
+            if (!item) {
+                item = new T;
+                item->mDictItemData->mDictOwned = true;
+                if (!setLocked(key, static_cast<DictItem *>(item))) {
+                    writeUnlock();
+
+                    delete item;
+                    return NULL;
+                }
+            }
+            item->set(value);
+            bumpVersion(key);
+
+            writeUnlock();
+
+            return item;
+        }
+
+        template <class T, class V>
+        const T *   set(const std::string &key, const V &value) {
+            return set<T, V>(DictKey(key), value);
+        }
+
+        // Typed read of a value, copied out while holding the lock, 
+        // so it's safe against a concurrent set<T>(). Returns false 
+        // if the key isn't found, or isn't a T.
+        template <class T, class V>
+        bool        getValue(const DictKey &key, V &value) const {
+            const T *item;
+
+            readLock();
+
+            item = castItem<T>(const_cast<DictItem *>(findItem(key)));
+            if (item) {
+                value = item->get();
+            }
+
+            readUnlock();
+
+            return item != NULL;
+        }
+
+        template <class T, class V>
+        bool        getValue(const std::string &key, V &value) const {
+            return getValue<T, V>(DictKey::find(key), value);
+        }
         
         // Remove a certain key from the dictionary. Returns
         // false if we didn't find the key.
         bool        remove(const std::string &key);
+        bool        remove(const DictKey     &key);
         
         // Remove everything from the dictionary.
         bool        clear();
@@ -374,6 +812,14 @@ class EXIMPORT Dict
         //
         // The parent parameter should be where we insert our children.
         bool serialize(xmlDocPtr doc, xmlNodePtr parent);
+
+        // Write a single item as a <dictitem> child of parent, just as
+        // serialize() does for each of ours. Returns the new node.
+        // Its crc attribute is a checksum of everything else in it.
+        static xmlNodePtr serializeItem(xmlDocPtr          doc, 
+                                        xmlNodePtr         parent,
+                                        const std::string &key,
+                                        DictItem          *item);
         
         //  xmlDocPtr doc = xmlParseFile(filename.c_str());
         //  if (doc == NULL) {
@@ -400,19 +846,157 @@ class EXIMPORT Dict
         // When unserializing, Assume that root is pointing to a <dict>
         // node and unserialize that.
         bool unserialize(xmlDocPtr doc, xmlNodePtr root);
+
+        // Streaming version of the above, for large files where we 
+        // don't want to build the whole tree first. reader should be
+        // sitting on a <dict> start element. Each <dictitem> is 
+        // expanded and handed to its DictItem on its own, so memory 
+        // use is bounded by the largest item rather than the file.
+        //
+        // On return, reader is left on the matching </dict> (or on 
+        // the <dict/> if it was empty), so the caller can keep 
+        // calling xmlTextReaderRead() from there.
+        bool unserialize(xmlTextReaderPtr reader);
         
 
     protected:
         PluginRegistry  *mRegistry;
 
+        // Create and unserialize the item for one <dictitem> node, 
+        // storing it on success. Items that don't match their crc
+        // are left out. Stored items belong to the Dict.
+        bool unserializeItem(xmlDocPtr doc, xmlNodePtr itemNode);
+
+        template <class T>
+        static T *  castItem(DictItem *item) {
+            if (!item) return NULL;
+
+            if (item->itemTypeKey() == T::typeKey()) {
+                return static_cast<T *>(item);
+            }
+            return dynamic_cast<T *>(item);
+        }
+
     private:
+
+        // Items live in a flat, open-addressed table indexed by 
+        // DictKey::id(), with linear probing. The table size is
+        // always a power of two. 
+        //
+        // get() reads mKey, mFlags and mItem without the lock, so 
+        // they're atomic. Everything else is only touched with the 
+        // lock held.
+        struct _DictSlot {
+            std::atomic<uint32_t>   mKey;
+
+            // _DICT_SLOT_ESCAPED once mItem has been handed out by
+            // the non-const get(), so it can skip the write lock.
+            std::atomic<uint32_t>   mFlags;
+            std::atomic<DictItem *> mItem;
+
+            // Our version when this key was last set
+            uint64_t                mVersion;
+        };
+
+        // A slot array keeps its size for life, so a reader that
+        // picks one up can't run off the end of it, even if it's 
+        // been recycled in the meantime.
+        struct _DictSlots {
+            uint32_t                mSize;
+            _DictSlot              *mSlot;
+        };
+
+        // Shared between copies of the Dict; see detach().
         struct _Dict {
-            std::map<std::string, DictItem *>  mItems;   
+            std::atomic<_DictSlots *>          mSlots;   
+            uint32_t                           mCount;
+            uint32_t                           mTombstones;
 
             std::string                        mName;            
+
+            std::atomic<uint32_t>              mRefCount;
+            uint64_t                           mVersion;
+
+            // Our version as of the last remove() or clear()
+            uint64_t                           mRemoveVersion;
         };
 
+        // Tables and slot arrays that are no longer used go back
+        // to a pool, rather than to the heap; see pool().
+        struct _DictPool;
+
         _Dict           *mDictData;
+        RwLock          *mLock;
+
+        // get() looks things up without the lock, seqlock style. The 
+        // write lock makes mSeq odd while it's held, and even again 
+        // when it's dropped. A reader that sees the same even value 
+        // before and after its lookup knows no change got in the way;
+        // otherwise it takes the lock instead. Readers go through 
+        // mReadData, which always matches mDictData.
+        std::atomic<uint32_t>  mSeq;
+        std::atomic<_Dict *>   mReadData;
+
+        void        readLock() const;
+        void        readUnlock() const;
+        void        writeLock();
+        void        writeUnlock();
+
+        // Lock-free lookup. Sets item to what's stored under keyId,
+        // and mine if the non-const get() can hand it straight out. 
+        // Returns false if a change got in the way, in which case 
+        // the caller should take the lock and look again.
+        bool        peekItem(uint32_t keyId, DictItem **item, 
+                             bool *mine) const;
+
+        // The rest of these expect the caller to hold the lock. 
+        const DictItem *findItem(const DictKey &key) const;
+
+        // Lookup for an item the caller may change. escape is set
+        // if the item is going to be handed out to the caller.
+        DictItem   *getLocked(const DictKey &key, bool escape);
+        bool        setLocked(const DictKey &key, DictItem *value);
+        void        bumpVersion();
+        void        bumpVersion(const DictKey &key);
+        bool        changedLocked(uint64_t version, 
+                                  const std::string &pattern) const;
+
+        int32_t     findSlot(uint32_t keyId) const;
+        void        growSlots();
+
+        _DictSlot  &slotAt(int32_t idx) const {
+            return mDictData->mSlots.load(
+                            std::memory_order_relaxed)->mSlot[idx];
+        }
+
+        // Give this Dict a private copy of the table before changing
+        // it, if it's shared with other copies.
+        void        detach();
+
+        // Switch to a different table.
+        void        setData(_Dict *data);
+
+        // Drop a reference to data, and its items, recycling it if we
+        // were the last.
+        void        releaseData(_Dict *data);
+        static _Dict *newData();
+
+        static _DictPool  &pool();
+        static _DictSlots *newSlots(uint32_t size);
+        static void        freeSlots(_DictSlots *slots);
+        static void        copySlots(_DictSlots *dst, const _DictSlots *src);
+
+        // The table for a new copy of us: ours, unless some items in
+        // it have escaped through get(), in which case the copy gets
+        // its own table with clones of them.
+        _Dict      *shareData() const;
+
+        static void retainItem(DictItem *item);
+        void        releaseItem(DictItem *item);
+
+        // All the keys we hold, sorted by name, so serialization
+        // and debug output keep a stable order.
+        std::vector<DictKey> sortedKeys() const;
 };
 
 }; // namespace Ookala
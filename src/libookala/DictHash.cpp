@@ -49,6 +49,7 @@ Ookala::DictHash::DictHash():
     Plugin()
 {        
     setName("DictHash");
+    declareNoDependencies();
 
     mDictHashData = new _DictHash();
 }
@@ -61,7 +62,7 @@ Ookala::DictHash::DictHash(const DictHash &src):
     mDictHashData = new _DictHash();
 
     if (src.mDictHashData) {
-        mDictHashData->mDictData = src.mDictHashData->mDictData;
+        copyDicts(*src.mDictHashData);
     }
 }
 
@@ -70,6 +71,8 @@ Ookala::DictHash::DictHash(const DictHash &src):
 Ookala::DictHash::~DictHash()
 {
     if (mDictHashData) {
+        freeDicts();
+
         delete mDictHashData;
         mDictHashData = NULL;
     }
@@ -84,13 +87,16 @@ Ookala::DictHash::operator=(const DictHash &src)
         Plugin::operator=(src);
 
         if (mDictHashData) {
+            freeDicts();
+
             delete mDictHashData;
             mDictHashData = NULL;
         }
 
         if (src.mDictHashData) {
             mDictHashData  = new _DictHash();
-            *mDictHashData = *(src.mDictHashData);
+
+            copyDicts(*src.mDictHashData);
         }
     }
 
@@ -104,6 +110,9 @@ Ookala::Dict *
 Ookala::DictHash::newDict(std::string key)
 {
     Dict *oldDict;
+    Dict *theNewDict;
+
+    std::pair<std::map<std::string, Dict *>::iterator, bool> inserted;
 
     if (!mDictHashData) return NULL;
 
@@ -114,30 +123,55 @@ Ookala::DictHash::newDict(std::string key)
         return oldDict;
     }
 
-    Dict theNewDict(mRegistry);
+    theNewDict = new Dict(mRegistry);
+    theNewDict->setName(key);
+
+    // Someone may have beaten us to it since we looked. If so, 
+    // leave theirs alone, which is what we want anyway.
+    mDictHashData->mLock.writeLock();
         
-    mDictHashData->mDictData.insert( std::pair< std::string, Dict >(key, theNewDict))  ;
+    inserted = mDictHashData->mDictData.insert( 
+                std::pair< std::string, Dict * >(key, theNewDict));
+
+    oldDict = (*inserted.first).second;
 
-    theNewDict.setName(key);
+    mDictHashData->mLock.writeUnlock();
 
-    return getDict(key);
+    if (!inserted.second) {
+        delete theNewDict;
+    }
+
+    return oldDict;
 }
 
 // --------------------------------------
 //
+// The Dict is emptied, but not freed, so that anyone still holding
+// it from getDict() doesn't touch freed memory. It stays in 
+// mCleared until we go away.
 bool
 Ookala::DictHash::clearDict(std::string key)
 {
-    std::map<std::string, Dict>::iterator theIter;
+    std::map<std::string, Dict *>::iterator theIter;
+    Dict                                   *dict;
 
     if (!mDictHashData) return false;
 
+    mDictHashData->mLock.writeLock();
+
     theIter = mDictHashData->mDictData.find(key);
     if (theIter == mDictHashData->mDictData.end()) {
+        mDictHashData->mLock.writeUnlock();
         return false;
     }
     
+    dict = (*theIter).second;
     mDictHashData->mDictData.erase(theIter);
+    mDictHashData->mCleared.push_back(dict);
+
+    mDictHashData->mLock.writeUnlock();
+
+    dict->clear();
 
     return true;
 }
@@ -147,18 +181,47 @@ Ookala::DictHash::clearDict(std::string key)
 Ookala::Dict *
 Ookala::DictHash::getDict(std::string key)
 {
-    std::map<std::string, Dict>::iterator theIter;
+    std::map<std::string, Dict *>::iterator theIter;
+    Dict                                   *dict = NULL;
 
     if (!mDictHashData) return NULL;
 
+    mDictHashData->mLock.readLock();
+
     theIter = mDictHashData->mDictData.find(key);
-    if (theIter == mDictHashData->mDictData.end()) {
-        return NULL;
+    if (theIter != mDictHashData->mDictData.end()) {
+        dict = (*theIter).second;
+        dict->setName(key);
     }
 
-    (*theIter).second.setName(key);
+    mDictHashData->mLock.readUnlock();
 
-    return &((*theIter).second);
+    return dict;
+}
+
+// --------------------------------------
+//
+bool
+Ookala::DictHash::getDictSnapshot(std::string key, Dict &snapshot)
+{
+    std::map<std::string, Dict *>::iterator theIter;
+    bool                                    found = false;
+
+    if (!mDictHashData) return false;
+
+    // Hold the map lock while we copy, so the dict can't be 
+    // cleared out from under us.
+    mDictHashData->mLock.readLock();
+
+    theIter = mDictHashData->mDictData.find(key);
+    if (theIter != mDictHashData->mDictData.end()) {
+        snapshot = *((*theIter).second);
+        found    = true;
+    }
+
+    mDictHashData->mLock.readUnlock();
+
+    return found;
 }
 
 // --------------------------------------
@@ -170,15 +233,58 @@ Ookala::DictHash::getDictNames()
 
     if (!mDictHashData) return names;
 
-    for (std::map<std::string, Dict>::iterator theIter = 
+    mDictHashData->mLock.readLock();
+
+    for (std::map<std::string, Dict *>::iterator theIter = 
                        mDictHashData->mDictData.begin();
             theIter != mDictHashData->mDictData.end(); ++theIter) {
         names.push_back( (*theIter).first );
     }
 
+    mDictHashData->mLock.readUnlock();
+
     return names;
 }
 
+// --------------------------------------
+//
+// private
+void
+Ookala::DictHash::copyDicts(_DictHash &src)
+{
+    src.mLock.readLock();
+
+    for (std::map<std::string, Dict *>::iterator theIter = 
+                       src.mDictData.begin();
+            theIter != src.mDictData.end(); ++theIter) {
+        mDictHashData->mDictData[(*theIter).first] = 
+                                        new Dict(*((*theIter).second));
+    }
+
+    src.mLock.readUnlock();
+}
+
+// --------------------------------------
+//
+// private
+void
+Ookala::DictHash::freeDicts()
+{
+    for (std::map<std::string, Dict *>::iterator theIter = 
+                       mDictHashData->mDictData.begin();
+            theIter != mDictHashData->mDictData.end(); ++theIter) {
+        delete (*theIter).second;
+    }
+    mDictHashData->mDictData.clear();
+
+    for (std::vector<Dict *>::iterator theDict = 
+                       mDictHashData->mCleared.begin();
+            theDict != mDictHashData->mCleared.end(); ++theDict) {
+        delete *theDict;
+    }
+    mDictHashData->mCleared.clear();
+}
+
 // --------------------------------------
 //
 // In the chain dict, we're going to look for:
@@ -195,6 +301,9 @@ Ookala::DictHash::_run(PluginChain *chain)
     StringDictItem      *stringItem      = NULL;
     StringArrayDictItem *stringArrayItem = NULL;
 
+    static const DictKey dictKey("DictHash::dict");
+    static const DictKey setKey("DictHash::set");
+
     std::vector<std::string> keysToSet;
 
     if (!mDictHashData) return false;
@@ -214,12 +323,7 @@ Ookala::DictHash::_run(PluginChain *chain)
     
     // Now, look for the dst dict - whose name is given by DictHash::dict
     // in the source dict.
-    item = srcDict->get("DictHash::dict");
-    if (!item) {
-        setErrorString("No destination dict specified for DictHash::_run().");
-        return false;
-    }
-    stringItem = dynamic_cast<StringDictItem *>(item);
+    stringItem = srcDict->get<StringDictItem>(dictKey);
     if (!stringItem) {
         setErrorString("No destination dict specified for DictHash::_run().");
         return false;
@@ -233,13 +337,12 @@ Ookala::DictHash::_run(PluginChain *chain)
     // Get the string array item named "DictHash::set" in the source dict
     // It contains the keys of things in the source dict that should be
     // copied into the destiation dict.
-    item = srcDict->get("DictHash::set");
-    if (!item) {
+    if (!srcDict->get(setKey)) {
         setErrorString("Unable to get DictHash::set [String Array] for DictHash::_run().");
         return false;
     }
-    stringArrayItem = dynamic_cast<StringArrayDictItem *>(item);
-    if (!item) {
+    stringArrayItem = srcDict->get<StringArrayDictItem>(setKey);
+    if (!stringArrayItem) {
         setErrorString("DictHash::set is not of type [String Array] for DictHash::_run().");
         return false;
     }
@@ -32,6 +32,7 @@
 #include "Types.h"
 #include "Plugin.h"
 #include "Dict.h"
+#include "Mutex.h"
 
 // Setup one plugin type for storing all our dictionary data.
 // This is a little easier, and cleaner, to do as a builtin
@@ -73,15 +74,30 @@ class EXIMPORT DictHash: public Plugin
         // via overwriting.
         Dict * newDict(std::string key);
 
-        // Remove a dict from our storage.
+        // Remove a dict from our storage. Pointers to it from 
+        // getDict() stay valid, but it's emptied and is no longer
+        // the dict of that name; getDict() and newDict() will hand
+        // out a different one from now on.
         bool clearDict(std::string key);
 
         // Lookup a stored dict. Returns NULL if we don't have
         // anything stored by that name. You shouldn't hold
         // the ptr that is returned, but instead re-query
         // it every time you need to retrieve the reference.
+        //
+        // The Dict itself lives as long as we do, even across a
+        // clearDict(), but the items in it don't. Another thread 
+        // may clear it or remove() from it while you look, so from 
+        // a thread other than the chain's, read values with 
+        // getValue<T>(), or take a getDictSnapshot().
         Dict * getDict(std::string key);
 
+        // Take a copy of a stored dict that won't change under
+        // you. Copies share storage with the original until one 
+        // side is modified, so this is cheap even for big dicts.
+        // Returns false if nothing is stored by that name.
+        bool getDictSnapshot(std::string key, Dict &snapshot);
+
         // Return a vector of all the names of Dicts that we hold.
         std::vector<std::string> getDictNames();
 
@@ -108,11 +124,23 @@ class EXIMPORT DictHash: public Plugin
         virtual bool _run(PluginChain *chain);    
 
     private:
+        // The map and mCleared are guarded by mLock; each Dict has
+        // its own lock for its contents. Dicts that have been 
+        // cleared move to mCleared, and are freed with us, so a
+        // Dict * from getDict() never dangles.
         struct _DictHash {                        
-            std::map<std::string, Dict> mDictData;
+            std::map<std::string, Dict *> mDictData;
+            std::vector<Dict *>           mCleared;
+            RwLock                        mLock;
         };  
         
         _DictHash  *mDictHashData;
+
+        // Copy src's dicts into ours, which should be empty.
+        void copyDicts(_DictHash &src);
+
+        // Free all our dicts, including cleared ones.
+        void freeDicts();
 };
 
 }; // namespace Ookala
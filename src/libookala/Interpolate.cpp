@@ -39,6 +39,7 @@ Ookala::Interpolate::Interpolate():
     Plugin()
 {
     setName("Interpolate");
+    declareNoDependencies();
 }
 
 // ----------------------------
@@ -0,0 +1,2210 @@
+// --------------------------------------------------------------------------
+// $Id: Journal.cpp 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+#ifdef _WIN32
+#pragma warning(disable: 4786)
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#endif
+
+#include <set>
+#include <algorithm>
+
+#include <libxml/xmlmemory.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include "Types.h"
+#include "Dict.h"
+#include "DictHash.h"
+#include "DataSavior.h"
+#include "Journal.h"
+#include "CalibCatalog.h"
+#include "LutStore.h"
+#include "Pack.h"
+
+#define _JOURNAL_MAGIC             "OMCFJRNL"
+#define _JOURNAL_VERSION           2
+#define _JOURNAL_HEADER_SIZE       16
+
+#define _JOURNAL_FRAME_MAGIC       0x4d52464f    // "OFRM"
+#define _JOURNAL_FRAME_HEADER_SIZE 16
+
+#define _JOURNAL_TAIL_MAGIC        0x4c49544f    // "OTIL"
+#define _JOURNAL_TAIL_SIZE         16
+
+#define _JOURNAL_KIND_ITEM         1
+#define _JOURNAL_KIND_REMOVE       2
+#define _JOURNAL_KIND_INDEX        3
+#define _JOURNAL_KIND_LUT          4
+
+// Don't bother compacting files smaller than this
+#define _JOURNAL_COMPACT_MIN_SIZE  (1024*1024)
+
+// ===================================
+//
+// Helpers for the file format
+//
+// -----------------------------------
+
+namespace {
+
+// -----------------------------------
+
+std::string
+_journalFrame(uint8_t kind, const std::string &payload)
+{
+    std::string frame;
+    uint32_t    crc;
+
+    frame.reserve(_JOURNAL_FRAME_HEADER_SIZE + payload.size());
+
+    Ookala::packU32(frame, _JOURNAL_FRAME_MAGIC);
+    frame.push_back((char)kind);
+    frame.append(3, '\0');
+    Ookala::packU32(frame, (uint32_t)payload.size());
+
+    // Cover the kind and length too, so a damaged header can't
+    // send us off into the weeds.
+    crc = Ookala::packCrc(0,   frame.data()+4, 8);
+    crc = Ookala::packCrc(crc, payload.data(), payload.size());
+    Ookala::packU32(frame, crc);
+
+    frame.append(payload);
+
+    return frame;
+}
+
+// -----------------------------------
+//
+// Reads the frame header at ptr. Returns false if there isn't
+// a whole frame there, or it doesn't check out.
+
+bool
+_journalCheckFrame(const uint8_t *ptr, size_t left,
+                   uint8_t &kind, uint32_t &size, uint32_t &crc)
+{
+    if (left < _JOURNAL_FRAME_HEADER_SIZE) {
+        return false;
+    }
+
+    if (Ookala::unpackU32(ptr) != _JOURNAL_FRAME_MAGIC) {
+        return false;
+    }
+
+    kind = ptr[4];
+    size = Ookala::unpackU32(ptr+8);
+    crc  = Ookala::unpackU32(ptr+12);
+
+    if (left - _JOURNAL_FRAME_HEADER_SIZE < size) {
+        return false;
+    }
+
+    uint32_t check = Ookala::packCrc(0, ptr+4, 8);
+    check = Ookala::packCrc(check, ptr+_JOURNAL_FRAME_HEADER_SIZE, size);
+
+    return check == crc;
+}
+
+// -----------------------------------
+
+std::string
+_journalTail(uint64_t indexOffset)
+{
+    std::string tail;
+    std::string offset;
+
+    Ookala::packU64(offset, indexOffset);
+
+    Ookala::packU32(tail, _JOURNAL_TAIL_MAGIC);
+    tail.append(offset);
+    Ookala::packU32(tail, Ookala::packCrc(0, offset.data(), offset.size()));
+
+    return tail;
+}
+
+bool
+_journalCheckTail(const uint8_t *ptr, size_t left, uint64_t &indexOffset)
+{
+    if (left < _JOURNAL_TAIL_SIZE) {
+        return false;
+    }
+
+    if (Ookala::unpackU32(ptr) != _JOURNAL_TAIL_MAGIC) {
+        return false;
+    }
+
+    if (Ookala::packCrc(0, ptr+4, 8) != Ookala::unpackU32(ptr+12)) {
+        return false;
+    }
+
+    indexOffset = Ookala::unpackU64(ptr+4);
+
+    return true;
+}
+
+// -----------------------------------
+//
+// The first offset at or after pos where a good frame or tail
+// starts, or data.size() if there isn't one.
+
+uint64_t
+_journalResync(const std::vector<uint8_t> &data, uint64_t pos)
+{
+    uint8_t  kind;
+    uint32_t size, crc;
+    uint64_t indexOffset;
+
+    while (pos < data.size()) {
+        // Both magics start with an 'O'.
+        const uint8_t *ptr = (const uint8_t *)memchr(&data[pos], 'O', 
+                                                     data.size() - pos);
+        if (!ptr) {
+            break;
+        }
+        pos = (uint64_t)(ptr - &data[0]);
+
+        if ((_journalCheckTail(ptr, data.size() - pos, indexOffset)) ||
+                (_journalCheckFrame(ptr, data.size() - pos, 
+                                    kind, size, crc))) {
+            return pos;
+        }
+
+        ++pos;
+    }
+
+    return data.size();
+}
+
+// -----------------------------------
+//
+// Dump item as a lone <dictitem>, the same as Dict::serialize()
+// would write it. parent is a scratch node in doc.
+
+bool
+_journalItemXml(xmlDocPtr doc, xmlNodePtr parent, const std::string &key,
+                Ookala::DictItem *item, std::string &xml)
+{
+    xmlNodePtr   itemNode;
+    xmlBufferPtr buffer;
+
+    itemNode = Ookala::Dict::serializeItem(doc, parent, key, item);
+
+    buffer = xmlBufferCreate();
+    if (buffer != NULL) {
+        xmlNodeDump(buffer, doc, itemNode, 0, 0);
+        xml.assign((const char *)xmlBufferContent(buffer),
+                   (size_t)xmlBufferLength(buffer));
+        xmlBufferFree(buffer);
+    }
+
+    xmlUnlinkNode(itemNode);
+    xmlFreeNode(itemNode);
+
+    return buffer != NULL;
+}
+
+// -----------------------------------
+//
+// Read size bytes at offset. If size is 0, read to the end of
+// the file. A missing file reads as empty.
+
+bool
+_journalRead(const std::string &filename, uint64_t offset, uint64_t size,
+             std::vector<uint8_t> &data)
+{
+    FILE *fid;
+
+    data.clear();
+
+    fid = fopen(filename.c_str(), "rb");
+    if (!fid) {
+        return (errno == ENOENT);
+    }
+
+    if (size == 0) {
+        if (fseek(fid, 0, SEEK_END) != 0) {
+            fclose(fid);
+            return false;
+        }
+        long end = ftell(fid);
+        if ((end < 0) || ((uint64_t)end < offset)) {
+            fclose(fid);
+            return false;
+        }
+        size = (uint64_t)end - offset;
+    }
+
+    if (fseek(fid, (long)offset, SEEK_SET) != 0) {
+        fclose(fid);
+        return false;
+    }
+
+    data.resize(size);
+    if ((size) && (fread(&data[0], 1, size, fid) != size)) {
+        data.clear();
+        fclose(fid);
+        return false;
+    }
+
+    fclose(fid);
+
+    return true;
+}
+
+// -----------------------------------
+
+bool
+_journalSync(FILE *fid)
+{
+    if (fflush(fid) != 0) {
+        return false;
+    }
+
+#ifdef WIN32
+    return _commit(_fileno(fid)) == 0;
+#else
+    return fsync(fileno(fid)) == 0;
+#endif
+}
+
+// -----------------------------------
+
+uint64_t
+_journalFileSize(const std::string &filename)
+{
+#ifdef WIN32
+    struct _stat statbuf;
+    if (_stat(filename.c_str(), &statbuf) != 0) {
+#else
+    struct stat statbuf;
+    if (stat(filename.c_str(), &statbuf) != 0) {
+#endif
+        return 0;
+    }
+
+    return (uint64_t)statbuf.st_size;
+}
+
+// -----------------------------------
+//
+// The size of filename, and an id that changes when compaction 
+// renames a new file over it: its inode or file index, mixed with
+// the generation from its header, since a freed inode is soon 
+// handed out again. A missing file is 0 and 0.
+
+void
+_journalFileStamp(const std::string &filename, uint64_t &size, 
+                  uint64_t &id)
+{
+    uint8_t header[_JOURNAL_HEADER_SIZE];
+    bool    gotHeader = false;
+
+    size = 0;
+    id   = 0;
+
+#ifdef WIN32
+    BY_HANDLE_FILE_INFORMATION info;
+    HANDLE                     handle;
+    DWORD                      got;
+
+    handle = CreateFileA(filename.c_str(), GENERIC_READ, 
+                         FILE_SHARE_READ | FILE_SHARE_WRITE | 
+                                           FILE_SHARE_DELETE,
+                         NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    if (GetFileInformationByHandle(handle, &info)) {
+        size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+        id   = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+    }
+
+    gotHeader = (ReadFile(handle, header, sizeof(header), &got, NULL)) &&
+                (got == sizeof(header));
+
+    CloseHandle(handle);
+#else
+    struct stat statbuf;
+    int         fd;
+
+    fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    if (fstat(fd, &statbuf) == 0) {
+        size = (uint64_t)statbuf.st_size;
+        id   = (uint64_t)statbuf.st_ino;
+    }
+
+    gotHeader = (pread(fd, header, sizeof(header), 0) == 
+                                            (ssize_t)sizeof(header));
+
+    close(fd);
+#endif
+
+    if (gotHeader) {
+        id ^= (uint64_t)Ookala::unpackU32(header+12) << 32;
+    }
+}
+
+// -----------------------------------
+
+bool
+_journalTruncate(const std::string &filename, uint64_t size)
+{
+#ifdef WIN32
+    FILE *fid = fopen(filename.c_str(), "r+b");
+    if (!fid) {
+        return false;
+    }
+    bool ret = (_chsize(_fileno(fid), (long)size) == 0);
+    fclose(fid);
+    return ret;
+#else
+    return truncate(filename.c_str(), (off_t)size) == 0;
+#endif
+}
+
+// -----------------------------------
+
+bool
+_journalReplace(const std::string &src, const std::string &dst)
+{
+#ifdef WIN32
+    return MoveFileExA(src.c_str(), dst.c_str(),
+                       MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(src.c_str(), dst.c_str()) == 0;
+#endif
+}
+
+// -----------------------------------
+//
+// Keeps other processes, and other Journals on the same file, from
+// appending or compacting while we do. Compaction renames a new file
+// over the journal, so the lock is taken on a file of its own 
+// next to it.
+
+class _JournalFileLock
+{
+    public:
+        _JournalFileLock() {
+#ifdef WIN32
+            mHandle = INVALID_HANDLE_VALUE;
+#else
+            mFd = -1;
+#endif
+        }
+
+        ~_JournalFileLock() {
+            unlock();
+        }
+
+        // Wait until we have filename to ourselves.
+        bool lock(const std::string &filename) {
+            std::string lockName = filename + ".lock";
+
+#ifdef WIN32
+            OVERLAPPED overlapped;
+
+            mHandle = CreateFileA(lockName.c_str(), 
+                                  GENERIC_READ | GENERIC_WRITE,
+                                  FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                                    FILE_SHARE_DELETE,
+                                  NULL, OPEN_ALWAYS, 
+                                  FILE_ATTRIBUTE_NORMAL, NULL);
+            if (mHandle == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+
+            memset(&overlapped, 0, sizeof(overlapped));
+            if (!LockFileEx(mHandle, LOCKFILE_EXCLUSIVE_LOCK, 0, 
+                            1, 0, &overlapped)) {
+                CloseHandle(mHandle);
+                mHandle = INVALID_HANDLE_VALUE;
+                return false;
+            }
+#else
+            mFd = open(lockName.c_str(), O_RDWR | O_CREAT, 0666);
+            if (mFd < 0) {
+                return false;
+            }
+
+            while (flock(mFd, LOCK_EX) != 0) {
+                if (errno != EINTR) {
+                    close(mFd);
+                    mFd = -1;
+                    return false;
+                }
+            }
+#endif
+            return true;
+        }
+
+        void unlock() {
+#ifdef WIN32
+            if (mHandle != INVALID_HANDLE_VALUE) {
+                OVERLAPPED overlapped;
+
+                memset(&overlapped, 0, sizeof(overlapped));
+                UnlockFileEx(mHandle, 0, 1, 0, &overlapped);
+                CloseHandle(mHandle);
+                mHandle = INVALID_HANDLE_VALUE;
+            }
+#else
+            // Closing drops the lock.
+            if (mFd >= 0) {
+                close(mFd);
+                mFd = -1;
+            }
+#endif
+        }
+
+    private:
+#ifdef WIN32
+        HANDLE mHandle;
+#else
+        int    mFd;
+#endif
+
+        _JournalFileLock(const _JournalFileLock &src);
+        _JournalFileLock & operator=(const _JournalFileLock &src);
+};
+
+// -----------------------------------
+//
+// Pull the lut hashes off the end of a calibRecord item frame.
+
+void
+_journalItemLuts(const std::vector<uint8_t> &payload,
+                 std::vector<std::string>   &hashes)
+{
+    Ookala::PackReader reader(payload.empty()? NULL: &payload[0], 
+                              payload.size());
+    hashes.clear();
+
+    reader.str();
+    reader.str();
+    if (!reader.u8()) {
+        return;
+    }
+    reader.str();
+    reader.u32();
+    reader.u32();
+    reader.skip(reader.u32());
+
+    if (!reader.left()) {
+        return;
+    }
+    reader.str();
+    if (!reader.left()) {
+        return;
+    }
+
+    uint32_t count = reader.u32();
+    for (uint32_t idx=0; (idx<count) && (reader.ok()); ++idx) {
+        std::string hash = reader.str();
+
+        if (reader.ok()) {
+            hashes.push_back(hash);
+        }
+    }
+}
+
+// -----------------------------------
+//
+// Check the lut frame at ptr, and add its lut to store.
+
+bool
+_journalLoadLut(const uint8_t *ptr, size_t left, Ookala::LutStore &store)
+{
+    uint8_t  kind;
+    uint32_t size, crc;
+
+    if ((!_journalCheckFrame(ptr, left, kind, size, crc)) ||
+            (kind != _JOURNAL_KIND_LUT)) {
+        return false;
+    }
+
+    Ookala::PackReader reader(ptr + _JOURNAL_FRAME_HEADER_SIZE, size);
+
+    return store.unserializeBinary(reader);
+}
+
+// -----------------------------------
+//
+// Turn the payload of an item frame back into a calibRecord.
+
+bool
+_journalRecord(const std::vector<uint8_t> &payload, 
+               Ookala::CalibRecordDictItem &record)
+{
+    Ookala::PackReader reader(payload.empty()? NULL: &payload[0], 
+                              payload.size());
+    reader.str();
+    reader.str();
+    if (reader.u8()) {
+        reader.str();
+        reader.u32();
+        reader.u32();
+    }
+    std::string xml = reader.str();
+    if (!reader.ok()) {
+        return false;
+    }
+
+    xmlDocPtr doc = xmlReadMemory(xml.data(), (int)xml.size(),
+                                  NULL, NULL, 0);
+    if (doc == NULL) {
+        return false;
+    }
+
+    bool ret = record.unserialize(doc, xmlDocGetRootElement(doc));
+
+    xmlFreeDoc(doc);
+
+    return ret;
+}
+
+}; // namespace
+
+
+// ===================================
+//
+// Journal
+//
+// -----------------------------------
+//
+Ookala::Journal::Journal(const std::string &filename)
+{
+    mJournalData = new _Journal;
+    mJournalData->mFilename   = filename;
+    mJournalData->mScanned    = false;
+    mJournalData->mEnd        = 0;
+    mJournalData->mLiveBytes  = 0;
+    mJournalData->mFileId     = 0;
+    mJournalData->mVersion    = _JOURNAL_VERSION;
+    mJournalData->mDamaged    = false;
+    mJournalData->mCompacting = false;
+}
+
+// -----------------------------------
+//
+// virtual
+Ookala::Journal::~Journal()
+{
+    if (mJournalData) {
+        if (mJournalData->mCompactThread.joinable()) {
+            mJournalData->mCompactThread.join();
+        }
+
+        delete mJournalData;
+        mJournalData = NULL;
+    }
+}
+
+// -----------------------------------
+//
+// static
+bool
+Ookala::Journal::isJournal(const std::string &filename)
+{
+    std::vector<uint8_t> data;
+
+    if (!_journalRead(filename, 0, strlen(_JOURNAL_MAGIC), data)) {
+        return false;
+    }
+
+    if (data.size() != strlen(_JOURNAL_MAGIC)) {
+        return false;
+    }
+
+    return memcmp(&data[0], _JOURNAL_MAGIC, data.size()) == 0;
+}
+
+// -----------------------------------
+//
+std::string
+Ookala::Journal::getFilename()
+{
+    return mJournalData->mFilename;
+}
+
+// -----------------------------------
+//
+std::string
+Ookala::Journal::getErrorString()
+{
+    std::string err;
+
+    mJournalData->mMutex.lock();
+    err = mJournalData->mErrorString;
+    mJournalData->mMutex.unlock();
+
+    return err;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::Journal::append(const std::vector<Dict *> &dicts)
+{
+    std::string           buf;
+    std::set<std::string> names;
+    std::set<std::string> newLuts;
+    uint64_t              base;
+    xmlDocPtr             doc;
+    xmlNodePtr            scratch;
+    LutStore              luts;
+    LutStore             *prevLuts = NULL;
+    _JournalFileLock      fileLock;
+
+    // The file lock always comes before mMutex.
+    if (!fileLock.lock(mJournalData->mFilename)) {
+        mJournalData->mMutex.lock();
+        mJournalData->mErrorString = std::string("Can't lock ") +
+                                                mJournalData->mFilename;
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    mJournalData->mMutex.lock();
+
+    // Another process may have appended to the file, or compacted
+    // it, since we last looked. Go by what's there now.
+    if (((!mJournalData->mScanned) || (fileChanged())) && 
+                                                (!scanLocked())) {
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    doc = xmlNewDoc((const xmlChar *)("1.0"));
+    if (doc == NULL) {
+        mJournalData->mErrorString = "Error creating XML document.";
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+    scratch = xmlNewNode(NULL, (const xmlChar *)("dict"));
+    xmlDocSetRootElement(doc, scratch);
+
+    base = mJournalData->mEnd;
+    if (base == 0) {
+        buf.append(_JOURNAL_MAGIC);
+        packU32(buf, _JOURNAL_VERSION);
+        packU32(buf, 0);
+        mJournalData->mVersion = _JOURNAL_VERSION;
+    }
+
+    // Older journals can't hold shared luts, so leave them inline.
+    if (mJournalData->mVersion >= 2) {
+        prevLuts = LutStore::setCurrent(&luts);
+    }
+
+    for (std::vector<Dict *>::const_iterator theDict = dicts.begin();
+            theDict != dicts.end(); ++theDict) {
+        const Dict *dict = *theDict;
+        uint64_t    since = 0;
+        bool        removed;
+
+        if (!dict) continue;
+
+        std::string dictName = (*theDict)->getName();
+        uint64_t    version  = dict->getVersion();
+
+        names.insert(dictName);
+
+        std::map<std::string, uint64_t>::iterator seen =
+                                    mJournalData->mSeen.find(dictName);
+        if (seen != mJournalData->mSeen.end()) {
+            since = seen->second;
+        }
+
+        std::vector<DictKey> keys = dict->getChangedKeys(since, removed,
+                                                         true);
+
+        // Write whatever actually differs from what's on disk. The
+        // first append for a dict sees every key, but only pays for
+        // serializing them. So does any item someone could have 
+        // changed in place through get().
+        for (std::vector<DictKey>::iterator theKey = keys.begin();
+                theKey != keys.end(); ++theKey) {
+            DictItem *item = const_cast<DictItem *>(dict->get(*theKey));
+            std::string payload, xml;
+
+            if ((!item) || (!item->serializable())) continue;
+
+            const std::string &key = (*theKey).str();
+
+            if (!_journalItemXml(doc, scratch, key, item, xml)) {
+                luts.takeAdded();
+                continue;
+            }
+
+            _JournalEntry entry;
+            entry.isCalib         = false;
+            entry.preset          = 0;
+            entry.calibrationTime = 0;
+            entry.luts            = luts.takeAdded();
+
+            CalibRecordDictItem *calib =
+                            dynamic_cast<CalibRecordDictItem *>(item);
+            if (calib) {
+                entry.isCalib         = true;
+                entry.deviceId        = calib->getDeviceId();
+                entry.preset          = calib->getPreset();
+                entry.calibrationTime = calib->getCalibrationTime();
+                entry.calibrationPluginName = 
+                                    calib->getCalibrationPluginName();
+            }
+
+            packString(payload, dictName);
+            packString(payload, key);
+            payload.push_back((char)(entry.isCalib? 1: 0));
+            if (entry.isCalib) {
+                packString(payload, entry.deviceId);
+                packU32(payload, entry.preset);
+                packU32(payload, entry.calibrationTime);
+            }
+            packString(payload, xml);
+            if (entry.isCalib) {
+                packString(payload, entry.calibrationPluginName);
+                packU32(payload, (uint32_t)entry.luts.size());
+                for (std::vector<std::string>::iterator theHash = 
+                                                    entry.luts.begin();
+                        theHash != entry.luts.end(); ++theHash) {
+                    packString(payload, *theHash);
+                }
+            }
+
+            std::string frame = _journalFrame(_JOURNAL_KIND_ITEM, payload);
+
+            entry.size   = (uint32_t)frame.size();
+            entry.hash   = packHash(payload.data(), payload.size());
+
+            // A crc32 match isn't enough to go on here; two different
+            // items that happened to share one would lose the change.
+            _JournalDict &live = mJournalData->mLive[dictName];
+            _JournalDict::iterator old = live.find(key);
+            if ((old != live.end()) && (old->second.hash == entry.hash) &&
+                                       (old->second.size == entry.size)) {
+                continue;
+            }
+
+            // Write any luts the file doesn't already have in use
+            // ahead of the item. Ones that nothing refers to anymore
+            // are written again, since compaction may drop them.
+            for (std::vector<std::string>::iterator theHash = 
+                                                    entry.luts.begin();
+                    theHash != entry.luts.end(); ++theHash) {
+                _JournalLutMap::iterator lut = 
+                                    mJournalData->mLuts.find(*theHash);
+                std::string              lutPayload;
+
+                if (((lut != mJournalData->mLuts.end()) && 
+                                    (lut->second.refs) && (lut->second.size)) ||
+                        (newLuts.find(*theHash) != newLuts.end())) {
+                    continue;
+                }
+
+                luts.serializeBinary(*theHash, lutPayload);
+
+                std::string lutFrame = _journalFrame(_JOURNAL_KIND_LUT, 
+                                                     lutPayload);
+
+                setLut(*theHash, base + buf.size(), 
+                                        (uint32_t)lutFrame.size());
+                buf.append(lutFrame);
+                newLuts.insert(*theHash);
+            }
+
+            entry.offset = base + buf.size();
+
+            buf.append(frame);
+            setEntry(dictName, key, entry);
+        }
+
+        // Drop anything that's no longer in the dict. If we're going
+        // through every key, what's on disk may not be ours at all.
+        if ((removed) || (since == 0)) {
+            std::map<std::string, _JournalDict>::iterator live =
+                                    mJournalData->mLive.find(dictName);
+            if (live != mJournalData->mLive.end()) {
+                std::vector<std::string> current =
+                                (const_cast<Dict *>(dict))->getKeys();
+                std::set<std::string>    keep(current.begin(),
+                                              current.end());
+                std::vector<std::string> gone;
+
+                for (_JournalDict::iterator theKey = live->second.begin();
+                        theKey != live->second.end(); ++theKey) {
+                    if (keep.find(theKey->first) == keep.end()) {
+                        gone.push_back(theKey->first);
+                    }
+                }
+
+                for (std::vector<std::string>::iterator theKey =
+                        gone.begin(); theKey != gone.end(); ++theKey) {
+                    std::string payload;
+
+                    packString(payload, dictName);
+                    packString(payload, *theKey);
+                    buf.append(_journalFrame(_JOURNAL_KIND_REMOVE, payload));
+
+                    removeEntry(dictName, *theKey);
+                }
+            }
+        }
+
+        mJournalData->mSeen[dictName] = version;
+    }
+
+    if (mJournalData->mVersion >= 2) {
+        LutStore::setCurrent(prevLuts);
+    }
+
+    xmlFreeDoc(doc);
+
+    // Like an xml save, dicts that weren't handed to us go away.
+    std::vector<std::string> goneDicts;
+    for (std::map<std::string, _JournalDict>::iterator live =
+                                        mJournalData->mLive.begin();
+            live != mJournalData->mLive.end(); ++live) {
+        if (names.find(live->first) == names.end()) {
+            goneDicts.push_back(live->first);
+        }
+    }
+
+    for (std::vector<std::string>::iterator theDict = goneDicts.begin();
+            theDict != goneDicts.end(); ++theDict) {
+        std::vector<std::string> gone;
+
+        for (_JournalDict::iterator theKey =
+                            mJournalData->mLive[*theDict].begin();
+                theKey != mJournalData->mLive[*theDict].end(); ++theKey) {
+            gone.push_back(theKey->first);
+        }
+
+        for (std::vector<std::string>::iterator theKey = gone.begin();
+                theKey != gone.end(); ++theKey) {
+            std::string payload;
+
+            packString(payload, *theDict);
+            packString(payload, *theKey);
+            buf.append(_journalFrame(_JOURNAL_KIND_REMOVE, payload));
+
+            removeEntry(*theDict, *theKey);
+        }
+
+        mJournalData->mLive.erase(*theDict);
+        mJournalData->mSeen.erase(*theDict);
+    }
+
+    // Nothing changed, so nothing to write
+    if ((mJournalData->mEnd != 0) && (buf.empty())) {
+        mJournalData->mMutex.unlock();
+        return true;
+    }
+
+    addIndex(buf, base, mJournalData->mCalib, mJournalData->mLuts);
+
+    if (!writeLocked(buf)) {
+        // We've already updated our idea of what's on disk. Forget
+        // it, so the next append reads the file again and writes
+        // whatever is missing.
+        mJournalData->mScanned = false;
+        mJournalData->mSeen.clear();
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    // Compacting also leaves any damage behind.
+    if ((mJournalData->mDamaged) ||
+            ((mJournalData->mEnd >= _JOURNAL_COMPACT_MIN_SIZE) &&
+             (mJournalData->mEnd - mJournalData->mLiveBytes >
+                                        mJournalData->mLiveBytes))) {
+        startCompaction();
+    }
+
+    mJournalData->mMutex.unlock();
+
+    return true;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::Journal::load(DictHash *hash)
+{
+    return load(hash, std::vector<std::string>());
+}
+
+// -----------------------------------
+//
+bool
+Ookala::Journal::load(DictHash *hash, 
+                      const std::vector<std::string> &dictNames)
+{
+    std::vector<uint8_t> data, frameData;
+    bool                 partial;
+
+    if (!hash) {
+        return false;
+    }
+
+    mJournalData->mMutex.lock();
+
+    // We already know where every frame is, so long as the file 
+    // hasn't grown behind our back.
+    partial = (!dictNames.empty()) && (mJournalData->mScanned) &&
+               (!fileChanged());
+
+    if (!partial) {
+        if ((!readLocked(data)) || (!scanBuffer(data))) {
+            mJournalData->mMutex.unlock();
+            return false;
+        }
+    }
+
+    // Stitch each dict's items back into one <dict>, in the order
+    // they were written, and hand it off the same as an xml file.
+    for (std::map<std::string, _JournalDict>::iterator live =
+                                    mJournalData->mLive.begin();
+            live != mJournalData->mLive.end(); ++live) {
+        std::vector<std::pair<uint64_t, uint32_t> > frames;
+        std::vector<std::string>                    lutHashes;
+        std::string                                 xml("<dict>");
+        LutStore                                    luts;
+
+        if ((!dictNames.empty()) &&
+                (std::find(dictNames.begin(), dictNames.end(), 
+                           live->first) == dictNames.end())) {
+            continue;
+        }
+
+        for (_JournalDict::iterator theKey = live->second.begin();
+                theKey != live->second.end(); ++theKey) {
+            frames.push_back(std::make_pair(theKey->second.offset,
+                                            theKey->second.size));
+            lutHashes.insert(lutHashes.end(), theKey->second.luts.begin(),
+                                              theKey->second.luts.end());
+        }
+
+        if (!readLuts(lutHashes, mJournalData->mLuts, 
+                      partial? NULL: &data, luts)) {
+            mJournalData->mMutex.unlock();
+            return false;
+        }
+        std::sort(frames.begin(), frames.end());
+
+        for (std::vector<std::pair<uint64_t, uint32_t> >::iterator
+                theFrame = frames.begin(); theFrame != frames.end();
+                ++theFrame) {
+            const uint8_t *frame;
+            uint8_t        kind;
+            uint32_t       size, crc;
+
+            if (partial) {
+                if ((!_journalRead(mJournalData->mFilename, 
+                                   theFrame->first, theFrame->second,
+                                   frameData)) ||
+                        (!_journalCheckFrame(frameData.empty()? NULL: 
+                                                        &frameData[0],
+                                             frameData.size(), 
+                                             kind, size, crc))) {
+                    mJournalData->mErrorString = 
+                            std::string("Damaged frame in ") + 
+                                                mJournalData->mFilename;
+                    mJournalData->mMutex.unlock();
+                    return false;
+                }
+                frame = &frameData[0];
+            } else {
+                frame = &data[theFrame->first];
+            }
+
+            PackReader reader(frame + _JOURNAL_FRAME_HEADER_SIZE,
+                              theFrame->second - 
+                                        _JOURNAL_FRAME_HEADER_SIZE);
+            reader.str();
+            reader.str();
+            if (reader.u8()) {
+                reader.str();
+                reader.u32();
+                reader.u32();
+            }
+            xml.append(reader.str());
+        }
+        xml.append("</dict>");
+
+        xmlDocPtr doc = xmlReadMemory(xml.data(), (int)xml.size(),
+                                      NULL, NULL, 0);
+        if (doc == NULL) {
+            mJournalData->mErrorString = std::string("Error parsing ") +
+                            live->first + " in " + mJournalData->mFilename;
+            mJournalData->mMutex.unlock();
+            return false;
+        }
+
+        LutStore *prevLuts = LutStore::setCurrent(&luts);
+        Dict     *dict     = hash->newDict(live->first.c_str());
+
+        if ((!dict) ||
+                (!dict->unserialize(doc, xmlDocGetRootElement(doc)))) {
+            mJournalData->mErrorString =
+                         std::string("Error unserializing dict in ") +
+                                                mJournalData->mFilename;
+            LutStore::setCurrent(prevLuts);
+            xmlFreeDoc(doc);
+            mJournalData->mMutex.unlock();
+            return false;
+        }
+
+        LutStore::setCurrent(prevLuts);
+        xmlFreeDoc(doc);
+    }
+
+    mJournalData->mMutex.unlock();
+
+    return true;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::Journal::getLatestCalibRecord(const std::string   &deviceId,
+                                      uint32_t             preset,
+                                      CalibRecordDictItem &record)
+{
+    std::vector<uint8_t>     payload;
+    std::vector<std::string> lutHashes;
+    _JournalLutMap           indexLuts;
+    LutStore                 luts;
+    uint8_t                  kind;
+    uint64_t                 offset = 0;
+    bool                     found  = false;
+
+    mJournalData->mMutex.lock();
+
+    // If we haven't read the file, try going by the index at the
+    // end. Should that be missing or damaged, read it all.
+    if (!mJournalData->mScanned) {
+        uint64_t             size =
+                            _journalFileSize(mJournalData->mFilename);
+        uint64_t             indexOffset;
+        std::vector<uint8_t> tail;
+
+        if ((size >= _JOURNAL_HEADER_SIZE + _JOURNAL_TAIL_SIZE) &&
+                (_journalRead(mJournalData->mFilename,
+                              size - _JOURNAL_TAIL_SIZE,
+                              _JOURNAL_TAIL_SIZE, tail)) &&
+                (_journalCheckTail(&tail[0], tail.size(), indexOffset)) &&
+                (readFrame(indexOffset, kind, payload)) &&
+                (kind == _JOURNAL_KIND_INDEX)) {
+            PackReader reader(payload.empty()? NULL: &payload[0],
+                                  payload.size());
+
+            uint32_t count = reader.u32();
+            for (uint32_t idx=0; (idx<count) && (reader.ok()); ++idx) {
+                std::string device = reader.str();
+                uint32_t    num    = reader.u32();
+
+                reader.u32();
+                reader.str();
+                reader.str();
+                uint64_t itemOffset = reader.u64();
+
+                if ((reader.ok()) && (device == deviceId) &&
+                                    (num == preset)) {
+                    offset = itemOffset;
+                    found  = true;
+                }
+            }
+
+            // Then where to find the luts those records use
+            if ((found) && (reader.ok()) && (reader.left())) {
+                uint32_t lutCount = reader.u32();
+
+                for (uint32_t idx=0; (idx<lutCount) && (reader.ok()); 
+                                                                ++idx) {
+                    std::string  hash = reader.str();
+                    _JournalLut &lut  = indexLuts[hash];
+
+                    lut.offset = reader.u64();
+                    lut.size   = 0;
+                    lut.refs   = 1;
+                }
+            }
+
+            if (!reader.ok()) {
+                found = false;
+                if (!scanLocked()) {
+                    mJournalData->mMutex.unlock();
+                    return false;
+                }
+            } else if (!found) {
+                mJournalData->mErrorString = "No calibRecord found.";
+                mJournalData->mMutex.unlock();
+                return false;
+            }
+        } else if (!scanLocked()) {
+            mJournalData->mMutex.unlock();
+            return false;
+        }
+    }
+
+    if (!found) {
+        _JournalCalibMap::iterator calib =
+            mJournalData->mCalib.find(_JournalCalibKey(deviceId, preset));
+        if (calib == mJournalData->mCalib.end()) {
+            mJournalData->mErrorString = "No calibRecord found.";
+            mJournalData->mMutex.unlock();
+            return false;
+        }
+
+        offset = calib->second.offset;
+    }
+
+    if ((!readFrame(offset, kind, payload)) ||
+                (kind != _JOURNAL_KIND_ITEM)) {
+        mJournalData->mErrorString = std::string("Bad calibRecord in ") +
+                                                mJournalData->mFilename;
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    _journalItemLuts(payload, lutHashes);
+    if (!readLuts(lutHashes, 
+                  mJournalData->mScanned? mJournalData->mLuts: indexLuts,
+                  NULL, luts)) {
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    mJournalData->mMutex.unlock();
+
+    LutStore *prevLuts = LutStore::setCurrent(&luts);
+    bool      ret      = _journalRecord(payload, record);
+
+    LutStore::setCurrent(prevLuts);
+
+    return ret;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::Journal::getCalibRecords(std::vector<CalibRecordHandle> &handles)
+{
+    mJournalData->mMutex.lock();
+
+    if ((!mJournalData->mScanned) && (!scanLocked())) {
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    for (std::map<std::string, _JournalDict>::iterator live =
+                                    mJournalData->mLive.begin();
+            live != mJournalData->mLive.end(); ++live) {
+        for (_JournalDict::iterator theKey = live->second.begin();
+                theKey != live->second.end(); ++theKey) {
+            const _JournalEntry &entry = theKey->second;
+            CalibRecordHandle    handle;
+
+            if (!entry.isCalib) {
+                continue;
+            }
+
+            handle.deviceId              = entry.deviceId;
+            handle.preset                = entry.preset;
+            handle.calibrationTime       = entry.calibrationTime;
+            handle.calibrationPluginName = entry.calibrationPluginName;
+            handle.filename              = mJournalData->mFilename;
+            handle.dictName              = live->first;
+            handle.key                   = theKey->first;
+            handle.offset                = entry.offset;
+            handle.size                  = entry.size;
+            handle.sourceHash            = 0;
+
+            handles.push_back(handle);
+        }
+    }
+
+    mJournalData->mMutex.unlock();
+
+    return true;
+}
+
+// -----------------------------------
+//
+// Go by dict and key rather than offset, since compaction moves
+// frames around.
+bool
+Ookala::Journal::getCalibRecord(const std::string   &dictName,
+                                const std::string   &key,
+                                CalibRecordDictItem &record)
+{
+    std::vector<uint8_t> payload;
+    LutStore             luts;
+    uint8_t              kind;
+
+    mJournalData->mMutex.lock();
+
+    if ((!mJournalData->mScanned) && (!scanLocked())) {
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    std::map<std::string, _JournalDict>::iterator live = 
+                                    mJournalData->mLive.find(dictName);
+    if (live == mJournalData->mLive.end()) {
+        mJournalData->mErrorString = "No calibRecord found.";
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    _JournalDict::iterator theKey = live->second.find(key);
+    if ((theKey == live->second.end()) || (!theKey->second.isCalib)) {
+        mJournalData->mErrorString = "No calibRecord found.";
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    if ((!readFrame(theKey->second.offset, kind, payload)) ||
+                (kind != _JOURNAL_KIND_ITEM)) {
+        mJournalData->mErrorString = std::string("Bad calibRecord in ") +
+                                                mJournalData->mFilename;
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    if (!readLuts(theKey->second.luts, mJournalData->mLuts, NULL, luts)) {
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    mJournalData->mMutex.unlock();
+
+    LutStore *prevLuts = LutStore::setCurrent(&luts);
+    bool      ret      = _journalRecord(payload, record);
+
+    LutStore::setCurrent(prevLuts);
+
+    return ret;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::Journal::compact()
+{
+    // One at a time. If append() already started one, it'll
+    // do the job.
+    if (mJournalData->mCompacting.exchange(true)) {
+        return true;
+    }
+
+    bool ret = doCompact();
+
+    mJournalData->mCompacting = false;
+
+    return ret;
+}
+
+// -----------------------------------
+//
+// Read the whole file, and note which file it was. That's done 
+// first, so if someone writes to it while we read, fileChanged()
+// says so afterwards rather than missing it.
+//
+// Anything we appended before may since have been written over,
+// so the next append checks every key against the file again.
+//
+// private
+bool
+Ookala::Journal::readLocked(std::vector<uint8_t> &data)
+{
+    uint64_t size;
+
+    _journalFileStamp(mJournalData->mFilename, size, 
+                      mJournalData->mFileId);
+    mJournalData->mSeen.clear();
+
+    if (!_journalRead(mJournalData->mFilename, 0, 0, data)) {
+        mJournalData->mErrorString =
+                std::string("Can't read ") + mJournalData->mFilename;
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+// Read the whole file and work out what's live.
+//
+// private
+bool
+Ookala::Journal::scanLocked()
+{
+    std::vector<uint8_t> data;
+
+    if (!readLocked(data)) {
+        return false;
+    }
+
+    return scanBuffer(data);
+}
+
+// -----------------------------------
+//
+// Has anyone written to the file, or renamed another over it, 
+// since we last read or wrote it?
+//
+// private
+bool
+Ookala::Journal::fileChanged()
+{
+    uint64_t size, id;
+
+    _journalFileStamp(mJournalData->mFilename, size, id);
+
+    return (size != mJournalData->mEnd) || (id != mJournalData->mFileId);
+}
+
+// -----------------------------------
+//
+// Replay the frames in data. Only whole appends count, which is
+// up to the last good tail; anything after that is from an append
+// that didn't finish, and gets cut off by the next one.
+//
+// private
+bool
+Ookala::Journal::scanBuffer(const std::vector<uint8_t> &data)
+{
+    uint64_t pos, end;
+    uint8_t  kind;
+    uint32_t size, crc;
+
+    mJournalData->mLive.clear();
+    mJournalData->mCalib.clear();
+    mJournalData->mLuts.clear();
+    mJournalData->mVersion   = _JOURNAL_VERSION;
+    mJournalData->mLiveBytes = 0;
+    mJournalData->mEnd       = 0;
+    mJournalData->mDamaged   = false;
+    mJournalData->mScanned   = false;
+
+    // A new file
+    if (data.empty()) {
+        mJournalData->mScanned = true;
+        return true;
+    }
+
+    if ((data.size() < _JOURNAL_HEADER_SIZE) ||
+            (memcmp(&data[0], _JOURNAL_MAGIC, strlen(_JOURNAL_MAGIC)))) {
+        mJournalData->mErrorString = mJournalData->mFilename +
+                                            " is not a journal.";
+        return false;
+    }
+
+    if (unpackU32(&data[8]) > _JOURNAL_VERSION) {
+        mJournalData->mErrorString = mJournalData->mFilename +
+                                " was written by a newer version.";
+        return false;
+    }
+    mJournalData->mVersion = unpackU32(&data[8]);
+
+    // First find where the good stuff ends. Something that isn't a
+    // frame is usually an append that didn't finish, but if good 
+    // frames turn up past it, the damage is in the middle; step 
+    // over it and keep everything around it.
+    std::vector<std::pair<uint64_t, uint64_t> > damaged;
+    uint64_t                                    damagedBytes = 0;
+
+    pos = end = _JOURNAL_HEADER_SIZE;
+    while (pos < data.size()) {
+        uint64_t indexOffset;
+
+        if (_journalCheckTail(&data[pos], data.size() - pos, indexOffset)) {
+            pos += _JOURNAL_TAIL_SIZE;
+            end  = pos;
+            continue;
+        }
+
+        if (_journalCheckFrame(&data[pos], data.size() - pos,
+                               kind, size, crc)) {
+            pos += _JOURNAL_FRAME_HEADER_SIZE + size;
+            continue;
+        }
+
+        uint64_t next = _journalResync(data, pos + 1);
+        if (next >= data.size()) {
+            break;
+        }
+
+        damaged.push_back(std::make_pair(pos, next));
+        pos = next;
+    }
+
+    if (data.size() > end) {
+        fprintf(stderr, "Ignoring %d bytes at the end of %s\n",
+                        (int)(data.size() - end),
+                        mJournalData->mFilename.c_str());
+    }
+
+    // Then replay it.
+    std::vector<std::pair<uint64_t, uint64_t> >::const_iterator 
+                                        theDamage = damaged.begin();
+
+    pos = _JOURNAL_HEADER_SIZE;
+    while (pos < end) {
+        uint64_t indexOffset;
+
+        if ((theDamage != damaged.end()) && (pos == theDamage->first)) {
+            damagedBytes += theDamage->second - theDamage->first;
+            pos           = theDamage->second;
+            ++theDamage;
+            continue;
+        }
+
+        if (_journalCheckTail(&data[pos], end - pos, indexOffset)) {
+            pos += _JOURNAL_TAIL_SIZE;
+            continue;
+        }
+
+        _journalCheckFrame(&data[pos], end - pos, kind, size, crc);
+
+        PackReader reader(&data[pos] + _JOURNAL_FRAME_HEADER_SIZE,
+                              size);
+
+        if (kind == _JOURNAL_KIND_ITEM) {
+            _JournalEntry entry;
+
+            std::string dictName = reader.str();
+            std::string key      = reader.str();
+
+            entry.offset          = pos;
+            entry.size            = _JOURNAL_FRAME_HEADER_SIZE + size;
+            entry.hash            = packHash(&data[pos] + 
+                                            _JOURNAL_FRAME_HEADER_SIZE, size);
+            entry.isCalib         = (reader.u8() != 0);
+            entry.preset          = 0;
+            entry.calibrationTime = 0;
+            if (entry.isCalib) {
+                entry.deviceId        = reader.str();
+                entry.preset          = reader.u32();
+                entry.calibrationTime = reader.u32();
+
+                reader.skip(reader.u32());
+                if (reader.left()) {
+                    entry.calibrationPluginName = reader.str();
+                }
+                if (reader.left()) {
+                    uint32_t count = reader.u32();
+
+                    for (uint32_t idx=0; (idx<count) && (reader.ok()); 
+                                                                ++idx) {
+                        entry.luts.push_back(reader.str());
+                    }
+                }
+            }
+
+            if (reader.ok()) {
+                setEntry(dictName, key, entry);
+            }
+        } else if (kind == _JOURNAL_KIND_REMOVE) {
+            std::string dictName = reader.str();
+            std::string key      = reader.str();
+
+            if (reader.ok()) {
+                removeEntry(dictName, key);
+            }
+        } else if (kind == _JOURNAL_KIND_LUT) {
+            std::string hash = reader.str();
+
+            if (reader.ok()) {
+                setLut(hash, pos, _JOURNAL_FRAME_HEADER_SIZE + size);
+            }
+        }
+
+        // Index frames are rebuilt from the items, so skip them.
+
+        pos += _JOURNAL_FRAME_HEADER_SIZE + size;
+    }
+
+    if (damagedBytes) {
+        fprintf(stderr, "Skipped %d damaged bytes in %s\n",
+                        (int)damagedBytes, mJournalData->mFilename.c_str());
+    }
+
+    mJournalData->mEnd     = end;
+    mJournalData->mDamaged = (damagedBytes != 0);
+    mJournalData->mScanned = true;
+
+    return true;
+}
+
+// -----------------------------------
+//
+// Read and check the frame at offset, without reading the
+// rest of the file.
+//
+// private
+bool
+Ookala::Journal::readFrame(uint64_t offset, uint8_t &kind,
+                           std::vector<uint8_t> &payload)
+{
+    std::vector<uint8_t> header, frame;
+    uint32_t             size, crc;
+
+    payload.clear();
+
+    if ((!_journalRead(mJournalData->mFilename, offset,
+                       _JOURNAL_FRAME_HEADER_SIZE, header)) ||
+            (header.size() != _JOURNAL_FRAME_HEADER_SIZE) ||
+            (unpackU32(&header[0]) != _JOURNAL_FRAME_MAGIC)) {
+        return false;
+    }
+
+    size = unpackU32(&header[8]);
+    if (!_journalRead(mJournalData->mFilename, offset,
+                      _JOURNAL_FRAME_HEADER_SIZE + (uint64_t)size, frame)) {
+        return false;
+    }
+
+    if (!_journalCheckFrame(&frame[0], frame.size(), kind, size, crc)) {
+        return false;
+    }
+
+    payload.assign(frame.begin() + _JOURNAL_FRAME_HEADER_SIZE, frame.end());
+
+    return true;
+}
+
+// -----------------------------------
+//
+// Put buf on the end of the file, and make sure it's there before
+// we return. The file lock has to be held, and the file read again
+// if fileChanged(), so everything past mEnd is really garbage.
+//
+// private
+bool
+Ookala::Journal::writeLocked(const std::string &buf)
+{
+    FILE     *fid;
+    uint64_t  size;
+    bool      ret;
+
+    // Cut off the remains of an append that didn't finish.
+    if (_journalFileSize(mJournalData->mFilename) > mJournalData->mEnd) {
+        if (!_journalTruncate(mJournalData->mFilename, mJournalData->mEnd)) {
+            mJournalData->mErrorString = std::string("Can't truncate ") +
+                                                mJournalData->mFilename;
+            return false;
+        }
+    }
+
+    fid = fopen(mJournalData->mFilename.c_str(), "ab");
+    if (!fid) {
+        mJournalData->mErrorString = std::string("Can't open ") +
+                                                mJournalData->mFilename;
+        return false;
+    }
+
+    ret = (fwrite(buf.data(), 1, buf.size(), fid) == buf.size());
+    ret = _journalSync(fid) && ret;
+    ret = (fclose(fid) == 0) && ret;
+
+    if (!ret) {
+        mJournalData->mErrorString = std::string("Error writing ") +
+                                                mJournalData->mFilename;
+        return false;
+    }
+
+    mJournalData->mEnd += buf.size();
+
+    // The file may have only just been made.
+    _journalFileStamp(mJournalData->mFilename, size, 
+                      mJournalData->mFileId);
+
+    return true;
+}
+
+// -----------------------------------
+//
+// Finish an append with an index of the newest calibRecords, and
+// the tail that points to it. buf starts at base in the file.
+//
+// private
+void
+Ookala::Journal::addIndex(std::string &buf, uint64_t base,
+                          const _JournalCalibMap &calib,
+                          const _JournalLutMap   &luts)
+{
+    std::string              payload, lutPayload;
+    std::set<std::string>    lutHashes;
+    uint32_t                 lutCount    = 0;
+    uint64_t                 indexOffset = base + buf.size();
+
+    packU32(payload, (uint32_t)calib.size());
+    for (_JournalCalibMap::const_iterator theCalib = calib.begin();
+            theCalib != calib.end(); ++theCalib) {
+        packString(payload, theCalib->first.first);
+        packU32(payload,    theCalib->first.second);
+        packU32(payload,    theCalib->second.calibrationTime);
+        packString(payload, theCalib->second.dictName);
+        packString(payload, theCalib->second.key);
+        packU64(payload,    theCalib->second.offset);
+
+        for (std::vector<std::string>::const_iterator theHash = 
+                                        theCalib->second.luts.begin();
+                theHash != theCalib->second.luts.end(); ++theHash) {
+            _JournalLutMap::const_iterator lut = luts.find(*theHash);
+
+            if ((lut == luts.end()) || 
+                    (!lutHashes.insert(*theHash).second)) {
+                continue;
+            }
+
+            packString(lutPayload, *theHash);
+            packU64(lutPayload,    lut->second.offset);
+            lutCount++;
+        }
+    }
+
+    // Older readers stop after the records, so the luts go on the end.
+    packU32(payload, lutCount);
+    payload.append(lutPayload);
+
+    buf.append(_journalFrame(_JOURNAL_KIND_INDEX, payload));
+    buf.append(_journalTail(indexOffset));
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::Journal::setEntry(const std::string   &dictName,
+                          const std::string   &key,
+                          const _JournalEntry &entry)
+{
+    _JournalDict  &live = mJournalData->mLive[dictName];
+    _JournalEntry  old    = _JournalEntry();
+    bool           hadOld = false;
+
+    _JournalDict::iterator theKey = live.find(key);
+    if (theKey != live.end()) {
+        old    = theKey->second;
+        hadOld = true;
+        mJournalData->mLiveBytes -= old.size;
+    }
+
+    live[key] = entry;
+    mJournalData->mLiveBytes += entry.size;
+
+    // Take the new references first, so luts shared by the old and
+    // new frames don't look dead for a moment.
+    refLuts(entry.luts, true);
+    if (hadOld) {
+        refLuts(old.luts, false);
+    }
+
+    if (entry.isCalib) {
+        _JournalCalibKey           calibKey(entry.deviceId, entry.preset);
+        _JournalCalibMap::iterator calib =
+                                    mJournalData->mCalib.find(calibKey);
+
+        if ((calib == mJournalData->mCalib.end()) ||
+                (entry.calibrationTime >= calib->second.calibrationTime)) {
+            _JournalCalib &newest = mJournalData->mCalib[calibKey];
+
+            newest.dictName        = dictName;
+            newest.key             = key;
+            newest.calibrationTime = entry.calibrationTime;
+            newest.offset          = entry.offset;
+            newest.luts            = entry.luts;
+        }
+    }
+
+    // If we've just replaced the newest record for some device,
+    // something else may be newest now.
+    if ((hadOld) && (old.isCalib)) {
+        _JournalCalibKey           calibKey(old.deviceId, old.preset);
+        _JournalCalibMap::iterator calib =
+                                    mJournalData->mCalib.find(calibKey);
+
+        if ((calib != mJournalData->mCalib.end()) &&
+                (calib->second.offset == old.offset)) {
+            updateCalib(calibKey);
+        }
+    }
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::Journal::removeEntry(const std::string &dictName,
+                             const std::string &key)
+{
+    std::map<std::string, _JournalDict>::iterator live =
+                                    mJournalData->mLive.find(dictName);
+    if (live == mJournalData->mLive.end()) {
+        return;
+    }
+
+    _JournalDict::iterator theKey = live->second.find(key);
+    if (theKey == live->second.end()) {
+        return;
+    }
+
+    _JournalEntry old = theKey->second;
+
+    mJournalData->mLiveBytes -= old.size;
+    live->second.erase(theKey);
+
+    refLuts(old.luts, false);
+
+    if (old.isCalib) {
+        _JournalCalibKey           calibKey(old.deviceId, old.preset);
+        _JournalCalibMap::iterator calib =
+                                    mJournalData->mCalib.find(calibKey);
+
+        if ((calib != mJournalData->mCalib.end()) &&
+                (calib->second.offset == old.offset)) {
+            updateCalib(calibKey);
+        }
+    }
+}
+
+// -----------------------------------
+//
+// Look through everything live for the newest record matching
+// calibKey. This only happens when the newest one goes away, so
+// it's fine that it's slow.
+//
+// private
+void
+Ookala::Journal::updateCalib(const _JournalCalibKey &calibKey)
+{
+    _JournalCalib newest;
+    bool          found = false;
+
+    for (std::map<std::string, _JournalDict>::iterator live =
+                                        mJournalData->mLive.begin();
+            live != mJournalData->mLive.end(); ++live) {
+        for (_JournalDict::iterator theKey = live->second.begin();
+                theKey != live->second.end(); ++theKey) {
+            const _JournalEntry &entry = theKey->second;
+
+            if ((!entry.isCalib) || (entry.deviceId != calibKey.first) ||
+                                    (entry.preset   != calibKey.second)) {
+                continue;
+            }
+
+            if ((!found) ||
+                    (entry.calibrationTime > newest.calibrationTime) ||
+                    ((entry.calibrationTime == newest.calibrationTime) &&
+                     (entry.offset > newest.offset))) {
+                newest.dictName        = live->first;
+                newest.key             = theKey->first;
+                newest.calibrationTime = entry.calibrationTime;
+                newest.offset          = entry.offset;
+                newest.luts            = entry.luts;
+                found                  = true;
+            }
+        }
+    }
+
+    if (found) {
+        mJournalData->mCalib[calibKey] = newest;
+    } else {
+        mJournalData->mCalib.erase(calibKey);
+    }
+}
+
+// -----------------------------------
+//
+// Note where the lut frame for hash is. Like items, the last frame
+// written wins.
+//
+// private
+void
+Ookala::Journal::setLut(const std::string &hash, uint64_t offset,
+                        uint32_t size)
+{
+    _JournalLut &lut = mJournalData->mLuts[hash];
+
+    if (lut.refs) {
+        mJournalData->mLiveBytes -= lut.size;
+        mJournalData->mLiveBytes += size;
+    }
+
+    lut.offset = offset;
+    lut.size   = size;
+}
+
+// -----------------------------------
+//
+// Count items using each of hashes. A lut frame is only live
+// while something uses it.
+//
+// private
+void
+Ookala::Journal::refLuts(const std::vector<std::string> &hashes, bool add)
+{
+    for (std::vector<std::string>::const_iterator theHash = hashes.begin();
+            theHash != hashes.end(); ++theHash) {
+        _JournalLut &lut = mJournalData->mLuts[*theHash];
+
+        if (add) {
+            if (lut.refs++ == 0) {
+                mJournalData->mLiveBytes += lut.size;
+            }
+        } else if ((lut.refs) && (--lut.refs == 0)) {
+            mJournalData->mLiveBytes -= lut.size;
+        }
+    }
+}
+
+// -----------------------------------
+//
+// Fill store with the luts for hashes, going by the frames in luts.
+// If data holds the whole file, read them from there.
+//
+// private
+bool
+Ookala::Journal::readLuts(const std::vector<std::string> &hashes,
+                          const _JournalLutMap           &luts,
+                          const std::vector<uint8_t>     *data,
+                          LutStore                       &store)
+{
+    std::vector<uint8_t> frame;
+    uint8_t              kind;
+
+    for (std::vector<std::string>::const_iterator theHash = hashes.begin();
+            theHash != hashes.end(); ++theHash) {
+        bool ok;
+
+        if (store.has(*theHash)) {
+            continue;
+        }
+
+        _JournalLutMap::const_iterator lut = luts.find(*theHash);
+        if (lut == luts.end()) {
+            mJournalData->mErrorString = std::string("Missing lut ") +
+                            *theHash + " in " + mJournalData->mFilename;
+            return false;
+        }
+
+        if ((data) && (lut->second.offset < data->size())) {
+            ok = _journalLoadLut(&(*data)[lut->second.offset], 
+                                 data->size() - lut->second.offset, store);
+        } else {
+            ok = (readFrame(lut->second.offset, kind, frame)) &&
+                 (kind == _JOURNAL_KIND_LUT);
+            if (ok) {
+                PackReader reader(&frame[0], frame.size());
+
+                ok = store.unserializeBinary(reader);
+            }
+        }
+
+        if ((!ok) || (!store.has(*theHash))) {
+            mJournalData->mErrorString = std::string("Damaged lut ") +
+                            *theHash + " in " + mJournalData->mFilename;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::Journal::startCompaction()
+{
+    if (mJournalData->mCompacting.exchange(true)) {
+        return;
+    }
+
+    // Any previous thread has already finished up, so this won't
+    // wait around.
+    if (mJournalData->mCompactThread.joinable()) {
+        mJournalData->mCompactThread.join();
+    }
+
+    mJournalData->mCompactThread = std::thread(&Journal::compactMain, this);
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::Journal::compactMain()
+{
+    if (!doCompact()) {
+        fprintf(stderr, "Journal: %s\n", getErrorString().c_str());
+    }
+
+    mJournalData->mCompacting = false;
+}
+
+// -----------------------------------
+//
+// Copy the live frames to a new file, and swap it in. The copying
+// happens without holding either lock, so appends, ours or other
+// processes', can carry on in the meantime. Whatever they add is 
+// copied over at the end.
+//
+// private
+bool
+Ookala::Journal::doCompact()
+{
+    std::vector<std::pair<uint64_t, uint32_t> > frames;
+    std::map<uint64_t, uint64_t>                moved;
+    _JournalCalibMap                            calib;
+    _JournalLutMap                              luts;
+    _JournalFileLock                            fileLock;
+    std::vector<uint8_t>                        data;
+    std::string                                 out;
+    uint64_t                                    end, fileId;
+    uint64_t                                    size, id;
+    char                                        suffix[32];
+    FILE                                       *fid;
+    bool                                        ret;
+    bool                                        replaced = false;
+
+    // Another process may be compacting the same file.
+#ifdef WIN32
+    snprintf(suffix, sizeof(suffix), ".%lu.compact", 
+                                (unsigned long)GetCurrentProcessId());
+#else
+    snprintf(suffix, sizeof(suffix), ".%lu.compact", 
+                                (unsigned long)getpid());
+#endif
+    std::string tmpName = mJournalData->mFilename + suffix;
+
+    if (!fileLock.lock(mJournalData->mFilename)) {
+        mJournalData->mMutex.lock();
+        mJournalData->mErrorString = std::string("Can't lock ") +
+                                                mJournalData->mFilename;
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    mJournalData->mMutex.lock();
+
+    if (((!mJournalData->mScanned) || (fileChanged())) && 
+                                                (!scanLocked())) {
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    for (std::map<std::string, _JournalDict>::iterator live =
+                                        mJournalData->mLive.begin();
+            live != mJournalData->mLive.end(); ++live) {
+        for (_JournalDict::iterator theKey = live->second.begin();
+                theKey != live->second.end(); ++theKey) {
+            frames.push_back(std::make_pair(theKey->second.offset,
+                                            theKey->second.size));
+        }
+    }
+
+    // Along with the luts something still uses. Each comes before
+    // the first item that needed it, so sorting keeps them in order.
+    for (_JournalLutMap::iterator theLut = mJournalData->mLuts.begin();
+            theLut != mJournalData->mLuts.end(); ++theLut) {
+        if ((theLut->second.refs) && (theLut->second.size)) {
+            frames.push_back(std::make_pair(theLut->second.offset,
+                                            theLut->second.size));
+            luts[theLut->first] = theLut->second;
+        }
+    }
+
+    calib  = mJournalData->mCalib;
+    end    = mJournalData->mEnd;
+    fileId = mJournalData->mFileId;
+
+    mJournalData->mMutex.unlock();
+    fileLock.unlock();
+
+    // Nothing on disk yet
+    if (end == 0) {
+        return true;
+    }
+
+    // Appends only ever add past end, so this part of the file is
+    // stable. If someone compacts it meanwhile, we find out below.
+    if ((!_journalRead(mJournalData->mFilename, 0, end, data)) ||
+            (data.size() != end)) {
+        mJournalData->mMutex.lock();
+        mJournalData->mErrorString = std::string("Can't read ") +
+                                                mJournalData->mFilename;
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    std::sort(frames.begin(), frames.end());
+
+    // The copy is always the current version, so older journals
+    // start sharing luts from here on. Its generation is one on
+    // from the old file's, for _journalFileStamp().
+    out.append(_JOURNAL_MAGIC);
+    packU32(out, _JOURNAL_VERSION);
+    packU32(out, unpackU32(&data[12]) + 1);
+    for (std::vector<std::pair<uint64_t, uint32_t> >::iterator theFrame =
+            frames.begin(); theFrame != frames.end(); ++theFrame) {
+        moved[theFrame->first] = out.size();
+        out.append((const char *)&data[theFrame->first], theFrame->second);
+    }
+
+    for (_JournalCalibMap::iterator theCalib = calib.begin();
+            theCalib != calib.end(); ++theCalib) {
+        theCalib->second.offset = moved[theCalib->second.offset];
+    }
+    for (_JournalLutMap::iterator theLut = luts.begin();
+            theLut != luts.end(); ++theLut) {
+        theLut->second.offset = moved[theLut->second.offset];
+    }
+    addIndex(out, 0, calib, luts);
+
+    fid = fopen(tmpName.c_str(), "wb");
+    if (!fid) {
+        mJournalData->mMutex.lock();
+        mJournalData->mErrorString = std::string("Can't open ") + tmpName;
+        mJournalData->mMutex.unlock();
+        return false;
+    }
+
+    ret = (fwrite(out.data(), 1, out.size(), fid) == out.size());
+
+    // Now catch up with anything appended since we started, and
+    // put the new file in place.
+    if (!fileLock.lock(mJournalData->mFilename)) {
+        mJournalData->mMutex.lock();
+        mJournalData->mErrorString = std::string("Can't lock ") +
+                                                mJournalData->mFilename;
+        ret = false;
+    } else {
+        mJournalData->mMutex.lock();
+    }
+
+    if (ret) {
+        _journalFileStamp(mJournalData->mFilename, size, id);
+
+        // If someone else got there first, leave them to it.
+        if (id != fileId) {
+            replaced = true;
+        } else if (((!mJournalData->mScanned) || 
+                            (size != mJournalData->mEnd)) &&
+                        (!scanLocked())) {
+            ret = false;
+        } else if (mJournalData->mEnd < end) {
+            mJournalData->mErrorString = mJournalData->mFilename +
+                                    " shrank during compaction.";
+            ret = false;
+        }
+    }
+
+    if ((ret) && (!replaced) && (mJournalData->mEnd > end)) {
+        std::vector<uint8_t> recent;
+
+        ret = (_journalRead(mJournalData->mFilename, end,
+                            mJournalData->mEnd - end, recent)) &&
+              (recent.size() == mJournalData->mEnd - end) &&
+              (fwrite(&recent[0], 1, recent.size(), fid) == recent.size());
+        if (ret) {
+            out.append((const char *)&recent[0], recent.size());
+        }
+    }
+
+    if ((ret) && (!replaced)) {
+        std::vector<uint8_t> newData(out.begin(), out.end());
+
+        // The frames all moved; work out where they are now. Index
+        // frames copied over from recent appends point into the old
+        // file, so finish with a fresh one.
+        ret = scanBuffer(newData);
+        if (ret) {
+            std::string index;
+
+            addIndex(index, newData.size(), mJournalData->mCalib,
+                                            mJournalData->mLuts);
+            ret = (fwrite(index.data(), 1, index.size(), fid) ==
+                                                        index.size());
+            mJournalData->mEnd += index.size();
+        }
+    }
+
+    ret = _journalSync(fid) && ret;
+    ret = (fclose(fid) == 0) && ret;
+
+    if ((ret) && (!replaced) &&
+            (!_journalReplace(tmpName, mJournalData->mFilename))) {
+        mJournalData->mErrorString = std::string("Can't rename ") +
+                                tmpName + " to " + mJournalData->mFilename;
+        ret = false;
+    }
+
+    if ((!ret) || (replaced)) {
+        remove(tmpName.c_str());
+
+        // Whatever we think we know may be about the new file, or
+        // someone else's; read the file again next time.
+        mJournalData->mScanned = false;
+        if ((!ret) && (mJournalData->mErrorString.empty())) {
+            mJournalData->mErrorString = std::string("Error writing ") +
+                                                            tmpName;
+        }
+    } else {
+        _journalFileStamp(mJournalData->mFilename, size, 
+                          mJournalData->mFileId);
+    }
+
+    mJournalData->mMutex.unlock();
+    fileLock.unlock();
+
+    return ret;
+}
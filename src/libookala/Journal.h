@@ -0,0 +1,258 @@
+// --------------------------------------------------------------------------
+// $Id: Journal.h 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+// 
+// Permission is hereby granted, free of charge, to any person obtaining 
+// a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation 
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the 
+// Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included 
+// in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR 
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR 
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+
+#ifndef JOURNAL_H_HAS_BEEN_INCLUDED
+#define JOURNAL_H_HAS_BEEN_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <thread>
+
+#include "Types.h"
+#include "Plugin.h"
+#include "Mutex.h"
+
+namespace Ookala {
+
+class Dict;
+class DictHash;
+class CalibRecordDictItem;
+class LutStore;
+struct CalibRecordHandle;
+
+//
+// Append-only store for Dicts. DataSavior uses one for each file 
+// name ending in ".journal", instead of rewriting a whole xml 
+// document on every save. append() only writes the items that have
+// changed since the last append, so a save costs about the same 
+// whether the file holds a week of calibration history or years.
+//
+// The file is a header followed by checksummed frames. Integers are
+// little-endian:
+//
+//    header:  "OMCFJRNL" <u32 version> <u32 generation>
+//    frame:   <u32 magic> <u8 kind> <u8 pad[3]> <u32 length> <u32 crc>
+//             <payload>
+//
+// An item frame holds a dict name, a key, and the item as a 
+// <dict><dictitem/></dict> snippet, plus the device, preset and time
+// for calibRecords. The calibration plugin name follows the snippet; 
+// frames written before it was added just end there. A remove frame
+// holds just the dict name and key.
+// The last frame on a key wins. Each append finishes with an index
+// frame giving the newest calibRecord for each device and preset, 
+// followed by a short tail pointing back at it, so that record can be
+// found from the end of the file without reading the rest.
+//
+// From version 2 on, calibRecords refer to their luts by hash (see
+// LutStore), and each distinct lut is written once, in a lut frame
+// ahead of the first item that needs it. A calibRecord frame lists
+// those hashes after the plugin name, and the index lists where the
+// luts of the records it points at are. Version 1 journals keep 
+// their luts inline until they're next compacted.
+//
+// If we die half-way through an append, the partial frame fails its
+// checksum. Reading stops there, and the next append cuts it off.
+// Damage further in is stepped over by looking for the next good
+// frame, so everything around it is still read; the next append 
+// then compacts the file, which leaves the damage behind.
+//
+// Once superseded frames make up more than half of a big enough file,
+// append() starts a compaction in the background. It copies the live
+// frames to a new file and renames that over the old one.
+//
+// Several processes can share a journal. Appends and compactions
+// take an exclusive lock on filename + ".lock" while they write, 
+// and if the file isn't the way we last left it, read it again
+// first, so nobody cuts off or renames over what another wrote.
+// Each compaction bumps the generation in the header, so a file 
+// that was replaced can be told apart even when it gets the old
+// one's inode. Files from before that have 0 there.
+//
+class EXIMPORT Journal
+{
+    public:
+        Journal(const std::string &filename);
+        virtual ~Journal();
+
+        // Does filename hold a journal, rather than xml?
+        static bool isJournal(const std::string &filename);
+
+        std::string getFilename();
+        std::string getErrorString();
+
+        // Write out whatever has changed in dicts since the last 
+        // append(). As with an xml save, keys and dicts that are 
+        // no longer around are removed from the journal. Items that
+        // went out through the non-const Dict::get() may have been
+        // edited in place, so they're serialized again every time, 
+        // and written if they differ.
+        bool        append(const std::vector<Dict *> &dicts);
+
+        // Read the newest version of every item into hash.
+        bool        load(DictHash *hash);
+
+        // Only read the dicts named in dictNames. If nothing else
+        // has written to the file since we last read or appended 
+        // to it, only their frames are read from disk.
+        bool        load(DictHash *hash, 
+                         const std::vector<std::string> &dictNames);
+
+        // Fetch the newest calibRecord for deviceId and preset. This
+        // only needs the index at the end of the file if the journal
+        // hasn't been read yet. Returns false if there isn't one.
+        bool        getLatestCalibRecord(const std::string   &deviceId,
+                                         uint32_t             preset,
+                                         CalibRecordDictItem &record);
+
+        // Add a handle for every calibRecord in the journal.
+        bool        getCalibRecords(std::vector<CalibRecordHandle> &handles);
+
+        // Fetch the calibRecord stored under dictName and key.
+        bool        getCalibRecord(const std::string   &dictName,
+                                   const std::string   &key,
+                                   CalibRecordDictItem &record);
+
+        // Rewrite the file with only the live frames, now, rather
+        // than waiting for append() to decide it's time.
+        bool        compact();
+
+    private:
+        // Journals hold a file and maybe a thread, so they can't
+        // be copied.
+        Journal(const Journal &src);
+        Journal & operator=(const Journal &src);
+
+        struct _JournalEntry {
+            uint64_t    offset;           // Start of the item frame
+            uint32_t    size;             // Frame size, with header
+            uint64_t    hash;             // packHash() of the payload
+
+            // Set for calibRecords
+            bool        isCalib;
+            std::string deviceId;
+            uint32_t    preset;
+            uint32_t    calibrationTime;
+            std::string calibrationPluginName;
+            std::vector<std::string> luts;   // Hashes of shared luts
+        };
+
+        struct _JournalCalib {
+            std::string dictName;
+            std::string key;
+            uint32_t    calibrationTime;
+            uint64_t    offset;
+            std::vector<std::string> luts;
+        };
+
+        struct _JournalLut {
+            uint64_t    offset;           // Start of the lut frame
+            uint32_t    size;             // Frame size, with header
+            uint32_t    refs;             // Live items using it
+        };
+
+        typedef std::map<std::string, _JournalEntry>         _JournalDict;
+        typedef std::pair<std::string, uint32_t>             _JournalCalibKey;
+        typedef std::map<_JournalCalibKey, _JournalCalib>    _JournalCalibMap;
+        typedef std::map<std::string, _JournalLut>           _JournalLutMap;
+
+        struct _Journal {
+            std::string                                mFilename;
+            std::string                                mErrorString;
+
+            // The file has been read, and what follows is valid
+            bool                                       mScanned;
+
+            // End of the last good frame, and how much of the file
+            // is frames that haven't been superseded.
+            uint64_t                                   mEnd;
+            uint64_t                                   mLiveBytes;
+
+            // Inode or file index of the file mEnd is about, so we
+            // notice if someone else compacts it.
+            uint64_t                                   mFileId;
+
+            // Some of the file before mEnd had to be skipped over
+            bool                                       mDamaged;
+
+            // dict name -> key -> newest item frame 
+            std::map<std::string, _JournalDict>        mLive;
+
+            // Newest calibRecord per (device, preset)
+            _JournalCalibMap                           mCalib;
+
+            // Lut hash -> newest lut frame
+            _JournalLutMap                             mLuts;
+
+            // Version from the file header
+            uint32_t                                   mVersion;
+
+            // Dict versions as of the last append
+            std::map<std::string, uint64_t>            mSeen;
+
+            Mutex                                      mMutex;
+
+            std::thread                                mCompactThread;
+            std::atomic<bool>                          mCompacting;
+        };
+
+        _Journal *mJournalData;
+
+        // These expect mMutex to be held.
+        bool        readLocked(std::vector<uint8_t> &data);
+        bool        scanLocked();
+        bool        fileChanged();
+        bool        scanBuffer(const std::vector<uint8_t> &data);
+        bool        readFrame(uint64_t offset, uint8_t &kind,
+                              std::vector<uint8_t> &payload);
+        bool        writeLocked(const std::string &buf);
+        void        addIndex(std::string &buf, uint64_t base, 
+                             const _JournalCalibMap &calib,
+                             const _JournalLutMap   &luts);
+        void        setEntry(const std::string   &dictName, 
+                             const std::string   &key,
+                             const _JournalEntry &entry);
+        void        removeEntry(const std::string &dictName, 
+                                const std::string &key);
+        void        setLut(const std::string &hash, uint64_t offset,
+                           uint32_t size);
+        void        refLuts(const std::vector<std::string> &hashes, 
+                            bool add);
+        bool        readLuts(const std::vector<std::string> &hashes,
+                             const _JournalLutMap           &luts,
+                             const std::vector<uint8_t>     *data,
+                             LutStore                       &store);
+        void        updateCalib(const _JournalCalibKey &calibKey);
+        void        startCompaction();
+
+        void        compactMain();
+        bool        doCompact();
+};
+
+}; // namespace Ookala
+
+#endif
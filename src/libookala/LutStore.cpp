@@ -0,0 +1,375 @@
+// --------------------------------------------------------------------------
+// $Id: LutStore.cpp 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+#ifdef _WIN32
+#pragma warning(disable: 4786)
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Dict.h"
+#include "LutStore.h"
+#include "Pack.h"
+
+// Luts shorter than this are written inline; a reference would
+// save next to nothing.
+#define _LUTSTORE_MIN_SIZE 16
+
+namespace {
+
+thread_local Ookala::LutStore *tCurrentLutStore = NULL;
+
+// 64-bit FNV-1a over the length and the little-endian values
+std::string
+_lutStoreHash(const std::vector<uint32_t> &lut)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    uint32_t size = (uint32_t)lut.size();
+    char     str[32];
+
+    for (int b=0; b<4; ++b) {
+        hash ^= (size >> (8*b)) & 0xff;
+        hash *= 0x100000001b3ULL;
+    }
+
+    for (std::vector<uint32_t>::const_iterator theValue = lut.begin();
+            theValue != lut.end(); ++theValue) {
+        for (int b=0; b<4; ++b) {
+            hash ^= (*theValue >> (8*b)) & 0xff;
+            hash *= 0x100000001b3ULL;
+        }
+    }
+
+    snprintf(str, sizeof(str), "%016llx", (unsigned long long)hash);
+
+    return std::string(str);
+}
+
+// The packed array helpers are protected in DictItem; this gets 
+// at them without exposing them to everyone.
+class _LutStoreArrays: public Ookala::DictItem
+{
+    public:
+        static void write(xmlNodePtr root, const std::vector<uint32_t> &lut)
+        {
+            serializeDeltaArray(root, 
+                            reinterpret_cast<const int32_t *>(&lut[0]),
+                            lut.size());
+        }
+
+        static bool read(xmlDocPtr doc, xmlNodePtr root, 
+                         std::vector<int32_t> &values)
+        {
+            return unserializeArray(doc, root, values);
+        }
+};
+
+}; // namespace
+
+// ===================================
+// 
+// LutStore
+//
+// -----------------------------------
+//
+Ookala::LutStore::LutStore()
+{
+    mLutStoreData = new _LutStore;
+}
+
+// -----------------------------------
+//
+Ookala::LutStore::LutStore(const LutStore &src)
+{
+    mLutStoreData = new _LutStore;
+
+    if (src.mLutStoreData) {
+        *mLutStoreData = *(src.mLutStoreData);
+    }
+}
+
+// -----------------------------------
+//
+// virtual
+Ookala::LutStore::~LutStore()
+{
+    if (mLutStoreData) {
+        delete mLutStoreData;
+        mLutStoreData = NULL;
+    }
+}
+
+// ----------------------------
+//
+Ookala::LutStore &
+Ookala::LutStore::operator=(const LutStore &src)
+{
+    if (this != &src) {
+        if (mLutStoreData) {
+            delete mLutStoreData;
+            mLutStoreData = NULL;
+        }
+
+        mLutStoreData = new _LutStore;
+        if (src.mLutStoreData) {
+            *mLutStoreData = *(src.mLutStoreData);
+        }
+    }
+
+    return *this;
+}
+
+// -----------------------------------
+//
+// static
+Ookala::LutStore *
+Ookala::LutStore::setCurrent(LutStore *store)
+{
+    LutStore *prev = tCurrentLutStore;
+
+    tCurrentLutStore = store;
+
+    return prev;
+}
+
+// -----------------------------------
+//
+// static
+Ookala::LutStore *
+Ookala::LutStore::getCurrent()
+{
+    return tCurrentLutStore;
+}
+
+// -----------------------------------
+//
+std::string
+Ookala::LutStore::add(const std::vector<uint32_t> &lut)
+{
+    if (lut.size() < _LUTSTORE_MIN_SIZE) {
+        return std::string();
+    }
+
+    std::string hash = _lutStoreHash(lut);
+
+    std::map<std::string, std::vector<uint32_t> >::iterator theLut =
+                                        mLutStoreData->mLuts.find(hash);
+    if (theLut == mLutStoreData->mLuts.end()) {
+        mLutStoreData->mLuts[hash] = lut;
+    } else if (theLut->second != lut) {
+        return std::string();
+    }
+
+    if (mLutStoreData->mAddedSet.insert(hash).second) {
+        mLutStoreData->mAdded.push_back(hash);
+    }
+
+    return hash;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::LutStore::get(const std::string     &hash, 
+                      std::vector<uint32_t> &lut) const
+{
+    std::map<std::string, std::vector<uint32_t> >::const_iterator theLut =
+                                        mLutStoreData->mLuts.find(hash);
+    if (theLut == mLutStoreData->mLuts.end()) {
+        return false;
+    }
+
+    lut = theLut->second;
+
+    return true;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::LutStore::has(const std::string &hash) const
+{
+    return mLutStoreData->mLuts.find(hash) != mLutStoreData->mLuts.end();
+}
+
+// -----------------------------------
+//
+std::vector<std::string>
+Ookala::LutStore::getHashes() const
+{
+    std::vector<std::string> hashes;
+
+    for (std::map<std::string, std::vector<uint32_t> >::const_iterator 
+                theLut = mLutStoreData->mLuts.begin();
+            theLut != mLutStoreData->mLuts.end(); ++theLut) {
+        hashes.push_back(theLut->first);
+    }
+
+    return hashes;
+}
+
+// -----------------------------------
+//
+uint32_t
+Ookala::LutStore::size() const
+{
+    return (uint32_t)mLutStoreData->mLuts.size();
+}
+
+// -----------------------------------
+//
+void
+Ookala::LutStore::clear()
+{
+    mLutStoreData->mLuts.clear();
+    mLutStoreData->mAdded.clear();
+    mLutStoreData->mAddedSet.clear();
+}
+
+// -----------------------------------
+//
+std::vector<std::string>
+Ookala::LutStore::takeAdded()
+{
+    std::vector<std::string> added;
+
+    added.swap(mLutStoreData->mAdded);
+    mLutStoreData->mAddedSet.clear();
+
+    return added;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::LutStore::serialize(xmlNodePtr root, const std::string &hash) const
+{
+    std::map<std::string, std::vector<uint32_t> >::const_iterator theLut =
+                                        mLutStoreData->mLuts.find(hash);
+    if (theLut == mLutStoreData->mLuts.end()) {
+        return false;
+    }
+
+    xmlNodePtr lutNode = xmlNewTextChild(root, NULL, 
+                                         (const xmlChar *)"lut", NULL);
+    xmlSetProp(lutNode, (const xmlChar *)"hash", 
+                        (const xmlChar *)hash.c_str());
+
+    _LutStoreArrays::write(lutNode, theLut->second);
+
+    return true;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::LutStore::unserialize(xmlDocPtr doc, xmlNodePtr node)
+{
+    std::vector<int32_t> values;
+    std::string          hash;
+    xmlChar             *attr;
+
+    attr = xmlGetProp(node, (const xmlChar *)"hash");
+    if (attr != NULL) {
+        hash = (const char *)attr;
+        xmlFree(attr);
+    }
+
+    if (!_LutStoreArrays::read(doc, node, values)) {
+        return false;
+    }
+
+    std::vector<uint32_t> lut(values.begin(), values.end());
+
+    if ((hash.empty()) || (add(lut) != hash)) {
+        fprintf(stderr, "LutStore: lut %s doesn't match its hash\n",
+                                                        hash.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+// Packed as <str hash> <u32 count>, then a varint per value of its
+// zigzagged step from the one before, the same as the 
+// "delta-varint" xml encoding.
+bool
+Ookala::LutStore::serializeBinary(const std::string &hash, 
+                                  std::string &buf) const
+{
+    std::map<std::string, std::vector<uint32_t> >::const_iterator theLut =
+                                        mLutStoreData->mLuts.find(hash);
+    if (theLut == mLutStoreData->mLuts.end()) {
+        return false;
+    }
+
+    uint32_t prev = 0;
+
+    packString(buf, hash);
+    packU32(buf, (uint32_t)theLut->second.size());
+    for (std::vector<uint32_t>::const_iterator theValue = 
+                                        theLut->second.begin();
+            theValue != theLut->second.end(); ++theValue) {
+        int32_t delta = (int32_t)(*theValue - prev);
+
+        packVarint(buf, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+        prev = *theValue;
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+bool
+Ookala::LutStore::unserializeBinary(PackReader &reader)
+{
+    std::string hash  = reader.str();
+    uint32_t    count = reader.u32();
+
+    if ((!reader.ok()) || (reader.left() < count)) {
+        return false;
+    }
+
+    std::vector<uint32_t> lut(count);
+    uint32_t              prev = 0;
+
+    for (uint32_t idx=0; idx<count; ++idx) {
+        uint64_t value = reader.varint();
+
+        prev    += (uint32_t)(value >> 1) ^ (0u - (uint32_t)(value & 1));
+        lut[idx] = prev;
+    }
+
+    if ((!reader.ok()) || (hash.empty()) || (add(lut) != hash)) {
+        fprintf(stderr, "LutStore: lut %s doesn't match its hash\n",
+                                                        hash.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,111 @@
+// --------------------------------------------------------------------------
+// $Id: LutStore.h 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+// 
+// Permission is hereby granted, free of charge, to any person obtaining 
+// a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation 
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the 
+// Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included 
+// in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR 
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR 
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+#ifndef LUTSTORE_H_HAS_BEEN_INCLUDED
+#define LUTSTORE_H_HAS_BEEN_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include <libxml/parser.h>
+
+#include "Types.h"
+#include "Plugin.h"
+
+namespace Ookala {
+
+class PackReader;
+
+//
+// A set of luts, each kept once and named by a hash of its
+// contents. Successive calibrations of a preset often come up with
+// the same luts, so DataSavior saves them through one of these: 
+// each calibRecord refers to its luts by hash, and the luts are 
+// written once per file, or once per journal.
+//
+// A store is made current for a thread while saving or loading. CalibRecordDictItem::serialize() puts its luts
+// in the current store, and unserialize() looks them up there. With
+// no store current, luts are written inline as before.
+//
+class EXIMPORT LutStore
+{
+    public:
+        LutStore();
+        LutStore(const LutStore &src);
+        virtual ~LutStore();
+        LutStore & operator=(const LutStore &src);
+
+        // Make store current for the calling thread (NULL for none),
+        // returning whatever was current before.
+        static LutStore *setCurrent(LutStore *store);
+        static LutStore *getCurrent();
+
+        // Add lut, and return the hash to find it by. Short luts 
+        // aren't worth sharing, and on the off chance that a different
+        // lut already has the same hash, we can't share that either; 
+        // both return an empty string.
+        std::string              add(const std::vector<uint32_t> &lut);
+
+        bool                     get(const std::string     &hash,
+                                     std::vector<uint32_t> &lut) const;
+
+        bool                     has(const std::string &hash) const;
+
+        std::vector<std::string> getHashes() const;
+        uint32_t                 size() const;
+        void                     clear();
+
+        // Hashes returned by add() since the last call, without 
+        // repeats. Savers use this to find which luts an item needs.
+        std::vector<std::string> takeAdded();
+
+        // Write a lut as <lut hash="...">, holding a packed array,
+        // under root.
+        bool                     serialize(xmlNodePtr root, 
+                                           const std::string &hash) const;
+
+        // Read a <lut> node back. The contents have to match the hash.
+        bool                     unserialize(xmlDocPtr doc, xmlNodePtr node);
+
+        // The same, in the little-endian form from Pack.h
+        bool                     serializeBinary(const std::string &hash,
+                                                 std::string &buf) const;
+        bool                     unserializeBinary(PackReader &reader);
+
+    private:
+        struct _LutStore {
+            std::map<std::string, std::vector<uint32_t> > mLuts;
+
+            std::vector<std::string>                      mAdded;
+            std::set<std::string>                         mAddedSet;
+        };
+
+        _LutStore *mLutStoreData;
+};
+
+}; // namespace Ookala
+
+#endif
@@ -79,3 +79,160 @@ Ookala::Mutex::unlock()
 #endif
 }
 
+// ====================================
+//
+// Condition
+//
+// ------------------------------------
+//
+// Windows mutex handles don't work with condition variables, so 
+// there waiters block on a semaphore instead. mWaiters is covered 
+// by the caller's mutex.
+Ookala::Condition::Condition()
+{
+#ifdef _WIN32
+    mWaiters = 0;
+    mSemaWin = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+#else
+    pthread_cond_init(&mCondPthread, NULL);
+#endif
+}
+
+// ------------------------------------
+//
+Ookala::Condition::~Condition()
+{
+#ifdef _WIN32
+    CloseHandle(mSemaWin);
+#else
+    pthread_cond_destroy(&mCondPthread);
+#endif
+}
+
+// ------------------------------------
+//
+void
+Ookala::Condition::wait(Mutex &mutex)
+{
+#ifdef _WIN32
+    mWaiters++;
+    mutex.unlock();
+    WaitForSingleObject(mSemaWin, INFINITE);
+    mutex.lock();
+#else
+    pthread_cond_wait(&mCondPthread, &mutex.mMutexPthread);
+#endif
+}
+
+// ------------------------------------
+//
+void
+Ookala::Condition::signal()
+{
+#ifdef _WIN32
+    if (mWaiters > 0) {
+        mWaiters--;
+        ReleaseSemaphore(mSemaWin, 1, NULL);
+    }
+#else
+    pthread_cond_signal(&mCondPthread);
+#endif
+}
+
+// ------------------------------------
+//
+void
+Ookala::Condition::broadcast()
+{
+#ifdef _WIN32
+    if (mWaiters > 0) {
+        ReleaseSemaphore(mSemaWin, mWaiters, NULL);
+        mWaiters = 0;
+    }
+#else
+    pthread_cond_broadcast(&mCondPthread);
+#endif
+}
+
+// ====================================
+//
+// RwLock
+//
+// ------------------------------------
+
+Ookala::RwLock::RwLock()
+{
+#ifdef _WIN32
+    InitializeSRWLock(&mLockWin);
+#else
+    pthread_rwlockattr_t attr;
+
+    pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+    // By default, glibc lets a steady stream of readers starve 
+    // out a writer. Chains poll their dicts constantly, so ask 
+    // for the writer to go first.
+    pthread_rwlockattr_setkind_np(&attr, 
+                    PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init(&mLockPthread, &attr);
+    pthread_rwlockattr_destroy(&attr);
+#endif
+}
+
+// ------------------------------------
+//
+Ookala::RwLock::~RwLock()
+{
+#ifndef _WIN32
+    pthread_rwlock_destroy(&mLockPthread);
+#endif
+}
+
+// ------------------------------------
+//
+void
+Ookala::RwLock::readLock()
+{
+#ifdef _WIN32
+    AcquireSRWLockShared(&mLockWin);
+#else
+    pthread_rwlock_rdlock(&mLockPthread);
+#endif
+}
+
+// ------------------------------------
+//
+void
+Ookala::RwLock::readUnlock()
+{
+#ifdef _WIN32
+    ReleaseSRWLockShared(&mLockWin);
+#else
+    pthread_rwlock_unlock(&mLockPthread);
+#endif
+}
+
+// ------------------------------------
+//
+void
+Ookala::RwLock::writeLock()
+{
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&mLockWin);
+#else
+    pthread_rwlock_wrlock(&mLockPthread);
+#endif
+}
+
+// ------------------------------------
+//
+void
+Ookala::RwLock::writeUnlock()
+{
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(&mLockWin);
+#else
+    pthread_rwlock_unlock(&mLockPthread);
+#endif
+}
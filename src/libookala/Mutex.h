@@ -54,6 +54,64 @@ class EXIMPORT Mutex
 #else
         pthread_mutex_t mMutexPthread;        
 #endif
+
+        friend class Condition;
+};
+
+// Condition variable to go with a Mutex. wait() must be called 
+// with the mutex locked, and it comes back with it locked again.
+// Wake-ups can be spurious, so wait in a loop on whatever you're 
+// waiting for. Signal with the mutex locked, too.
+class EXIMPORT Condition
+{
+    public:
+        Condition();
+        ~Condition();
+
+        void wait(Mutex &mutex);
+
+        // Wake one waiter, or all of them.
+        void signal();
+        void broadcast();
+
+    protected:
+#ifdef WIN32
+        HANDLE         mSemaWin;
+        uint32_t       mWaiters;
+#else
+        pthread_cond_t mCondPthread;
+#endif
+
+    private:
+        Condition(const Condition &src);
+        Condition & operator=(const Condition &src);
+};
+
+// Reader/writer lock; any number of readers, or one writer. 
+// Not recursive, so don't re-lock from inside a locked section.
+class EXIMPORT RwLock
+{
+    public:
+        RwLock();
+        ~RwLock();
+
+        void readLock();
+        void readUnlock();
+
+        void writeLock();
+        void writeUnlock();
+
+    protected:
+#ifdef WIN32
+        SRWLOCK          mLockWin;
+#else
+        pthread_rwlock_t mLockPthread;
+#endif
+
+    private:
+        // Locks can't be copied.
+        RwLock(const RwLock &src);
+        RwLock & operator=(const RwLock &src);
 };
 
 }; // namespace Ookala
@@ -0,0 +1,259 @@
+// --------------------------------------------------------------------------
+// $Id: Pack.h 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+// 
+// Permission is hereby granted, free of charge, to any person obtaining 
+// a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation 
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the 
+// Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included 
+// in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR 
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR 
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+
+#ifndef PACK_H_HAS_BEEN_INCLUDED
+#define PACK_H_HAS_BEEN_INCLUDED
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "Types.h"
+
+namespace Ookala {
+
+//
+// Helpers for the binary files we write, like journals and load 
+// caches. Values are appended to a string little-endian, whatever
+// the host, and read back with a PackReader.
+//
+
+inline void
+packU8(std::string &buf, uint8_t value)
+{
+    buf.push_back((char)value);
+}
+
+inline void
+packU32(std::string &buf, uint32_t value)
+{
+    char bytes[4];
+
+    for (int i=0; i<4; ++i) {
+        bytes[i] = (char)((value >> (8*i)) & 0xff);
+    }
+    buf.append(bytes, 4);
+}
+
+inline void
+packU64(std::string &buf, uint64_t value)
+{
+    packU32(buf, (uint32_t)(value & 0xffffffff));
+    packU32(buf, (uint32_t)(value >> 32));
+}
+
+inline void
+packDouble(std::string &buf, double value)
+{
+    uint64_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    packU64(buf, bits);
+}
+
+inline void
+packString(std::string &buf, const std::string &value)
+{
+    packU32(buf, (uint32_t)value.size());
+    buf.append(value);
+}
+
+// Base-128, low 7 bits first, for values that are usually small.
+inline void
+packVarint(std::string &buf, uint64_t value)
+{
+    while (value >= 0x80) {
+        buf.push_back((char)((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    buf.push_back((char)value);
+}
+
+inline uint32_t
+unpackU32(const uint8_t *ptr)
+{
+    return  (uint32_t)ptr[0]        | ((uint32_t)ptr[1] << 8) |
+           ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+inline uint64_t
+unpackU64(const uint8_t *ptr)
+{
+    return (uint64_t)unpackU32(ptr) | ((uint64_t)unpackU32(ptr+4) << 32);
+}
+
+// Standard crc32. Pass the result back in to continue a checksum
+// over another chunk.
+inline uint32_t
+packCrc(uint32_t crc, const void *data, size_t size)
+{
+    struct CrcTable {
+        uint32_t entry[256];
+
+        CrcTable() {
+            for (uint32_t i=0; i<256; ++i) {
+                uint32_t c = i;
+                for (int bit=0; bit<8; ++bit) {
+                    c = (c & 1)? (0xedb88320 ^ (c >> 1)): (c >> 1);
+                }
+                entry[i] = c;
+            }
+        }
+    };
+    static const CrcTable table;
+
+    const uint8_t *ptr = (const uint8_t *)data;
+
+    crc = ~crc;
+    while (size--) {
+        crc = table.entry[(crc ^ *ptr++) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+// 64-bit hash, for telling apart buffers a crc32 might mix up. 
+// Eight bytes at a time, so it's cheap enough to run over whole 
+// files.
+inline uint64_t
+packHash(const void *data, size_t size)
+{
+    const uint8_t  *ptr   = (const uint8_t *)data;
+    const uint64_t  prime = 0x100000001b3ULL;
+    uint64_t        hash  = 0xcbf29ce484222325ULL ^ size;
+    size_t          idx;
+
+    for (idx=0; idx+8 <= size; idx+=8) {
+        uint64_t word;
+
+        memcpy(&word, ptr+idx, 8);
+        hash  = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+
+    for (; idx<size; ++idx) {
+        hash = (hash ^ ptr[idx]) * prime;
+    }
+
+    hash ^= hash >> 32;
+    hash *= prime;
+    hash ^= hash >> 29;
+
+    return hash;
+}
+
+// -----------------------------------
+//
+// Walks a packed buffer. Once a read runs off the end, ok() goes
+// false and everything after that reads as zero, so callers can 
+// read a whole record and check once at the end.
+//
+class PackReader
+{
+    public:
+        PackReader(const uint8_t *data, size_t size):
+            mPtr(data), mLeft(size), mOk(true) {}
+
+        bool           ok()   const { return mOk; }
+        size_t         left() const { return mLeft; }
+        const uint8_t *ptr()  const { return mPtr; }
+
+        // Step over size bytes, if there are that many.
+        bool skip(size_t size) {
+            if (!have(size)) return false;
+            mPtr  += size;
+            mLeft -= size;
+            return true;
+        }
+
+        uint8_t u8() {
+            if (!have(1)) return 0;
+            mLeft--;
+            return *mPtr++;
+        }
+
+        uint32_t u32() {
+            if (!have(4)) return 0;
+            uint32_t value = unpackU32(mPtr);
+            mPtr  += 4;
+            mLeft -= 4;
+            return value;
+        }
+
+        uint64_t u64() {
+            if (!have(8)) return 0;
+            uint64_t value = unpackU64(mPtr);
+            mPtr  += 8;
+            mLeft -= 8;
+            return value;
+        }
+
+        double f64() {
+            uint64_t bits = u64();
+            double   value;
+
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        uint64_t varint() {
+            uint64_t value = 0;
+
+            for (int shift=0; shift<64; shift += 7) {
+                uint8_t b = u8();
+
+                value |= (uint64_t)(b & 0x7f) << shift;
+                if (!(b & 0x80)) return mOk? value: 0;
+            }
+            mOk = false;
+            return 0;
+        }
+
+        std::string str() {
+            uint32_t size = u32();
+            if (!have(size)) return std::string();
+            std::string value((const char *)mPtr, size);
+            mPtr  += size;
+            mLeft -= size;
+            return value;
+        }
+
+    private:
+        const uint8_t *mPtr;
+        size_t         mLeft;
+        bool           mOk;
+
+        bool have(size_t size) {
+            if ((!mOk) || (mLeft < size)) {
+                mOk = false;
+            }
+            return mOk;
+        }
+};
+
+}; // namespace Ookala
+
+#endif
@@ -46,6 +46,7 @@ Ookala::Plugin::Plugin()
     
 
     mPluginData = new _Plugin;
+    mPluginData->mDeclaresDependencies = false;
 }
 
 // ------------------------------------
@@ -58,10 +59,17 @@ Ookala::Plugin::Plugin(const Plugin &src)
    
 
     mPluginData = new _Plugin;  
+    mPluginData->mDeclaresDependencies = false;
     if (src.mPluginData) {
         mPluginData->mAttributes = src.mPluginData->mAttributes;
         mPluginData->mName       = src.mPluginData->mName;
         mPluginData->mErrorString= src.mPluginData->mErrorString;
+
+        mPluginData->mDependencies = src.mPluginData->mDependencies;
+        mPluginData->mAttributeDependencies = 
+                            src.mPluginData->mAttributeDependencies;
+        mPluginData->mDeclaresDependencies = 
+                            src.mPluginData->mDeclaresDependencies;
     }       
 }
 
@@ -161,6 +169,7 @@ Ookala::Plugin::checkDeps()
 {
     if (mHasCheckedDeps == false) {
         mCheckDepReturn = _checkDeps();
+        mHasCheckedDeps = true;
     }
 
     return mCheckDepReturn;
@@ -256,27 +265,53 @@ Ookala::Plugin::matchAttributes(std::vector<std::string> attributeGoals)
         return false;
     }
       
-    for (std::vector<std::string>::iterator theAttr = 
-                       mPluginData->mAttributes.begin();
-            theAttr != mPluginData->mAttributes.end(); ++theAttr) { 
-        bool found = false;
-
-        for (std::vector<std::string>::iterator j = attributeGoals.begin();
-                        j != attributeGoals.end(); ++j) {
-            if ((*theAttr) == (*j)) {
-                found = true;
-            }                
-        }
-
-        if (found == false) {
+    for (std::vector<std::string>::iterator theGoal = 
+                       attributeGoals.begin();
+            theGoal != attributeGoals.end(); ++theGoal) { 
+        if (!matchAttribute(*theGoal)) {
             return false;
         }       
     }
-   
 
     return true;
 }
 
+// ------------------------------------
+//
+
+const std::vector<std::string> &
+Ookala::Plugin::attributes() const
+{
+    return mPluginData->mAttributes;
+}
+
+// ------------------------------------
+//
+
+const std::vector<std::string> &
+Ookala::Plugin::dependencies() const
+{
+    return mPluginData->mDependencies;
+}
+
+// ------------------------------------
+//
+
+const std::vector<std::string> &
+Ookala::Plugin::attributeDependencies() const
+{
+    return mPluginData->mAttributeDependencies;
+}
+
+// ------------------------------------
+//
+
+bool
+Ookala::Plugin::declaresDependencies() const
+{
+    return mPluginData->mDeclaresDependencies;
+}
+
 // ------------------------------------
 //
 // virtual
@@ -323,6 +358,38 @@ Ookala::Plugin::addAttribute(std::string attrib)
     mPluginData->mAttributes.push_back(attrib); 
 }
 
+// ------------------------------------
+//
+// protected
+
+void
+Ookala::Plugin::addDependency(const std::string &name)
+{
+    mPluginData->mDependencies.push_back(name);
+    mPluginData->mDeclaresDependencies = true;
+}
+
+// ------------------------------------
+//
+// protected
+
+void
+Ookala::Plugin::addAttributeDependency(const std::string &attrib)
+{
+    mPluginData->mAttributeDependencies.push_back(attrib);
+    mPluginData->mDeclaresDependencies = true;
+}
+
+// ------------------------------------
+//
+// protected
+
+void
+Ookala::Plugin::declareNoDependencies()
+{
+    mPluginData->mDeclaresDependencies = true;
+}
+
 // ------------------------------------
 //
 // virtual protected
@@ -187,6 +187,18 @@ class EXIMPORT Plugin
         // Check if we have _all_ the listed attributes
         bool matchAttributes(std::vector<std::string> attributeGoals);
 
+        // Everything added with addAttribute()
+        const std::vector<std::string> & attributes() const;
+
+        // What we've said we need, by name and by attribute, from
+        // addDependency() and addAttributeDependency().
+        const std::vector<std::string> & dependencies() const;
+        const std::vector<std::string> & attributeDependencies() const;
+
+        // True once any of addDependency(), addAttributeDependency()
+        // or declareNoDependencies() has been called.
+        bool         declaresDependencies() const;
+
 
         // If we're a calibration sort of plugin, we should allow people
         // to verify that we're still in a calibrated state. This involves
@@ -225,6 +237,24 @@ class EXIMPORT Plugin
         // or "LED LCD Colorimeter".         
         void         addAttribute(std::string attrib);
 
+        // Say what we'll go looking for in checkDeps(), by name
+        // or by attribute. Call these in the constructor.
+        //
+        // A plugin that declares its dependencies, even if it's 
+        // only to say there aren't any, is initialized alongside
+        // others that it doesn't depend on: postLoad(), checkDeps() 
+        // and postCheckDeps() may run on another thread, at the 
+        // same time as other plugins' do. So they shouldn't touch 
+        // anything shared that isn't safe for that, and 
+        // checkDeps() and postCheckDeps() shouldn't look up 
+        // anything that wasn't declared.
+        //
+        // Plugins that don't declare anything are initialized
+        // on their own, in the order they were loaded.
+        void         addDependency(const std::string &name);
+        void         addAttributeDependency(const std::string &attrib);
+        void         declareNoDependencies();
+
         // The real implementation that is called by postLoad().
         // NOTE: If you're extending the plugin class, _this_ is the
         // version you want to override.
@@ -255,6 +285,10 @@ class EXIMPORT Plugin
             std::string              mName;
             std::string              mErrorString;
             std::vector<std::string> mAttributes;       
+
+            std::vector<std::string> mDependencies;
+            std::vector<std::string> mAttributeDependencies;
+            bool                     mDeclaresDependencies;
         };
 
         _Plugin *mPluginData;
@@ -347,6 +381,10 @@ class EXIMPORT Plugin
 //
 // This should allow unserilization of plugin-defined data types
 // by anyone.
+//
+// The registry only walks the dictitem_create() and dictitem_destroy()
+// functions the first time it meets a type; after that, it remembers 
+// which plugin handles the type and goes straight there.
 
 
 
@@ -45,6 +45,7 @@
 #include "PluginRegistry.h"
 #include "PluginChain.h"
 #include "Ui.h"
+#include "Trace.h"
 
 
 // =========================================
@@ -65,6 +66,11 @@ Ookala::PluginChain::PluginChain(PluginRegistry *registry)
     mPluginChainData->mDictName    = "";
     mPluginChainData->mErrorString = "";
     mPluginChainData->mName        = "";
+
+    mPluginChainData->mGeneration               = 1;
+    mPluginChainData->mDictHash                 = NULL;
+    mPluginChainData->mHandleGeneration         = 0;
+    mPluginChainData->mHandleRegistryGeneration = 0;
 }
 
 // -----------------------------------------
@@ -83,11 +89,17 @@ Ookala::PluginChain::PluginChain(const PluginChain &src)
     mPluginChainData->mErrorString = "";
     mPluginChainData->mName        = "";
 
+    mPluginChainData->mGeneration               = 1;
+    mPluginChainData->mDictHash                 = NULL;
+    mPluginChainData->mHandleGeneration         = 0;
+    mPluginChainData->mHandleRegistryGeneration = 0;
+
     if (src.mPluginChainData) {
         mPluginChainData->mDictName = src.mPluginChainData->mDictName;
         mPluginChainData->mErrorString = src.mPluginChainData->mErrorString;
         mPluginChainData->mName = src.mPluginChainData->mName;
         mPluginChainData->mPluginChain = src.mPluginChainData->mPluginChain;        
+        mPluginChainData->mPluginNames = src.mPluginChainData->mPluginNames;
     }
 }
 
@@ -115,7 +127,21 @@ Ookala::PluginChain::operator=(const PluginChain &src)
 
         if (src.mPluginChainData) {
             mPluginChainData  = new _PluginChain();
-            *mPluginChainData = *(src.mPluginChainData);
+
+            mPluginChainData->mDictName    = src.mPluginChainData->mDictName;
+            mPluginChainData->mErrorString = 
+                                    src.mPluginChainData->mErrorString;
+            mPluginChainData->mName        = src.mPluginChainData->mName;
+            mPluginChainData->mPluginChain = 
+                                    src.mPluginChainData->mPluginChain;
+            mPluginChainData->mPluginNames = 
+                                    src.mPluginChainData->mPluginNames;
+
+            // Handles get looked up again on first use.
+            mPluginChainData->mGeneration               = 1;
+            mPluginChainData->mDictHash                 = NULL;
+            mPluginChainData->mHandleGeneration         = 0;
+            mPluginChainData->mHandleRegistryGeneration = 0;
         }
 
         mRegistry          = src.mRegistry;
@@ -207,12 +233,17 @@ Ookala::PluginChain::getDict()
     if (!mPluginChainData) return NULL;
     if (!mRegistry)        return NULL;
         
+    mPluginChainData->mHandleLock.readLock();
 
-    std::vector<Plugin *>plugins = mRegistry->queryByName("DictHash");
-    if (plugins.empty()) {
-        return NULL;
+    if (handlesStale()) {
+        mPluginChainData->mHandleLock.readUnlock();
+        resolveHandles();
+        mPluginChainData->mHandleLock.readLock();
     }
-    hash = dynamic_cast<DictHash *>(plugins[0]);
+
+    hash = mPluginChainData->mDictHash;
+    mPluginChainData->mHandleLock.readUnlock();
+
     if (!hash) {
         return NULL;
     }
@@ -236,6 +267,9 @@ Ookala::PluginChain::getDict()
 // however, we should still execute _postRun() so people
 // have a chance to clean-up
 //
+// With tracing on, the chain and each plugin's preRun(), run()
+// and postRun() are recorded as spans.
+//
 // virtual
 bool
 Ookala::PluginChain::run()
@@ -250,6 +284,8 @@ Ookala::PluginChain::run()
 
     if (!mPluginChainData) return false;
 
+    TraceSpan  chainSpan("chain", name());
+
     // Record the current time, to say that we've executid
     mChainMutex.lock();
     mLastExecutionTime = time(NULL);
@@ -261,6 +297,16 @@ Ookala::PluginChain::run()
     if (mPeriod < 0) mPeriod = 0;
     
 
+    // Plugins from DSOs that weren't needed until now get 
+    // loaded here.
+    {
+        TraceSpan span("chain", "resolvePlugins");
+
+        if (!resolvePlugins()) {
+            return false;
+        }
+    }
+
     // Grab a copy of the chain, to protect from access funk.
     // We can't just lock access to mPluginChain, because when
     // we're run()'ing, we would need to lock against changes
@@ -276,6 +322,9 @@ Ookala::PluginChain::run()
 
     mChainMutex.unlock();
 
+    // Find who we'll be talking to now, rather than on the first
+    // Ui update from some plugin.
+    resolveHandles();
     
 
     if (theChain.empty()) {
@@ -287,6 +336,8 @@ Ookala::PluginChain::run()
     for (thePlugin = theChain.begin();
             thePlugin != theChain.end(); ++thePlugin) {
 
+        TraceSpan span("preRun", (*thePlugin)->name());
+
         printf("preRun %s\n", (*thePlugin)->name().c_str());
         if (((*thePlugin)->preRun(this) == false) && (wasCancelled() == false)) {
             okToRun      = false;
@@ -303,6 +354,8 @@ Ookala::PluginChain::run()
     if (okToRun) {
         for (thePlugin = theChain.begin();
                 thePlugin != theChain.end(); ++thePlugin) {
+            TraceSpan span("run", (*thePlugin)->name());
+
             printf("run %s\n", (*thePlugin)->name().c_str());
 
             if (((*thePlugin)->run(this) == false) && (wasCancelled() == false)) {
@@ -317,6 +370,8 @@ Ookala::PluginChain::run()
     
     for (thePlugin = theChain.begin();
             thePlugin != theChain.end(); ++thePlugin) {
+        TraceSpan span("postRun", (*thePlugin)->name());
+
         printf("postRun %s\n", (*thePlugin)->name().c_str());
         if (((*thePlugin)->postRun(this) == false) && (wasCancelled() == false)) {
             ret          = false;
@@ -345,6 +400,8 @@ Ookala::PluginChain::clear()
     mChainMutex.lock();
 
     mPluginChainData->mPluginChain.clear();
+    mPluginChainData->mPluginNames.clear();
+    mPluginChainData->mGeneration++;
 
     mChainMutex.unlock();
 
@@ -366,12 +423,95 @@ Ookala::PluginChain::append(Plugin *plugin)
     mChainMutex.lock();
 
     mPluginChainData->mPluginChain.push_back(plugin);
+    mPluginChainData->mPluginNames.push_back(plugin->name());
+    mPluginChainData->mGeneration++;
 
     mChainMutex.unlock();
 
     return true;
 }
 
+// -----------------------------------------
+//
+// private
+bool
+Ookala::PluginChain::appendByName(const std::string &name)
+{    
+    mChainMutex.lock();
+
+    mPluginChainData->mPluginChain.push_back(NULL);
+    mPluginChainData->mPluginNames.push_back(name);
+    mPluginChainData->mGeneration++;
+
+    mChainMutex.unlock();
+
+    return true;
+}
+
+// -----------------------------------------
+//
+// Look up anything we only have the name for. This can open
+// DSOs, so we don't hold the chain lock while we're at it.
+//
+// private
+bool
+Ookala::PluginChain::resolvePlugins()
+{
+    std::vector<Plugin *>    plugins;
+    std::vector<std::string> names;
+    uint32_t                 generation;
+    bool                     ok = true;
+
+    if (!mPluginChainData) return false;
+
+    mChainMutex.lock();
+
+    if (std::find(mPluginChainData->mPluginChain.begin(),
+                  mPluginChainData->mPluginChain.end(), 
+                  (Plugin *)NULL) == mPluginChainData->mPluginChain.end()) {
+        mChainMutex.unlock();
+        return true;
+    }
+
+    plugins    = mPluginChainData->mPluginChain;
+    names      = mPluginChainData->mPluginNames;
+    generation = mPluginChainData->mGeneration;
+
+    mChainMutex.unlock();
+
+    for (size_t idx=0; idx<plugins.size(); ++idx) {
+        if (plugins[idx] != NULL) continue;
+
+        if (mRegistry) {
+            const std::vector<Plugin *> &found = 
+                                    mRegistry->queryByName(names[idx]);
+            if (!found.empty()) {
+                plugins[idx] = found[0];
+                continue;
+            }
+        }
+
+        fprintf(stderr, "ERROR: Plugin %s not loaded..\n", 
+                                            names[idx].c_str());
+        setErrorString(std::string("Plugin ") + names[idx] + 
+                                            " not loaded.");
+        ok = false;
+    }
+
+    // If someone changed the chain while we were looking, let 
+    // them win, and we'll try again next time.
+    mChainMutex.lock();
+
+    if (mPluginChainData->mGeneration == generation) {
+        mPluginChainData->mPluginChain = plugins;
+        mPluginChainData->mGeneration++;
+    }
+
+    mChainMutex.unlock();
+
+    return ok;
+}
+
 // -----------------------------------------
 //
 // virtual
@@ -418,13 +558,15 @@ Ookala::PluginChain::queryByName(const std::string name)
 
     if (!mPluginChainData) return matches;
 
+    resolvePlugins();
+
     mChainMutex.lock();
 
     for (std::vector<Plugin *>::iterator i = 
                  mPluginChainData->mPluginChain.begin();
             i != mPluginChainData->mPluginChain.end(); ++i) {
 
-        if ((*i)->matchName(goal)) {
+        if ((*i) && (*i)->matchName(goal)) {
             matches.push_back(*i);
         }        
     }
@@ -450,13 +592,15 @@ Ookala::PluginChain::queryByAttribute(const std::string attrib)
 
     if (!mPluginChainData) return matches;
 
+    resolvePlugins();
+
     mChainMutex.lock();
 
     for (std::vector<Plugin *>::iterator i = 
                  mPluginChainData->mPluginChain.begin();
             i != mPluginChainData->mPluginChain.end(); ++i) {
 
-        if ((*i)->matchAttribute(goal)) {
+        if ((*i) && (*i)->matchAttribute(goal)) {
             matches.push_back(*i);
         }        
     }
@@ -480,13 +624,15 @@ Ookala::PluginChain::queryByAttributes(std::vector<std::string> attribs)
 
     if (!mPluginChainData) return matches;
 
+    resolvePlugins();
+
     mChainMutex.lock();
 
     for (std::vector<Plugin *>::iterator i = 
                  mPluginChainData->mPluginChain.begin();
             i != mPluginChainData->mPluginChain.end(); ++i) {
 
-        if ((*i)->matchAttributes(attribs)) {
+        if ((*i) && (*i)->matchAttributes(attribs)) {
             matches.push_back(*i);
         }        
     }
@@ -572,6 +718,41 @@ Ookala::PluginChain::serialize(xmlDocPtr doc, xmlNodePtr root)
     return false;
 }
 
+// -----------------------------------------
+//
+// Interpret the value of a hidden="..." attribute. NULL, or 
+// anything but yes/true, means we're not hidden.
+//
+// protected static
+bool
+Ookala::PluginChain::isHiddenValue(const xmlChar *value)
+{
+    if (value == NULL) {
+        return false;
+    }
+
+    std::string hidden = (const char *)value;
+
+    size_t start = hidden.find_first_not_of(" \t\n");
+    size_t end   = hidden.find_last_not_of(" \t\n");
+
+    if (start == std::string::npos) {
+        hidden = "";
+    } else {
+        hidden = hidden.substr(start, end-start+1);
+    }
+    std::transform(hidden.begin(), 
+                   hidden.end(), 
+                   hidden.begin(), 
+#ifdef _WIN32
+                   tolower);
+#else
+                   (int(*)(int))std::tolower);
+#endif
+
+    return (hidden == "yes") || (hidden == "true");
+}
+
 // -----------------------------------------
 //
 // virtual
@@ -625,34 +806,9 @@ Ookala::PluginChain::unserialize(xmlDocPtr doc, xmlNodePtr root)
     }
 
     attrName = xmlGetProp(root, (const xmlChar *)("hidden"));
+    setHidden(isHiddenValue(attrName));
     if (attrName != NULL) {
-        std::string hidden = (char *)attrName;
         xmlFree(attrName);
-
-        size_t start = hidden.find_first_not_of(" \t\n");
-        size_t end   = hidden.find_last_not_of(" \t\n");
-
-        if (start == std::string::npos) {
-            hidden = "";
-        } else {
-            hidden = hidden.substr(start, end-start+1);
-        }
-        std::transform(hidden.begin(), 
-                       hidden.end(), 
-                       hidden.begin(), 
-#ifdef _WIN32
-                       tolower);
-#else
-                       (int(*)(int))std::tolower);
-#endif
-
-        if ((hidden == "yes") || (hidden == "true")) {
-            setHidden(true);
-        } else {
-            setHidden(false);
-        }
-    } else {
-        setHidden(false);
     }
 
 
@@ -707,12 +863,13 @@ Ookala::PluginChain::unserialize(xmlDocPtr doc, xmlNodePtr root)
             if (chainOk) {
                 printf("Found plugin; %s\n", pluginName.c_str());
 
-                plugins = mRegistry->queryByName(pluginName);
-                if (plugins.empty()) {
+                // Plugins whose DSO hasn't been opened yet stay 
+                // that way until the chain is used.
+                if (!mRegistry->hasPlugin(pluginName)) {
                     fprintf(stderr, "ERROR: Plugin %s not loaded..\n", pluginName.c_str());
                     chainOk = false;
                 } else {
-                    append(plugins[0]);
+                    appendByName(pluginName);
                 }
             }
         }
@@ -723,6 +880,147 @@ Ookala::PluginChain::unserialize(xmlDocPtr doc, xmlNodePtr root)
     return chainOk;
 }
 
+// -----------------------------------------
+//
+// virtual
+bool
+Ookala::PluginChain::unserialize(xmlTextReaderPtr reader)
+{
+    std::string           chainName;
+    std::string           dictName;
+    int32_t               period    = 0;
+    bool                  chainOk   = true;
+    int                   chainDepth, ret;
+    std::vector<Plugin *> plugins;
+    DictHash             *hash    = NULL;
+
+    if (!mPluginChainData) return false;
+    if (!mRegistry)        return false;
+        
+    plugins = mRegistry->queryByName("DictHash");
+    if (plugins.empty()) {
+        return false;
+    }
+
+    hash = dynamic_cast<DictHash *>(plugins[0]);
+    if (!hash) {
+        return false;
+    }
+
+
+    if (reader == NULL) return false;
+
+    if ((xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) ||
+            strcmp((const char *)xmlTextReaderConstName(reader), "chain")) {
+        return false;
+    }
+
+    printf("Loading chain...\n");
+
+    xmlChar *attrName = xmlTextReaderGetAttribute(reader, (const xmlChar *)("name"));
+    if (attrName != NULL) {
+        chainName = (char *)(attrName);
+        xmlFree(attrName);
+    }
+
+    attrName = xmlTextReaderGetAttribute(reader, (const xmlChar *)("period"));
+    if (attrName != NULL) {
+        period = atoi( (char *)attrName);
+        xmlFree(attrName);
+    } else {
+        period = 0;
+    }
+
+    attrName = xmlTextReaderGetAttribute(reader, (const xmlChar *)("hidden"));
+    setHidden(isHiddenValue(attrName));
+    if (attrName != NULL) {
+        xmlFree(attrName);
+    }
+
+
+    printf("\t   Name: %s, period: %d\n", chainName.c_str(), period);
+
+    setName(chainName);
+    setPeriod(period);
+
+    if (xmlTextReaderIsEmptyElement(reader)) {
+        return chainOk;
+    }
+
+    // Same as above, we only care about the <dict> and <plugin>
+    // nodes directly under the chain.
+    chainDepth = xmlTextReaderDepth(reader);
+    while ((ret = xmlTextReaderRead(reader)) == 1) {
+        int type  = xmlTextReaderNodeType(reader);
+        int depth = xmlTextReaderDepth(reader);
+
+        if ((type == XML_READER_TYPE_END_ELEMENT) && (depth == chainDepth)) {
+            break;
+        }
+
+        if ((type != XML_READER_TYPE_ELEMENT) || (depth != chainDepth+1)) {
+            continue;
+        }
+
+        std::string childName((const char *)xmlTextReaderConstName(reader));
+
+        if (childName == "dict") {
+            dictName = "";
+            
+            attrName = xmlTextReaderGetAttribute(reader, (const xmlChar *)("name"));
+            if (attrName != NULL) {
+                dictName = (char *)(attrName);
+                xmlFree(attrName);
+            }
+
+            printf("\t   Name: %s\n", dictName.c_str());
+
+            Dict *dict = hash->newDict(dictName.c_str());
+            if (!dict) {
+                fprintf(stderr, "WARNING: Unable to create dict \"%s\"\n",
+                                         dictName.c_str());
+                return false;
+            }
+
+            dict->unserialize(reader);
+    
+            setDictName(dictName);
+        }
+
+        if (childName == "plugin") {
+            std::string           pluginName;
+
+            attrName = xmlTextReaderReadString(reader);
+            if (attrName != NULL) {
+                pluginName = (char *)attrName;            
+                xmlFree(attrName);
+            } else {
+                chainOk = false;
+            }
+            
+            if (chainOk) {
+                printf("Found plugin; %s\n", pluginName.c_str());
+
+                // Plugins whose DSO hasn't been opened yet stay 
+                // that way until the chain is used.
+                if (!mRegistry->hasPlugin(pluginName)) {
+                    fprintf(stderr, "ERROR: Plugin %s not loaded..\n", pluginName.c_str());
+                    chainOk = false;
+                } else {
+                    appendByName(pluginName);
+                }
+            }
+        }
+    }
+
+    if (ret != 1) {
+        fprintf(stderr, "ERROR: Problem reading chain %s\n", chainName.c_str());
+        return false;
+    }
+
+    return chainOk;
+}
+
 // -----------------------------------------
 //
 // virtual 
@@ -730,19 +1028,23 @@ bool
 Ookala::PluginChain::setUiBool(const std::string &key, 
                                bool               value)
 {
-    Ui *ui;
-    std::vector<Plugin *>plugins = queryByAttribute("Ui");
-    
-    if (plugins.empty()) {
+    bool ret = true;
+    std::vector<Ui *>::iterator theUi;
+
+    if (!lockUi()) {
         return false;
     }
 
-    ui = dynamic_cast<Ui *>(plugins[0]);
-    if (!ui) {
-        return false;
+    for (theUi = mPluginChainData->mUi.begin();
+            theUi != mPluginChainData->mUi.end(); ++theUi) {
+        if (!(*theUi)->setBool(key, value)) {
+            ret = false;
+        }
     }
 
-    return ui->setBool(key, value);
+    unlockUi();
+
+    return ret;
 }
 
 // -----------------------------------------
@@ -752,19 +1054,23 @@ bool
 Ookala::PluginChain::setUiString(const std::string &key,  
                                  const std::string &value)
 {
-    Ui *ui;
-    std::vector<Plugin *>plugins = queryByAttribute("Ui");
-    
-    if (plugins.empty()) {
+    bool ret = true;
+    std::vector<Ui *>::iterator theUi;
+
+    if (!lockUi()) {
         return false;
     }
 
-    ui = dynamic_cast<Ui *>(plugins[0]);
-    if (!ui) {
-        return false;
+    for (theUi = mPluginChainData->mUi.begin();
+            theUi != mPluginChainData->mUi.end(); ++theUi) {
+        if (!(*theUi)->setString(key, value)) {
+            ret = false;
+        }
     }
 
-    return ui->setString(key, value);
+    unlockUi();
+
+    return ret;
 }
 
 // -----------------------------------------
@@ -774,19 +1080,23 @@ bool
 Ookala::PluginChain::setUiInt(const std::string &key, 
                               int32_t            value)
 {
-    Ui *ui;
-    std::vector<Plugin *>plugins = queryByAttribute("Ui");
-    
-    if (plugins.empty()) {
+    bool ret = true;
+    std::vector<Ui *>::iterator theUi;
+
+    if (!lockUi()) {
         return false;
     }
 
-    ui = dynamic_cast<Ui *>(plugins[0]);
-    if (!ui) {
-        return false;
+    for (theUi = mPluginChainData->mUi.begin();
+            theUi != mPluginChainData->mUi.end(); ++theUi) {
+        if (!(*theUi)->setInt(key, value)) {
+            ret = false;
+        }
     }
 
-    return ui->setInt(key, value);
+    unlockUi();
+
+    return ret;
 }
 
 // -----------------------------------------
@@ -796,19 +1106,23 @@ bool
 Ookala::PluginChain::setUiDouble(const std::string &key, 
                                  double             value)
 {
-    Ui *ui;
-    std::vector<Plugin *>plugins = queryByAttribute("Ui");
-    
-    if (plugins.empty()) {
+    bool ret = true;
+    std::vector<Ui *>::iterator theUi;
+
+    if (!lockUi()) {
         return false;
     }
 
-    ui = dynamic_cast<Ui *>(plugins[0]);
-    if (!ui) {
-        return false;
+    for (theUi = mPluginChainData->mUi.begin();
+            theUi != mPluginChainData->mUi.end(); ++theUi) {
+        if (!(*theUi)->setDouble(key, value)) {
+            ret = false;
+        }
     }
 
-    return ui->setDouble(key, value);
+    unlockUi();
+
+    return ret;
 }
 
 // -----------------------------------------
@@ -818,19 +1132,23 @@ bool
 Ookala::PluginChain::setUiRgb(const std::string &key, 
                               Rgb                value)
 {
-    Ui *ui;
-    std::vector<Plugin *>plugins = queryByAttribute("Ui");
-    
-    if (plugins.empty()) {
+    bool ret = true;
+    std::vector<Ui *>::iterator theUi;
+
+    if (!lockUi()) {
         return false;
     }
 
-    ui = dynamic_cast<Ui *>(plugins[0]);
-    if (!ui) {
-        return false;
+    for (theUi = mPluginChainData->mUi.begin();
+            theUi != mPluginChainData->mUi.end(); ++theUi) {
+        if (!(*theUi)->setRgb(key, value)) {
+            ret = false;
+        }
     }
 
-    return ui->setRgb(key, value);
+    unlockUi();
+
+    return ret;
 }
 
 // -----------------------------------------
@@ -840,17 +1158,144 @@ bool
 Ookala::PluginChain::setUiYxy(const std::string &key, 
                               Yxy                value)
 {
-    Ui *ui;
-    std::vector<Plugin *>plugins = queryByAttribute("Ui");
-    
-    if (plugins.empty()) {
+    bool ret = true;
+    std::vector<Ui *>::iterator theUi;
+
+    if (!lockUi()) {
         return false;
     }
 
-    ui = dynamic_cast<Ui *>(plugins[0]);
-    if (!ui) {
+    for (theUi = mPluginChainData->mUi.begin();
+            theUi != mPluginChainData->mUi.end(); ++theUi) {
+        if (!(*theUi)->setYxy(key, value)) {
+            ret = false;
+        }
+    }
+
+    unlockUi();
+
+    return ret;
+}
+
+// -----------------------------------------
+//
+bool 
+Ookala::PluginChain::setUiRgb(const std::string &key, 
+                              const RgbDictItem &value)
+{
+    return setUiRgb(key, value.get());
+}
+
+// -----------------------------------------
+//
+bool 
+Ookala::PluginChain::setUiYxy(const std::string &key, 
+                              const YxyDictItem &value)
+{
+    return setUiYxy(key, value.get());
+}
+
+// -----------------------------------------
+//
+// private
+bool
+Ookala::PluginChain::handlesStale()
+{
+    uint32_t registryGeneration = 0;
+
+    if (mRegistry) {
+        registryGeneration = mRegistry->generation();
+    }
+
+    return (mPluginChainData->mHandleGeneration != 
+                                mPluginChainData->mGeneration) ||
+           (mPluginChainData->mHandleRegistryGeneration != 
+                                registryGeneration);
+}
+
+// -----------------------------------------
+//
+// private
+void
+Ookala::PluginChain::resolveHandles()
+{
+    std::vector<Plugin *>           theChain;
+    std::vector<Plugin *>::iterator thePlugin;
+    uint32_t                        generation;
+    uint32_t                        registryGeneration = 0;
+    DictHash                       *hash = NULL;
+    Ui                             *ui;
+
+    // Ui plugins we only know by name need to be loaded to 
+    // talk to.
+    resolvePlugins();
+
+    // Note the generations before looking, so that anything that
+    // changes while we're at it leaves us stale for next time.
+    mChainMutex.lock();
+    generation = mPluginChainData->mGeneration;
+    theChain   = mPluginChainData->mPluginChain;
+    mChainMutex.unlock();
+
+    if (mRegistry) {
+        registryGeneration = mRegistry->generation();
+
+        const std::vector<Plugin *> &plugins = 
+                                    mRegistry->queryByName("DictHash");
+        if (!plugins.empty()) {
+            hash = dynamic_cast<DictHash *>(plugins[0]);
+        }
+    }
+
+    mPluginChainData->mHandleLock.writeLock();
+
+    mPluginChainData->mUi.clear();
+    for (thePlugin = theChain.begin(); 
+            thePlugin != theChain.end(); ++thePlugin) {
+        if ((!*thePlugin) || (!(*thePlugin)->matchAttribute("Ui"))) continue;
+
+        ui = dynamic_cast<Ui *>(*thePlugin);
+        if (ui) {
+            mPluginChainData->mUi.push_back(ui);
+        }
+    }
+
+    mPluginChainData->mDictHash                 = hash;
+    mPluginChainData->mHandleGeneration         = generation;
+    mPluginChainData->mHandleRegistryGeneration = registryGeneration;
+
+    mPluginChainData->mHandleLock.writeUnlock();
+}
+
+// -----------------------------------------
+//
+// private
+bool
+Ookala::PluginChain::lockUi()
+{
+    if (!mPluginChainData) return false;
+
+    mPluginChainData->mHandleLock.readLock();
+
+    if (handlesStale()) {
+        mPluginChainData->mHandleLock.readUnlock();
+        resolveHandles();
+        mPluginChainData->mHandleLock.readLock();
+    }
+
+    if (mPluginChainData->mUi.empty()) {
+        mPluginChainData->mHandleLock.readUnlock();
         return false;
     }
 
-    return ui->setYxy(key, value);
+    return true;
+}
+
+// -----------------------------------------
+//
+// private
+void
+Ookala::PluginChain::unlockUi()
+{
+    mPluginChainData->mHandleLock.readUnlock();
 }
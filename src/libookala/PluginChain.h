@@ -27,10 +27,12 @@
 
 #include <vector>
 #include <string>
+#include <atomic>
 
 // --------------------------------------------------------------------------
 
 #include <libxml/xmlmemory.h>
+#include <libxml/xmlreader.h>
 
   // xmlmemory.h pulls in "libxml/xmlversion.h" that redefines a conflicting
   // ATTRIBUTE_PRINTF in some versions - if so, remove conflict with 
@@ -55,6 +57,10 @@
 namespace Ookala {
 
 class PluginRegistry;
+class DictHash;
+class Ui;
+class RgbDictItem;
+class YxyDictItem;
 class Dict;
 class EXIMPORT PluginChain
 {
@@ -81,6 +87,8 @@ class EXIMPORT PluginChain
         std::string getDictName();
         
         // As a convience, to down the verbage of dicthash queries.
+        // The DictHash is looked up once and kept until the registry
+        // changes.
         Dict *      getDict();
         
         
@@ -155,6 +163,10 @@ class EXIMPORT PluginChain
         virtual bool serialize(xmlDocPtr doc, xmlNodePtr root);
         virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
 
+        // Streaming version; reader should be sitting on a <chain> 
+        // start element, and is left on the matching </chain>.
+        virtual bool unserialize(xmlTextReaderPtr reader);
+
         // Convience UI setting methods
         //
         // Often, running plugins will want to update some 
@@ -163,6 +175,12 @@ class EXIMPORT PluginChain
         // we'll replicate all the Ui methods here. Then,
         // we can handle the searching and make life easier
         // for plugin writers.
+        //
+        // Values go to every Ui plugin in the chain. Which plugins
+        // those are gets worked out at the start of run(), and 
+        // again only if the chain or the registry changes, so these 
+        // are cheap enough to call per measurement. They return 
+        // false if there's no Ui, or if any of them refused the value.
 
         virtual bool setUiBool(  const std::string &key, 
                                  bool               value);
@@ -181,6 +199,13 @@ class EXIMPORT PluginChain
         
         virtual bool setUiYxy   (const std::string &key, 
                                  Yxy                value);
+
+        // Hand a value stored in a Dict straight on to the Ui.
+        bool         setUiRgb(   const std::string &key, 
+                                 const RgbDictItem &value);
+
+        bool         setUiYxy   (const std::string &key, 
+                                 const YxyDictItem &value);
         
     protected:        
         PluginRegistry       *mRegistry;
@@ -194,18 +219,54 @@ class EXIMPORT PluginChain
         Mutex                 mCancelMutex,
                               mChainMutex;
 
+        static bool           isHiddenValue(const xmlChar *value);
+
     private:
         struct _PluginChain {
             std::string           mName;
-            std::vector<Plugin *> mPluginChain;
+
+            // Plugins unserialized from a DSO that hasn't been opened
+            // yet are NULL here until they're needed, so we keep 
+            // the names alongside.
+            std::vector<Plugin *>    mPluginChain;
+            std::vector<std::string> mPluginNames;
 
             std::string           mDictName;
 
             std::string           mErrorString;
+
+            // Bumped whenever mPluginChain changes.
+            std::atomic<uint32_t> mGeneration;
+
+            // Ui plugins in the chain and the registry's DictHash,
+            // and the chain and registry generations they were 
+            // found at.
+            RwLock                mHandleLock;
+            std::vector<Ui *>     mUi;
+            DictHash             *mDictHash;
+            uint32_t              mHandleGeneration;
+            uint32_t              mHandleRegistryGeneration;
         };
 
         _PluginChain         *mPluginChainData;
 
+        // Add a plugin that might not be loaded yet, and fill in 
+        // any that weren't. resolvePlugins() returns false, with
+        // the error string set, if some can't be found.
+        bool                  appendByName(const std::string &name);
+        bool                  resolvePlugins();
+
+        // Is what we have out of date? Call with mHandleLock held.
+        // resolveHandles() looks up the Ui and DictHash plugins 
+        // again.
+        bool                  handlesStale();
+        void                  resolveHandles();
+
+        // Read lock the handles, resolving them first if need be.
+        // Returns false, unlocked, if there's no Ui to talk to.
+        bool                  lockUi();
+        void                  unlockUi();
+
 
         PluginChain() {}
 };
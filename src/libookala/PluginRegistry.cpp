@@ -28,6 +28,16 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
 
 #ifdef __linux__
 #include <dlfcn.h>
@@ -41,6 +51,255 @@
 #include "Interpolate.h"
 
 
+// Most threads to run a wave of plugin init on.
+#define _PLUGINREGISTRY_INIT_THREADS 16
+
+
+namespace {
+
+// Create/delete funcs for the builtin DictItem types, with the
+// same signatures that plugins provide.
+template <class T>
+Ookala::DictItem *
+_createBuiltinDictItem(const char *)
+{
+    return new T;
+}
+
+int
+_deleteBuiltinDictItem(Ookala::DictItem *item)
+{
+    delete item;
+    return 0;
+}
+
+// Source of registry generations, shared so that a registry built
+// where an old one used to be doesn't look unchanged.
+std::atomic<uint32_t> gPluginRegistryGeneration(0);
+
+// The registry whose init wave this thread is running, if it's 
+// running on more than one. The load it's part of is waiting on
+// the wave, so nothing can be opened for it from here.
+thread_local const Ookala::PluginRegistry *gPluginRegistryInitWave = NULL;
+
+// -----------------------------------
+
+bool
+_pluginRegistryStat(const char *filename, uint64_t &mtime, uint64_t &size)
+{
+#ifdef WIN32
+    struct _stat statbuf;
+    if (_stat(filename, &statbuf) != 0) {
+#else
+    struct stat statbuf;
+    if (stat(filename, &statbuf) != 0) {
+#endif
+        return false;
+    }
+
+    mtime = (uint64_t)statbuf.st_mtime;
+    size  = (uint64_t)statbuf.st_size;
+
+    return true;
+}
+
+// -----------------------------------
+
+bool
+_pluginRegistryHas(const std::vector<std::string> &list, 
+                   const std::string              &value)
+{
+    return std::find(list.begin(), list.end(), value) != list.end();
+}
+
+// -----------------------------------
+
+uint64_t
+_pluginRegistryNumberProp(xmlNodePtr node, const char *name)
+{
+    uint64_t  value = 0;
+    xmlChar  *prop  = xmlGetProp(node, (const xmlChar *)name);
+
+    if (prop) {
+        value = strtoull((const char *)prop, NULL, 10);
+        xmlFree(prop);
+    }
+
+    return value;
+}
+
+// -----------------------------------
+
+std::string
+_pluginRegistryStringProp(xmlNodePtr node, const char *name)
+{
+    std::string  value;
+    xmlChar     *prop = xmlGetProp(node, (const xmlChar *)name);
+
+    if (prop) {
+        value = (const char *)prop;
+        xmlFree(prop);
+    }
+
+    return value;
+}
+
+// -----------------------------------
+
+std::string
+_pluginRegistryContent(xmlNodePtr node)
+{
+    std::string  value;
+    xmlChar     *content = xmlNodeGetContent(node);
+
+    if (content) {
+        value = (const char *)content;
+        xmlFree(content);
+    }
+
+    return value;
+}
+
+// -----------------------------------
+
+bool
+_pluginRegistryHasDso(const std::vector<struct Ookala::PluginInfo> &info,
+                      const std::string                            &dsoName)
+{
+    for (std::vector<struct Ookala::PluginInfo>::const_iterator theInfo = 
+                    info.begin();
+            theInfo != info.end(); ++theInfo) {
+        if ((*theInfo).dsoName == dsoName) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// -----------------------------------
+
+void
+_pluginRegistryFreeLists(std::vector<std::vector<Ookala::Plugin *> *> &lists)
+{
+    for (size_t idx=0; idx<lists.size(); ++idx) {
+        delete lists[idx];
+    }
+    lists.clear();
+}
+
+// -----------------------------------
+
+double
+_pluginRegistryNow()
+{
+    return std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// -----------------------------------
+//
+// Indexed by PluginRegistry::_InitStep
+
+const char *_pluginRegistryStepNames[] = {
+    "postLoad",
+    "checkDeps",
+    "postCheckDeps"
+};
+
+bool
+_pluginRegistryPostLoad(Ookala::Plugin *plugin)
+{
+    return plugin->postLoad();
+}
+
+bool
+_pluginRegistryCheckDeps(Ookala::Plugin *plugin)
+{
+    return plugin->checkDeps();
+}
+
+bool
+_pluginRegistryPostCheckDeps(Ookala::Plugin *plugin)
+{
+    return plugin->postCheckDeps();
+}
+
+// -----------------------------------
+//
+// True if plugin has declared that it depends on something
+// else in remaining.
+
+bool
+_pluginRegistryWaiting(Ookala::Plugin                      *plugin,
+                       const std::vector<Ookala::Plugin *> &remaining)
+{
+    const std::vector<std::string> &names   = plugin->dependencies();
+    const std::vector<std::string> &attribs = 
+                                        plugin->attributeDependencies();
+
+    for (std::vector<Ookala::Plugin *>::const_iterator theOther = 
+                    remaining.begin();
+            theOther != remaining.end(); ++theOther) {
+        if ((*theOther) == plugin) {
+            continue;
+        }
+
+        if (_pluginRegistryHas(names, (*theOther)->name())) {
+            return true;
+        }
+
+        for (std::vector<std::string>::const_iterator theAttr = 
+                        attribs.begin();
+                theAttr != attribs.end(); ++theAttr) {
+            if ((*theOther)->matchAttribute(*theAttr)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// -----------------------------------
+//
+// A wave of init work, shared by the threads running it. Each
+// takes the next plugin until there aren't any left. registry 
+// is NULL if the wave is only running on the loading thread.
+
+struct _PluginRegistryWave {
+    const Ookala::PluginRegistry        *registry;
+    const std::vector<Ookala::Plugin *> *plugins;
+    bool                               (*step)(Ookala::Plugin *);
+    std::vector<char>                   *passed;
+    std::vector<double>                 *times;
+    std::atomic<size_t>                  next;
+};
+
+void
+_pluginRegistryRunWave(_PluginRegistryWave *wave)
+{
+    const Ookala::PluginRegistry *outer = gPluginRegistryInitWave;
+    size_t                        idx;
+    double                        start;
+
+    if (wave->registry) {
+        gPluginRegistryInitWave = wave->registry;
+    }
+
+    while ((idx = wave->next++) < wave->plugins->size()) {
+        start = _pluginRegistryNow();
+
+        (*wave->passed)[idx] = (*wave->step)((*wave->plugins)[idx]);
+        (*wave->times)[idx]  = _pluginRegistryNow() - start;
+    }
+
+    gPluginRegistryInitWave = outer;
+}
+
+}; // namespace
+
+
 // ===================================
 //
 // PluginRegistry
@@ -50,6 +309,13 @@
 Ookala::PluginRegistry::PluginRegistry()
 {
     mPluginRegistryData = new _PluginRegistry;    
+    mPluginRegistryData->mGeneration   = ++gPluginRegistryGeneration;
+    mPluginRegistryData->mRegistering  = false;
+    mPluginRegistryData->mInitFromDso  = false;
+    mPluginRegistryData->mLoader       = std::thread::id();
+    mPluginRegistryData->mLoadDepth    = 0;
+
+    addBuiltinDictItemTypes();
 
     loadPlugin(static_cast<Plugin *>(new DictHash),    NULL, NULL);
     loadPlugin(static_cast<Plugin *>(new Color),       NULL, NULL);
@@ -65,10 +331,30 @@ Ookala::PluginRegistry::PluginRegistry()
 Ookala::PluginRegistry::PluginRegistry(const PluginRegistry &src)
 {
     mPluginRegistryData = new _PluginRegistry;    
+    mPluginRegistryData->mGeneration   = ++gPluginRegistryGeneration;
+    mPluginRegistryData->mRegistering  = false;
+    mPluginRegistryData->mInitFromDso  = false;
+    mPluginRegistryData->mLoader       = std::thread::id();
+    mPluginRegistryData->mLoadDepth    = 0;
     
     if (src.mPluginRegistryData) {
+        src.mPluginRegistryData->mLock.readLock();
+
         mPluginRegistryData->mPluginInfo = src.mPluginRegistryData->mPluginInfo;
         mPluginRegistryData->mLibHandles = src.mPluginRegistryData->mLibHandles;
+
+        mPluginRegistryData->mManifestFile = 
+                            src.mPluginRegistryData->mManifestFile;
+        mPluginRegistryData->mManifest = src.mPluginRegistryData->mManifest;
+        mPluginRegistryData->mPending  = src.mPluginRegistryData->mPending;
+
+        mPluginRegistryData->mDictItemTypes = 
+                            src.mPluginRegistryData->mDictItemTypes;
+
+        src.mPluginRegistryData->mLock.readUnlock();
+
+        rebuildIndex();
+        indexPending();
     }    
 }
 
@@ -101,6 +387,8 @@ Ookala::PluginRegistry::~PluginRegistry()
             FreeLibrary(*j);
 #endif
         }
+
+        _pluginRegistryFreeLists(mPluginRegistryData->mIndexLists);
    
         delete mPluginRegistryData;
         mPluginRegistryData = NULL;
@@ -115,13 +403,40 @@ Ookala::PluginRegistry::operator=(const PluginRegistry &src)
 {
     if (this != &src) {
         if (mPluginRegistryData) {
+            _pluginRegistryFreeLists(mPluginRegistryData->mIndexLists);
             delete mPluginRegistryData;
             mPluginRegistryData = NULL;
         }
 
         if (src.mPluginRegistryData) {
             mPluginRegistryData  = new _PluginRegistry();
-            *mPluginRegistryData = *(src.mPluginRegistryData);
+            mPluginRegistryData->mGeneration   = ++gPluginRegistryGeneration;
+            mPluginRegistryData->mRegistering  = false;
+            mPluginRegistryData->mInitFromDso  = false;
+            mPluginRegistryData->mLoader       = std::thread::id();
+            mPluginRegistryData->mLoadDepth    = 0;
+
+            src.mPluginRegistryData->mLock.readLock();
+
+            mPluginRegistryData->mPluginInfo = 
+                                src.mPluginRegistryData->mPluginInfo;
+            mPluginRegistryData->mLibHandles = 
+                                src.mPluginRegistryData->mLibHandles;
+
+            mPluginRegistryData->mManifestFile = 
+                                src.mPluginRegistryData->mManifestFile;
+            mPluginRegistryData->mManifest = 
+                                src.mPluginRegistryData->mManifest;
+            mPluginRegistryData->mPending  = 
+                                src.mPluginRegistryData->mPending;
+
+            mPluginRegistryData->mDictItemTypes = 
+                                src.mPluginRegistryData->mDictItemTypes;
+
+            src.mPluginRegistryData->mLock.readUnlock();
+
+            rebuildIndex();
+            indexPending();
         }
     }
 
@@ -131,18 +446,147 @@ Ookala::PluginRegistry::operator=(const PluginRegistry &src)
 // -----------------------------------
 //
 // Load in a DSO from a file and pull in all the 
-// plugins that it contains.
+// plugins that it contains - or if the manifest already
+// knows what's in there, wait until somebody wants one.
 //
 // virtual
 
 bool
 Ookala::PluginRegistry::loadPlugin(const char *filename)
+{
+    bool retVal;
+
+    if (!mPluginRegistryData) return false;
+    if (filename == NULL)     return false;
+
+    lockLoad();
+
+    if (deferPlugin(filename)) {
+        unlockLoad();
+        return true;
+    }
+
+    if (!openPlugin(filename)) {
+        unlockLoad();
+        return false;
+    }
+
+    postLoadPlugins();
+
+    mPluginRegistryData->mLock.readLock();
+    retVal = _pluginRegistryHasDso(mPluginRegistryData->mPluginInfo, 
+                                   filename);
+    mPluginRegistryData->mLock.readUnlock();
+
+    registerPlugins();
+
+    unlockLoad();
+
+    return retVal;
+}
+
+// -----------------------------------
+//
+// Like loadPlugin(), but with everything opened at once, 
+// so that all their plugins can be initialized together.
+//
+// virtual
+
+bool
+Ookala::PluginRegistry::loadPlugins(const std::vector<std::string> &filenames)
+{
+    std::vector<std::string>::const_iterator theFile;
+    std::vector<std::string>                 opened;
+    bool                                     retVal = true;
+
+    if (!mPluginRegistryData) return false;
+
+    lockLoad();
+
+    for (theFile = filenames.begin(); theFile != filenames.end(); ++theFile) {
+        if (deferPlugin((*theFile).c_str())) {
+            continue;
+        }
+
+        if (openPlugin((*theFile).c_str())) {
+            opened.push_back(*theFile);
+        } else {
+            fprintf(stderr, "ERROR: Can't load plugin %s\n", 
+                                                (*theFile).c_str());
+            retVal = false;
+        }
+    }
+
+    postLoadPlugins();
+
+    mPluginRegistryData->mLock.readLock();
+    for (theFile = opened.begin(); theFile != opened.end(); ++theFile) {
+        if (!_pluginRegistryHasDso(mPluginRegistryData->mPluginInfo, 
+                                   *theFile)) {
+            fprintf(stderr, "ERROR: Can't load plugin %s\n", 
+                                                (*theFile).c_str());
+            retVal = false;
+        }
+    }
+    mPluginRegistryData->mLock.readUnlock();
+
+    registerPlugins();
+
+    unlockLoad();
+
+    return retVal;
+}
+
+// -----------------------------------
+//
+// private
+bool
+Ookala::PluginRegistry::deferPlugin(const char *filename)
+{
+    std::map<std::string, _ManifestDso>::iterator theDso;
+    uint64_t                                      mtime, size;
+    bool                                          deferred;
+
+    mPluginRegistryData->mLock.writeLock();
+
+    theDso   = mPluginRegistryData->mManifest.find(filename);
+    deferred = (!mPluginRegistryData->mManifestFile.empty()) &&
+               (theDso != mPluginRegistryData->mManifest.end()) &&
+               (!(*theDso).second.mPlugins.empty()) &&
+               (_pluginRegistryStat(filename, mtime, size)) &&
+               ((*theDso).second.mMtime == mtime) && 
+               ((*theDso).second.mSize  == size);
+
+    if ((deferred) && 
+            (!_pluginRegistryHas(mPluginRegistryData->mPending, filename))) {
+        mPluginRegistryData->mPending.push_back(filename);
+        indexPending();
+    }
+
+    mPluginRegistryData->mLock.writeUnlock();
+
+    if (deferred) {
+        printf("Found %s in the plugin manifest, opening on first use\n", 
+                                                                filename);
+    }
+
+    return deferred;
+}
+
+// -----------------------------------
+//
+// private
+bool
+Ookala::PluginRegistry::openPlugin(const char *filename)
 {
     int numPlugins;
     LibHandle  hand;
     RegisterFunc registerFunc;
     struct PluginInfo pi;
     struct PluginAllocInfo *allocInfo;
+    _PluginIndex::const_iterator theName;
+    _ManifestDso            manifestDso;
+    _ManifestPlugin         manifestPlugin;
 
     if (!mPluginRegistryData) return false;
 
@@ -217,18 +661,27 @@ Ookala::PluginRegistry::loadPlugin(const char *filename)
 
         pi.handle             = hand;
 
+        manifestPlugin.mName = pi.pluginName;
+        manifestPlugin.mAttributes.clear();
+
         // Test if we already have a plugin of this name loaded. If so, skip it
-        // for now.
-        nameFound = false;
-        for (std::vector<PluginInfo>::iterator theInfo = 
-                               mPluginRegistryData->mPluginInfo.begin();
-                    theInfo != mPluginRegistryData->mPluginInfo.end(); 
-                                                            ++theInfo) {
-            if (pi.pluginName == (*theInfo).pluginName) {
-                nameFound = true;
-            }
+        // for now. Don't go through queryByName(), which could open 
+        // some other DSO that has one.
+        mPluginRegistryData->mLock.readLock();
+        theName   = mPluginRegistryData->mByName.find(pi.pluginName);
+        nameFound = (theName != mPluginRegistryData->mByName.end()) &&
+                    (!theName->second->empty());
+        mPluginRegistryData->mLock.readUnlock();
+
+        for (std::vector<struct PluginInfo>::iterator theStaged = 
+                        mPluginRegistryData->mStaged.begin();
+                (!nameFound) && 
+                    (theStaged != mPluginRegistryData->mStaged.end()); 
+                ++theStaged) {
+            nameFound = ((*theStaged).plugin->name() == pi.pluginName);
         }
         if (nameFound) {
+            manifestDso.mPlugins.push_back(manifestPlugin);
             continue;
         }
 
@@ -243,33 +696,60 @@ Ookala::PluginRegistry::loadPlugin(const char *filename)
             continue;
         }
 
-        // After creating an object, run postLoad() to see if it fails
-        // immediately. If so, don't bother keeping track of it.
-        if (pi.plugin->postLoad() == false) {
-            (*pi.deleteFunc)(pi.plugin);
-            fprintf(stderr, "WARNING: %s failed postLoad()\n", pi.pluginName.c_str());
-            continue;
-        }
-
-        // Loaded successfully and passed postLoad, so its safe to
-        // add it into the list of what we care about. But first, 
-        // we need to remember to assigne a pointer back to the 
-        // plugin registry in each plugin.
+        // Note it before postLoad(), which may fail for reasons
+        // that have nothing to do with the DSO (like a sensor that 
+        // isn't plugged in). Queries go by what the plugin calls
+        // itself, so that's the name to remember.
+        manifestPlugin.mName       = pi.plugin->name();
+        manifestPlugin.mAttributes = pi.plugin->attributes();
+        manifestDso.mPlugins.push_back(manifestPlugin);
 
-        pi.plugin->setPluginRegistry(this);
+        // postLoad() waits until everything that's being loaded 
+        // together has been created, so they can go at once.
+        mPluginRegistryData->mStaged.push_back(pi);
 
-        mPluginRegistryData->mPluginInfo.push_back(pi);
+        retVal = true;
+    }
 
-        printf("Loaded %s from %s\n",
-            pi.pluginName.c_str(),
-            pi.dsoName.c_str());
+    mPluginRegistryData->mLock.writeLock();
+
+    if ((!mPluginRegistryData->mManifestFile.empty()) &&
+            (_pluginRegistryStat(filename, manifestDso.mMtime, 
+                                           manifestDso.mSize))) {
+        std::map<std::string, _ManifestDso>::iterator theDso = 
+                                mPluginRegistryData->mManifest.find(filename);
+        bool changed = true;
+
+        // DictItem types are only learned as they're used, so hang 
+        // on to them if the DSO hasn't changed.
+        if ((theDso != mPluginRegistryData->mManifest.end()) &&
+                ((*theDso).second.mMtime == manifestDso.mMtime) &&
+                ((*theDso).second.mSize  == manifestDso.mSize)) {
+            manifestDso.mDictItemTypes = (*theDso).second.mDictItemTypes;
+
+            changed = 
+                ((*theDso).second.mPlugins.size() != 
+                                            manifestDso.mPlugins.size());
+            for (size_t idx=0; (!changed) && 
+                               (idx < manifestDso.mPlugins.size()); ++idx) {
+                changed = 
+                    ((*theDso).second.mPlugins[idx].mName != 
+                                    manifestDso.mPlugins[idx].mName) ||
+                    ((*theDso).second.mPlugins[idx].mAttributes !=
+                                    manifestDso.mPlugins[idx].mAttributes);
+            }
+        }
 
-        retVal = true;
+        if (changed) {
+            mPluginRegistryData->mManifest[filename] = manifestDso;
+            writeManifest();
+        }
     }
 
+    mPluginRegistryData->mLock.writeUnlock();
+
     if (retVal) {
-        mPluginRegistryData->mLibHandles.push_back(hand);
-        registerPlugins();
+        mPluginRegistryData->mStagedHandles.push_back(hand);
     } else {
 #ifdef __linux__
         dlclose(hand);
@@ -281,6 +761,74 @@ Ookala::PluginRegistry::loadPlugin(const char *filename)
     return retVal;
 }
 
+// -----------------------------------
+//
+// private
+void
+Ookala::PluginRegistry::postLoadPlugins()
+{
+    std::vector<struct PluginInfo>::iterator theInfo;
+    std::vector<LibHandle>::iterator         theHandle;
+    std::vector<Plugin *>                    plugins;
+    bool                                     used;
+
+    for (theInfo = mPluginRegistryData->mStaged.begin();
+            theInfo != mPluginRegistryData->mStaged.end(); ++theInfo) {
+        plugins.push_back((*theInfo).plugin);
+    }
+
+    if (!plugins.empty()) {
+        mPluginRegistryData->mInitFromDso = true;
+    }
+
+    // After creating an object, run postLoad() to see if it fails
+    // immediately. If so, don't bother keeping track of it.
+    initPlugins(plugins, _POST_LOAD);
+
+    // Whatever's left passed postLoad, so its safe to add it into
+    // the list of what we care about. But first, we need to 
+    // remember to assigne a pointer back to the plugin registry
+    // in each plugin.
+    for (theInfo = mPluginRegistryData->mStaged.begin();
+            theInfo != mPluginRegistryData->mStaged.end(); ++theInfo) {
+        (*theInfo).plugin->setPluginRegistry(this);
+
+        mPluginRegistryData->mLock.writeLock();
+        mPluginRegistryData->mPluginInfo.push_back(*theInfo);
+        indexPlugin((*theInfo).plugin);
+        mPluginRegistryData->mLock.writeUnlock();
+
+        printf("Loaded %s from %s\n",
+            (*theInfo).pluginName.c_str(),
+            (*theInfo).dsoName.c_str());
+    }
+
+    // Hang on to the DSOs that still have plugins.
+    for (theHandle = mPluginRegistryData->mStagedHandles.begin();
+            theHandle != mPluginRegistryData->mStagedHandles.end(); 
+            ++theHandle) {
+        used = false;
+        for (theInfo = mPluginRegistryData->mStaged.begin();
+                (!used) && (theInfo != mPluginRegistryData->mStaged.end()); 
+                ++theInfo) {
+            used = ((*theInfo).handle == (*theHandle));
+        }
+
+        if (used) {
+            mPluginRegistryData->mLibHandles.push_back(*theHandle);
+        } else {
+#ifdef __linux__
+            dlclose(*theHandle);
+#elif defined _WIN32
+            FreeLibrary(*theHandle);
+#endif
+        }
+    }
+
+    mPluginRegistryData->mStaged.clear();
+    mPluginRegistryData->mStagedHandles.clear();
+}
+
 // -----------------------------------
 //
 // virtual
@@ -294,6 +842,7 @@ Ookala::PluginRegistry::loadPlugin(
 
     // Load in any builtin plugins
     PluginInfo pi;
+    bool       retVal;
 
     pi.pluginName = plugin->name();
     pi.plugin     = plugin;
@@ -306,17 +855,23 @@ Ookala::PluginRegistry::loadPlugin(
     pi.dictItemCreateFunc = dictItemCreate;
     pi.dictItemDeleteFunc = dictItemDelete;
 
-    if (!plugin->postLoad()) {
-        return false;
-    }
+    lockLoad();
 
-    if (!plugin->setPluginRegistry(this)) {
+    if ((!plugin->postLoad()) || (!plugin->setPluginRegistry(this))) {
+        unlockLoad();
         return false;
     }
 
+    mPluginRegistryData->mLock.writeLock();
     mPluginRegistryData->mPluginInfo.push_back(pi);
+    indexPlugin(plugin);
+    mPluginRegistryData->mLock.writeUnlock();
    
-    return registerPlugins();
+    retVal = registerPlugins();
+
+    unlockLoad();
+
+    return retVal;
 }
 
 
@@ -328,86 +883,446 @@ Ookala::PluginRegistry::loadPlugin(
 bool
 Ookala::PluginRegistry::registerPlugins()
 {
+    std::vector<struct PluginInfo>::iterator theInfo;
+    std::vector<Plugin *>                    batch;
+    bool                                     unregistered = true;
+
     if (!mPluginRegistryData) return false;
 
-    // Once everything is loaded, run checkDeps() on all the plugins
-    // so they can check if everything they need has been loaded.
-    // If they fail, take them out of the list.
-
-    std::vector<struct PluginInfo>::iterator i = 
-                        mPluginRegistryData->mPluginInfo.begin();
-    while (i != mPluginRegistryData->mPluginInfo.end()) {
-        if ((*i).registered == false) {
-            // If we fail, don't advance the itertor. erase() will
-            // give us the next item in the vector
-            if ((*i).plugin->checkDeps() == false) {
-                fprintf(stderr, 
-                    "WARNING: %s failed checkDeps()\n",
-                                     (*i).pluginName.c_str());
-                if ((*i).deleteFunc) {
-                    (*(*i).deleteFunc)((*i).plugin);
-                } else if (((*i).plugin) && ((*i).builtinPlugin)) {
-                    delete (*i).plugin;
+    lockLoad();
+
+    // Plugins may go looking for others in checkDeps(), which can
+    // open a DSO that was waiting on first use, which lands us back
+    // here. The outer call gets to the new plugins, so leave it.
+    if (mPluginRegistryData->mRegistering) {
+        unlockLoad();
+        return true;
+    }
+
+    mPluginRegistryData->mRegistering = true;
+
+    std::vector<struct PluginInfo> &info = mPluginRegistryData->mPluginInfo;
+
+    while (unregistered) {
+
+        // Nothing can be opened while plugins are being checked
+        // on more than one thread, so first open whatever they've
+        // said they depend on. That may bring in more plugins, with 
+        // dependancies of their own.
+        do {
+            batch.clear();
+
+            mPluginRegistryData->mLock.readLock();
+            for (theInfo = info.begin(); theInfo != info.end(); ++theInfo) {
+                if (!(*theInfo).registered) {
+                    batch.push_back((*theInfo).plugin);
                 }
-                i = mPluginRegistryData->mPluginInfo.erase(i);
-            } else {
-                ++i;
             }
-        } else {
-            ++i;
-        }
-    }
+            mPluginRegistryData->mLock.readUnlock();
+        } while (openDependencies(batch));
+
+        // Once everything is loaded, run checkDeps() on all the plugins
+        // so they can check if everything they need has been loaded.
+        // If they fail, take them out of the list.
+        initPlugins(batch, _CHECK_DEPS);
     
-    // Then, make a pass post-checkDeps. Values of checkDeps() should be
-    // cached at this point and safe to query w/o fear of circular 
-    // dependancies.
-    i = mPluginRegistryData->mPluginInfo.begin();
-    while (i != mPluginRegistryData->mPluginInfo.end()) {
-        if ((*i).registered == false) {
-            // If we fail, don't advance the itertor. erase() will
-            // give us the next item in the vector
-            if ((*i).plugin->postCheckDeps() == false) {
-                fprintf(stderr, "WARNING: %s failed postCheckDeps()\n", 
-                                            (*i).pluginName.c_str());
-                if ((*i).deleteFunc) {
-                    (*(*i).deleteFunc)((*i).plugin);
-                } else if (((*i).plugin) && ((*i).builtinPlugin)) {
-                    delete (*i).plugin;
-                }
-                i = mPluginRegistryData->mPluginInfo.erase(i);
-            } else {
-                ++i;
+        // Then, make a pass post-checkDeps. Values of checkDeps() should be
+        // cached at this point and safe to query w/o fear of circular 
+        // dependancies. Anything that turned up since we started the
+        // batch hasn't been through checkDeps() yet, so it waits for 
+        // another go around.
+        initPlugins(batch, _POST_CHECK_DEPS);
+
+        unregistered = false;
+
+        mPluginRegistryData->mLock.writeLock();
+        for (theInfo = info.begin(); theInfo != info.end(); ++theInfo) {
+            if (std::find(batch.begin(), batch.end(), (*theInfo).plugin) != 
+                                                                batch.end()) {
+                (*theInfo).registered = true;
+            } else if (!(*theInfo).registered) {
+                unregistered = true;
             }
-        } else {
-            ++i;
         }
+        mPluginRegistryData->mLock.writeUnlock();
     }
 
-    return true;
-}
+    // The plugin list has changed, so anything we've cached
+    // about plugin DictItem types may be stale.
+    forgetPluginDictItemTypes();
+
+    mPluginRegistryData->mRegistering = false;
+
+    reportInit();
+
+    unlockLoad();
+
+    return true;
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::PluginRegistry::initPlugins(std::vector<Plugin *> &plugins, 
+                                    _InitStep              step)
+{
+    std::vector<Plugin *>           remaining(plugins), wave, failed;
+    std::vector<Plugin *>::iterator thePlugin;
+    std::vector<std::thread>        workers;
+    std::vector<char>               passed;
+    std::vector<double>             times;
+    _PluginRegistryWave             job;
+    _InitWave                       record;
+    size_t                          idx, numThreads, slowest;
+    double                          start;
+
+    job.plugins = &wave;
+    job.passed  = &passed;
+    job.times   = &times;
+
+    switch (step) {
+        case _POST_LOAD:
+            job.step = _pluginRegistryPostLoad;
+            break;
+        case _CHECK_DEPS:
+            job.step = _pluginRegistryCheckDeps;
+            break;
+        case _POST_CHECK_DEPS:
+            job.step = _pluginRegistryPostCheckDeps;
+            break;
+    }
+
+    while (!remaining.empty()) {
+        nextInitWave(remaining, step, wave);
+
+        passed.assign(wave.size(), 0);
+        times.assign(wave.size(), 0.0);
+        job.next = 0;
+
+        start = _pluginRegistryNow();
+
+        if (wave.size() == 1) {
+            job.registry = NULL;
+
+            _pluginRegistryRunWave(&job);
+        } else {
+            // Init mostly waits on devices rather than the cpu,
+            // so don't hold it to the number of cores.
+            numThreads = wave.size();
+            if (numThreads > _PLUGINREGISTRY_INIT_THREADS) {
+                numThreads = _PLUGINREGISTRY_INIT_THREADS;
+            }
+
+            // We work on the wave too, so that's one less to start.
+            job.registry = this;
+
+            workers.clear();
+            for (idx=1; idx<numThreads; ++idx) {
+                workers.push_back(std::thread(_pluginRegistryRunWave, &job));
+            }
+
+            _pluginRegistryRunWave(&job);
+
+            for (idx=0; idx<workers.size(); ++idx) {
+                workers[idx].join();
+            }
+        }
+
+        slowest = 0;
+        record.mStep       = step;
+        record.mTime       = _pluginRegistryNow() - start;
+        record.mWork       = 0;
+        record.mNumPlugins = wave.size();
+        for (idx=0; idx<wave.size(); ++idx) {
+            if (times[idx] > times[slowest]) {
+                slowest = idx;
+            }
+            record.mWork += times[idx];
+        }
+        record.mSlowest = wave[slowest]->name();
+        mPluginRegistryData->mInitWaves.push_back(record);
+
+        // The wave is in load order, so failures are too, no
+        // matter who finished first.
+        for (idx=0; idx<wave.size(); ++idx) {
+            thePlugin = std::find(remaining.begin(), remaining.end(), 
+                                                            wave[idx]);
+            remaining.erase(thePlugin);
+
+            if (!passed[idx]) {
+                failed.push_back(wave[idx]);
+                dropPlugin(wave[idx], step);
+            }
+        }
+    }
+
+    thePlugin = plugins.begin();
+    while (thePlugin != plugins.end()) {
+        if (std::find(failed.begin(), failed.end(), *thePlugin) != 
+                                                            failed.end()) {
+            thePlugin = plugins.erase(thePlugin);
+        } else {
+            ++thePlugin;
+        }
+    }
+}
+
+// -----------------------------------
+//
+// A wave is everything from the front of remaining that's
+// declared its dependancies, and doesn't depend on anything
+// else that's still to go. A plugin that hasn't declared
+// anything could depend on anything, so it waits for all
+// that's before it, and gets a wave to itself.
+//
+// postLoad() doesn't depend on other plugins, so only whether
+// a plugin has declared matters there.
+//
+// private
+void
+Ookala::PluginRegistry::nextInitWave(
+                            const std::vector<Plugin *> &remaining,
+                            _InitStep                    step,
+                            std::vector<Plugin *>       &wave)
+{
+    wave.clear();
+
+    for (size_t idx=0; idx<remaining.size(); ++idx) {
+        if (!remaining[idx]->declaresDependencies()) {
+            if (idx == 0) {
+                wave.push_back(remaining[idx]);
+            }
+            break;
+        }
+
+        if ((step == _POST_LOAD) || 
+                (!_pluginRegistryWaiting(remaining[idx], remaining))) {
+            wave.push_back(remaining[idx]);
+        }
+    }
+
+    // Nothing's ready if plugins depend on each other, or on 
+    // something behind a plugin that hasn't declared. Either way,
+    // fall back on load order to get through.
+    if (wave.empty()) {
+        wave.push_back(remaining[0]);
+    }
+}
+
+// -----------------------------------
+//
+// private
+bool
+Ookala::PluginRegistry::openDependencies(
+                            const std::vector<Plugin *> &plugins)
+{
+    std::vector<Plugin *>::const_iterator    thePlugin;
+    std::vector<std::string>::const_iterator theDep, theDso;
+    _PluginIndex::const_iterator             theName;
+    _PendingIndex::const_iterator            thePending;
+    std::vector<std::string>                 dsos;
+
+    // Gather them all up first, so they're opened together.
+    mPluginRegistryData->mLock.readLock();
+
+    for (thePlugin = plugins.begin(); thePlugin != plugins.end(); 
+                                                        ++thePlugin) {
+        const std::vector<std::string> &names = 
+                                    (*thePlugin)->dependencies();
+        const std::vector<std::string> &attribs = 
+                                    (*thePlugin)->attributeDependencies();
+
+        for (theDep = names.begin(); theDep != names.end(); ++theDep) {
+            theName = mPluginRegistryData->mByName.find(*theDep);
+            if ((theName != mPluginRegistryData->mByName.end()) &&
+                    (!theName->second->empty())) {
+                continue;
+            }
+
+            thePending = mPluginRegistryData->mPendingByName.find(*theDep);
+            if (thePending == mPluginRegistryData->mPendingByName.end()) {
+                continue;
+            }
+
+            for (theDso = thePending->second.begin(); 
+                    theDso != thePending->second.end(); ++theDso) {
+                if (!_pluginRegistryHas(dsos, *theDso)) {
+                    dsos.push_back(*theDso);
+                }
+            }
+        }
+
+        for (theDep = attribs.begin(); theDep != attribs.end(); ++theDep) {
+            thePending = 
+                    mPluginRegistryData->mPendingByAttribute.find(*theDep);
+            if (thePending == mPluginRegistryData->mPendingByAttribute.end()) {
+                continue;
+            }
+
+            for (theDso = thePending->second.begin(); 
+                    theDso != thePending->second.end(); ++theDso) {
+                if (!_pluginRegistryHas(dsos, *theDso)) {
+                    dsos.push_back(*theDso);
+                }
+            }
+        }
+    }
+
+    mPluginRegistryData->mLock.readUnlock();
+
+    if (dsos.empty()) {
+        return false;
+    }
+
+    return loadPending(dsos);
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::PluginRegistry::dropPlugin(Plugin *plugin, _InitStep step)
+{
+    std::vector<struct PluginInfo>::iterator theInfo;
+    struct PluginInfo                        info;
+
+    mPluginRegistryData->mLock.writeLock();
+
+    for (theInfo = mPluginRegistryData->mPluginInfo.begin();
+            theInfo != mPluginRegistryData->mPluginInfo.end(); ++theInfo) {
+        if ((*theInfo).plugin != plugin) {
+            continue;
+        }
+
+        // Out of the list and the indexes first, so nobody finds
+        // it once it's gone.
+        info = *theInfo;
+        unindexPlugin(plugin);
+        mPluginRegistryData->mPluginInfo.erase(theInfo);
+
+        mPluginRegistryData->mLock.writeUnlock();
+
+        fprintf(stderr, "WARNING: %s failed %s()\n", 
+                    info.pluginName.c_str(), 
+                    _pluginRegistryStepNames[step]);
+
+        if (info.deleteFunc) {
+            (*info.deleteFunc)(plugin);
+        } else if ((plugin) && (info.builtinPlugin)) {
+            delete plugin;
+        }
+        return;
+    }
+
+    mPluginRegistryData->mLock.writeUnlock();
+
+    // Or it could still be staged, having failed postLoad().
+    for (theInfo = mPluginRegistryData->mStaged.begin();
+            theInfo != mPluginRegistryData->mStaged.end(); ++theInfo) {
+        if ((*theInfo).plugin != plugin) {
+            continue;
+        }
+
+        fprintf(stderr, "WARNING: %s failed %s()\n", 
+                    (*theInfo).pluginName.c_str(), 
+                    _pluginRegistryStepNames[step]);
+
+        (*(*theInfo).deleteFunc)(plugin);
+        mPluginRegistryData->mStaged.erase(theInfo);
+        return;
+    }
+}
+
+// -----------------------------------
+//
+// Each wave takes as long as its slowest plugin, so the slowest
+// plugins of each are what startup is waiting on.
+//
+// private
+void
+Ookala::PluginRegistry::reportInit()
+{
+    std::vector<_InitWave>::const_iterator theWave;
+    double                                 time = 0, work = 0;
+
+    if (mPluginRegistryData->mInitFromDso) {
+        for (theWave = mPluginRegistryData->mInitWaves.begin();
+                theWave != mPluginRegistryData->mInitWaves.end(); 
+                ++theWave) {
+            time += (*theWave).mTime;
+            work += (*theWave).mWork;
+        }
+
+        printf("Initialized plugins in %.1f ms (%.1f ms of work, "
+               "%d waves). Critical path:\n", time, work, 
+               (int)mPluginRegistryData->mInitWaves.size());
+
+        for (theWave = mPluginRegistryData->mInitWaves.begin();
+                theWave != mPluginRegistryData->mInitWaves.end(); 
+                ++theWave) {
+            printf("    %-14s %-24s %8.1f ms", 
+                        _pluginRegistryStepNames[(*theWave).mStep],
+                        (*theWave).mSlowest.c_str(), (*theWave).mTime);
+            if ((*theWave).mNumPlugins > 1) {
+                printf("  (slowest of %d)", (int)(*theWave).mNumPlugins);
+            }
+            printf("\n");
+        }
+    }
+
+    mPluginRegistryData->mInitWaves.clear();
+    mPluginRegistryData->mInitFromDso = false;
+}
 
 // -----------------------------------
 //
 // Search for a plugin with an exact match to the given
 // name. If nothing is found, return an empty vector.
 
-std::vector<Ookala::Plugin *>
-Ookala::PluginRegistry::queryByName(const std::string name)
+const std::vector<Ookala::Plugin *> &
+Ookala::PluginRegistry::queryByName(const std::string &name)
 {
-    std::vector<Plugin *> matches;
-    std::string goal(name);
+    static const std::vector<Plugin *> none;
+    const std::vector<Plugin *>       *plugins = &none;
+    std::vector<std::string>           dsos;
+    _PluginIndex::const_iterator       theName;
+    _PendingIndex::const_iterator      thePending;
 
-    if (!mPluginRegistryData) return matches;
+    if (!mPluginRegistryData) return none;
 
-    for (std::vector<struct PluginInfo>::iterator i = 
-                 mPluginRegistryData->mPluginInfo.begin();
-            i != mPluginRegistryData->mPluginInfo.end(); ++i) {
+    mPluginRegistryData->mLock.readLock();
 
-        if ((*i).plugin->matchName(goal)) {
-            matches.push_back((*i).plugin);
-        }        
+    theName = mPluginRegistryData->mByName.find(name);
+    if (theName != mPluginRegistryData->mByName.end()) {
+        plugins = theName->second;
     }
-    return matches;
+
+    // Names don't collide, so we only need to look at what's 
+    // waiting to be opened if we don't already have one.
+    if (plugins->empty()) {
+        thePending = mPluginRegistryData->mPendingByName.find(name);
+        if (thePending != mPluginRegistryData->mPendingByName.end()) {
+            dsos = thePending->second;
+        }
+    }
+
+    mPluginRegistryData->mLock.readUnlock();
+
+    // Look again even if we didn't open it, as another thread
+    // may have beaten us to it.
+    if (!dsos.empty()) {
+        loadPending(dsos);
+
+        mPluginRegistryData->mLock.readLock();
+        theName = mPluginRegistryData->mByName.find(name);
+        if (theName != mPluginRegistryData->mByName.end()) {
+            plugins = theName->second;
+        }
+        mPluginRegistryData->mLock.readUnlock();
+    }
+
+    return *plugins;
 }
 
 // -----------------------------------
@@ -417,24 +1332,47 @@ Ookala::PluginRegistry::queryByName(const std::string name)
 // as a hit and returned. If nothing matches, we return
 // an empty vector.
 
-std::vector<Ookala::Plugin *>
-Ookala::PluginRegistry::queryByAttribute(const std::string attrib)
+const std::vector<Ookala::Plugin *> &
+Ookala::PluginRegistry::queryByAttribute(const std::string &attrib)
 {
-    std::vector<Plugin *> matches;
-    std::string goal(attrib);
+    static const std::vector<Plugin *> none;
+    const std::vector<Plugin *>       *plugins = &none;
+    std::vector<std::string>           dsos;
+    _PluginIndex::const_iterator       theAttr;
+    _PendingIndex::const_iterator      thePending;
 
-    if (!mPluginRegistryData) return matches;
+    if (!mPluginRegistryData) return none;
 
-    for (std::vector<struct PluginInfo>::iterator i = 
-                 mPluginRegistryData->mPluginInfo.begin();
-            i != mPluginRegistryData->mPluginInfo.end(); ++i) {
+    mPluginRegistryData->mLock.readLock();
 
-        if ((*i).plugin->matchAttribute(goal)) {
-            matches.push_back((*i).plugin);
-        }        
+    theAttr = mPluginRegistryData->mByAttribute.find(attrib);
+    if (theAttr != mPluginRegistryData->mByAttribute.end()) {
+        plugins = theAttr->second;
     }
 
-    return matches;
+    // Everything with this attribute gets opened now, so that
+    // what we hand back won't grow under the caller later.
+    if (!mPluginRegistryData->mPendingByAttribute.empty()) {
+        thePending = mPluginRegistryData->mPendingByAttribute.find(attrib);
+        if (thePending != mPluginRegistryData->mPendingByAttribute.end()) {
+            dsos = thePending->second;
+        }
+    }
+
+    mPluginRegistryData->mLock.readUnlock();
+
+    if (!dsos.empty()) {
+        loadPending(dsos);
+
+        mPluginRegistryData->mLock.readLock();
+        theAttr = mPluginRegistryData->mByAttribute.find(attrib);
+        if (theAttr != mPluginRegistryData->mByAttribute.end()) {
+            plugins = theAttr->second;
+        }
+        mPluginRegistryData->mLock.readUnlock();
+    }
+
+    return *plugins;
 }
 
 // -----------------------------------
@@ -447,16 +1385,80 @@ Ookala::PluginRegistry::queryByAttribute(const std::string attrib)
 std::vector<Ookala::Plugin *>
 Ookala::PluginRegistry::queryByAttributes(std::vector<std::string> attribs)
 {
-    std::vector<Plugin *> matches;
+    std::vector<Plugin *>    matches;
+    std::vector<std::string> dsos;
 
     if (!mPluginRegistryData) return matches;
+    if (attribs.empty())      return matches;
 
-    for (std::vector<struct PluginInfo>::iterator i = 
-                 mPluginRegistryData->mPluginInfo.begin();
-            i != mPluginRegistryData->mPluginInfo.end(); ++i) {
+    // Open any waiting DSO with a plugin that has all the attributes.
+    mPluginRegistryData->mLock.readLock();
 
-        if ((*i).plugin->matchAttributes(attribs)) {
-            matches.push_back((*i).plugin);
+    for (std::vector<std::string>::iterator theDso = 
+                    mPluginRegistryData->mPending.begin();
+            theDso != mPluginRegistryData->mPending.end(); ++theDso) {
+        std::map<std::string, _ManifestDso>::const_iterator theManifest = 
+                            mPluginRegistryData->mManifest.find(*theDso);
+        if (theManifest == mPluginRegistryData->mManifest.end()) {
+            continue;
+        }
+
+        const _ManifestDso &dso = theManifest->second;
+
+        for (std::vector<_ManifestPlugin>::const_iterator thePlugin = 
+                        dso.mPlugins.begin();
+                thePlugin != dso.mPlugins.end(); ++thePlugin) {
+            std::vector<std::string>::const_iterator theAttr = 
+                                                    attribs.begin();
+
+            while ((theAttr != attribs.end()) && 
+                    (_pluginRegistryHas((*thePlugin).mAttributes, 
+                                                          *theAttr))) {
+                ++theAttr;
+            }
+
+            if (theAttr == attribs.end()) {
+                dsos.push_back(*theDso);
+                break;
+            }
+        }
+    }
+
+    mPluginRegistryData->mLock.readUnlock();
+
+    if (!dsos.empty()) {
+        loadPending(dsos);
+    }
+
+    // Start from whichever attribute has the fewest plugins, and
+    // check those for the rest. Lists don't change once they're 
+    // in the index, so that can be done outside the lock.
+    static const std::vector<Plugin *> none;
+    const std::vector<Plugin *>       *candidates = NULL;
+
+    mPluginRegistryData->mLock.readLock();
+
+    for (std::vector<std::string>::const_iterator theAttr = 
+                    attribs.begin();
+            theAttr != attribs.end(); ++theAttr) {
+        _PluginIndex::const_iterator thePlugins = 
+                        mPluginRegistryData->mByAttribute.find(*theAttr);
+        const std::vector<Plugin *> &plugins = 
+                    (thePlugins == mPluginRegistryData->mByAttribute.end())?
+                                                none: *thePlugins->second;
+
+        if ((candidates == NULL) || (plugins.size() < candidates->size())) {
+            candidates = &plugins;
+        }
+    }
+
+    mPluginRegistryData->mLock.readUnlock();
+
+    for (std::vector<Plugin *>::const_iterator thePlugin = 
+                    candidates->begin();
+            thePlugin != candidates->end(); ++thePlugin) {
+        if ((*thePlugin)->matchAttributes(attribs)) {
+            matches.push_back(*thePlugin);
         }        
     }
 
@@ -476,11 +1478,13 @@ Ookala::PluginRegistry::queryByIndex(const int idx)
     if (!mPluginRegistryData)           return matches;
     if (idx <  0)                       return matches;
 
-    if (idx >= (int)mPluginRegistryData->mPluginInfo.size()) {
-        return matches;
+    mPluginRegistryData->mLock.readLock();
+
+    if (idx < (int)mPluginRegistryData->mPluginInfo.size()) {
+        matches.push_back(mPluginRegistryData->mPluginInfo[idx].plugin);
     }
 
-    matches.push_back(mPluginRegistryData->mPluginInfo[idx].plugin);
+    mPluginRegistryData->mLock.readUnlock();
     
     return matches;
 }
@@ -492,69 +1496,704 @@ Ookala::PluginRegistry::queryByIndex(const int idx)
 const int
 Ookala::PluginRegistry::numPlugins()
 {
+    int num;
+
     if (!mPluginRegistryData) return 0;
 
-    return (int)mPluginRegistryData->mPluginInfo.size();
+    mPluginRegistryData->mLock.readLock();
+    num = (int)mPluginRegistryData->mPluginInfo.size();
+    mPluginRegistryData->mLock.readUnlock();
+
+    return num;
 }
 
+// -----------------------------------
+//
+
+uint32_t
+Ookala::PluginRegistry::generation()
+{
+    if (!mPluginRegistryData) return 0;
+
+    return mPluginRegistryData->mGeneration;
+}
 
 // -----------------------------------
 //
+// Start using a manifest, reading in what it already knows.
+// A missing file is fine; it'll be written as DSOs are opened.
 
-Ookala::DictItem *
-Ookala::PluginRegistry::createDictItem(const std::string typeName) 
+bool
+Ookala::PluginRegistry::setManifestFile(const std::string &filename)
 {
-    if (!mPluginRegistryData) return NULL;
+    bool retVal = true;
+
+    if (!mPluginRegistryData) return false;
+
+    lockLoad();
+
+    // Anything waiting was found through the old manifest.
+    loadPendingPlugins();
+
+    mPluginRegistryData->mLock.writeLock();
+
+    mPluginRegistryData->mManifestFile = filename;
+    mPluginRegistryData->mManifest.clear();
+
+    if (!filename.empty()) {
+        retVal = readManifest();
+    }
+
+    mPluginRegistryData->mLock.writeUnlock();
+
+    unlockLoad();
+
+    return retVal;
+}
+
+// -----------------------------------
+//
+
+std::string
+Ookala::PluginRegistry::getManifestFile()
+{
+    std::string filename;
+
+    if (!mPluginRegistryData) return std::string("");
+
+    mPluginRegistryData->mLock.readLock();
+    filename = mPluginRegistryData->mManifestFile;
+    mPluginRegistryData->mLock.readUnlock();
+
+    return filename;
+}
+
+// -----------------------------------
+//
+
+bool
+Ookala::PluginRegistry::hasPlugin(const std::string &name)
+{
+    _PluginIndex::const_iterator theName;
+    bool                         found;
+
+    if (!mPluginRegistryData) return false;
+
+    mPluginRegistryData->mLock.readLock();
+
+    theName = mPluginRegistryData->mByName.find(name);
+    found   = ((theName != mPluginRegistryData->mByName.end()) &&
+                    (!theName->second->empty())) ||
+              (mPluginRegistryData->mPendingByName.find(name) != 
+                            mPluginRegistryData->mPendingByName.end());
+
+    mPluginRegistryData->mLock.readUnlock();
+
+    return found;
+}
+
+// -----------------------------------
+//
+
+bool
+Ookala::PluginRegistry::loadPendingPlugins()
+{
+    std::vector<std::string> dsos;
+
+    if (!mPluginRegistryData) return false;
+
+    mPluginRegistryData->mLock.readLock();
+    dsos = mPluginRegistryData->mPending;
+    mPluginRegistryData->mLock.readUnlock();
+
+    return loadPending(dsos);
+}
+
+// -----------------------------------
+//
+// dsos is a copy, as opening things changes the pending
+// lists it probably came from.
+//
+// private
+bool
+Ookala::PluginRegistry::loadPending(std::vector<std::string> dsos)
+{
+    std::vector<std::string>::iterator theDso, thePending;
+    std::vector<std::string>           opening, staged;
+    bool                               waiting;
+
+    // The load that plugins initializing together are part of is 
+    // waiting on them, so they can't wait on it. Whatever they
+    // were after should have been declared.
+    if (gPluginRegistryInitWave == this) {
+        mPluginRegistryData->mLock.readLock();
+        for (theDso = dsos.begin(); theDso != dsos.end(); ++theDso) {
+            if (_pluginRegistryHas(mPluginRegistryData->mPending, *theDso)) {
+                fprintf(stderr, "WARNING: Can't open %s while plugins "
+                                "are initializing\n", (*theDso).c_str());
+            }
+        }
+        mPluginRegistryData->mLock.readUnlock();
+        return false;
+    }
+
+    lockLoad();
+
+    for (theDso = dsos.begin(); theDso != dsos.end(); ++theDso) {
+
+        // Plugins may go looking for each other while they load,
+        // which brings us back here for what we're already opening.
+        mPluginRegistryData->mLock.readLock();
+        waiting = 
+            _pluginRegistryHas(mPluginRegistryData->mPending, *theDso) &&
+            (!_pluginRegistryHas(mPluginRegistryData->mOpening, *theDso));
+        mPluginRegistryData->mLock.readUnlock();
+
+        if (!waiting) {
+            continue;
+        }
+
+        mPluginRegistryData->mOpening.push_back(*theDso);
+        opening.push_back(*theDso);
+
+        printf("Opening %s on first use\n", (*theDso).c_str());
+        if (openPlugin((*theDso).c_str())) {
+            staged.push_back(*theDso);
+        } else {
+            fprintf(stderr, "ERROR: Can't load plugin %s\n",
+                                                (*theDso).c_str());
+        }
+    }
+
+    postLoadPlugins();
+
+    // Their plugins are in, so they're not pending any more.
+    mPluginRegistryData->mLock.writeLock();
+
+    for (theDso = opening.begin(); theDso != opening.end(); ++theDso) {
+        thePending = std::find(mPluginRegistryData->mPending.begin(),
+                               mPluginRegistryData->mPending.end(), 
+                               *theDso);
+        mPluginRegistryData->mPending.erase(thePending);
 
-    // First, check out all our built-in types
-    if (typeName == "bool") {
-        return new BoolDictItem;
+        thePending = std::find(mPluginRegistryData->mOpening.begin(),
+                               mPluginRegistryData->mOpening.end(), 
+                               *theDso);
+        mPluginRegistryData->mOpening.erase(thePending);
     }
+    if (!opening.empty()) {
+        indexPending();
+    }
+
+    for (theDso = staged.begin(); theDso != staged.end(); ++theDso) {
+        if (!_pluginRegistryHasDso(mPluginRegistryData->mPluginInfo, 
+                                   *theDso)) {
+            fprintf(stderr, "ERROR: Can't load plugin %s\n",
+                                                (*theDso).c_str());
+        }
+    }
+
+    mPluginRegistryData->mLock.writeUnlock();
+
+    if (!opening.empty()) {
+        registerPlugins();
+    }
+
+    unlockLoad();
+
+    return !opening.empty();
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::PluginRegistry::indexPending()
+{
+    std::vector<std::string>::iterator           theDso;
+    std::vector<_ManifestPlugin>::const_iterator thePlugin;
+    std::vector<std::string>::const_iterator     theKey;
+
+    mPluginRegistryData->mPendingByName.clear();
+    mPluginRegistryData->mPendingByAttribute.clear();
+    mPluginRegistryData->mPendingByType.clear();
+
+    for (theDso = mPluginRegistryData->mPending.begin();
+            theDso != mPluginRegistryData->mPending.end(); ++theDso) {
+        const _ManifestDso &dso = mPluginRegistryData->mManifest[*theDso];
+
+        for (thePlugin = dso.mPlugins.begin(); 
+                thePlugin != dso.mPlugins.end(); ++thePlugin) {
+            mPluginRegistryData->mPendingByName[
+                                (*thePlugin).mName].push_back(*theDso);
+
+            for (theKey = (*thePlugin).mAttributes.begin();
+                    theKey != (*thePlugin).mAttributes.end(); ++theKey) {
+                std::vector<std::string> &dsos = 
+                            mPluginRegistryData->mPendingByAttribute[*theKey];
+
+                if ((dsos.empty()) || (dsos.back() != *theDso)) {
+                    dsos.push_back(*theDso);
+                }
+            }
+        }
+
+        for (theKey = dso.mDictItemTypes.begin();
+                theKey != dso.mDictItemTypes.end(); ++theKey) {
+            mPluginRegistryData->mPendingByType[*theKey].push_back(*theDso);
+        }
+    }
+}
+
+// -----------------------------------
+//
+// The manifest looks like:
+//
+//   <pluginManifest>
+//     <dso file="/path/to/libFoo.so" mtime="..." size="...">
+//       <plugin name="Foo">
+//         <attribute>...</attribute>
+//       </plugin>
+//       <dictItemType>...</dictItemType>
+//     </dso>
+//   </pluginManifest>
+//
+// private
+bool
+Ookala::PluginRegistry::readManifest()
+{
+    xmlDocPtr   doc;
+    xmlNodePtr  root, dsoNode, child, attrNode;
+    FILE       *fid;
+
+    // Not having one yet is normal.
+    fid = fopen(mPluginRegistryData->mManifestFile.c_str(), "rb");
+    if (!fid) {
+        return true;
+    }
+    fclose(fid);
+
+    doc = xmlReadFile(mPluginRegistryData->mManifestFile.c_str(), NULL, 
+                      XML_PARSE_NONET | XML_PARSE_NOBLANKS);
+    if (doc == NULL) {
+        fprintf(stderr, "WARNING: Can't parse plugin manifest %s\n",
+                            mPluginRegistryData->mManifestFile.c_str());
+        return false;
+    }
+
+    root = xmlDocGetRootElement(doc);
+    if ((root == NULL) || 
+            (xmlStrcmp(root->name, (const xmlChar *)"pluginManifest"))) {
+        fprintf(stderr, "WARNING: %s isn't a plugin manifest\n",
+                            mPluginRegistryData->mManifestFile.c_str());
+        xmlFreeDoc(doc);
+        return false;
+    }
+
+    for (dsoNode = root->children; dsoNode; dsoNode = dsoNode->next) {
+        _ManifestDso dso;
+        std::string  file;
+
+        if ((dsoNode->type != XML_ELEMENT_NODE) ||
+                (xmlStrcmp(dsoNode->name, (const xmlChar *)"dso"))) {
+            continue;
+        }
+
+        file       = _pluginRegistryStringProp(dsoNode, "file");
+        dso.mMtime = _pluginRegistryNumberProp(dsoNode, "mtime");
+        dso.mSize  = _pluginRegistryNumberProp(dsoNode, "size");
+        if (file.empty()) {
+            continue;
+        }
+
+        for (child = dsoNode->children; child; child = child->next) {
+            if (child->type != XML_ELEMENT_NODE) {
+                continue;
+            }
+
+            if (!xmlStrcmp(child->name, (const xmlChar *)"plugin")) {
+                _ManifestPlugin plugin;
+
+                plugin.mName = _pluginRegistryStringProp(child, "name");
+
+                for (attrNode = child->children; attrNode; 
+                                            attrNode = attrNode->next) {
+                    if ((attrNode->type == XML_ELEMENT_NODE) &&
+                            (!xmlStrcmp(attrNode->name, 
+                                        (const xmlChar *)"attribute"))) {
+                        plugin.mAttributes.push_back(
+                                    _pluginRegistryContent(attrNode));
+                    }
+                }
+
+                if (!plugin.mName.empty()) {
+                    dso.mPlugins.push_back(plugin);
+                }
+            } else if (!xmlStrcmp(child->name, 
+                                  (const xmlChar *)"dictItemType")) {
+                dso.mDictItemTypes.push_back(_pluginRegistryContent(child));
+            }
+        }
+
+        mPluginRegistryData->mManifest[file] = dso;
+    }
+
+    xmlFreeDoc(doc);
+
+    return true;
+}
+
+// -----------------------------------
+//
+// Written to the side and renamed into place, so a crash part
+// way through doesn't leave half a manifest.
+//
+// private
+bool
+Ookala::PluginRegistry::writeManifest()
+{
+    std::map<std::string, _ManifestDso>::const_iterator theDso;
+    std::vector<_ManifestPlugin>::const_iterator        thePlugin;
+    std::vector<std::string>::const_iterator            theKey;
+    xmlDocPtr                                           doc;
+    xmlNodePtr                                          root, dsoNode, node;
+    char                                                number[32];
+    std::string                                         tmpName;
+    bool                                                ok;
+
+    if (mPluginRegistryData->mManifestFile.empty()) return false;
+
+    doc  = xmlNewDoc((const xmlChar *)"1.0");
+    root = xmlNewNode(NULL, (const xmlChar *)"pluginManifest");
+    xmlDocSetRootElement(doc, root);
+
+    for (theDso = mPluginRegistryData->mManifest.begin();
+            theDso != mPluginRegistryData->mManifest.end(); ++theDso) {
+        dsoNode = xmlNewChild(root, NULL, (const xmlChar *)"dso", NULL);
+
+        xmlNewProp(dsoNode, (const xmlChar *)"file", 
+                            (const xmlChar *)(*theDso).first.c_str());
+        snprintf(number, sizeof(number), "%llu", 
+                            (unsigned long long)(*theDso).second.mMtime);
+        xmlNewProp(dsoNode, (const xmlChar *)"mtime", 
+                            (const xmlChar *)number);
+        snprintf(number, sizeof(number), "%llu", 
+                            (unsigned long long)(*theDso).second.mSize);
+        xmlNewProp(dsoNode, (const xmlChar *)"size", 
+                            (const xmlChar *)number);
+
+        for (thePlugin = (*theDso).second.mPlugins.begin();
+                thePlugin != (*theDso).second.mPlugins.end(); ++thePlugin) {
+            node = xmlNewChild(dsoNode, NULL, (const xmlChar *)"plugin", 
+                               NULL);
+            xmlNewProp(node, (const xmlChar *)"name",
+                             (const xmlChar *)(*thePlugin).mName.c_str());
+
+            for (theKey = (*thePlugin).mAttributes.begin();
+                    theKey != (*thePlugin).mAttributes.end(); ++theKey) {
+                xmlNewTextChild(node, NULL, (const xmlChar *)"attribute",
+                                (const xmlChar *)(*theKey).c_str());
+            }
+        }
+
+        for (theKey = (*theDso).second.mDictItemTypes.begin();
+                theKey != (*theDso).second.mDictItemTypes.end(); ++theKey) {
+            xmlNewTextChild(dsoNode, NULL, (const xmlChar *)"dictItemType",
+                            (const xmlChar *)(*theKey).c_str());
+        }
+    }
+
+    tmpName = mPluginRegistryData->mManifestFile + ".tmp";
+
+    ok = (xmlSaveFormatFileEnc(tmpName.c_str(), doc, "UTF-8", 1) != -1);
+    xmlFreeDoc(doc);
+
+#ifdef WIN32
+    ok = ok && MoveFileExA(tmpName.c_str(), 
+                           mPluginRegistryData->mManifestFile.c_str(),
+                           MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && (rename(tmpName.c_str(), 
+                       mPluginRegistryData->mManifestFile.c_str()) == 0);
+#endif
+
+    if (!ok) {
+        fprintf(stderr, "WARNING: Can't write plugin manifest %s\n",
+                            mPluginRegistryData->mManifestFile.c_str());
+        remove(tmpName.c_str());
+    }
+
+    return ok;
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::PluginRegistry::learnDictItemType(const std::string &dsoName,
+                                          const char        *typeName)
+{
+    std::map<std::string, _ManifestDso>::iterator theDso;
+
+    if (dsoName.empty()) return;
+
+    mPluginRegistryData->mLock.writeLock();
+
+    theDso = mPluginRegistryData->mManifest.find(dsoName);
+    if ((!mPluginRegistryData->mManifestFile.empty()) &&
+            (theDso != mPluginRegistryData->mManifest.end()) &&
+            (!_pluginRegistryHas((*theDso).second.mDictItemTypes, 
+                                                        typeName))) {
+        (*theDso).second.mDictItemTypes.push_back(typeName);
+        writeManifest();
+    }
+
+    mPluginRegistryData->mLock.writeUnlock();
+}
+
+
+// -----------------------------------
+//
+// Lists that are already in the index may be held by whoever
+// queried them, so rather than changing one we copy it and 
+// put the copy in its place.
+//
+// private
+void
+Ookala::PluginRegistry::indexPlugin(Plugin *plugin)
+{
+    _PluginIndex::const_iterator theList;
+    std::vector<Plugin *>        plugins;
+
+    mPluginRegistryData->mGeneration = ++gPluginRegistryGeneration;
+
+    theList = mPluginRegistryData->mByName.find(plugin->name());
+    if (theList != mPluginRegistryData->mByName.end()) {
+        plugins = *theList->second;
+    }
+    plugins.push_back(plugin);
+    setIndexList(mPluginRegistryData->mByName, plugin->name(), plugins);
+
+    const std::vector<std::string> &attribs = plugin->attributes();
+
+    for (std::vector<std::string>::const_iterator theAttr = 
+                    attribs.begin();
+            theAttr != attribs.end(); ++theAttr) {
+        plugins.clear();
+
+        theList = mPluginRegistryData->mByAttribute.find(*theAttr);
+        if (theList != mPluginRegistryData->mByAttribute.end()) {
+            plugins = *theList->second;
+        }
 
-    if (typeName == "int") {
-        return new IntDictItem;
+        // A plugin that lists an attribute twice is still only
+        // one match.
+        if ((plugins.empty()) || (plugins.back() != plugin)) {
+            plugins.push_back(plugin);
+            setIndexList(mPluginRegistryData->mByAttribute, *theAttr, 
+                                                            plugins);
+        }
     }
+}
 
-    if (typeName == "double") {
-        return new DoubleDictItem;
+// -----------------------------------
+//
+// Entries are left in place once they're empty, so that only
+// lists are ever replaced, never taken away.
+//
+// private
+void
+Ookala::PluginRegistry::unindexPlugin(Plugin *plugin)
+{
+    _PluginIndex::const_iterator             theList;
+    std::vector<Plugin *>                    plugins;
+    std::vector<Plugin *>::iterator          thePlugin;
+    std::vector<std::string>                 keys;
+    std::vector<std::string>::const_iterator theKey;
+
+    theList = mPluginRegistryData->mByName.find(plugin->name());
+    if (theList != mPluginRegistryData->mByName.end()) {
+        plugins   = *theList->second;
+        thePlugin = std::find(plugins.begin(), plugins.end(), plugin);
+        if (thePlugin != plugins.end()) {
+            plugins.erase(thePlugin);
+            setIndexList(mPluginRegistryData->mByName, plugin->name(), 
+                                                       plugins);
+        }
     }
 
-    if (typeName == "string") {
-        return new StringDictItem;
+    keys = plugin->attributes();
+    for (theKey = keys.begin(); theKey != keys.end(); ++theKey) {
+        theList = mPluginRegistryData->mByAttribute.find(*theKey);
+        if (theList == mPluginRegistryData->mByAttribute.end()) {
+            continue;
+        }
+
+        plugins   = *theList->second;
+        thePlugin = std::find(plugins.begin(), plugins.end(), plugin);
+        if (thePlugin != plugins.end()) {
+            plugins.erase(thePlugin);
+            setIndexList(mPluginRegistryData->mByAttribute, *theKey, 
+                                                            plugins);
+        }
     }
 
-    if (typeName == "blob") {
-        return new BlobDictItem;
+    mPluginRegistryData->mGeneration = ++gPluginRegistryGeneration;
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::PluginRegistry::rebuildIndex()
+{
+    mPluginRegistryData->mByName.clear();
+    mPluginRegistryData->mByAttribute.clear();
+    mPluginRegistryData->mGeneration = ++gPluginRegistryGeneration;
+
+    for (std::vector<struct PluginInfo>::iterator i = 
+                 mPluginRegistryData->mPluginInfo.begin();
+            i != mPluginRegistryData->mPluginInfo.end(); ++i) {
+        indexPlugin((*i).plugin);
     }
-        
-    if (typeName == "intArray") {
-        return new IntArrayDictItem;
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::PluginRegistry::setIndexList(_PluginIndex                &index,
+                                     const std::string           &key,
+                                     const std::vector<Plugin *> &plugins)
+{
+    std::vector<Plugin *> *list = new std::vector<Plugin *>(plugins);
+
+    mPluginRegistryData->mIndexLists.push_back(list);
+    index[key] = list;
+}
+
+// -----------------------------------
+//
+
+Ookala::DictItem *
+Ookala::PluginRegistry::createDictItem(const std::string typeName) 
+{
+    return createDictItem(DictKey(typeName), typeName.c_str());
+}
+
+// -----------------------------------
+//
+
+Ookala::DictItem *
+Ookala::PluginRegistry::createDictItem(const DictKey &typeKey) 
+{
+    if (!typeKey.valid()) return NULL;
+
+    return createDictItem(typeKey, typeKey.str().c_str());
+}
+
+// -----------------------------------
+//
+// private
+Ookala::DictItem *
+Ookala::PluginRegistry::createDictItem(const DictKey &typeKey,
+                                       const char    *typeName) 
+{
+    std::unordered_map<uint32_t, _DictItemType>::iterator theType;
+    std::vector<PluginInfo>                               plugins;
+    std::vector<std::string>                              dsos;
+    _PendingIndex::const_iterator                         thePending;
+    DictItemCreateFunc createFunc = NULL;
+    bool               known      = false;
+    bool               pending;
+    uint32_t           generation;
+
+    if (!mPluginRegistryData) return NULL;
+    if (!typeKey.valid())     return NULL;
+
+    mPluginRegistryData->mLock.readLock();
+
+    theType = mPluginRegistryData->mDictItemTypes.find(typeKey.id());
+    if (theType != mPluginRegistryData->mDictItemTypes.end()) {
+        known      = true;
+        createFunc = (*theType).second.mCreateFunc;
     }
 
-    if (typeName == "doubleArray") {
-        return new DoubleArrayDictItem;
+    mPluginRegistryData->mLock.readUnlock();
+
+    if (known) {
+        if (createFunc == NULL) {
+            return NULL;
+        }
+        return (*createFunc)(typeName);
     }
 
-    if (typeName == "stringArray") {
-        return new StringArrayDictItem;
+    // If we haven't seen this type before, walk the plugin list
+    // and see if anyone recognizes it. Plugins aren't called with
+    // the lock held, so go by a copy of the list.
+    mPluginRegistryData->mLock.readLock();
+
+    plugins    = mPluginRegistryData->mPluginInfo;
+    generation = mPluginRegistryData->mGeneration;
+    pending    = !mPluginRegistryData->mPending.empty();
+
+    thePending = mPluginRegistryData->mPendingByType.find(typeName);
+    if (thePending != mPluginRegistryData->mPendingByType.end()) {
+        dsos = thePending->second;
     }
 
-    // If we're not requesting one of those, walk the plugin list
-    // and see if anyone recognizes this type
-    for (std::vector<PluginInfo>::iterator plugin = 
-                          mPluginRegistryData->mPluginInfo.begin();
-                plugin != mPluginRegistryData->mPluginInfo.end(); 
-                                                        ++plugin) {
+    mPluginRegistryData->mLock.readUnlock();
+
+    for (std::vector<PluginInfo>::iterator plugin = plugins.begin();
+                plugin != plugins.end(); ++plugin) {
 
         DictItem *item = NULL;
 
         if ((*plugin).dictItemCreateFunc) {
-            item = ((*plugin).dictItemCreateFunc)(typeName.c_str());
+            item = ((*plugin).dictItemCreateFunc)(typeName);
             if (item) {
+                setDictItemType(typeKey, (*plugin).dictItemCreateFunc,
+                                (*plugin).dictItemDeleteFunc, false);
+                learnDictItemType((*plugin).dsoName, typeName);
                 return item;
             }
         }
     }
+
+    // Maybe it's from a DSO we haven't opened yet. If the manifest 
+    // doesn't say which, the only way to find out is to open them
+    // all. Either way there's less waiting each time around. Another
+    // thread may have opened it while we waited, so go by whether
+    // the plugins have changed, not by whether we opened anything.
+    if (pending) {
+        if (!dsos.empty()) {
+            loadPending(dsos);
+        } else {
+            loadPendingPlugins();
+        }
+
+        if (generation != mPluginRegistryData->mGeneration) {
+            return createDictItem(typeKey, typeName);
+        }
+    }
+
+    // Remember that nobody knows this one, so files full of it 
+    // don't keep re-walking the list. If plugins have come along
+    // since we looked, they may know it, so let it be.
+    mPluginRegistryData->mLock.writeLock();
+
+    if ((mPluginRegistryData->mGeneration == generation) &&
+            (mPluginRegistryData->mDictItemTypes.find(typeKey.id()) == 
+                            mPluginRegistryData->mDictItemTypes.end())) {
+        _DictItemType &itemType = 
+                        mPluginRegistryData->mDictItemTypes[typeKey.id()];
+
+        itemType.mCreateFunc = NULL;
+        itemType.mDeleteFunc = NULL;
+        itemType.mBuiltin    = false;
+    }
+
+    mPluginRegistryData->mLock.writeUnlock();
     
     return NULL;
 }
@@ -565,29 +2204,44 @@ Ookala::PluginRegistry::createDictItem(const std::string typeName)
 bool
 Ookala::PluginRegistry::deleteDictItem(DictItem *item) 
 {
+    std::unordered_map<uint32_t, _DictItemType>::iterator theType;
+    std::vector<PluginInfo>                               plugins;
+    DictItemDeleteFunc deleteFunc = NULL;
+
     if (!mPluginRegistryData) return false;
+    if (!item)                return false;
+
+    mPluginRegistryData->mLock.readLock();
+
+    theType = mPluginRegistryData->mDictItemTypes.find(
+                                        item->itemTypeKey().id());
+    if (theType != mPluginRegistryData->mDictItemTypes.end()) {
+        deleteFunc = (*theType).second.mDeleteFunc;
+    }
+
+    mPluginRegistryData->mLock.readUnlock();
 
-    if ((item->itemType() == "bool") ||
-        (item->itemType() == "int") ||
-        (item->itemType() == "double") ||
-        (item->itemType() == "string") ||
-        (item->itemType() == "blob") ||
-        (item->itemType() == "intArray") ||
-        (item->itemType() == "doubleArray") ||
-        (item->itemType() == "stringArray")) {
-        delete item;
+    if ((deleteFunc) && ((*deleteFunc)(item) == 0)) {
         return true;
     }
 
-    // If we're not requesting one of those, walk the plugin list
-    // and see if anyone recognizes this type
-    for (std::vector<PluginInfo>::iterator plugin = 
-                          mPluginRegistryData->mPluginInfo.begin();
-                plugin != mPluginRegistryData->mPluginInfo.end(); 
-                                                        ++plugin) {
+    // Items that were created directly, rather than through us, 
+    // may not be in the table yet. Walk the plugin list and see 
+    // if anyone recognizes this type
+    mPluginRegistryData->mLock.readLock();
+    plugins = mPluginRegistryData->mPluginInfo;
+    mPluginRegistryData->mLock.readUnlock();
+
+    for (std::vector<PluginInfo>::iterator plugin = plugins.begin();
+                plugin != plugins.end(); ++plugin) {
+
+        if (((*plugin).dictItemDeleteFunc) && 
+                ((*plugin).dictItemDeleteFunc != deleteFunc)) {
+            DictKey typeKey = item->itemTypeKey();
 
-        if ((*plugin).dictItemDeleteFunc) {
             if (((*plugin).dictItemDeleteFunc)(item) == 0) {
+                setDictItemType(typeKey, (*plugin).dictItemCreateFunc,
+                                (*plugin).dictItemDeleteFunc, false);
                 return true;
             }
         }
@@ -595,3 +2249,128 @@ Ookala::PluginRegistry::deleteDictItem(DictItem *item)
     
     return false;
 }
+
+// -----------------------------------
+//
+// private
+void
+Ookala::PluginRegistry::addBuiltinDictItemTypes()
+{
+    setDictItemType(BoolDictItem::typeKey(), 
+                    _createBuiltinDictItem<BoolDictItem>,
+                    _deleteBuiltinDictItem, true);
+    setDictItemType(IntDictItem::typeKey(), 
+                    _createBuiltinDictItem<IntDictItem>,
+                    _deleteBuiltinDictItem, true);
+    setDictItemType(DoubleDictItem::typeKey(), 
+                    _createBuiltinDictItem<DoubleDictItem>,
+                    _deleteBuiltinDictItem, true);
+    setDictItemType(StringDictItem::typeKey(), 
+                    _createBuiltinDictItem<StringDictItem>,
+                    _deleteBuiltinDictItem, true);
+    setDictItemType(BlobDictItem::typeKey(), 
+                    _createBuiltinDictItem<BlobDictItem>,
+                    _deleteBuiltinDictItem, true);
+    setDictItemType(IntArrayDictItem::typeKey(), 
+                    _createBuiltinDictItem<IntArrayDictItem>,
+                    _deleteBuiltinDictItem, true);
+    setDictItemType(DoubleArrayDictItem::typeKey(), 
+                    _createBuiltinDictItem<DoubleArrayDictItem>,
+                    _deleteBuiltinDictItem, true);
+    setDictItemType(StringArrayDictItem::typeKey(), 
+                    _createBuiltinDictItem<StringArrayDictItem>,
+                    _deleteBuiltinDictItem, true);
+    setDictItemType(YxyDictItem::typeKey(), 
+                    _createBuiltinDictItem<YxyDictItem>,
+                    _deleteBuiltinDictItem, true);
+    setDictItemType(RgbDictItem::typeKey(), 
+                    _createBuiltinDictItem<RgbDictItem>,
+                    _deleteBuiltinDictItem, true);
+    setDictItemType(Mat33DictItem::typeKey(), 
+                    _createBuiltinDictItem<Mat33DictItem>,
+                    _deleteBuiltinDictItem, true);
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::PluginRegistry::forgetPluginDictItemTypes()
+{
+    std::unordered_map<uint32_t, _DictItemType>::iterator theType;
+
+    mPluginRegistryData->mLock.writeLock();
+
+    theType = mPluginRegistryData->mDictItemTypes.begin();
+    while (theType != mPluginRegistryData->mDictItemTypes.end()) {
+        if ((*theType).second.mBuiltin) {
+            ++theType;
+        } else {
+            theType = mPluginRegistryData->mDictItemTypes.erase(theType);
+        }
+    }
+
+    mPluginRegistryData->mLock.writeUnlock();
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::PluginRegistry::setDictItemType(const DictKey      &typeKey,
+                                        DictItemCreateFunc  createFunc,
+                                        DictItemDeleteFunc  deleteFunc,
+                                        bool                builtin)
+{
+    _DictItemType itemType;
+
+    if (!typeKey.valid()) return;
+
+    itemType.mCreateFunc = createFunc;
+    itemType.mDeleteFunc = deleteFunc;
+    itemType.mBuiltin    = builtin;
+
+    mPluginRegistryData->mLock.writeLock();
+
+    // Plugins can't take over the builtin types.
+    std::unordered_map<uint32_t, _DictItemType>::iterator theType = 
+                mPluginRegistryData->mDictItemTypes.find(typeKey.id());
+    if ((theType == mPluginRegistryData->mDictItemTypes.end()) ||
+            (!(*theType).second.mBuiltin)) {
+        mPluginRegistryData->mDictItemTypes[typeKey.id()] = itemType;
+    }
+
+    mPluginRegistryData->mLock.writeUnlock();
+}
+
+// -----------------------------------
+//
+// Loading can come back around to us on the same thread, 
+// through plugins that query for others as they load, so a 
+// thread that's already loading goes straight through.
+//
+// private
+void
+Ookala::PluginRegistry::lockLoad()
+{
+    if (mPluginRegistryData->mLoader == std::this_thread::get_id()) {
+        mPluginRegistryData->mLoadDepth++;
+        return;
+    }
+
+    mPluginRegistryData->mLoadLock.lock();
+    mPluginRegistryData->mLoader    = std::this_thread::get_id();
+    mPluginRegistryData->mLoadDepth = 1;
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::PluginRegistry::unlockLoad()
+{
+    if (--mPluginRegistryData->mLoadDepth == 0) {
+        mPluginRegistryData->mLoader = std::thread::id();
+        mPluginRegistryData->mLoadLock.unlock();
+    }
+}
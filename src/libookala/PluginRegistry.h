@@ -27,10 +27,15 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <map>
+#include <atomic>
+#include <thread>
 
 #include "Types.h"
 #include "Plugin.h"
 #include "Dict.h"
+#include "Mutex.h"
 
 namespace Ookala {
 
@@ -39,6 +44,12 @@ namespace Ookala {
 // plugins. Also provides query ability for plugins
 // to get access to others.
 //
+// Queries can come from any thread. Plugins are loaded by one 
+// thread at a time, and a query that needs a DSO opened waits 
+// for any load that's going on. Plugins initializing in a wave 
+// on more than one thread can query, but can't have anything
+// opened for them.
+//
 class EXIMPORT PluginRegistry
 {
     public:
@@ -50,8 +61,20 @@ class EXIMPORT PluginRegistry
 
         // Load in a DSO that contains plugins. Will return false
         // if we coulnd't find any plugins in the DSO.
+        //
+        // With a manifest set, a DSO that's in the manifest and 
+        // hasn't changed since isn't opened here. Its plugins are 
+        // noted, and the DSO is opened the first time one of them
+        // is asked for by name or by attribute, or one of its 
+        // DictItem types is needed. Anything that goes wrong opening
+        // it then shows up as the plugin not being there.
         // 
         virtual bool loadPlugin(const char *filename);
+
+        // Load a list of DSOs at once, so their plugins can all be
+        // initialized together. Returns false if any of them didn't
+        // give us a plugin, after loading the rest.
+        virtual bool loadPlugins(const std::vector<std::string> &filenames);
         
         // Load a plugin, optionally with dict item create and
         // delete, from within your code.
@@ -67,17 +90,53 @@ class EXIMPORT PluginRegistry
         
         // Look through various places and load plugins that seem
         // to be valid.
+        //
+        // Plugins that declare their dependencies are checked in
+        // waves: each wave is everything whose dependencies have
+        // already been through, and the plugins in a wave run on 
+        // a pool of threads. Plugins that don't declare anything 
+        // get a wave to themselves, in load order. Failures are 
+        // handled between waves, in load order, so what's left at 
+        // the end doesn't depend on which thread finished first.
+        //
+        // Once plugins from a DSO have been through, the slowest
+        // plugin in each wave is printed, which is the critical
+        // path through startup.
         virtual bool registerPlugins();       
 
+        // Remember what each DSO holds in filename: plugin names and
+        // attributes, and the DictItem types it's been seen to 
+        // create, keyed on the DSO's mtime and size. Set this 
+        // before loading anything from DSOs. An empty filename, the
+        // default, opens every DSO as soon as it's loaded.
+        bool        setManifestFile(const std::string &filename);
+        std::string getManifestFile();
+
+        // True if a plugin of this name is loaded, or waiting in a
+        // DSO to be opened on first use. This doesn't open anything.
+        bool        hasPlugin(const std::string &name);
+
+        // Open every DSO that's waiting on first use.
+        bool        loadPendingPlugins();
+
         // Search for a plugin with an exact match to the given
         // name. If nothing is found, return an empty vector.
-        std::vector<Plugin *> queryByName(const std::string name);
+        //
+        // Plugins are indexed by name and by attribute as they're
+        // loaded, so these are a hash lookup. What comes back is 
+        // the index's own list, in load order. A list is never 
+        // changed once it's in the index; plugins coming or going 
+        // put a new one in its place. So the reference stays good 
+        // for as long as the registry does, though it may go out of 
+        // date - check generation() to see if it has.
+        const std::vector<Plugin *> & queryByName(const std::string &name);
         
         // Search for a plugin that has a given set of attributes.
         // If a plugin matches all specified attributes, it's counted
         // as a hit and returned. If nothing matches, we return
         // an empty vector.
-        std::vector<Plugin *> queryByAttribute(const std::string attrib);
+        const std::vector<Plugin *> & queryByAttribute(
+                                            const std::string &attrib);
         
         std::vector<Plugin *> queryByAttributes(
                                   const std::vector<std::string> attribs);
@@ -87,27 +146,218 @@ class EXIMPORT PluginRegistry
         // methods.
         std::vector<Plugin *> queryByIndex(const int idx);
         
-        // Return the number of loaded plugins
+        // Return the number of loaded plugins. Plugins waiting on 
+        // first use don't count until they're opened.
         const int numPlugins();
+
+        // Changes whenever the set of plugins does. Anyone holding 
+        // on to plugins they've looked up can compare this against 
+        // what it was at the time, and look them up again when it
+        // differs. No two registries hand out the same value.
+        uint32_t   generation();
         
         // Walk our list of plugins and see if we're able to create 
         // and destroy various types of plugins. This allows for
         // plugins to instanciate new data types and have them
         // saved/loaded in the dict
+        //
+        // Types are looked up in a hash keyed on the interned type
+        // name. The builtin types are in there from the start; a 
+        // plugin type goes in the first time some plugin's 
+        // dictItemCreateFunc or dictItemDeleteFunc claims it, so
+        // we only walk the plugin list once per type.
         DictItem * createDictItem(const std::string typeName);
+        DictItem * createDictItem(const DictKey &typeKey);
         
         bool       deleteDictItem(DictItem *item);
               
 
     private:
+        // Who knows how to create and delete a given DictItem type.
+        // A NULL create func means we've looked, and nobody does.
+        struct _DictItemType {
+            DictItemCreateFunc mCreateFunc;
+            DictItemDeleteFunc mDeleteFunc;
+            bool               mBuiltin;
+        };
+
+        typedef std::unordered_map<std::string, 
+                                   const std::vector<Plugin *> *> _PluginIndex;
+
+        // What the manifest knows about a DSO.
+        struct _ManifestPlugin {
+            std::string              mName;
+            std::vector<std::string> mAttributes;
+        };
+
+        struct _ManifestDso {
+            uint64_t                     mMtime;
+            uint64_t                     mSize;
+            std::vector<_ManifestPlugin> mPlugins;
+            std::vector<std::string>     mDictItemTypes;
+        };
+
+        // DSOs waiting on first use, by plugin name, attribute or
+        // DictItem type.
+        typedef std::unordered_map<std::string, 
+                                   std::vector<std::string> > _PendingIndex;
+
+        enum _InitStep {
+            _POST_LOAD,
+            _CHECK_DEPS,
+            _POST_CHECK_DEPS
+        };
+
+        // One wave of initialization, by how long it held us up.
+        struct _InitWave {
+            _InitStep   mStep;
+            std::string mSlowest;
+            double      mTime;
+            double      mWork;
+            size_t      mNumPlugins;
+        };
+
         struct _PluginRegistry {
             std::vector<struct PluginInfo> mPluginInfo;
 
+            // Plugins in mPluginInfo by name and by attribute, in 
+            // the same order.
+            _PluginIndex                   mByName;
+            _PluginIndex                   mByAttribute;
+
+            // Every list that's been in the indexes. Queries hand out
+            // references to them, so they're kept until we go away.
+            std::vector<std::vector<Plugin *> *> mIndexLists;
+
+            // Bumped along with the indexes. 
+            std::atomic<uint32_t>          mGeneration;
+
+            // DSOs by filename, as they were when last opened.
+            std::string                          mManifestFile;
+            std::map<std::string, _ManifestDso>  mManifest;
+
+            // DSOs from the manifest that haven't been opened yet, 
+            // in the order they were loaded, and indexes over them.
+            std::vector<std::string>       mPending;
+            _PendingIndex                  mPendingByName;
+            _PendingIndex                  mPendingByAttribute;
+            _PendingIndex                  mPendingByType;
+
+            // Pending DSOs that are being opened. They stay pending 
+            // until their plugins are in, so that other threads 
+            // after them wait for the load.
+            std::vector<std::string>       mOpening;
+
+            // Set while registerPlugins() is checking dependancies.
+            bool                           mRegistering;
+
+            // Plugins that have been created from a DSO but haven't
+            // been through postLoad() yet, and the DSOs they came from.
+            std::vector<struct PluginInfo> mStaged;
+            std::vector<LibHandle>         mStagedHandles;
+
+            // Waves since the last report, and whether any of them
+            // had plugins from a DSO in them.
+            std::vector<_InitWave>         mInitWaves;
+            bool                           mInitFromDso;
+
             // Handles to libs that have have been opened and will 
             // eventually need to be closed.
             std::vector<LibHandle>mLibHandles;
+
+            // Indexed by DictKey::id() of the type name. Filled in as
+            // we go.
+            std::unordered_map<uint32_t, _DictItemType> mDictItemTypes;
+
+            // Guards the plugin list, the indexes, the manifest, what's
+            // pending and the DictItem types against other threads.
+            // It's never held while calling into a plugin, as plugins
+            // query us.
+            RwLock                         mLock;
+
+            // Held while loading, so that only one thread changes the
+            // set of plugins at a time. Plugins being loaded can land
+            // us back here on the same thread, which goes straight
+            // through.
+            Mutex                          mLoadLock;
+            std::atomic<std::thread::id>   mLoader;
+            int                            mLoadDepth;
         };
 
+        DictItem * createDictItem(const DictKey &typeKey, 
+                                  const char    *typeName);
+
+        void       addBuiltinDictItemTypes();
+
+        void       lockLoad();
+        void       unlockLoad();
+
+        // Add a plugin that's just gone on the end of mPluginInfo
+        // to the indexes, take one out, or start them over.
+        void       indexPlugin(Plugin *plugin);
+        void       unindexPlugin(Plugin *plugin);
+        void       rebuildIndex();
+
+        // Put a new list in place of an index entry. These all need
+        // mLock held for writing.
+        void       setIndexList(_PluginIndex                &index,
+                                const std::string           &key,
+                                const std::vector<Plugin *> &plugins);
+
+        // If the manifest says we don't need to open a DSO yet, 
+        // note it as waiting on first use and return true.
+        bool       deferPlugin(const char *filename);
+
+        // Actually open a DSO and create its plugins, noting what
+        // we find in the manifest. The plugins are staged until
+        // postLoadPlugins().
+        bool       openPlugin(const char *filename);
+
+        // Run postLoad() over the staged plugins and add the ones
+        // that pass. The caller then needs to registerPlugins().
+        void       postLoadPlugins();
+
+        // Run an init step over plugins, in waves. Whatever fails
+        // is dropped, and taken out of plugins.
+        void       initPlugins(std::vector<Plugin *> &plugins, 
+                               _InitStep              step);
+
+        // The next wave from remaining, in load order.
+        void       nextInitWave(const std::vector<Plugin *> &remaining,
+                                _InitStep                    step,
+                                std::vector<Plugin *>       &wave);
+
+        // Open anything that plugins have declared they depend on
+        // that's waiting on first use. Returns true if anything was.
+        bool       openDependencies(const std::vector<Plugin *> &plugins);
+
+        // Get rid of a plugin that's failed one of the init steps.
+        void       dropPlugin(Plugin *plugin, _InitStep step);
+
+        void       reportInit();
+
+        // Open DSOs that were waiting on first use. Returns true
+        // if any of them were still waiting.
+        bool       loadPending(std::vector<std::string> dsos);
+
+        // These need mLock held for writing.
+        void       indexPending();
+        bool       readManifest();
+        bool       writeManifest();
+
+        // Note in the manifest that a DSO makes DictItems of typeName.
+        void       learnDictItemType(const std::string &dsoName,
+                                     const char        *typeName);
+
+        // Drop what we've learned about plugin types, whenever the
+        // set of plugins changes.
+        void       forgetPluginDictItemTypes();
+
+        void       setDictItemType(const DictKey      &typeKey, 
+                                   DictItemCreateFunc  createFunc,
+                                   DictItemDeleteFunc  deleteFunc,
+                                   bool                builtin);
+
         _PluginRegistry *mPluginRegistryData;          
 };
 
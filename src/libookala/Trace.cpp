@@ -0,0 +1,438 @@
+// --------------------------------------------------------------------------
+// $Id: Trace.cpp 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+// 
+// Permission is hereby granted, free of charge, to any person obtaining 
+// a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation 
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the 
+// Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included 
+// in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR 
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR 
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+#ifdef _WIN32
+#pragma warning(disable: 4786)
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "Trace.h"
+#include "Mutex.h"
+
+// Past this many spans, we only keep the totals.
+#define _TRACE_MAX_EVENTS 250000
+
+
+namespace {
+
+struct _TraceEvent {
+    const char  *mCategory;
+    std::string  mName;
+    uint32_t     mThread;
+    double       mStart;            // usec since the epoch
+    double       mWall;             // usec
+    double       mCpu;              // usec
+};
+
+struct _TraceTotal {
+    uint32_t     mCount;
+    double       mWall;
+    double       mCpu;
+    double       mSelf;
+    double       mMax;
+};
+
+typedef std::map<std::pair<std::string, std::string>, 
+                 _TraceTotal> _TraceTotals;
+
+struct _TraceData {
+    _TraceData(): mDropped(0), mEpoch(0) {}
+
+    Ookala::Mutex            mLock;
+    std::vector<_TraceEvent> mEvents;
+    _TraceTotals             mTotals;
+    uint64_t                 mDropped;
+    double                   mEpoch;
+};
+
+std::atomic<bool>     gTraceEnabled(false);
+std::atomic<uint32_t> gTraceNextThread(0);
+
+// Per thread: a small id for the trace, and for each open span,
+// the wall time of the spans nested in it so far.
+thread_local uint32_t            tTraceThread = 0;
+thread_local std::vector<double> tTraceChildren;
+
+// -----------------------------------
+//
+// Made on first use, so spans from static constructors are safe.
+
+_TraceData &
+_traceData()
+{
+    static _TraceData data;
+
+    return data;
+}
+
+// -----------------------------------
+
+double
+_traceWallUs()
+{
+    return std::chrono::duration<double, std::micro>(
+              std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// -----------------------------------
+//
+// CPU time used by the calling thread.
+
+double
+_traceCpuUs()
+{
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, 
+                                            &kernel, &user)) {
+        return 0;
+    }
+
+    // In 100 nsec units
+    return (((double)kernel.dwHighDateTime + (double)user.dwHighDateTime) *
+                                                        4294967296.0 +
+            (double)kernel.dwLowDateTime + (double)user.dwLowDateTime) / 10.0;
+#elif defined CLOCK_THREAD_CPUTIME_ID
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) {
+        return 0;
+    }
+
+    return (double)now.tv_sec * 1000000.0 + (double)now.tv_nsec / 1000.0;
+#else
+    return (double)clock() * 1000000.0 / CLOCKS_PER_SEC;
+#endif
+}
+
+// -----------------------------------
+
+void
+_traceRecord(const char *category, const std::string &name, 
+             double start, double wall, double cpu, double self)
+{
+    _TraceData &data = _traceData();
+    _TraceEvent event;
+
+    if (tTraceThread == 0) {
+        tTraceThread = ++gTraceNextThread;
+    }
+
+    data.mLock.lock();
+
+    // New totals start out zeroed.
+    _TraceTotal &total = data.mTotals[std::make_pair(std::string(category),
+                                                     name)];
+    total.mCount++;
+    total.mWall += wall;
+    total.mCpu  += cpu;
+    total.mSelf += self;
+    if (wall > total.mMax) {
+        total.mMax = wall;
+    }
+
+    if (data.mEvents.size() < _TRACE_MAX_EVENTS) {
+        event.mCategory = category;
+        event.mName     = name;
+        event.mThread   = tTraceThread;
+        event.mStart    = start - data.mEpoch;
+        event.mWall     = wall;
+        event.mCpu      = cpu;
+
+        data.mEvents.push_back(event);
+    } else {
+        data.mDropped++;
+    }
+
+    data.mLock.unlock();
+}
+
+// -----------------------------------
+
+void
+_traceJsonString(FILE *fid, const std::string &value)
+{
+    fputc('"', fid);
+
+    for (std::string::const_iterator theChar = value.begin();
+            theChar != value.end(); ++theChar) {
+        switch (*theChar) {
+            case '"':
+                fputs("\\\"", fid);
+                break;
+            case '\\':
+                fputs("\\\\", fid);
+                break;
+            default:
+                if ((unsigned char)(*theChar) < 0x20) {
+                    fprintf(fid, "\\u%04x", (unsigned char)(*theChar));
+                } else {
+                    fputc(*theChar, fid);
+                }
+                break;
+        }
+    }
+
+    fputc('"', fid);
+}
+
+// -----------------------------------
+
+bool
+_traceByWall(const std::pair<std::pair<std::string, std::string>, 
+                             _TraceTotal> &a,
+             const std::pair<std::pair<std::string, std::string>, 
+                             _TraceTotal> &b)
+{
+    return a.second.mWall > b.second.mWall;
+}
+
+}; // namespace
+
+
+// ===================================
+//
+// Trace
+//
+// -----------------------------------
+//
+// static
+void
+Ookala::Trace::setEnabled(bool enabled)
+{
+    _TraceData &data = _traceData();
+
+    data.mLock.lock();
+    if ((enabled) && (data.mEpoch == 0)) {
+        data.mEpoch = _traceWallUs();
+    }
+    data.mLock.unlock();
+
+    gTraceEnabled = enabled;
+}
+
+// -----------------------------------
+//
+// static
+bool
+Ookala::Trace::enabled()
+{
+    return gTraceEnabled.load(std::memory_order_relaxed);
+}
+
+// -----------------------------------
+//
+// static
+void
+Ookala::Trace::clear()
+{
+    _TraceData &data = _traceData();
+
+    data.mLock.lock();
+    data.mEvents.clear();
+    data.mTotals.clear();
+    data.mDropped = 0;
+    data.mLock.unlock();
+}
+
+// -----------------------------------
+//
+// Complete ("X") events, with timestamps and durations in 
+// usec. Spans on a thread nest by their times, so we don't 
+// need to say which is inside which.
+//
+// static
+bool
+Ookala::Trace::writeChromeTrace(const std::string &filename, 
+                                std::string       &error)
+{
+    _TraceData                               &data = _traceData();
+    std::vector<_TraceEvent>::const_iterator  theEvent;
+    FILE                                     *fid;
+    int                                       pid;
+
+#ifdef _WIN32
+    pid = (int)GetCurrentProcessId();
+#else
+    pid = (int)getpid();
+#endif
+
+    fid = fopen(filename.c_str(), "w");
+    if (fid == NULL) {
+        error = "Unable to open " + filename + " for writing.";
+        return false;
+    }
+
+    data.mLock.lock();
+
+    fprintf(fid, "{\"displayTimeUnit\": \"ms\",\n");
+    fprintf(fid, " \"otherData\": {\"droppedSpans\": %llu},\n",
+                                    (unsigned long long)data.mDropped);
+    fprintf(fid, " \"traceEvents\": [\n");
+
+    for (theEvent = data.mEvents.begin(); 
+            theEvent != data.mEvents.end(); ++theEvent) {
+        fprintf(fid, "  {\"ph\": \"X\", \"pid\": %d, \"tid\": %u, "
+                     "\"ts\": %.3f, \"dur\": %.3f, \"cat\": ", 
+                     pid, (*theEvent).mThread, 
+                     (*theEvent).mStart, (*theEvent).mWall);
+        _traceJsonString(fid, (*theEvent).mCategory);
+        fprintf(fid, ", \"name\": ");
+        _traceJsonString(fid, (*theEvent).mName);
+        fprintf(fid, ", \"args\": {\"cpu_ms\": %.3f}}%s\n", 
+                     (*theEvent).mCpu / 1000.0,
+                     (theEvent+1 == data.mEvents.end())? "": ",");
+    }
+
+    fprintf(fid, " ]\n}\n");
+
+    data.mLock.unlock();
+
+    if (ferror(fid)) {
+        error = "Error writing " + filename + ".";
+        fclose(fid);
+        return false;
+    }
+
+    if (fclose(fid) != 0) {
+        error = "Error writing " + filename + ".";
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------
+//
+// static
+std::string
+Ookala::Trace::summary()
+{
+    _TraceData                                &data = _traceData();
+    std::vector<std::pair<std::pair<std::string, std::string>, 
+                          _TraceTotal> >       totals;
+    std::string                                table;
+    char                                       line[256];
+
+    data.mLock.lock();
+    totals.assign(data.mTotals.begin(), data.mTotals.end());
+    data.mLock.unlock();
+
+    std::stable_sort(totals.begin(), totals.end(), _traceByWall);
+
+    snprintf(line, sizeof(line), 
+             "%-14s %-28s %8s %12s %12s %12s %10s\n",
+             "category", "name", "count", "wall ms", "cpu ms", 
+             "self ms", "max ms");
+    table += line;
+
+    for (size_t idx=0; idx<totals.size(); ++idx) {
+        const _TraceTotal &total = totals[idx].second;
+
+        snprintf(line, sizeof(line), 
+                 "%-14s %-28s %8u %12.1f %12.1f %12.1f %10.1f\n",
+                 totals[idx].first.first.c_str(), 
+                 totals[idx].first.second.c_str(),
+                 total.mCount, total.mWall / 1000.0, total.mCpu / 1000.0, 
+                 total.mSelf / 1000.0, total.mMax / 1000.0);
+        table += line;
+    }
+
+    return table;
+}
+
+
+// ===================================
+//
+// TraceSpan
+//
+// -----------------------------------
+//
+Ookala::TraceSpan::TraceSpan(const char *category, const char *name)
+{
+    mActive = gTraceEnabled.load(std::memory_order_relaxed);
+    if (mActive) {
+        begin(category, name);
+    }
+}
+
+// -----------------------------------
+//
+Ookala::TraceSpan::TraceSpan(const char *category, const std::string &name)
+{
+    mActive = gTraceEnabled.load(std::memory_order_relaxed);
+    if (mActive) {
+        begin(category, name.c_str());
+    }
+}
+
+// -----------------------------------
+//
+Ookala::TraceSpan::~TraceSpan()
+{
+    double wall, cpu, children;
+
+    if (!mActive) return;
+
+    wall = _traceWallUs() - mStart;
+    cpu  = _traceCpuUs()  - mCpuStart;
+
+    children = tTraceChildren.back();
+    tTraceChildren.pop_back();
+    if (!tTraceChildren.empty()) {
+        tTraceChildren.back() += wall;
+    }
+
+    _traceRecord(mCategory, mName, mStart, wall, cpu, wall - children);
+}
+
+// -----------------------------------
+//
+// private
+void
+Ookala::TraceSpan::begin(const char *category, const char *name)
+{
+    mCategory = category;
+    mName     = name;
+
+    tTraceChildren.push_back(0);
+
+    mCpuStart = _traceCpuUs();
+    mStart    = _traceWallUs();
+}
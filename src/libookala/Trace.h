@@ -0,0 +1,101 @@
+// --------------------------------------------------------------------------
+// $Id: Trace.h 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+// 
+// Permission is hereby granted, free of charge, to any person obtaining 
+// a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation 
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the 
+// Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included 
+// in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR 
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR 
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+#ifndef TRACE_H_HAS_BEEN_INCLUDED
+#define TRACE_H_HAS_BEEN_INCLUDED
+
+#include <string>
+
+#include "Types.h"
+#include "Plugin.h"
+
+namespace Ookala {
+
+//
+// Records where time goes, as spans of wall clock and cpu time,
+// so we can see what a long chain run is actually waiting on.
+// 
+// PluginChain::run() records a span for the whole chain and one
+// for each plugin's preRun(), run() and postRun(). Plugins add 
+// their own with a TraceSpan around whatever's worth timing - 
+// device transactions, sensor reads, waiting for things to 
+// settle. Spans nest on each thread.
+//
+// Recording is process-wide and off until someone turns it on.
+// While it's off, a TraceSpan costs a check of one flag.
+//
+class EXIMPORT Trace
+{
+    public:
+        static void        setEnabled(bool enabled);
+        static bool        enabled();
+
+        // Throw away everything recorded so far.
+        static void        clear();
+
+        // Write out the spans as Chrome trace-event JSON, for 
+        // chrome://tracing or Perfetto. Past a few hundred thousand 
+        // spans, only the totals in summary() are kept up.
+        static bool        writeChromeTrace(const std::string &filename,
+                                            std::string       &error);
+
+        // A table of the totals for each category and name, 
+        // most wall time first: how many spans, wall and cpu time, 
+        // wall time not spent in nested spans, and the longest.
+        static std::string summary();
+};
+
+//
+// Records a span from construction to destruction, so put one
+// at the top of whatever block you want timed:
+//
+//     TraceSpan span("ddc", "setVcpFeature");
+//
+// category groups spans in the summary, and must be a string 
+// that stays around, like a literal.
+//
+class EXIMPORT TraceSpan
+{
+    public:
+        TraceSpan(const char *category, const char *name);
+        TraceSpan(const char *category, const std::string &name);
+        ~TraceSpan();
+
+    private:
+        void begin(const char *category, const char *name);
+
+        bool         mActive;
+        const char  *mCategory;
+        std::string  mName;
+        double       mStart;
+        double       mCpuStart;
+
+        // Spans can't be copied.
+        TraceSpan(const TraceSpan &src);
+        TraceSpan & operator=(const TraceSpan &src);
+};
+
+}; // namespace Ookala
+
+#endif
@@ -47,6 +47,7 @@
 
 #include <Chrfuncs.h>
 #include "Chroma5.h"
+#include "Trace.h"
 
 
 // ----------------------------------
@@ -68,6 +69,7 @@ Ookala::Chroma5::Chroma5():
   Sensor()
 {
     setName("Chroma5");
+    declareNoDependencies();
 
     mDeviceOpen        = false;
     mNextSensorKey     = 1;
@@ -160,6 +162,8 @@ Ookala::Chroma5::measureYxy(Yxy       &value,
     DictOptions opts;
     dYxy        G5reading;
 
+    TraceSpan span("sensor", "Chroma5::measureYxy");
+
     setErrorString("");
 
     if (!getDictOptions(opts, chain)) {
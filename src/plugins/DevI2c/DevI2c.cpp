@@ -38,6 +38,7 @@
 
 #include "Dict.h"
 #include "DevI2c.h"
+#include "Trace.h"
 
 //static uint32_t eventId = 0;
 
@@ -54,6 +55,7 @@ Ookala::DevI2c::DevI2c():
     Ddc()
 {
     setName("DevI2c");
+    declareNoDependencies();
 }
 
 // -----------------------------------
@@ -384,6 +386,8 @@ Ookala::DevI2c::sendI2cMsg(uint8_t *buf, uint32_t bufLen,
     uint32_t realId;
     uint32_t sleepUsec =  40000;
 
+    TraceSpan span("i2c", "sendI2cMsg");
+
     if (!validDevId(devId, realId)) {
         setErrorString("Invalid device ID.");
         return false;
@@ -428,6 +432,8 @@ Ookala::DevI2c::recvI2cMsg(uint8_t *buf, uint32_t bufLen,
     int      addr      = 0x37;
     uint32_t sleepUsec =  40000;
 
+    TraceSpan span("i2c", "recvI2cMsg");
+
     if (!validDevId(devId, realId)) {
         setErrorString("Invalid device ID/");
         return false;
@@ -45,6 +45,7 @@
 #include "plugins/WsLut/WsLut.h"
 
 #include "DreamColorCalib.h"
+#include "Trace.h"
 
 namespace Ookala {
 
@@ -67,6 +68,8 @@ Ookala::DreamColorCalib::DreamColorCalib():
     Plugin()
 {
     setName("DreamColorCalib");
+    addDependency("DreamColorCtrl");
+    addDependency("WsLut");
 
     mNumGraySamples = 16;
 }
@@ -2173,13 +2176,13 @@ Ookala::DreamColorCalib::computeLuts(
         postLut[2].push_back( static_cast<uint32_t>(rgb[2] + 0.5) );
     }
 
-    calib.setPreLutRed(preLut[0]);
-    calib.setPreLutGreen(preLut[1]);
-    calib.setPreLutBlue(preLut[2]);
+    calib.setPreLutRed(std::move(preLut[0]));
+    calib.setPreLutGreen(std::move(preLut[1]));
+    calib.setPreLutBlue(std::move(preLut[2]));
 
-    calib.setPostLutRed(postLut[0]);
-    calib.setPostLutGreen(postLut[1]);
-    calib.setPostLutBlue(postLut[2]);
+    calib.setPostLutRed(std::move(postLut[0]));
+    calib.setPostLutGreen(std::move(postLut[1]));
+    calib.setPostLutBlue(std::move(postLut[2]));
 
     return true;
 }
@@ -2428,9 +2431,9 @@ Ookala::DreamColorCalib::validate(
             calibRec->setMeasuredGreen(actualGreen);
             calibRec->setMeasuredBlue(actualBlue);
                    
-            calibRec->setLut("red",   redLut);
-            calibRec->setLut("green", greenLut);
-            calibRec->setLut("blue",  blueLut);
+            calibRec->setLut("red",   std::move(redLut));
+            calibRec->setLut("green", std::move(greenLut));
+            calibRec->setLut("blue",  std::move(blueLut));
 
             if (pi.disp) {
                 uint32_t regValues[4];
@@ -2501,6 +2504,8 @@ Ookala::DreamColorCalib::idle(double seconds, PluginChain *chain)
 {
     uint32_t sleepUs = static_cast<uint32_t>( (seconds - floor(seconds)) * 1000000.0);
 
+    TraceSpan span("idle", "DreamColorCalib::idle");
+
 #ifdef _WIN32
     Sleep(sleepUs / 1000.0);
 #else
@@ -109,6 +109,15 @@ Ookala::DreamColorCalibRecord::operator=(
     return *this;
 }
 
+// ----------------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::DreamColorCalibRecord::clone() const
+{
+    return new DreamColorCalibRecord(*this);
+}
+
 // ------------------------------------------
 //
 // virtual
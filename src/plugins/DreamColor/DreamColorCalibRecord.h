@@ -55,6 +55,8 @@ class EXIMPORT DreamColorCalibRecord: public CalibRecordDictItem
         DreamColorCalibRecord & operator=(
                               const DreamColorCalibRecord &src);
 
+        virtual DictItem *clone() const;
+
         virtual bool serialize(xmlDocPtr doc, xmlNodePtr root);
         virtual bool unserialize(xmlDocPtr doc, xmlNodePtr root);
 
@@ -104,6 +104,15 @@ Ookala::DreamColorCalibrationData::operator=(
     return *this;
 }
 
+// ----------------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::DreamColorCalibrationData::clone() const
+{
+    return new DreamColorCalibrationData(*this);
+}
+
 
 
 // --------------------------------------
@@ -136,15 +145,16 @@ Ookala::DreamColorCalibrationData::setColorSpaceInfo(
 // --------------------------------------
 //
 // virtual 
-std::vector<uint32_t>     
+const std::vector<uint32_t> &
 Ookala::DreamColorCalibrationData::getPreLutRed() const
 {
+    static const std::vector<uint32_t> nothing;
+
     if (mCalibrationData) {
         return mCalibrationData->preLutR;
     }
 
-    std::vector<uint32_t> lut;
-    return lut;
+    return nothing;
 }
 
 // --------------------------------------
@@ -162,16 +172,28 @@ Ookala::DreamColorCalibrationData::setPreLutRed(
 // --------------------------------------
 //
 // virtual 
-std::vector<uint32_t>     
+void                      
+Ookala::DreamColorCalibrationData::setPreLutRed(std::vector<uint32_t> &&lut)
+{
+    if (mCalibrationData) {
+        mCalibrationData->preLutR.swap(lut);
+        lut.clear();
+    }
+}
+
+// --------------------------------------
+//
+// virtual 
+const std::vector<uint32_t> &
 Ookala::DreamColorCalibrationData::getPreLutGreen() const
 {
+    static const std::vector<uint32_t> nothing;
+
     if (mCalibrationData) {
         return mCalibrationData->preLutG;
     }
 
-    std::vector<uint32_t> lut;
-    return lut;
-
+    return nothing;
 }
 
 // --------------------------------------
@@ -186,19 +208,32 @@ Ookala::DreamColorCalibrationData::setPreLutGreen(
     }
 }
 
+// --------------------------------------
+//
+// virtual 
+void                      
+Ookala::DreamColorCalibrationData::setPreLutGreen(std::vector<uint32_t> &&lut)
+{
+    if (mCalibrationData) {
+        mCalibrationData->preLutG.swap(lut);
+        lut.clear();
+    }
+}
+
 
 // --------------------------------------
 //
 // virtual 
-std::vector<uint32_t>     
+const std::vector<uint32_t> &
 Ookala::DreamColorCalibrationData::getPreLutBlue() const
 {
+    static const std::vector<uint32_t> nothing;
+
     if (mCalibrationData) {
         return mCalibrationData->preLutB;
     }
 
-    std::vector<uint32_t> lut;
-    return lut;
+    return nothing;
 }
 
 
@@ -214,6 +249,18 @@ Ookala::DreamColorCalibrationData::setPreLutBlue(
     }
 }
 
+// --------------------------------------
+//
+// virtual 
+void                      
+Ookala::DreamColorCalibrationData::setPreLutBlue(std::vector<uint32_t> &&lut)
+{
+    if (mCalibrationData) {
+        mCalibrationData->preLutB.swap(lut);
+        lut.clear();
+    }
+}
+
 
 // --------------------------------------
 //
@@ -249,15 +296,16 @@ Ookala::DreamColorCalibrationData::setMatrix(const Mat33 &matrix)
 // --------------------------------------
 //
 // virtual 
-std::vector<uint32_t>     
+const std::vector<uint32_t> &
 Ookala::DreamColorCalibrationData::getPostLutRed() const
 {
+    static const std::vector<uint32_t> nothing;
+
     if (mCalibrationData) {
         return mCalibrationData->postLutR;
     }
 
-    std::vector<uint32_t> lut;
-    return lut;
+    return nothing;
 }
 
 
@@ -273,19 +321,32 @@ Ookala::DreamColorCalibrationData::setPostLutRed(
     }
 }
 
+// --------------------------------------
+//
+// virtual 
+void                      
+Ookala::DreamColorCalibrationData::setPostLutRed(std::vector<uint32_t> &&lut)
+{
+    if (mCalibrationData) {
+        mCalibrationData->postLutR.swap(lut);
+        lut.clear();
+    }
+}
+
 
 // --------------------------------------
 //
 // virtual 
-std::vector<uint32_t>    
+const std::vector<uint32_t> &
 Ookala::DreamColorCalibrationData::getPostLutGreen() const
 {
+    static const std::vector<uint32_t> nothing;
+
     if (mCalibrationData) {
         return mCalibrationData->postLutG;
     }
 
-    std::vector<uint32_t> lut;
-    return lut;
+    return nothing;
 }
 
 
@@ -304,15 +365,28 @@ Ookala::DreamColorCalibrationData::setPostLutGreen(
 // --------------------------------------
 //
 // virtual 
-std::vector<uint32_t>     
+void                      
+Ookala::DreamColorCalibrationData::setPostLutGreen(std::vector<uint32_t> &&lut)
+{
+    if (mCalibrationData) {
+        mCalibrationData->postLutG.swap(lut);
+        lut.clear();
+    }
+}
+
+// --------------------------------------
+//
+// virtual 
+const std::vector<uint32_t> &
 Ookala::DreamColorCalibrationData::getPostLutBlue() const
 {
+    static const std::vector<uint32_t> nothing;
+
     if (mCalibrationData) {
         return mCalibrationData->postLutB;
     }
 
-    std::vector<uint32_t> lut;
-    return lut;
+    return nothing;
 }
 
 
@@ -328,6 +402,18 @@ Ookala::DreamColorCalibrationData::setPostLutBlue(
     }
 }
 
+// --------------------------------------
+//
+// virtual 
+void                      
+Ookala::DreamColorCalibrationData::setPostLutBlue(std::vector<uint32_t> &&lut)
+{
+    if (mCalibrationData) {
+        mCalibrationData->postLutB.swap(lut);
+        lut.clear();
+    }
+}
+
 
 // --------------------------------------
 //
@@ -64,30 +64,38 @@ class EXIMPORT DreamColorCalibrationData: public DictItem
         DreamColorCalibrationData & operator=(
                             const DreamColorCalibrationData &src);
 
+        virtual DictItem *clone() const;
+
 
         virtual DreamColorSpaceInfo   getColorSpaceInfo() const;
         virtual void                  setColorSpaceInfo(const DreamColorSpaceInfo &);
 
-        virtual std::vector<uint32_t> getPreLutRed() const;
+        virtual const std::vector<uint32_t> &getPreLutRed() const;
         virtual void                  setPreLutRed(const std::vector<uint32_t> &);
+        virtual void                  setPreLutRed(std::vector<uint32_t> &&);
 
-        virtual std::vector<uint32_t> getPreLutGreen() const;
+        virtual const std::vector<uint32_t> &getPreLutGreen() const;
         virtual void                  setPreLutGreen(const std::vector<uint32_t> &);
+        virtual void                  setPreLutGreen(std::vector<uint32_t> &&);
 
-        virtual std::vector<uint32_t> getPreLutBlue() const;
+        virtual const std::vector<uint32_t> &getPreLutBlue() const;
         virtual void                  setPreLutBlue(const std::vector<uint32_t> &);
+        virtual void                  setPreLutBlue(std::vector<uint32_t> &&);
 
         virtual Mat33                 getMatrix() const;
         virtual void                  setMatrix(const Mat33 &);
 
-        virtual std::vector<uint32_t> getPostLutRed() const;
+        virtual const std::vector<uint32_t> &getPostLutRed() const;
         virtual void                  setPostLutRed(const std::vector<uint32_t> &);
+        virtual void                  setPostLutRed(std::vector<uint32_t> &&);
 
-        virtual std::vector<uint32_t> getPostLutGreen() const;
+        virtual const std::vector<uint32_t> &getPostLutGreen() const;
         virtual void                  setPostLutGreen(const std::vector<uint32_t> &);
+        virtual void                  setPostLutGreen(std::vector<uint32_t> &&);
 
-        virtual std::vector<uint32_t> getPostLutBlue() const;
+        virtual const std::vector<uint32_t> &getPostLutBlue() const;
         virtual void                  setPostLutBlue(const std::vector<uint32_t> &);
+        virtual void                  setPostLutBlue(std::vector<uint32_t> &&);
 
         virtual uint32_t              getRegP0() const;
         virtual void                  setRegP0(uint32_t);
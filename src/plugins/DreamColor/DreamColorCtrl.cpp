@@ -141,6 +141,7 @@ Ookala::DreamColorCtrl::DreamColorCtrl():
     Plugin()
 {
     setName("DreamColorCtrl");
+    declareNoDependencies();
 
     mDreamColorCtrlData           = new _DreamColorCtrl;
     mDreamColorCtrlData->mNextKey = 1;
@@ -244,12 +245,13 @@ Ookala::DreamColorCtrl::enumerate(PluginChain *chain /* = NULL */)
     }    
 
     // Grab all DDC communications channels
-    std::vector<Plugin *> ddcPlugins = mRegistry->queryByAttribute("ddc/ci");
+    const std::vector<Plugin *> &ddcPlugins = 
+                                mRegistry->queryByAttribute("ddc/ci");
 
     // Search them all for all their EDIDs.
     // If we find an EDID we recognize, add the
     // edid to a temp connection list (foundConnections)
-    for (std::vector<Plugin *>::iterator pi = ddcPlugins.begin();
+    for (std::vector<Plugin *>::const_iterator pi = ddcPlugins.begin();
                 pi != ddcPlugins.end(); ++pi) {
 
         Ddc *ddcpi = dynamic_cast<Ddc *>(*pi);
@@ -1945,15 +1947,15 @@ Ookala::DreamColorCtrl::getCalibration(
 
     data.setColorSpaceInfo(info);
 
-    data.setPreLutRed(preLut[0]);
-    data.setPreLutGreen(preLut[1]);
-    data.setPreLutBlue(preLut[2]);
+    data.setPreLutRed(std::move(preLut[0]));
+    data.setPreLutGreen(std::move(preLut[1]));
+    data.setPreLutBlue(std::move(preLut[2]));
 
     data.setMatrix(matrix);
 
-    data.setPostLutRed(postLut[0]);
-    data.setPostLutGreen(postLut[1]);
-    data.setPostLutBlue(postLut[2]);
+    data.setPostLutRed(std::move(postLut[0]));
+    data.setPostLutGreen(std::move(postLut[1]));
+    data.setPostLutBlue(std::move(postLut[2]));
 
     data.setRegP0(reg[0]);
     data.setRegP1(reg[1]);
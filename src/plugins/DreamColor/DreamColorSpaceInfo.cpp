@@ -179,6 +179,15 @@ Ookala::DreamColorSpaceInfo::operator=(const DreamColorSpaceInfo &src)
     return *this;
 }
 
+// ----------------------------------
+//
+// virtual
+Ookala::DictItem *
+Ookala::DreamColorSpaceInfo::clone() const
+{
+    return new DreamColorSpaceInfo(*this);
+}
+
 
 // -------------------------------------
 //
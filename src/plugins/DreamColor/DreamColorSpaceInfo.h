@@ -56,6 +56,8 @@ class EXIMPORT DreamColorSpaceInfo: public DictItem
         virtual ~DreamColorSpaceInfo();
         DreamColorSpaceInfo & operator=(const DreamColorSpaceInfo &src);
 
+        virtual DictItem *clone() const;
+
 
         // The name of the calibration record to write into when
         // we're done calibrating
@@ -42,6 +42,7 @@
 
 //ExampleSensor - headers ----------------------------------------------------
 #include "ExampleSensor.h"
+#include "Trace.h"
 
 // ----------------------------------
 
@@ -62,6 +63,7 @@ Ookala::ExampleSensor::ExampleSensor():
   Sensor()
 {
     setName("ExampleSensor");
+    declareNoDependencies();
 
     mDeviceOpen        = false;
     mNextSensorKey     = 1;
@@ -139,6 +141,8 @@ Ookala::ExampleSensor::measureYxy(Yxy       &value,
 {
     DictOptions opts;
 
+    TraceSpan span("sensor", "ExampleSensor::measureYxy");
+
     setErrorString("");
 
     if (!getDictOptions(opts, chain)) {
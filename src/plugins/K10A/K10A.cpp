@@ -42,6 +42,7 @@
 
 //K10A - headers ----------------------------------------------------
 #include "K10A.h"
+#include "Trace.h"
 #include "../../kclmtr/KClmtr.h"
 
 // ----------------------------------
@@ -121,6 +122,7 @@ Ookala::K10A::K10A():
   Sensor()
 {
 	setName("K10A");
+	declareNoDependencies();
 
 	mDeviceOpen		= false;
 	mNextSensorKey	 = 1;
@@ -198,6 +200,8 @@ Ookala::K10A::measureYxy(Yxy	   &value,
 {
 	DictOptions opts;
 
+	TraceSpan span("sensor", "K10A::measureYxy");
+
 	setErrorString("");
 
 	if (!getDictOptions(opts, chain)) {
@@ -72,6 +72,7 @@ Ookala::WsLut::WsLut():
     mLutMax(0)
 {
     setName("WsLut");
+    declareNoDependencies();
 }
 
 // --------------------------------------
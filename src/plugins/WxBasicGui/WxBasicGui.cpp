@@ -607,6 +607,7 @@ Ookala::WxBasicGui::WxBasicGui():
     Ui()
 {
     setName("WxBasicGui");
+    declareNoDependencies();
 
     mDialog    = NULL;
     mGamutPlot = NULL;
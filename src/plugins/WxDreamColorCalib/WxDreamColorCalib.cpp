@@ -268,6 +268,7 @@ Ookala::WxDreamColorCalib::WxDreamColorCalib():
     Plugin()
 {
     setName("WxDreamColorCalib");
+    addDependency("DreamColorCalib");
 }
 
 // ----------------------------------
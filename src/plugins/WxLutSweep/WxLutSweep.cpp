@@ -157,6 +157,7 @@ Ookala::WxLutSweep::WxLutSweep():
   Plugin()
 {
     setName("WxLutSweep");
+    addDependency("WsLut");
 }
 
 // ----------------------------------
@@ -70,6 +70,7 @@ Ookala::WxSensorPrep::WxSensorPrep():
   Plugin()
 {
     setName("WxSensorPrep");
+    declareNoDependencies();
 }
 
 // ----------------------------------
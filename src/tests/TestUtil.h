@@ -0,0 +1,73 @@
+// --------------------------------------------------------------------------
+// $Id: TestUtil.h 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+// 
+// Permission is hereby granted, free of charge, to any person obtaining 
+// a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation 
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the 
+// Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included 
+// in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR 
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR 
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+#ifndef TESTUTIL_H_HAS_BEEN_INCLUDED
+#define TESTUTIL_H_HAS_BEEN_INCLUDED
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+//
+// Bits shared by the stress tests and benchmarks: a check that
+// fails the program (so "make check" notices), and some clocks.
+//
+
+#define TEST_CHECK(cond)                                               \
+    do {                                                               \
+        if (!(cond)) {                                                 \
+            fprintf(stderr, "FAILED: %s:%d: %s\n",                     \
+                            __FILE__, __LINE__, #cond);                \
+            exit(1);                                                   \
+        }                                                              \
+    } while (0)
+
+// Milliseconds on a monotonic clock.
+inline double
+testMsec()
+{
+    return std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Peak resident set size so far, in KB, or 0 if we can't tell.
+inline long
+testPeakRssKb()
+{
+#ifdef __linux__
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return usage.ru_maxrss;
+    }
+#endif
+    return 0;
+}
+
+#endif
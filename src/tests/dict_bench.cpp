@@ -0,0 +1,176 @@
+// --------------------------------------------------------------------------
+// $Id: dict_bench.cpp 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+// 
+// Permission is hereby granted, free of charge, to any person obtaining 
+// a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation 
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the 
+// Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included 
+// in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR 
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR 
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+// dict_bench - times a hot-path Dict lookup the ways plugins do it.
+//
+// Compares a std::map<std::string, DictItem *> plus dynamic_cast<>,
+// which is what Dict::get() used to be, against the string API and
+// the typed get<T>() with and without a cached DictKey.
+//
+// Usage: dict_bench [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Dict.h"
+
+#include "TestUtil.h"
+
+namespace {
+
+// Keys like the ones a chain dict carries; the benchmark looks up
+// the first one.
+const char *_keyNames[] = {
+    "DataSavior::fileNames",
+    "DataSavior::dictNames",
+    "DataSavior::loadDictNames",
+    "DataSavior::deviceId",
+    "DataSavior::async",
+    "CalibChecker::calibHours",
+    "CalibChecker::calibRecordDict",
+    "CalibChecker::calibRecordName",
+    "CalibChecker::calibMetaRecordName",
+    "DreamColorCalib::calibRecordDict",
+    "DreamColorCalib::graySamples",
+    "DreamColorCalib::targets",
+    "DreamColorCalib::redTolerance",
+    "DreamColorCalib::redTolerancePlus",
+    "DreamColorCalib::redToleranceMinus",
+    "DreamColorCalib::greenTolerance",
+    "DreamColorCalib::greenTolerancePlus",
+    "DreamColorCalib::greenToleranceMinus",
+    "DreamColorCalib::blueTolerance",
+    "DreamColorCalib::blueTolerancePlus",
+    "DreamColorCalib::blueToleranceMinus",
+    "DreamColorCalib::whiteTolerance",
+    "DreamColorCalib::whiteTolerancePlus",
+    "DreamColorCalib::whiteToleranceMinus",
+    "ExampleSensor::calibrationIdx",
+    "ExampleSensor::displayType",
+    "ExampleSensor::integrationTime",
+    "WsLut::pow",
+    "WxIconCtrl::load",
+    "WxIconCtrl::set",
+    NULL
+};
+
+void
+_report(const char *what, double msec, int iterations, size_t found)
+{
+    printf("%-40s %8.1f ns/lookup  (%zu found)\n", what, 
+                       msec * 1e6 / (double)iterations, found);
+}
+
+}; // anonymous namespace
+
+
+int 
+main(int argc, char **argv)
+{
+    Ookala::Dict                               dict;
+    std::map<std::string, const Ookala::DictItem *> oldDict;
+    const Ookala::StringArrayDictItem         *item;
+    std::vector<std::string>                   fileNames;
+    std::string                                keyName;
+    Ookala::DictKey                            key;
+    double                                     start;
+    size_t                                     found;
+    int                                        iterations = 2000000;
+
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+        if (iterations < 1) iterations = 1;
+    }
+
+    fileNames.push_back("/tmp/ucal.xml");
+
+    for (int idx=0; _keyNames[idx]; ++idx) {
+        item = dict.set<Ookala::StringArrayDictItem>(
+                                    std::string(_keyNames[idx]), fileNames);
+        TEST_CHECK(item != NULL);
+
+        oldDict[_keyNames[idx]] = item;
+    }
+
+    keyName = _keyNames[0];
+    key     = Ookala::DictKey(keyName);
+
+    printf("%d lookups of \"%s\" among %zu keys\n", 
+                       iterations, keyName.c_str(), oldDict.size());
+
+    // What Dict::get() + dynamic_cast<> used to cost
+    found = 0;
+    start = testMsec();
+    for (int i=0; i<iterations; ++i) {
+        std::map<std::string, const Ookala::DictItem *>::iterator theItem =
+                                                    oldDict.find(keyName);
+
+        if ((theItem != oldDict.end()) &&
+                (dynamic_cast<const Ookala::StringArrayDictItem *>(
+                                                  (*theItem).second))) {
+            found++;
+        }
+    }
+    _report("std::map + dynamic_cast (old get)", 
+                                   testMsec() - start, iterations, found);
+
+    found = 0;
+    start = testMsec();
+    for (int i=0; i<iterations; ++i) {
+        if (dynamic_cast<Ookala::StringArrayDictItem *>(dict.get(keyName))) {
+            found++;
+        }
+    }
+    _report("get(string) + dynamic_cast", 
+                                   testMsec() - start, iterations, found);
+
+    found = 0;
+    start = testMsec();
+    for (int i=0; i<iterations; ++i) {
+        if (dict.get<Ookala::StringArrayDictItem>(keyName)) {
+            found++;
+        }
+    }
+    _report("get<T>(string)", testMsec() - start, iterations, found);
+
+    found = 0;
+    start = testMsec();
+    for (int i=0; i<iterations; ++i) {
+        if (dict.get<Ookala::StringArrayDictItem>(key)) {
+            found++;
+        }
+    }
+    _report("get<T>(DictKey)", testMsec() - start, iterations, found);
+
+    // The typed lookup has to refuse the wrong type, too
+    TEST_CHECK(dict.get<Ookala::IntDictItem>(key) == NULL);
+    TEST_CHECK(dict.get<Ookala::StringArrayDictItem>(key)->get() == 
+                                                               fileNames);
+
+    return 0;
+}
@@ -0,0 +1,348 @@
+// --------------------------------------------------------------------------
+// $Id: dict_stress.cpp 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+// 
+// Permission is hereby granted, free of charge, to any person obtaining 
+// a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation 
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the 
+// Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included 
+// in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR 
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR 
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+// dict_stress - many threads reading and writing chain dicts at once.
+//
+// One writer per chain dict keeps bumping a counter and rewriting a 
+// lut with set<T>(). Readers look at every dict with getValue<T>(), 
+// getVersion() and snapshots, and scribble on their snapshots to
+// make sure copy-on-write keeps that away from the live dicts. 
+// Another thread keeps adding and removing dicts in the DictHash,
+// under new key names so the key table keeps growing as readers 
+// look names up, while one more keeps using those dicts through 
+// getDict().
+//
+// Fails if a counter or version goes backwards, a lut is ever seen 
+// half written, or a snapshot's changes show up in a live dict.
+//
+// Usage: dict_stress [iterations per thread]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Dict.h"
+#include "DictHash.h"
+
+#include "TestUtil.h"
+
+#define _DICT_STRESS_CHAINS   4
+#define _DICT_STRESS_READERS  8
+#define _DICT_STRESS_LUT_SIZE 64
+
+namespace {
+
+struct _StressState
+{
+    Ookala::DictHash      *mHash;
+    int                    mIterations;
+
+    Ookala::DictKey        mCountKey;
+    Ookala::DictKey        mLutKey;
+    Ookala::DictKey        mTmpKey;
+
+    std::atomic<long>      mReads;
+    std::atomic<long>      mFailures;
+
+    std::atomic<bool>      mChurnDone;
+};
+
+struct _StressThread
+{
+    _StressState *mState;
+    int           mIndex;
+};
+
+std::string
+_chainName(int chain)
+{
+    char name[32];
+
+    snprintf(name, sizeof(name), "chain%d", chain);
+    return std::string(name);
+}
+
+void
+_fail(_StressState *state, const char *what, int chain)
+{
+    // Report the first few, and count them all
+    if (state->mFailures++ < 10) {
+        fprintf(stderr, "FAILED: %s in %s\n", what, 
+                                  _chainName(chain).c_str());
+    }
+}
+
+// A lut that's all one value, unless we caught it half written
+bool
+_lutConsistent(const std::vector<int32_t> &lut)
+{
+    for (size_t idx=1; idx<lut.size(); ++idx) {
+        if (lut[idx] != lut[0]) return false;
+    }
+    return true;
+}
+
+void
+_writerMain(_StressThread *thread)
+{
+    _StressState  *state = thread->mState;
+    Ookala::Dict  *dict;
+
+    dict = state->mHash->newDict(_chainName(thread->mIndex));
+
+    for (int i=1; i<=state->mIterations; ++i) {
+        dict->set<Ookala::IntDictItem>(state->mCountKey, i);
+        dict->set<Ookala::IntArrayDictItem>(state->mLutKey, 
+                       std::vector<int32_t>(_DICT_STRESS_LUT_SIZE, i));
+
+        if (i % 1000 == 0) {
+            dict->remove(state->mTmpKey);
+            dict->set<Ookala::DoubleDictItem>(state->mTmpKey, 1.0);
+        }
+    }
+}
+
+void
+_readerMain(_StressThread *thread)
+{
+    _StressState                    *state = thread->mState;
+    Ookala::Dict                    *dict;
+    const Ookala::IntArrayDictItem  *snapLut;
+    Ookala::IntArrayDictItem        *ownLut;
+    std::vector<int32_t>             lut;
+    uint64_t                         lastVersion[_DICT_STRESS_CHAINS];
+    int32_t                          lastCount[_DICT_STRESS_CHAINS];
+    uint64_t                         version;
+    int32_t                          count;
+    int                              chain;
+
+    for (chain=0; chain<_DICT_STRESS_CHAINS; ++chain) {
+        lastVersion[chain] = 0;
+        lastCount[chain]   = 0;
+    }
+
+    for (int i=0; i<state->mIterations; ++i) {
+        chain = (i + thread->mIndex) % _DICT_STRESS_CHAINS;
+        dict  = state->mHash->getDict(_chainName(chain));
+
+        version = dict->getVersion();
+        if (version < lastVersion[chain]) {
+            _fail(state, "version went backwards", chain);
+        }
+        lastVersion[chain] = version;
+
+        // Every other time, look the count up by name
+        count = -1;
+        if (i & 1) {
+            dict->getValue<Ookala::IntDictItem>(
+                                std::string("DictStress::count"), count);
+        } else {
+            dict->getValue<Ookala::IntDictItem>(state->mCountKey, count);
+        }
+
+        if (count >= 0) {
+            if (count < lastCount[chain]) {
+                _fail(state, "count went backwards", chain);
+            }
+            lastCount[chain] = count;
+
+            // Once it's there, the lock-free get() has to find it
+            if (!((const Ookala::Dict *)dict)->get<Ookala::IntDictItem>(
+                                                     state->mCountKey)) {
+                _fail(state, "get() lost count", chain);
+            }
+        }
+
+        if (dict->getValue<Ookala::IntArrayDictItem>(state->mLutKey, lut)) {
+            if (!_lutConsistent(lut)) {
+                _fail(state, "torn lut", chain);
+            }
+
+            if (!((const Ookala::Dict *)dict)->get<Ookala::IntArrayDictItem>(
+                                          std::string("DictStress::lut"))) {
+                _fail(state, "get() lost lut", chain);
+            }
+
+            // Writers only store positive values; negative ones
+            // can only have leaked out of someone's snapshot.
+            if ((!lut.empty()) && (lut[0] < 0)) {
+                _fail(state, "snapshot change seen in live dict", chain);
+            }
+        }
+
+        if (i % 500 == 0) {
+            Ookala::Dict snapshot;
+
+            TEST_CHECK(state->mHash->getDictSnapshot(_chainName(chain), 
+                                                     snapshot));
+
+            snapLut = 
+              ((const Ookala::Dict &)snapshot).get<Ookala::IntArrayDictItem>(
+                                                        state->mLutKey);
+            if ((snapLut) && (!_lutConsistent(snapLut->get()))) {
+                _fail(state, "torn lut in snapshot", chain);
+            }
+
+            // The non-const get() has to hand us our own copy
+            ownLut = snapshot.get<Ookala::IntArrayDictItem>(state->mLutKey);
+            if (ownLut) {
+                ownLut->set(std::vector<int32_t>(_DICT_STRESS_LUT_SIZE, -1));
+            }
+            snapshot.set<Ookala::IntDictItem>(state->mCountKey, -1);
+
+            snapshot.getKeys();
+        }
+
+        state->mReads++;
+    }
+}
+
+// Dicts coming and going in the hash while the chains run
+void
+_churnMain(_StressThread *thread)
+{
+    _StressState *state = thread->mState;
+    std::string   name;
+    char          keyName[64];
+
+    for (int i=0; i<state->mIterations; ++i) {
+        name = "tmp" + _chainName(i % 7);
+        snprintf(keyName, sizeof(keyName), "DictStress::churn%d", i);
+
+        state->mHash->newDict(name)->set<Ookala::IntDictItem>(
+                                                  state->mCountKey, i);
+        state->mHash->getDict(name)->set<Ookala::IntDictItem>(
+                                              std::string(keyName), i);
+        state->mHash->getDictNames();
+        state->mHash->clearDict(name);
+    }
+
+    state->mChurnDone = true;
+}
+
+// Use the churned dicts through getDict() for as long as they're
+// being cleared. The Dict * has to stay good, even if it's emptied.
+void
+_getterMain(_StressThread *thread)
+{
+    _StressState *state = thread->mState;
+    Ookala::Dict *dict;
+    int32_t       count;
+
+    for (int i=0; !state->mChurnDone; ++i) {
+        dict = state->mHash->getDict("tmp" + _chainName(i % 7));
+        if (!dict) continue;
+
+        if (dict->getName() != "tmp" + _chainName(i % 7)) {
+            _fail(state, "wrong name from getDict()", i % 7);
+        }
+
+        dict->getVersion();
+        dict->get(state->mCountKey);
+        if (dict->getValue<Ookala::IntDictItem>(state->mCountKey, count)) {
+            if (count < 0) {
+                _fail(state, "bad count in churned dict", i % 7);
+            }
+        }
+
+        if (i % 100 == 0) {
+            dict->set<Ookala::IntDictItem>(state->mTmpKey, i);
+        }
+
+        state->mReads++;
+    }
+}
+
+}; // anonymous namespace
+
+
+int 
+main(int argc, char **argv)
+{
+    Ookala::DictHash            hash;
+    _StressState                state;
+    std::vector<_StressThread>  threads;
+    std::vector<std::thread>    workers;
+    int32_t                     count;
+    double                      start;
+
+    state.mHash       = &hash;
+    state.mIterations = 20000;
+    state.mCountKey   = Ookala::DictKey("DictStress::count");
+    state.mLutKey     = Ookala::DictKey("DictStress::lut");
+    state.mTmpKey     = Ookala::DictKey("DictStress::tmp");
+    state.mReads      = 0;
+    state.mFailures   = 0;
+    state.mChurnDone  = false;
+
+    if (argc > 1) {
+        state.mIterations = atoi(argv[1]);
+        if (state.mIterations < 1) state.mIterations = 1;
+    }
+
+    // Make the chain dicts up front, so readers always find them.
+    for (int chain=0; chain<_DICT_STRESS_CHAINS; ++chain) {
+        hash.newDict(_chainName(chain));
+    }
+
+    // Fill in all the thread args before starting anyone, so 
+    // the vector doesn't move under them.
+    threads.resize(_DICT_STRESS_CHAINS + _DICT_STRESS_READERS + 2);
+    for (size_t idx=0; idx<threads.size(); ++idx) {
+        threads[idx].mState = &state;
+        threads[idx].mIndex = (int)idx;
+    }
+
+    start = testMsec();
+
+    for (int idx=0; idx<_DICT_STRESS_CHAINS; ++idx) {
+        workers.push_back(std::thread(_writerMain, &threads[idx]));
+    }
+    for (int idx=0; idx<_DICT_STRESS_READERS; ++idx) {
+        workers.push_back(std::thread(_readerMain, 
+                                 &threads[_DICT_STRESS_CHAINS + idx]));
+    }
+    workers.push_back(std::thread(_churnMain, &threads[threads.size()-2]));
+    workers.push_back(std::thread(_getterMain, &threads.back()));
+
+    for (size_t idx=0; idx<workers.size(); ++idx) {
+        workers[idx].join();
+    }
+
+    // Everyone's done, so the last write to each chain must be there.
+    for (int chain=0; chain<_DICT_STRESS_CHAINS; ++chain) {
+        TEST_CHECK(hash.getDict(_chainName(chain))->getValue<
+                        Ookala::IntDictItem>(state.mCountKey, count));
+        TEST_CHECK(count == state.mIterations);
+    }
+
+    printf("%ld reads, %ld failures, %.0f ms\n", 
+              (long)state.mReads, (long)state.mFailures, testMsec() - start);
+
+    return (state.mFailures == 0)? 0: 1;
+}
@@ -0,0 +1,692 @@
+// --------------------------------------------------------------------------
+// $Id: journal_test.cpp 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+// journal_test - the journal file format, and the partial loads and
+// calibRecord catalog that DataSavior builds on it.
+//
+// Checks that:
+//   - appends read back, and an append with nothing new writes nothing;
+//   - an item edited in place through get() still gets written;
+//   - a file cut short anywhere reads back as its last whole append,
+//     and the next append cuts off the rest and carries on;
+//   - a damaged frame in the middle only loses that frame, and the
+//     next append compacts the damage away;
+//   - compactions running alongside appends, from another Journal on
+//     the same file, lose nothing and never show a reader a half
+//     written state;
+//   - loading some dicts from an xml file or a journal reads those
+//     and leaves the rest alone;
+//   - a catalog finds the newest record for a device and preset and
+//     the records in a time range, and loads them back whole.
+//
+// Files are made in the current directory, as journal_test.*.
+//
+// Usage: journal_test [appends for the compaction test]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Dict.h"
+#include "DictHash.h"
+#include "DataSavior.h"
+#include "CalibCatalog.h"
+#include "Journal.h"
+#include "PluginRegistry.h"
+
+#include "TestUtil.h"
+
+#define _JOURNAL_TEST_FILE      "journal_test.journal"
+#define _JOURNAL_TEST_XML       "journal_test.xml"
+#define _JOURNAL_TEST_LUT_SIZE  256
+
+namespace {
+
+// A registry with the DictHash and DataSavior in it, the way an
+// app sets one up, so items can be read back.
+struct _TestSavior
+{
+    Ookala::PluginRegistry  mRegistry;
+    Ookala::DictHash       *mHash;
+    Ookala::DataSavior     *mSavior;
+
+    _TestSavior() {
+        TEST_CHECK(mRegistry.loadPlugin(new Ookala::DictHash(),
+                                        NULL, NULL));
+        TEST_CHECK(mRegistry.loadPlugin(new Ookala::DataSavior(),
+                               Ookala::DataSavior::dictitem_create,
+                               Ookala::DataSavior::dictitem_destroy));
+        TEST_CHECK(mRegistry.registerPlugins());
+
+        mHash   = dynamic_cast<Ookala::DictHash *>(
+                                mRegistry.queryByName("DictHash")[0]);
+        mSavior = dynamic_cast<Ookala::DataSavior *>(
+                                mRegistry.queryByName("DataSavior")[0]);
+        TEST_CHECK((mHash) && (mSavior));
+    }
+};
+
+struct _CompactState
+{
+    int                 mAppends;
+    Ookala::DictKey     mCountKey;
+    Ookala::DictKey     mLutKey;
+    std::atomic<bool>   mDone;
+    std::atomic<long>   mFailures;
+};
+
+// -----------------------------------
+
+void
+_removeFiles(const std::string &filename)
+{
+    remove(filename.c_str());
+    remove((filename + ".lock").c_str());
+    remove((filename + ".cache").c_str());
+}
+
+std::string
+_readFile(const std::string &filename)
+{
+    std::string data;
+    char        buf[4096];
+    size_t      got;
+    FILE       *fid;
+
+    fid = fopen(filename.c_str(), "rb");
+    TEST_CHECK(fid != NULL);
+    while ((got = fread(buf, 1, sizeof(buf), fid)) > 0) {
+        data.append(buf, got);
+    }
+    fclose(fid);
+
+    return data;
+}
+
+void
+_writeFile(const std::string &filename, const std::string &data)
+{
+    FILE *fid;
+
+    fid = fopen(filename.c_str(), "wb");
+    TEST_CHECK(fid != NULL);
+    TEST_CHECK(fwrite(data.data(), 1, data.size(), fid) == data.size());
+    TEST_CHECK(fclose(fid) == 0);
+}
+
+bool
+_append(const std::string &filename, Ookala::Dict *dict)
+{
+    Ookala::Journal journal(filename);
+
+    return journal.append(std::vector<Ookala::Dict *>(1, dict));
+}
+
+// Read filename into a fresh DictHash, and return "count" from
+// dict "a", or -1 if it isn't there.
+int32_t
+_loadCount(_TestSavior &savior, const std::string &filename, bool &ok)
+{
+    Ookala::DictHash  hash;
+    Ookala::Journal   journal(filename);
+    Ookala::Dict     *dict;
+    int32_t           count = -1;
+
+    hash.setPluginRegistry(&savior.mRegistry);
+
+    ok = journal.load(&hash);
+
+    dict = hash.getDict("a");
+    if (dict) {
+        dict->getValue<Ookala::IntDictItem>(std::string("count"), count);
+    }
+
+    return count;
+}
+
+Ookala::CalibRecordDictItem *
+_newRecord(const std::string &deviceId, uint32_t preset, uint32_t time)
+{
+    Ookala::CalibRecordDictItem *record = new Ookala::CalibRecordDictItem;
+    std::vector<uint32_t>        lut(_JOURNAL_TEST_LUT_SIZE);
+
+    for (size_t idx=0; idx<lut.size(); ++idx) {
+        lut[idx] = time * 1000 + (uint32_t)idx;
+    }
+
+    record->setDeviceId(deviceId);
+    record->setPreset(preset);
+    record->setCalibrationTime(time);
+    record->setCalibrationPluginName((preset & 1)? "Odd": "Even");
+    record->setLut("red", lut);
+
+    return record;
+}
+
+// The lut _newRecord() gave a record from time
+bool
+_recordLutOk(Ookala::CalibRecordDictItem &record)
+{
+    const std::vector<uint32_t> &lut = record.getLut("red");
+
+    if (lut.size() != _JOURNAL_TEST_LUT_SIZE) {
+        return false;
+    }
+
+    for (size_t idx=0; idx<lut.size(); ++idx) {
+        if (lut[idx] != record.getCalibrationTime() * 1000 + idx) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// -----------------------------------
+//
+// Appends read back, and only write what changed.
+
+void
+_testAppend(_TestSavior &savior)
+{
+    Ookala::Dict             dict;
+    Ookala::IntDictItem     *item;
+    std::string              data;
+    size_t                   size;
+    int32_t                  count;
+    bool                     ok;
+
+    printf("append\n");
+
+    _removeFiles(_JOURNAL_TEST_FILE);
+
+    dict.setName("a");
+    dict.set<Ookala::IntDictItem>(std::string("count"), 1);
+    dict.set<Ookala::StringDictItem>(std::string("name"),
+                                     std::string("first"));
+
+    {
+        Ookala::Journal journal(_JOURNAL_TEST_FILE);
+        std::vector<Ookala::Dict *> dicts(1, &dict);
+
+        TEST_CHECK(journal.append(dicts));
+
+        data = _readFile(_JOURNAL_TEST_FILE);
+        TEST_CHECK(data.compare(0, 8, "OMCFJRNL") == 0);
+        TEST_CHECK(Ookala::Journal::isJournal(_JOURNAL_TEST_FILE));
+        size = data.size();
+
+        // Nothing new, so nothing written
+        TEST_CHECK(journal.append(dicts));
+        TEST_CHECK(_readFile(_JOURNAL_TEST_FILE).size() == size);
+
+        dict.set<Ookala::IntDictItem>(std::string("count"), 2);
+        TEST_CHECK(journal.append(dicts));
+        TEST_CHECK(_readFile(_JOURNAL_TEST_FILE).size() > size);
+        size = _readFile(_JOURNAL_TEST_FILE).size();
+
+        // Changed in place, without a set()
+        item = dict.get<Ookala::IntDictItem>(std::string("count"));
+        TEST_CHECK(item != NULL);
+        item->set(3);
+        TEST_CHECK(journal.append(dicts));
+        TEST_CHECK(_readFile(_JOURNAL_TEST_FILE).size() > size);
+    }
+
+    count = _loadCount(savior, _JOURNAL_TEST_FILE, ok);
+    TEST_CHECK(ok);
+    TEST_CHECK(count == 3);
+
+    // Another Journal on the file sees the same, and a key that's
+    // gone from the dict goes from the file.
+    dict.remove(std::string("name"));
+    TEST_CHECK(_append(_JOURNAL_TEST_FILE, &dict));
+    {
+        Ookala::DictHash hash;
+        Ookala::Journal  journal(_JOURNAL_TEST_FILE);
+        std::string      name;
+
+        hash.setPluginRegistry(&savior.mRegistry);
+        TEST_CHECK(journal.load(&hash));
+        TEST_CHECK(hash.getDict("a") != NULL);
+        TEST_CHECK(!hash.getDict("a")->getValue<Ookala::StringDictItem>(
+                                            std::string("name"), name));
+    }
+}
+
+// -----------------------------------
+//
+// Cut the file everywhere between its start and the end of the
+// second append. Whatever's left reads back as the last append
+// that's all there, and appending again carries on from it.
+
+void
+_testTruncate(_TestSavior &savior)
+{
+    Ookala::Dict  dict;
+    std::string   data, first, recovered;
+    size_t        firstSize, cut;
+    int32_t       count;
+    bool          ok;
+
+    printf("truncate\n");
+
+    _removeFiles(_JOURNAL_TEST_FILE);
+
+    dict.setName("a");
+    dict.set<Ookala::IntDictItem>(std::string("count"), 1);
+    dict.set<Ookala::StringDictItem>(std::string("name"),
+                                     std::string("truncate"));
+    TEST_CHECK(_append(_JOURNAL_TEST_FILE, &dict));
+    firstSize = _readFile(_JOURNAL_TEST_FILE).size();
+
+    dict.set<Ookala::IntDictItem>(std::string("count"), 2);
+    TEST_CHECK(_append(_JOURNAL_TEST_FILE, &dict));
+    data = _readFile(_JOURNAL_TEST_FILE);
+
+    // What appending count = 3 to the first append alone looks like
+    _writeFile(_JOURNAL_TEST_FILE, data.substr(0, firstSize));
+    dict.set<Ookala::IntDictItem>(std::string("count"), 3);
+    TEST_CHECK(_append(_JOURNAL_TEST_FILE, &dict));
+    first = _readFile(_JOURNAL_TEST_FILE);
+
+    for (cut=0; cut<=data.size(); ++cut) {
+        _writeFile(_JOURNAL_TEST_FILE, data.substr(0, cut));
+
+        count = _loadCount(savior, _JOURNAL_TEST_FILE, ok);
+
+        if ((cut > 0) && (cut < 16)) {
+            // Not even a whole header
+            TEST_CHECK(!ok);
+            continue;
+        }
+
+        TEST_CHECK(ok);
+        if (cut < firstSize) {
+            TEST_CHECK(count == -1);
+        } else if (cut < data.size()) {
+            TEST_CHECK(count == 1);
+        } else {
+            TEST_CHECK(count == 2);
+        }
+
+        // A torn second append gets cut off by the next one.
+        if ((cut > firstSize) && (cut < data.size())) {
+            TEST_CHECK(_append(_JOURNAL_TEST_FILE, &dict));
+            recovered = _readFile(_JOURNAL_TEST_FILE);
+            TEST_CHECK(recovered == first);
+        }
+    }
+}
+
+// -----------------------------------
+//
+// Damage a frame in the middle. Only its item is lost, and the
+// next append compacts the damage out of the file.
+
+void
+_testCorrupt(_TestSavior &savior)
+{
+    Ookala::DictHash  hash;
+    Ookala::Dict      dict, *loaded;
+    std::string       data, value;
+    size_t            pos;
+    char              key[32], payload[32];
+
+    printf("corrupt\n");
+
+    _removeFiles(_JOURNAL_TEST_FILE);
+
+    dict.setName("a");
+    for (int idx=0; idx<3; ++idx) {
+        snprintf(key,     sizeof(key),     "key%d",     idx);
+        snprintf(payload, sizeof(payload), "payload-%d", idx);
+
+        dict.set<Ookala::StringDictItem>(std::string(key),
+                                         std::string(payload));
+        TEST_CHECK(_append(_JOURNAL_TEST_FILE, &dict));
+    }
+
+    data = _readFile(_JOURNAL_TEST_FILE);
+    pos  = data.find("payload-1");
+    TEST_CHECK(pos != std::string::npos);
+    data[pos] = 'q';
+    _writeFile(_JOURNAL_TEST_FILE, data);
+
+    hash.setPluginRegistry(&savior.mRegistry);
+    {
+        Ookala::Journal journal(_JOURNAL_TEST_FILE);
+
+        TEST_CHECK(journal.load(&hash));
+
+        loaded = hash.getDict("a");
+        TEST_CHECK(loaded != NULL);
+        TEST_CHECK(loaded->getValue<Ookala::StringDictItem>(
+                                        std::string("key0"), value));
+        TEST_CHECK(value == "payload-0");
+        TEST_CHECK(loaded->getValue<Ookala::StringDictItem>(
+                                        std::string("key2"), value));
+        TEST_CHECK(value == "payload-2");
+        TEST_CHECK(!loaded->getValue<Ookala::StringDictItem>(
+                                        std::string("key1"), value));
+
+        // Save what we got back, which compacts once the Journal
+        // is done with.
+        loaded->set<Ookala::StringDictItem>(std::string("key3"),
+                                            std::string("payload-3"));
+        TEST_CHECK(journal.append(std::vector<Ookala::Dict *>(1, loaded)));
+    }
+
+    data = _readFile(_JOURNAL_TEST_FILE);
+    TEST_CHECK(data.find("qayload-1") == std::string::npos);
+    TEST_CHECK(data.find("payload-0") != std::string::npos);
+    TEST_CHECK(data.find("payload-3") != std::string::npos);
+}
+
+// -----------------------------------
+//
+// One thread appends a count and a lut that goes with it, through
+// one Journal. Another keeps compacting through a second one, the
+// way a second process would, and a third keeps loading through
+// a third.
+
+void
+_compactWriterMain(_CompactState *state)
+{
+    Ookala::Journal             journal(_JOURNAL_TEST_FILE);
+    Ookala::Dict                dict;
+    std::vector<Ookala::Dict *> dicts(1, &dict);
+
+    dict.setName("a");
+
+    for (int idx=1; idx<=state->mAppends; ++idx) {
+        dict.set<Ookala::IntDictItem>(state->mCountKey, idx);
+        dict.set<Ookala::IntArrayDictItem>(state->mLutKey,
+                     std::vector<int32_t>(_JOURNAL_TEST_LUT_SIZE, idx));
+
+        if (!journal.append(dicts)) {
+            fprintf(stderr, "FAILED: append: %s\n",
+                                    journal.getErrorString().c_str());
+            state->mFailures++;
+        }
+    }
+
+    state->mDone = true;
+}
+
+void
+_compactorMain(_CompactState *state)
+{
+    Ookala::Journal journal(_JOURNAL_TEST_FILE);
+
+    while (!state->mDone) {
+        if (!journal.compact()) {
+            fprintf(stderr, "FAILED: compact: %s\n",
+                                    journal.getErrorString().c_str());
+            state->mFailures++;
+        }
+    }
+}
+
+void
+_compactReaderMain(_CompactState *state, _TestSavior *savior)
+{
+    int32_t               last = 0;
+    int32_t               count;
+    std::vector<int32_t>  lut;
+
+    while (!state->mDone) {
+        Ookala::DictHash  hash;
+        Ookala::Journal   journal(_JOURNAL_TEST_FILE);
+        Ookala::Dict     *dict;
+
+        hash.setPluginRegistry(&savior->mRegistry);
+        if (!journal.load(&hash)) {
+            fprintf(stderr, "FAILED: load: %s\n",
+                                    journal.getErrorString().c_str());
+            state->mFailures++;
+            continue;
+        }
+
+        dict = hash.getDict("a");
+        if ((!dict) ||
+                (!dict->getValue<Ookala::IntDictItem>(state->mCountKey,
+                                                      count))) {
+            continue;
+        }
+
+        if ((count < last) ||
+                (!dict->getValue<Ookala::IntArrayDictItem>(
+                                            state->mLutKey, lut)) ||
+                (lut.size() != _JOURNAL_TEST_LUT_SIZE) ||
+                (lut[0] != count) || (lut.back() != count)) {
+            fprintf(stderr, "FAILED: read count %d after %d\n",
+                                                        count, last);
+            state->mFailures++;
+        }
+        last = count;
+    }
+}
+
+void
+_testCompact(_TestSavior &savior, int appends)
+{
+    _CompactState             state;
+    std::vector<std::thread>  workers;
+    int32_t                   count;
+    bool                      ok;
+    double                    start;
+
+    printf("compact\n");
+
+    _removeFiles(_JOURNAL_TEST_FILE);
+
+    state.mAppends  = appends;
+    state.mCountKey = Ookala::DictKey("count");
+    state.mLutKey   = Ookala::DictKey("lut");
+    state.mDone     = false;
+    state.mFailures = 0;
+
+    start = testMsec();
+
+    workers.push_back(std::thread(_compactWriterMain, &state));
+    workers.push_back(std::thread(_compactorMain, &state));
+    workers.push_back(std::thread(_compactReaderMain, &state, &savior));
+
+    for (size_t idx=0; idx<workers.size(); ++idx) {
+        workers[idx].join();
+    }
+
+    TEST_CHECK(state.mFailures == 0);
+
+    count = _loadCount(savior, _JOURNAL_TEST_FILE, ok);
+    TEST_CHECK(ok);
+    TEST_CHECK(count == appends);
+
+    // Only the newest frames are left once it's compacted again.
+    {
+        Ookala::Journal journal(_JOURNAL_TEST_FILE);
+
+        TEST_CHECK(journal.compact());
+    }
+    TEST_CHECK(_readFile(_JOURNAL_TEST_FILE).size() <
+                                    4 * _JOURNAL_TEST_LUT_SIZE * 4);
+
+    printf("  %d appends, %.0f ms\n", appends, testMsec() - start);
+}
+
+// -----------------------------------
+//
+// Save three dicts, then load only one of them over a DictHash
+// that already has another. Twice for xml, since the second load
+// goes through the load cache.
+
+void
+_testPartialLoad(const std::string &filename)
+{
+    std::vector<std::string>  filenames(1, filename);
+    std::vector<std::string>  dictNames(1, "two");
+    std::vector<Ookala::Dict *> dicts;
+    std::string               value;
+    const char               *names[] = { "one", "two", "three", NULL };
+
+    printf("partial load from %s\n", filename.c_str());
+
+    _removeFiles(filename);
+
+    {
+        _TestSavior savior;
+
+        for (int idx=0; names[idx]; ++idx) {
+            Ookala::Dict *dict = savior.mHash->newDict(names[idx]);
+
+            dict->set<Ookala::StringDictItem>(std::string("value"),
+                                    std::string("saved ") + names[idx]);
+            dicts.push_back(dict);
+        }
+        TEST_CHECK(savior.mSavior->save(dicts, filenames));
+    }
+
+    for (int pass=0; pass<2; ++pass) {
+        _TestSavior savior;
+
+        savior.mHash->newDict("one")->set<Ookala::StringDictItem>(
+                            std::string("value"), std::string("local"));
+
+        TEST_CHECK(savior.mSavior->load(filenames, dictNames));
+
+        TEST_CHECK(savior.mHash->getDict("two") != NULL);
+        TEST_CHECK(savior.mHash->getDict("two")->getValue<
+                    Ookala::StringDictItem>(std::string("value"), value));
+        TEST_CHECK(value == "saved two");
+
+        TEST_CHECK(savior.mHash->getDict("one")->getValue<
+                    Ookala::StringDictItem>(std::string("value"), value));
+        TEST_CHECK(value == "local");
+
+        TEST_CHECK(savior.mHash->getDict("three") == NULL);
+    }
+}
+
+// -----------------------------------
+//
+// Save records for two devices and two presets at several times,
+// and look them up through a catalog.
+
+void
+_testCatalog(const std::string &filename)
+{
+    std::vector<std::string>             filenames(1, filename);
+    std::vector<Ookala::Dict *>          dicts;
+    std::vector<Ookala::CalibRecordHandle> handles;
+    Ookala::CalibRecordHandle            handle;
+    Ookala::CalibCatalog                 catalog;
+    Ookala::CalibRecordDictItem          record;
+    const char                          *devices[] = { "A", "B" };
+    char                                 key[32];
+
+    printf("catalog from %s\n", filename.c_str());
+
+    _removeFiles(filename);
+
+    _TestSavior savior;
+    Ookala::Dict *dict = savior.mHash->newDict("calib");
+
+    // Times 100..111; device A gets the even ones.
+    for (uint32_t time=100; time<112; ++time) {
+        snprintf(key, sizeof(key), "record%u", time);
+        dict->adopt(Ookala::DictKey(key),
+                    _newRecord(devices[time & 1], (time / 2) & 1, time));
+    }
+    dicts.push_back(dict);
+    TEST_CHECK(savior.mSavior->save(dicts, filenames));
+
+    TEST_CHECK(savior.mSavior->buildCalibCatalog(filenames, catalog));
+    TEST_CHECK(catalog.size() == 12);
+
+    // A, preset 1 has 102, 106 and 110.
+    TEST_CHECK(catalog.getLatest("A", 1, handle));
+    TEST_CHECK(handle.calibrationTime == 110);
+    TEST_CHECK(!catalog.getLatest("C", 0, handle));
+
+    handles = catalog.getByTime(103, 106);
+    TEST_CHECK(handles.size() == 4);
+    for (size_t idx=0; idx<handles.size(); ++idx) {
+        TEST_CHECK(handles[idx].calibrationTime == 103 + idx);
+    }
+
+    handles = catalog.getByDevice("B", 105, 109);
+    TEST_CHECK(handles.size() == 3);
+
+    handles = catalog.getByPlugin("Odd");
+    TEST_CHECK(handles.size() == 6);
+
+    // Records come back whole, luts and all.
+    handles = catalog.getByTime(0, 0xffffffff);
+    TEST_CHECK(handles.size() == 12);
+    for (size_t idx=0; idx<handles.size(); ++idx) {
+        TEST_CHECK(savior.mSavior->loadCalibRecord(handles[idx], record));
+        TEST_CHECK(record.getCalibrationTime() ==
+                                        handles[idx].calibrationTime);
+        TEST_CHECK(record.getDeviceId() == handles[idx].deviceId);
+        TEST_CHECK(_recordLutOk(record));
+    }
+}
+
+}; // anonymous namespace
+
+
+int
+main(int argc, char **argv)
+{
+    _TestSavior savior;
+    int         appends = 300;
+
+    if (argc > 1) {
+        appends = atoi(argv[1]);
+        if (appends < 1) appends = 1;
+    }
+
+    _testAppend(savior);
+    _testTruncate(savior);
+    _testCorrupt(savior);
+    _testCompact(savior, appends);
+
+    _testPartialLoad(_JOURNAL_TEST_XML);
+    _testPartialLoad(_JOURNAL_TEST_FILE);
+
+    _testCatalog(_JOURNAL_TEST_XML);
+    _testCatalog(_JOURNAL_TEST_FILE);
+
+    _removeFiles(_JOURNAL_TEST_FILE);
+    _removeFiles(_JOURNAL_TEST_XML);
+
+    printf("ok\n");
+
+    return 0;
+}
@@ -0,0 +1,275 @@
+// --------------------------------------------------------------------------
+// $Id: pack_bench.cpp 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+// 
+// Permission is hereby granted, free of charge, to any person obtaining 
+// a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation 
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the 
+// Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included 
+// in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR 
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR 
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+// pack_bench - save/load time and file size for big numeric arrays,
+// written one <value> per element as we used to, and packed.
+//
+// The per-element form is written the way the array DictItems used
+// to do it, through an ostringstream per value, and read back the
+// way they used to, through getXmlDirectChildren(). The packed form 
+// goes through IntArrayDictItem and DoubleArrayDictItem as they are 
+// now. Before timing, checks that packed arrays round-trip exactly
+// and that the per-element form still loads.
+//
+// Usage: pack_bench [scratch file]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <libxml/parser.h>
+
+#include "Dict.h"
+
+#include "TestUtil.h"
+
+// Three 4096 entry luts, and 2000 measured Yxy triples
+#define _PACK_BENCH_LUT_SIZE   4096
+#define _PACK_BENCH_LUTS       3
+#define _PACK_BENCH_MEASURED   (3*2000)
+#define _PACK_BENCH_REPEAT     20
+
+namespace {
+
+// Gets us at getXmlDirectChildren(), for reading the old way.
+class _OldReader: public Ookala::DictItem
+{
+    public:
+        bool read(xmlDocPtr doc, xmlNodePtr root,
+                  std::vector<std::string> &tags,
+                  std::vector<std::string> &contents) {
+            return getXmlDirectChildren(doc, root, tags, contents);
+        }
+};
+
+long
+_fileSize(const std::string &filename)
+{
+    struct stat st;
+
+    if (stat(filename.c_str(), &st)) return 0;
+
+    return (long)st.st_size;
+}
+
+template <class T>
+void
+_writeOld(xmlNodePtr item, const std::vector<T> &values)
+{
+    for (size_t idx=0; idx<values.size(); ++idx) {
+        std::ostringstream valueStr;
+
+        valueStr << values[idx];
+        xmlNewTextChild(item, NULL, (const xmlChar *)"value", 
+                        (const xmlChar *)valueStr.str().c_str());
+    }
+}
+
+size_t
+_readOld(xmlDocPtr doc, xmlNodePtr item, bool isInt)
+{
+    _OldReader               reader;
+    std::vector<std::string> tags, contents;
+    std::vector<int32_t>     ints;
+    std::vector<double>      doubles;
+
+    reader.read(doc, item, tags, contents);
+    for (size_t idx=0; idx<tags.size(); ++idx) {
+        if (tags[idx] != "value") continue;
+
+        if (isInt) {
+            ints.push_back(atoi(contents[idx].c_str()));
+        } else {
+            doubles.push_back(atof(contents[idx].c_str()));
+        }
+    }
+
+    return ints.size() + doubles.size();
+}
+
+xmlNodePtr
+_newItem(xmlNodePtr root)
+{
+    return xmlNewChild(root, NULL, (const xmlChar *)"dictitem", NULL);
+}
+
+// Packed arrays must come back bit for bit, and the per-element 
+// form must still load.
+void
+_checkRoundTrip(const std::vector<int32_t> &lut,
+                const std::vector<double>  &measured)
+{
+    Ookala::IntArrayDictItem    intItem, intCopy, oldItem;
+    Ookala::DoubleArrayDictItem doubleItem, doubleCopy;
+    std::vector<int32_t>        shortInts;
+    xmlDocPtr                   doc;
+    xmlNodePtr                  root, intNode, doubleNode, oldNode;
+
+    doc  = xmlNewDoc((const xmlChar *)"1.0");
+    root = xmlNewNode(NULL, (const xmlChar *)"dict");
+    xmlDocSetRootElement(doc, root);
+
+    intNode    = _newItem(root);
+    doubleNode = _newItem(root);
+    oldNode    = _newItem(root);
+
+    intItem.set(lut);
+    intItem.serialize(doc, intNode);
+    doubleItem.set(measured);
+    doubleItem.serialize(doc, doubleNode);
+
+    for (int idx=0; idx<40; ++idx) {
+        shortInts.push_back(idx*7);
+    }
+    _writeOld(oldNode, shortInts);
+
+    TEST_CHECK(intCopy.unserialize(doc, intNode));
+    TEST_CHECK(intCopy.get() == lut);
+    TEST_CHECK(doubleCopy.unserialize(doc, doubleNode));
+    TEST_CHECK(doubleCopy.get() == measured);
+    TEST_CHECK(oldItem.unserialize(doc, oldNode));
+    TEST_CHECK(oldItem.get() == shortInts);
+
+    xmlFreeDoc(doc);
+}
+
+}; // anonymous namespace
+
+
+int 
+main(int argc, char **argv)
+{
+    std::vector<int32_t> lut(_PACK_BENCH_LUT_SIZE);
+    std::vector<double>  measured(_PACK_BENCH_MEASURED);
+    std::string          filename = "pack_bench.xml";
+    xmlDocPtr            doc;
+    xmlNodePtr           root, item;
+    double               start, saveMsec, loadMsec;
+    size_t               loaded;
+    long                 size;
+    int                  itemIdx;
+    bool                 isInt;
+
+    if (argc > 1) {
+        filename = argv[1];
+    }
+
+    for (size_t idx=0; idx<lut.size(); ++idx) {
+        lut[idx] = (int32_t)(idx * 16);
+    }
+    for (size_t idx=0; idx<measured.size(); ++idx) {
+        measured[idx] = sin(idx * 0.001) * 123.456789 + 1.0/3.0;
+    }
+
+    _checkRoundTrip(lut, measured);
+
+    for (int packed=0; packed<2; ++packed) {
+        saveMsec = loadMsec = 0;
+        size     = 0;
+
+        for (int rep=0; rep<_PACK_BENCH_REPEAT; ++rep) {
+            start = testMsec();
+
+            doc  = xmlNewDoc((const xmlChar *)"1.0");
+            root = xmlNewNode(NULL, (const xmlChar *)"dict");
+            xmlDocSetRootElement(doc, root);
+
+            for (int lutIdx=0; lutIdx<_PACK_BENCH_LUTS; ++lutIdx) {
+                item = _newItem(root);
+                if (packed) {
+                    Ookala::IntArrayDictItem lutItem;
+
+                    lutItem.set(lut);
+                    lutItem.serialize(doc, item);
+                } else {
+                    _writeOld(item, lut);
+                }
+            }
+
+            item = _newItem(root);
+            if (packed) {
+                Ookala::DoubleArrayDictItem measuredItem;
+
+                measuredItem.set(measured);
+                measuredItem.serialize(doc, item);
+            } else {
+                _writeOld(item, measured);
+            }
+
+            TEST_CHECK(xmlSaveFormatFile(filename.c_str(), doc, 1) > 0);
+            xmlFreeDoc(doc);
+
+            saveMsec += testMsec() - start;
+            start     = testMsec();
+
+            doc    = xmlParseFile(filename.c_str());
+            TEST_CHECK(doc != NULL);
+            root   = xmlDocGetRootElement(doc);
+            loaded = 0;
+
+            itemIdx = 0;
+            for (item = root->children; item != NULL; item = item->next) {
+                if (item->type != XML_ELEMENT_NODE) continue;
+
+                // The luts come first, then the measurements
+                isInt = (itemIdx++ < _PACK_BENCH_LUTS);
+
+                if (!packed) {
+                    loaded += _readOld(doc, item, isInt);
+                } else if (isInt) {
+                    Ookala::IntArrayDictItem lutItem;
+
+                    TEST_CHECK(lutItem.unserialize(doc, item));
+                    loaded += lutItem.get().size();
+                } else {
+                    Ookala::DoubleArrayDictItem measuredItem;
+
+                    TEST_CHECK(measuredItem.unserialize(doc, item));
+                    loaded += measuredItem.get().size();
+                }
+            }
+            xmlFreeDoc(doc);
+
+            loadMsec += testMsec() - start;
+            size      = _fileSize(filename);
+
+            TEST_CHECK(loaded == _PACK_BENCH_LUTS * lut.size() + 
+                                                       measured.size());
+        }
+
+        printf("%-10s %8ld bytes, save %6.2f ms, load %6.2f ms\n", 
+               packed? "packed:": "per-value:", size,
+               saveMsec / _PACK_BENCH_REPEAT, loadMsec / _PACK_BENCH_REPEAT);
+    }
+
+    unlink(filename.c_str());
+
+    return 0;
+}
@@ -0,0 +1,234 @@
+// --------------------------------------------------------------------------
+// $Id: registry_bench.cpp 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+// 
+// Permission is hereby granted, free of charge, to any person obtaining 
+// a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation 
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the 
+// Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included 
+// in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR 
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR 
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+// registry_bench - PluginRegistry queries by name and by attribute,
+// against a linear scan of the plugins like the queries used to do.
+//
+// Loads the plugins we ship (as stand-ins, so nothing touches any
+// hardware) plus enough extra sensors and tools to reach a given
+// count. The old way is a scan over every plugin with matchName()
+// or matchAttribute(), building a fresh vector each time.
+//
+// Usage: registry_bench [plugin count]...
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "Plugin.h"
+#include "PluginRegistry.h"
+
+#include "TestUtil.h"
+
+#define _REGISTRY_BENCH_ITERATIONS 1000000
+
+namespace {
+
+// A plugin with a name and some attributes, and nothing else.
+class _BenchPlugin: public Ookala::Plugin
+{
+    public:
+        _BenchPlugin(const std::string &name, const char **attributes) {
+            setName(name);
+            for (int idx=0; attributes[idx]; ++idx) {
+                addAttribute(attributes[idx]);
+            }
+            declareNoDependencies();
+        }
+};
+
+const char *_sensorAttribs[] = { "Sensor", "sensor", NULL };
+const char *_ddcAttribs[]    = { "DDC", "DDC/CI", "DDCCI", 
+                                 "ddc", "ddc/ci", "ddcci", NULL };
+const char *_uiAttribs[]     = { "UI", "Ui", "ui", 
+                                 "GUI", "Gui", "gui", NULL };
+const char *_noAttribs[]     = { NULL };
+
+struct _ShippedPlugin
+{
+    const char  *mName;
+    const char **mAttributes;
+};
+
+// Everything that's not built into libookala
+_ShippedPlugin _shipped[] = {
+    { "Chroma5",           _sensorAttribs },
+    { "ExampleSensor",     _sensorAttribs },
+    { "K10A",              _sensorAttribs },
+    { "i1D2HPDC",          _sensorAttribs },
+    { "DevI2c",            _ddcAttribs    },
+    { "DreamColorCtrl",    _noAttribs     },
+    { "DreamColorCalib",   _noAttribs     },
+    { "WsLut",             _noAttribs     },
+    { "WxBasicGui",        _uiAttribs     },
+    { "WxDreamColorCalib", _uiAttribs     },
+    { "WxLutSweep",        _uiAttribs     },
+    { "WxSensorPrep",      _uiAttribs     },
+    { "WxIconCtrl",        _noAttribs     },
+    { "CalibChecker",      _noAttribs     },
+    { NULL,                NULL           }
+};
+
+std::string
+_numbered(const char *prefix, int idx)
+{
+    char name[64];
+
+    snprintf(name, sizeof(name), "%s%d", prefix, idx);
+    return std::string(name);
+}
+
+// What queryByName() used to do
+std::vector<Ookala::Plugin *>
+_scanByName(const std::vector<Ookala::Plugin *> &plugins, 
+            const std::string &name)
+{
+    std::vector<Ookala::Plugin *> matches;
+
+    for (size_t idx=0; idx<plugins.size(); ++idx) {
+        if (plugins[idx]->matchName(name)) {
+            matches.push_back(plugins[idx]);
+        }
+    }
+    return matches;
+}
+
+// What queryByAttribute() used to do
+std::vector<Ookala::Plugin *>
+_scanByAttribute(const std::vector<Ookala::Plugin *> &plugins, 
+                 const std::string &attrib)
+{
+    std::vector<Ookala::Plugin *> matches;
+
+    for (size_t idx=0; idx<plugins.size(); ++idx) {
+        if (plugins[idx]->matchAttribute(attrib)) {
+            matches.push_back(plugins[idx]);
+        }
+    }
+    return matches;
+}
+
+void
+_report(const char *what, double oldMsec, double newMsec)
+{
+    printf("  %-18s %8.1f ns -> %6.1f ns\n", what,
+           oldMsec * 1e6 / _REGISTRY_BENCH_ITERATIONS,
+           newMsec * 1e6 / _REGISTRY_BENCH_ITERATIONS);
+}
+
+void
+_run(int count)
+{
+    Ookala::PluginRegistry        registry;
+    std::vector<Ookala::Plugin *> plugins;
+    Ookala::Plugin               *plugin;
+    std::string                   name   = "DreamColorCalib";
+    std::string                   attrib = "ddc/ci";
+    double                        start, oldMsec, newMsec;
+    size_t                        found;
+
+    for (int idx=0; _shipped[idx].mName; ++idx) {
+        TEST_CHECK(registry.loadPlugin(
+                       new _BenchPlugin(_shipped[idx].mName, 
+                                        _shipped[idx].mAttributes),
+                       NULL, NULL));
+    }
+
+    // Pad out with more sensors and tools, the way a site with 
+    // its own plugins might look.
+    for (int idx=0; registry.numPlugins()<count; ++idx) {
+        if (idx % 4) {
+            plugin = new _BenchPlugin(_numbered("SiteTool", idx), 
+                                      _noAttribs);
+        } else {
+            plugin = new _BenchPlugin(_numbered("SiteSensor", idx), 
+                                      _sensorAttribs);
+        }
+        TEST_CHECK(registry.loadPlugin(plugin, NULL, NULL));
+    }
+
+    for (int idx=0; idx<registry.numPlugins(); ++idx) {
+        plugins.push_back(registry.queryByIndex(idx)[0]);
+    }
+
+    // Both ways have to agree
+    TEST_CHECK(_scanByName(plugins, name) == registry.queryByName(name));
+    TEST_CHECK(_scanByAttribute(plugins, attrib) == 
+                                       registry.queryByAttribute(attrib));
+    TEST_CHECK(registry.queryByName(name).size() == 1);
+    TEST_CHECK(registry.queryByAttribute(attrib).size() == 1);
+
+    printf("%d plugins, %d queries each:\n", 
+                         registry.numPlugins(), _REGISTRY_BENCH_ITERATIONS);
+
+    found = 0;
+    start = testMsec();
+    for (int i=0; i<_REGISTRY_BENCH_ITERATIONS; ++i) {
+        found += _scanByName(plugins, name).size();
+    }
+    oldMsec = testMsec() - start;
+
+    start = testMsec();
+    for (int i=0; i<_REGISTRY_BENCH_ITERATIONS; ++i) {
+        found += registry.queryByName(name).size();
+    }
+    newMsec = testMsec() - start;
+    _report("queryByName", oldMsec, newMsec);
+
+    start = testMsec();
+    for (int i=0; i<_REGISTRY_BENCH_ITERATIONS; ++i) {
+        found += _scanByAttribute(plugins, attrib).size();
+    }
+    oldMsec = testMsec() - start;
+
+    start = testMsec();
+    for (int i=0; i<_REGISTRY_BENCH_ITERATIONS; ++i) {
+        found += registry.queryByAttribute(attrib).size();
+    }
+    newMsec = testMsec() - start;
+    _report("queryByAttribute", oldMsec, newMsec);
+
+    TEST_CHECK(found == 4 * (size_t)_REGISTRY_BENCH_ITERATIONS);
+}
+
+}; // anonymous namespace
+
+
+int 
+main(int argc, char **argv)
+{
+    if (argc < 2) {
+        _run(34);
+        _run(104);
+        return 0;
+    }
+
+    for (int idx=1; idx<argc; ++idx) {
+        _run(atoi(argv[idx]));
+    }
+
+    return 0;
+}
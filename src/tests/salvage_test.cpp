@@ -0,0 +1,461 @@
+// --------------------------------------------------------------------------
+// $Id: salvage_test.cpp 135 2008-12-19 00:49:58Z omcf $
+// --------------------------------------------------------------------------
+// Copyright (c) 2008 Hewlett-Packard Development Company, L.P.
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------------------------------------
+
+// salvage_test - loading saved files that have been damaged.
+//
+// Saves a dict of calibRecords, each with its own shared lut, and a
+// dict of plain ints, then damages the file and loads it back:
+//
+//   - cut to 2/3 of its size, as a crash part way through a save
+//     would leave it;
+//   - a byte flipped inside a <lut>;
+//   - a run of bytes zeroed in the middle of the records;
+//   - the calibRecord dict's </dict> broken;
+//   - one int's value changed, leaving the xml well formed, so only
+//     the item's crc can tell;
+//   - a run of bytes scrambled in the middle of a journal.
+//
+// Each load has to succeed, bring back every item the damage didn't
+// touch, and never bring back a record with the wrong lut or an int
+// with the wrong value.
+//
+// Files are made in the current directory, as salvage_test.*.
+//
+// Usage: salvage_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "Dict.h"
+#include "DictHash.h"
+#include "DataSavior.h"
+#include "PluginRegistry.h"
+
+#include "TestUtil.h"
+
+#define _SALVAGE_TEST_XML       "salvage_test.xml"
+#define _SALVAGE_TEST_JOURNAL   "salvage_test.journal"
+#define _SALVAGE_TEST_RECORDS   12
+#define _SALVAGE_TEST_INTS      10
+#define _SALVAGE_TEST_LUT_SIZE  256
+
+namespace {
+
+// A registry with the DictHash and DataSavior in it, the way an
+// app sets one up.
+struct _TestSavior
+{
+    Ookala::PluginRegistry  mRegistry;
+    Ookala::DictHash       *mHash;
+    Ookala::DataSavior     *mSavior;
+
+    _TestSavior() {
+        TEST_CHECK(mRegistry.loadPlugin(new Ookala::DictHash(),
+                                        NULL, NULL));
+        TEST_CHECK(mRegistry.loadPlugin(new Ookala::DataSavior(),
+                               Ookala::DataSavior::dictitem_create,
+                               Ookala::DataSavior::dictitem_destroy));
+        TEST_CHECK(mRegistry.registerPlugins());
+
+        mHash   = dynamic_cast<Ookala::DictHash *>(
+                                mRegistry.queryByName("DictHash")[0]);
+        mSavior = dynamic_cast<Ookala::DataSavior *>(
+                                mRegistry.queryByName("DataSavior")[0]);
+        TEST_CHECK((mHash) && (mSavior));
+    }
+};
+
+// What a load brought back
+struct _Loaded
+{
+    int  mRecords;
+    int  mLutless;
+    int  mInts;
+    bool mHave[_SALVAGE_TEST_RECORDS];
+};
+
+// -----------------------------------
+
+void
+_removeFiles(const std::string &filename)
+{
+    remove(filename.c_str());
+    remove((filename + ".lock").c_str());
+    remove((filename + ".cache").c_str());
+}
+
+std::string
+_readFile(const std::string &filename)
+{
+    std::string data;
+    char        buf[4096];
+    size_t      got;
+    FILE       *fid;
+
+    fid = fopen(filename.c_str(), "rb");
+    TEST_CHECK(fid != NULL);
+    while ((got = fread(buf, 1, sizeof(buf), fid)) > 0) {
+        data.append(buf, got);
+    }
+    fclose(fid);
+
+    return data;
+}
+
+void
+_writeFile(const std::string &filename, const std::string &data)
+{
+    FILE *fid;
+
+    fid = fopen(filename.c_str(), "wb");
+    TEST_CHECK(fid != NULL);
+    TEST_CHECK(fwrite(data.data(), 1, data.size(), fid) == data.size());
+    TEST_CHECK(fclose(fid) == 0);
+}
+
+std::string
+_recordKey(int idx)
+{
+    char key[32];
+
+    snprintf(key, sizeof(key), "record%02d", idx);
+    return std::string(key);
+}
+
+std::string
+_intKey(int idx)
+{
+    char key[32];
+
+    snprintf(key, sizeof(key), "int%02d", idx);
+    return std::string(key);
+}
+
+// Save the test dicts to filename, replacing whatever's there.
+void
+_save(const std::string &filename)
+{
+    _TestSavior                 savior;
+    std::vector<Ookala::Dict *> dicts;
+    Ookala::Dict               *calib, *ints;
+
+    _removeFiles(filename);
+
+    calib = savior.mHash->newDict("calib");
+    for (int idx=0; idx<_SALVAGE_TEST_RECORDS; ++idx) {
+        Ookala::CalibRecordDictItem *record =
+                                        new Ookala::CalibRecordDictItem;
+        std::vector<uint32_t>        lut(_SALVAGE_TEST_LUT_SIZE);
+
+        for (size_t entry=0; entry<lut.size(); ++entry) {
+            lut[entry] = (uint32_t)(idx * 1000 + entry);
+        }
+
+        record->setDeviceId("salvage");
+        record->setPreset((uint32_t)idx);
+        record->setCalibrationTime((uint32_t)(1000 + idx));
+        record->setLut("red", lut);
+
+        calib->adopt(Ookala::DictKey(_recordKey(idx)), record);
+    }
+
+    ints = savior.mHash->newDict("ints");
+    for (int idx=0; idx<_SALVAGE_TEST_INTS; ++idx) {
+        ints->set<Ookala::IntDictItem>(_intKey(idx), idx * 11);
+    }
+
+    dicts.push_back(calib);
+    dicts.push_back(ints);
+    TEST_CHECK(savior.mSavior->save(dicts,
+                                    std::vector<std::string>(1, filename)));
+}
+
+// Load filename, and check that whatever came back is right.
+_Loaded
+_load(_TestSavior &savior, const std::string &filename)
+{
+    _Loaded       loaded;
+    Ookala::Dict *dict;
+    int32_t       value;
+
+    loaded.mRecords = 0;
+    loaded.mLutless = 0;
+    loaded.mInts    = 0;
+
+    TEST_CHECK(savior.mSavior->load(std::vector<std::string>(1, filename)));
+
+    dict = savior.mHash->getDict("calib");
+    for (int idx=0; idx<_SALVAGE_TEST_RECORDS; ++idx) {
+        Ookala::CalibRecordDictItem *record;
+
+        loaded.mHave[idx] = false;
+        if (!dict) continue;
+
+        record = dynamic_cast<Ookala::CalibRecordDictItem *>(
+                                        dict->get(_recordKey(idx)));
+        if (!record) continue;
+
+        const std::vector<uint32_t> &lut = record->getLut("red");
+
+        TEST_CHECK(record->getCalibrationTime() == (uint32_t)(1000 + idx));
+
+        // A record whose lut was damaged comes back without it
+        if (lut.empty()) {
+            loaded.mLutless++;
+            continue;
+        }
+
+        TEST_CHECK(lut.size() == _SALVAGE_TEST_LUT_SIZE);
+        for (size_t entry=0; entry<lut.size(); ++entry) {
+            TEST_CHECK(lut[entry] == (uint32_t)(idx * 1000 + entry));
+        }
+
+        loaded.mHave[idx] = true;
+        loaded.mRecords++;
+    }
+
+    dict = savior.mHash->getDict("ints");
+    for (int idx=0; (dict) && (idx<_SALVAGE_TEST_INTS); ++idx) {
+        if (dict->getValue<Ookala::IntDictItem>(_intKey(idx), value)) {
+            TEST_CHECK(value == idx * 11);
+            loaded.mInts++;
+        }
+    }
+
+    return loaded;
+}
+
+// -----------------------------------
+
+void
+_testCut()
+{
+    _TestSavior savior;
+    _Loaded     loaded;
+    std::string data;
+
+    printf("cut to 2/3\n");
+
+    _save(_SALVAGE_TEST_XML);
+    data = _readFile(_SALVAGE_TEST_XML);
+    _writeFile(_SALVAGE_TEST_XML, data.substr(0, data.size() * 2 / 3));
+
+    // The luts come first, so every record up to the cut is whole.
+    // The ints were all past it.
+    loaded = _load(savior, _SALVAGE_TEST_XML);
+    TEST_CHECK(loaded.mRecords > 0);
+    TEST_CHECK(loaded.mRecords < _SALVAGE_TEST_RECORDS);
+    for (int idx=0; idx<loaded.mRecords; ++idx) {
+        TEST_CHECK(loaded.mHave[idx]);
+    }
+    TEST_CHECK(loaded.mInts == 0);
+    TEST_CHECK(loaded.mLutless == 0);
+}
+
+void
+_testLut()
+{
+    _TestSavior savior;
+    _Loaded     loaded;
+    std::string data;
+    size_t      pos;
+
+    printf("flipped lut byte\n");
+
+    _save(_SALVAGE_TEST_XML);
+    data = _readFile(_SALVAGE_TEST_XML);
+
+    // Change a base64 digit, so it's still well formed.
+    pos = data.find("<packed", data.find("<lut "));
+    TEST_CHECK(pos != std::string::npos);
+    pos = data.find('>', pos) + 8;
+    data[pos] = (data[pos] == 'A')? 'B': 'A';
+    _writeFile(_SALVAGE_TEST_XML, data);
+
+    // One record loses its lut, and comes back without it rather
+    // than with a wrong one.
+    loaded = _load(savior, _SALVAGE_TEST_XML);
+    TEST_CHECK(loaded.mRecords == _SALVAGE_TEST_RECORDS - 1);
+    TEST_CHECK(loaded.mLutless == 1);
+    TEST_CHECK(loaded.mInts == _SALVAGE_TEST_INTS);
+}
+
+void
+_testZeroed()
+{
+    _TestSavior savior;
+    _Loaded     loaded;
+    std::string data;
+    size_t      pos;
+
+    printf("zeroed range\n");
+
+    _save(_SALVAGE_TEST_XML);
+    data = _readFile(_SALVAGE_TEST_XML);
+
+    pos = data.find(_recordKey(_SALVAGE_TEST_RECORDS / 2));
+    TEST_CHECK(pos != std::string::npos);
+    memset(&data[pos + 100], 0, 200);
+    _writeFile(_SALVAGE_TEST_XML, data);
+
+    loaded = _load(savior, _SALVAGE_TEST_XML);
+    TEST_CHECK(!loaded.mHave[_SALVAGE_TEST_RECORDS / 2]);
+    TEST_CHECK(loaded.mRecords == _SALVAGE_TEST_RECORDS - 1);
+    TEST_CHECK(loaded.mInts == _SALVAGE_TEST_INTS);
+    TEST_CHECK(loaded.mLutless == 0);
+}
+
+void
+_testDictEnd()
+{
+    _TestSavior savior;
+    _Loaded     loaded;
+    std::string data;
+    size_t      pos;
+    int32_t     value;
+
+    printf("broken </dict>\n");
+
+    _save(_SALVAGE_TEST_XML);
+    data = _readFile(_SALVAGE_TEST_XML);
+
+    pos = data.find("</dict>");
+    TEST_CHECK(pos != std::string::npos);
+    data[pos + 5] = 'x';
+    _writeFile(_SALVAGE_TEST_XML, data);
+
+    // Nothing's actually lost, and the ints stay in their own dict.
+    loaded = _load(savior, _SALVAGE_TEST_XML);
+    TEST_CHECK(loaded.mRecords == _SALVAGE_TEST_RECORDS);
+    TEST_CHECK(loaded.mInts == _SALVAGE_TEST_INTS);
+    TEST_CHECK(loaded.mLutless == 0);
+    TEST_CHECK(!savior.mHash->getDict("calib")->getValue<
+                        Ookala::IntDictItem>(_intKey(0), value));
+}
+
+void
+_testItemCrc()
+{
+    _TestSavior savior;
+    _Loaded     loaded;
+    std::string data;
+    size_t      pos;
+    int32_t     value;
+
+    printf("changed item\n");
+
+    _save(_SALVAGE_TEST_XML);
+    data = _readFile(_SALVAGE_TEST_XML);
+
+    // int03 holds 33; make it 34.
+    pos = data.find(">33<", data.find(_intKey(3)));
+    TEST_CHECK(pos != std::string::npos);
+    data[pos + 2] = '4';
+    _writeFile(_SALVAGE_TEST_XML, data);
+
+    loaded = _load(savior, _SALVAGE_TEST_XML);
+    TEST_CHECK(loaded.mRecords == _SALVAGE_TEST_RECORDS);
+    TEST_CHECK(loaded.mInts == _SALVAGE_TEST_INTS - 1);
+    TEST_CHECK(loaded.mLutless == 0);
+    TEST_CHECK(!savior.mHash->getDict("ints")->getValue<
+                        Ookala::IntDictItem>(_intKey(3), value));
+}
+
+void
+_testJournal()
+{
+    _Loaded     loaded;
+    std::string data;
+    uint32_t    seed = 12345;
+    size_t      pos;
+
+    printf("scrambled journal\n");
+
+    _save(_SALVAGE_TEST_JOURNAL);
+    data = _readFile(_SALVAGE_TEST_JOURNAL);
+
+    pos = data.find(_recordKey(_SALVAGE_TEST_RECORDS / 2));
+    TEST_CHECK(pos != std::string::npos);
+    for (size_t idx=pos; idx<pos+300; ++idx) {
+        seed      = seed * 1103515245 + 12345;
+        data[idx] = (char)(seed >> 16);
+    }
+    _writeFile(_SALVAGE_TEST_JOURNAL, data);
+
+    {
+        _TestSavior                 savior;
+        std::vector<Ookala::Dict *> dicts;
+
+        loaded = _load(savior, _SALVAGE_TEST_JOURNAL);
+        TEST_CHECK(!loaded.mHave[_SALVAGE_TEST_RECORDS / 2]);
+        TEST_CHECK(loaded.mRecords >= _SALVAGE_TEST_RECORDS - 2);
+        TEST_CHECK(loaded.mInts == _SALVAGE_TEST_INTS);
+
+        // Saving what's left compacts the damage away, once the
+        // savior is done with the file.
+        savior.mHash->getDict("ints")->set<Ookala::IntDictItem>(
+                                        std::string("saved"), 1);
+        dicts.push_back(savior.mHash->getDict("calib"));
+        dicts.push_back(savior.mHash->getDict("ints"));
+        TEST_CHECK(savior.mSavior->save(dicts,
+                        std::vector<std::string>(1, _SALVAGE_TEST_JOURNAL)));
+    }
+
+    {
+        _TestSavior savior;
+        _Loaded     again;
+
+        again = _load(savior, _SALVAGE_TEST_JOURNAL);
+        TEST_CHECK(again.mRecords == loaded.mRecords);
+        TEST_CHECK(again.mInts == _SALVAGE_TEST_INTS);
+    }
+
+    TEST_CHECK(_readFile(_SALVAGE_TEST_JOURNAL).find(
+                            data.substr(pos, 300)) == std::string::npos);
+}
+
+}; // anonymous namespace
+
+
+int
+main(int argc, char **argv)
+{
+    _testCut();
+    _testLut();
+    _testZeroed();
+    _testDictEnd();
+    _testItemCrc();
+    _testJournal();
+
+    _removeFiles(_SALVAGE_TEST_XML);
+    _removeFiles(_SALVAGE_TEST_JOURNAL);
+
+    printf("ok\n");
+
+    return 0;
+}